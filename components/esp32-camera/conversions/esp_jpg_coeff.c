@@ -0,0 +1,465 @@
+#include <stdlib.h>
+#include <string.h>
+#include "esp_jpg_coeff.h"
+
+/*
+ * Codes up to HUFF_LOOKUP_BITS long, which are nearly all of them in a
+ * camera frame, decode with one table lookup; longer ones fall back to the
+ * canonical code limits of each length.
+ */
+#define HUFF_LOOKUP_BITS 9
+
+typedef struct {
+    uint16_t lookup[1 << HUFF_LOOKUP_BITS]; /* length << 8 | symbol, 0 for longer codes */
+    int32_t maxcode[17];                    /* largest code of each length, -1 for none */
+    int32_t valoffset[17];                  /* symbol index minus code, for each length */
+    uint8_t symbols[256];
+    bool defined;
+} huff_table_t;
+
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+    size_t pos;
+    uint32_t bits;          /* MSB aligned */
+    int count;              /* bits held */
+    int pad;                /* of those, zeros fed past a marker or the end */
+    bool marker;            /* the reader has stopped at a marker */
+    huff_table_t dc[2];
+    huff_table_t ac[2];
+    uint8_t td[JPG_COEFF_COMPONENTS];
+    uint8_t ta[JPG_COEFF_COMPONENTS];
+} jpg_coeff_decoder_t;
+
+const uint8_t jpg_coeff_zigzag[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10,
+    17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34,
+    27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36,
+    29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46,
+    53, 60, 61, 54, 47, 55, 62, 63
+};
+
+static bool huff_build(huff_table_t *t, const uint8_t *counts, const uint8_t *symbols, int total)
+{
+    int code = 0;
+    int k = 0;
+
+    memset(t->lookup, 0, sizeof(t->lookup));
+    memcpy(t->symbols, symbols, total);
+    for (int l = 1; l <= 16; l++) {
+        /* more codes than the length holds, checked before they reach the lookup */
+        if (code + counts[l - 1] > (1 << l)) {
+            return false;
+        }
+        t->valoffset[l] = k - code;
+        for (int i = 0; i < counts[l - 1]; i++, k++, code++) {
+            if (l <= HUFF_LOOKUP_BITS) {
+                int shift = HUFF_LOOKUP_BITS - l;
+                for (int f = 0; f < (1 << shift); f++) {
+                    t->lookup[(code << shift) | f] = (l << 8) | symbols[k];
+                }
+            }
+        }
+        t->maxcode[l] = counts[l - 1] ? code - 1 : -1;
+        code <<= 1;
+    }
+    t->defined = true;
+    return true;
+}
+
+/* ----------
+ * bit reader
+ * ---------- */
+
+static inline void bits_fill(jpg_coeff_decoder_t *d)
+{
+    while (d->count <= 24) {
+        uint32_t byte = 0;
+        bool real = false;
+        if (!d->marker && d->pos < d->len) {
+            if (d->data[d->pos] != 0xFF) {
+                byte = d->data[d->pos++];
+                real = true;
+            } else if (d->pos + 1 < d->len && d->data[d->pos + 1] == 0x00) {
+                byte = 0xFF;
+                d->pos += 2;
+                real = true;
+            } else {
+                d->marker = true;
+            }
+        }
+        if (!real) {
+            d->pad += 8;
+        }
+        d->bits |= byte << (24 - d->count);
+        d->count += 8;
+    }
+}
+
+static inline void bits_skip(jpg_coeff_decoder_t *d, int n)
+{
+    d->bits <<= n;
+    d->count -= n;
+}
+
+static inline int huff_decode(jpg_coeff_decoder_t *d, const huff_table_t *t)
+{
+    bits_fill(d);
+    uint16_t entry = t->lookup[d->bits >> (32 - HUFF_LOOKUP_BITS)];
+    if (entry) {
+        bits_skip(d, entry >> 8);
+        return entry & 0xFF;
+    }
+    for (int l = HUFF_LOOKUP_BITS + 1; l <= 16; l++) {
+        int32_t code = d->bits >> (32 - l);
+        if (code <= t->maxcode[l]) {
+            bits_skip(d, l);
+            return t->symbols[t->valoffset[l] + code];
+        }
+    }
+    return -1;
+}
+
+/* the next s bits as a signed coefficient, s is at most 16 */
+static inline int receive_extend(jpg_coeff_decoder_t *d, int s)
+{
+    bits_fill(d);
+    int v = d->bits >> (32 - s);
+    bits_skip(d, s);
+    if (v < (1 << (s - 1))) {
+        v -= (1 << s) - 1;
+    }
+    return v;
+}
+
+/* discards the bits left before a restart marker and the marker itself */
+static bool bits_restart(jpg_coeff_decoder_t *d)
+{
+    d->bits = 0;
+    d->count = 0;
+    d->pad = 0;
+    d->marker = false;
+    while (d->pos + 1 < d->len) {
+        if (d->data[d->pos] == 0xFF && d->data[d->pos + 1] >= 0xD0 && d->data[d->pos + 1] <= 0xD7) {
+            d->pos += 2;
+            return true;
+        }
+        if (d->data[d->pos] == 0xFF && d->data[d->pos + 1] != 0x00 && d->data[d->pos + 1] != 0xFF) {
+            return false;
+        }
+        d->pos++;
+    }
+    return false;
+}
+
+/* ------
+ * blocks
+ * ------ */
+
+static bool decode_block(jpg_coeff_decoder_t *d, const huff_table_t *dc, const huff_table_t *ac, jpg_coeff_mode_t mode, int16_t *pred, int16_t *coef)
+{
+    int t = huff_decode(d, dc);
+    if (t < 0 || t > 11) {
+        return false;
+    }
+    if (t) {
+        *pred += receive_extend(d, t);
+    }
+    coef[0] = *pred;
+
+    for (int k = 1; k < 64; k++) {
+        int rs = huff_decode(d, ac);
+        if (rs < 0) {
+            return false;
+        }
+        int r = rs >> 4;
+        int s = rs & 15;
+        if (s) {
+            k += r;
+            if (k > 63) {
+                return false;
+            }
+            if (mode == JPG_COEFF_ALL) {
+                coef[k] = receive_extend(d, s);
+            } else {
+                bits_fill(d);
+                bits_skip(d, s);
+            }
+        } else if (r == 15) {
+            k += 15;
+        } else {
+            break;
+        }
+    }
+    return true;
+}
+
+/* -------
+ * headers
+ * ------- */
+
+static inline uint16_t read16(const uint8_t *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+static esp_err_t parse_sof(const uint8_t *p, size_t n, jpg_coeff_info_t *info)
+{
+    if (n < 6) {
+        return ESP_FAIL;
+    }
+    if (p[0] != 8) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    info->height = read16(p + 1);
+    info->width = read16(p + 3);
+    info->components = p[5];
+    if (info->components != 1 && info->components != 3) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (!info->width || !info->height || n < 6 + 3 * info->components) {
+        return ESP_FAIL;
+    }
+    info->max_h = 1;
+    info->max_v = 1;
+    for (int i = 0; i < info->components; i++) {
+        jpg_coeff_component_t *c = &info->component[i];
+        c->id = p[6 + 3 * i];
+        c->h = p[7 + 3 * i] >> 4;
+        c->v = p[7 + 3 * i] & 15;
+        c->tq = p[8 + 3 * i] & 3;
+        if (c->h < 1 || c->h > 4 || c->v < 1 || c->v > 4) {
+            return ESP_FAIL;
+        }
+        info->max_h = c->h > info->max_h ? c->h : info->max_h;
+        info->max_v = c->v > info->max_v ? c->v : info->max_v;
+    }
+    if (info->components == 1) {
+        /* a single component scan is not interleaved, every MCU is one block */
+        info->component[0].h = info->component[0].v = 1;
+        info->max_h = info->max_v = 1;
+    }
+    info->mcus_x = (info->width + 8 * info->max_h - 1) / (8 * info->max_h);
+    info->mcus_y = (info->height + 8 * info->max_v - 1) / (8 * info->max_v);
+    for (int i = 0; i < info->components; i++) {
+        info->component[i].blocks_w = info->mcus_x * info->component[i].h;
+        info->component[i].blocks_h = info->mcus_y * info->component[i].v;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t parse_dqt(const uint8_t *p, size_t n, jpg_coeff_info_t *info)
+{
+    while (n) {
+        int pq = p[0] >> 4;
+        int tq = p[0] & 15;
+        size_t size = 1 + 64 * (pq ? 2 : 1);
+        if (tq > 3 || pq > 1 || n < size) {
+            return ESP_FAIL;
+        }
+        for (int i = 0; i < 64; i++) {
+            info->quant[tq][i] = pq ? read16(p + 1 + 2 * i) : p[1 + i];
+        }
+        p += size;
+        n -= size;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t parse_dht(const uint8_t *p, size_t n, jpg_coeff_decoder_t *d)
+{
+    while (n >= 17) {
+        int tc = p[0] >> 4;
+        int th = p[0] & 15;
+        int total = 0;
+        for (int i = 0; i < 16; i++) {
+            total += p[1 + i];
+        }
+        if (tc > 1 || th > 1 || total > 256 || n < 17 + total) {
+            return ESP_FAIL;
+        }
+        if (d && !huff_build(tc ? &d->ac[th] : &d->dc[th], p + 1, p + 17, total)) {
+            return ESP_FAIL;
+        }
+        p += 17 + total;
+        n -= 17 + total;
+    }
+    return n ? ESP_FAIL : ESP_OK;
+}
+
+static esp_err_t parse_sos(const uint8_t *p, size_t n, jpg_coeff_info_t *info, jpg_coeff_decoder_t *d)
+{
+    if (!info->components) {
+        return ESP_FAIL;
+    }
+    if (n < 1 || p[0] != info->components) {
+        /* one scan per component, which baseline allows but no camera writes */
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (n < 4 + 2 * p[0]) {
+        return ESP_FAIL;
+    }
+    for (int i = 0; i < p[0]; i++) {
+        int j = 0;
+        while (j < info->components && info->component[j].id != p[1 + 2 * i]) {
+            j++;
+        }
+        if (j == info->components) {
+            return ESP_FAIL;
+        }
+        if (d) {
+            d->td[j] = p[2 + 2 * i] >> 4;
+            d->ta[j] = p[2 + 2 * i] & 15;
+            if (d->td[j] > 1 || d->ta[j] > 1 || !d->dc[d->td[j]].defined || !d->ac[d->ta[j]].defined) {
+                return ESP_FAIL;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+/*
+ * Walks the markers up to the start of the scan, leaving pos at the first
+ * byte of entropy coded data. d may be NULL to read the headers only.
+ */
+static esp_err_t parse_headers(const uint8_t *src, size_t len, size_t *pos, jpg_coeff_info_t *info, jpg_coeff_decoder_t *d)
+{
+    memset(info, 0, sizeof(*info));
+    if (len < 4 || src[0] != 0xFF || src[1] != 0xD8) {
+        return ESP_FAIL;
+    }
+    size_t i = 2;
+    while (i + 4 <= len) {
+        if (src[i] != 0xFF) {
+            return ESP_FAIL;
+        }
+        uint8_t marker = src[i + 1];
+        if (marker == 0xFF) {
+            i++;
+            continue;
+        }
+        size_t n = read16(src + i + 2);
+        if (n < 2 || i + 2 + n > len) {
+            return ESP_FAIL;
+        }
+        const uint8_t *p = src + i + 4;
+        n -= 2;
+        esp_err_t err = ESP_OK;
+        switch (marker) {
+        case 0xC0:
+        case 0xC1:
+            err = parse_sof(p, n, info);
+            break;
+        case 0xC2: case 0xC3: case 0xC5: case 0xC6: case 0xC7:
+        case 0xC9: case 0xCA: case 0xCB: case 0xCD: case 0xCE: case 0xCF:
+            return ESP_ERR_NOT_SUPPORTED;
+        case 0xC4:
+            err = parse_dht(p, n, d);
+            break;
+        case 0xDB:
+            err = parse_dqt(p, n, info);
+            break;
+        case 0xDD:
+            info->restart_interval = n >= 2 ? read16(p) : 0;
+            break;
+        case 0xDA:
+            err = parse_sos(p, n, info, d);
+            *pos = i + 2 + n + 2;
+            return err;
+        case 0xD9:
+            return ESP_FAIL;
+        default:
+            break;
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+        i += 2 + n + 2;
+    }
+    return ESP_FAIL;
+}
+
+esp_err_t esp_jpg_coeff_info(const uint8_t *src, size_t len, jpg_coeff_info_t *info)
+{
+    size_t pos;
+    if (!src || !info) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return parse_headers(src, len, &pos, info, NULL);
+}
+
+esp_err_t esp_jpg_coeff_decode(const uint8_t *src, size_t len, jpg_coeff_mode_t mode, jpg_coeff_cb cb, void *arg, jpg_coeff_info_t *info)
+{
+    jpg_coeff_info_t local;
+    jpg_coeff_block_t block;
+    int16_t pred[JPG_COEFF_COMPONENTS] = {0};
+    bool exhausted = false;
+
+    if (!src || !cb) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!info) {
+        info = &local;
+    }
+
+    jpg_coeff_decoder_t *d = calloc(1, sizeof(jpg_coeff_decoder_t));
+    if (!d) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = parse_headers(src, len, &d->pos, info, d);
+    if (err != ESP_OK) {
+        free(d);
+        return err;
+    }
+    d->data = src;
+    d->len = len;
+
+    uint32_t mcus = 0;
+    memset(block.coef, 0, sizeof(block.coef));
+    for (int my = 0; my < info->mcus_y && err == ESP_OK; my++) {
+        for (int mx = 0; mx < info->mcus_x && err == ESP_OK; mx++, mcus++) {
+            if (info->restart_interval && mcus && !(mcus % info->restart_interval) && !exhausted) {
+                if (!bits_restart(d)) {
+                    exhausted = true;
+                }
+                memset(pred, 0, sizeof(pred));
+            }
+            for (int c = 0; c < info->components && err == ESP_OK; c++) {
+                const jpg_coeff_component_t *comp = &info->component[c];
+                for (int by = 0; by < comp->v && err == ESP_OK; by++) {
+                    for (int bx = 0; bx < comp->h; bx++) {
+                        if (mode == JPG_COEFF_ALL) {
+                            memset(block.coef + 1, 0, sizeof(block.coef) - sizeof(block.coef[0]));
+                        }
+                        if (!exhausted && d->marker && d->count <= d->pad) {
+                            exhausted = true;
+                        }
+                        if (exhausted) {
+                            /* past the end of a frame cut short */
+                            block.coef[0] = pred[c];
+                        } else if (!decode_block(d, &d->dc[d->td[c]], &d->ac[d->ta[c]], mode, &pred[c], block.coef)) {
+                            if (!d->marker) {
+                                err = ESP_FAIL;
+                                break;
+                            }
+                            exhausted = true;
+                            block.coef[0] = pred[c];
+                        }
+                        block.component = c;
+                        block.x = mx * comp->h + bx;
+                        block.y = my * comp->v + by;
+                        if (!cb(arg, info, &block)) {
+                            err = ESP_ERR_INVALID_STATE;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    free(d);
+    return err;
+}
@@ -0,0 +1,94 @@
+/*
+ * Entropy decoder for baseline JPEG that stops at the DCT coefficients.
+ *
+ * The frame is Huffman decoded block by block and each block is handed to
+ * a callback as quantized coefficients, with no dequantization and no
+ * IDCT. Reading only the DC coefficients skips the value bits of every AC
+ * coefficient, which is most of the work of a full decode, and still gives
+ * the mean of every 8x8 block: a 1/8 scale image.
+ *
+ * Baseline sequential Huffman frames only (SOF0 and SOF1 with 8 bit
+ * samples), one scan holding every component, with or without restart
+ * intervals. That covers the OV2640, OV3660 and OV5640 and jpge.
+ */
+#ifndef _ESP_JPG_COEFF_H_
+#define _ESP_JPG_COEFF_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#define JPG_COEFF_COMPONENTS 3
+
+typedef enum {
+    JPG_COEFF_DC,   /* coef[0] only, the AC coefficients are skipped */
+    JPG_COEFF_ALL,  /* all 64 coefficients */
+} jpg_coeff_mode_t;
+
+typedef struct {
+    uint8_t id;             /* component identifier from the frame header */
+    uint8_t h;              /* horizontal sampling factor */
+    uint8_t v;              /* vertical sampling factor */
+    uint8_t tq;             /* quantization table */
+    uint16_t blocks_w;      /* blocks per row, including the MCU padding */
+    uint16_t blocks_h;      /* rows of blocks, including the MCU padding */
+} jpg_coeff_component_t;
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint8_t components;     /* 1 for grayscale, 3 for YCbCr */
+    uint8_t max_h;          /* the largest sampling factors, the MCU is */
+    uint8_t max_v;          /* 8 * max_h by 8 * max_v pixels */
+    uint16_t mcus_x;
+    uint16_t mcus_y;
+    uint16_t restart_interval;  /* MCUs between restart markers, 0 for none */
+    jpg_coeff_component_t component[JPG_COEFF_COMPONENTS];
+    uint16_t quant[4][64];  /* quantization tables in zigzag order */
+} jpg_coeff_info_t;
+
+typedef struct {
+    uint8_t component;      /* index into jpg_coeff_info_t.component */
+    uint16_t x;             /* block column in the component */
+    uint16_t y;             /* block row in the component */
+    int16_t coef[64];       /* quantized, in zigzag order */
+} jpg_coeff_block_t;
+
+/*
+ * Called for every block in stream order, that is MCU by MCU and within an
+ * MCU component by component. In JPG_COEFF_DC mode only coef[0] is set.
+ * Returning false stops the decode.
+ */
+typedef bool (* jpg_coeff_cb)(void *arg, const jpg_coeff_info_t *info, const jpg_coeff_block_t *block);
+
+/* the natural (row major) index of each zigzag position */
+extern const uint8_t jpg_coeff_zigzag[64];
+
+/*
+ * Reads the headers of a frame.
+ *
+ * Returns ESP_ERR_NOT_SUPPORTED for progressive, lossless, arithmetic coded
+ * and 12 bit frames and ESP_FAIL for a frame that is not a valid JPEG.
+ */
+esp_err_t esp_jpg_coeff_info(const uint8_t *src, size_t len, jpg_coeff_info_t *info);
+
+/*
+ * Decodes a frame, calling cb for every block. info may be NULL.
+ *
+ * Returns as esp_jpg_coeff_info, ESP_ERR_NO_MEM when the Huffman tables
+ * cannot be allocated and ESP_ERR_INVALID_STATE when the callback stopped
+ * the decode. A frame cut short decodes to the end with the missing blocks
+ * flat, as a sensor frame that lost its tail still carries the rest.
+ */
+esp_err_t esp_jpg_coeff_decode(const uint8_t *src, size_t len, jpg_coeff_mode_t mode, jpg_coeff_cb cb, void *arg, jpg_coeff_info_t *info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_JPG_COEFF_H_ */
@@ -119,6 +119,110 @@ bool frame2bmp(camera_fb_t * fb, uint8_t ** out, size_t * out_len);
  */
 bool fmt2rgb888(const uint8_t *src_buf, size_t src_len, pixformat_t format, uint8_t * rgb_buf);
 
+/**
+ * @brief Decode a 1/8 scale image from a JPEG buffer
+ *
+ * Each pixel is the mean of an 8x8 block, read from the DC coefficients
+ * alone. There is no IDCT, so this costs a fraction of esp_jpg_decode with
+ * JPG_SCALE_8X. RGB888 pixels are stored in the same byte order as
+ * fmt2rgb888 produces, and the result can be encoded again with fmt2jpg.
+ * Only baseline JPEG is supported.
+ *
+ * @param src       Source buffer in JPEG format
+ * @param src_len   Length in bytes of the source buffer
+ * @param format    Format of the output image, RGB888 or GRAYSCALE
+ * @param out       Pointer to the output buffer
+ * @param out_len   Length in bytes of the output buffer, at least
+ *                  ((width + 7) / 8) * ((height + 7) / 8) * 3 for RGB888
+ * @param width     Pointer to be populated with the width of the output image
+ * @param height    Pointer to be populated with the height of the output image
+ *
+ * @return true on success
+ */
+bool jpg2thumbnail(const uint8_t *src, size_t src_len, pixformat_t format, uint8_t *out, size_t out_len, uint16_t *width, uint16_t *height);
+
+typedef enum {
+    JPG_TRANSFORM_NONE,
+    JPG_TRANSFORM_FLIP_H,       /* mirrored left to right */
+    JPG_TRANSFORM_FLIP_V,       /* mirrored top to bottom */
+    JPG_TRANSFORM_ROT_180,
+    JPG_TRANSFORM_TRANSPOSE,    /* mirrored across the diagonal from the top left */
+    JPG_TRANSFORM_ROT_90,       /* clockwise */
+    JPG_TRANSFORM_ROT_270,
+    JPG_TRANSFORM_TRANSVERSE,   /* mirrored across the diagonal from the top right */
+} jpg_transform_t;
+
+/**
+ * @brief Rotate or mirror a JPEG without decoding it, with callback
+ *
+ * The quantized DCT coefficients are rearranged and coded again, as
+ * jpegtran does, so no quality is lost and there is no IDCT, DCT or colour
+ * conversion. Where the frame is not a whole number of MCUs along a
+ * mirrored axis the partial MCUs are trimmed off. The output uses the
+ * standard Huffman tables and no restart markers. Only baseline JPEG with
+ * one chroma quantization table is supported.
+ *
+ * @param src       Source buffer in JPEG format
+ * @param src_len   Length in bytes of the source buffer
+ * @param transform How to rotate or mirror the image
+ * @param cb        Callback to be called to write the bytes of the output JPEG
+ * @param arg       Pointer to be passed to the callback
+ *
+ * @return true on success
+ */
+bool jpg_transform_cb(const uint8_t *src, size_t src_len, jpg_transform_t transform, jpg_out_cb cb, void *arg);
+
+/**
+ * @brief Rotate or mirror a JPEG without decoding it, into a new buffer
+ *
+ * As jpg_transform_cb. The output buffer is allocated and must be freed.
+ *
+ * @param src       Source buffer in JPEG format
+ * @param src_len   Length in bytes of the source buffer
+ * @param transform How to rotate or mirror the image
+ * @param out       Pointer to be populated with the address of the resulting buffer
+ * @param out_len   Pointer to be populated with the length of the output buffer
+ *
+ * @return true on success
+ */
+bool jpg_transform(const uint8_t *src, size_t src_len, jpg_transform_t transform, uint8_t **out, size_t *out_len);
+
+/**
+ * @brief Reduce the quality of a JPEG without decoding it, with callback
+ *
+ * The quantized DCT coefficients are divided again to the coarser of the
+ * source's tables and those fmt2jpg uses at the quality given, and coded
+ * again, so there is no IDCT, DCT or colour conversion and the size and
+ * sampling stay as they were. The output uses the standard Huffman tables
+ * and no restart markers. Where the tables come out as the source's own,
+ * the source is written out unchanged instead. Only baseline JPEG is
+ * supported.
+ *
+ * @param src       Source buffer in JPEG format
+ * @param src_len   Length in bytes of the source buffer
+ * @param quality   JPEG quality of the output image, 1 - 100
+ * @param cb        Callback to be called to write the bytes of the output JPEG
+ * @param arg       Pointer to be passed to the callback
+ *
+ * @return true on success
+ */
+bool jpg_requantize_cb(const uint8_t *src, size_t src_len, int quality, jpg_out_cb cb, void *arg);
+
+/**
+ * @brief Reduce the quality of a JPEG without decoding it, into a new buffer
+ *
+ * As jpg_requantize_cb. The output buffer is allocated and must be freed.
+ *
+ * @param src       Source buffer in JPEG format
+ * @param src_len   Length in bytes of the source buffer
+ * @param quality   JPEG quality of the output image, 1 - 100
+ * @param out       Pointer to be populated with the address of the resulting buffer
+ * @param out_len   Pointer to be populated with the length of the output buffer
+ *
+ * @return true on success
+ */
+bool jpg_requantize(const uint8_t *src, size_t src_len, int quality, uint8_t **out, size_t *out_len);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,447 @@
+#include <stdlib.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_jpg_coeff.h"
+#include "img_converters.h"
+#include "jpge.h"
+
+/*
+ * JPEG to JPEG without leaving the DCT domain. The frame is entropy decoded
+ * to its quantized coefficients with esp_jpg_coeff, the blocks are changed
+ * as they are, and jpge codes them again with its standard Huffman tables.
+ * There is no IDCT, DCT or colour conversion, so nothing is lost to them.
+ *
+ * Rotating and mirroring work as jpegtran does. Mirroring a block is
+ * negating its odd frequencies along that axis and transposing it is
+ * transposing its coefficients, and the quantization tables with them. The
+ * blocks move to their mirrored or transposed places, which needs the whole
+ * frame, so the coefficients are kept until the last block is decoded.
+ * Blocks that only pad the last MCU cannot be mirrored into place, so a
+ * frame whose size is not a whole number of MCUs along a mirrored axis is
+ * trimmed to one, as jpegtran -trim does. The sensors' frame sizes are all
+ * whole MCUs.
+ *
+ * Requantizing divides each coefficient again, by the ratio of a coarser
+ * table to the one it was quantized with, which rounds away the detail the
+ * coarser table would have and leaves more zeros for the entropy coder.
+ * The blocks keep their order, so they are coded as they are decoded and
+ * nothing is kept.
+ */
+
+#define STORE_PAGE      (16 * 1024)
+#define STORE_BLOCK     (1 + 64 * 3)    /* the most one block takes in a page */
+#define STORE_FLAT      0xffffffff      /* a block never stored, all zero */
+
+static void *_malloc(size_t size)
+{
+    void * res = malloc(size);
+    if(res) {
+        return res;
+    }
+    return heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+}
+
+static void *_realloc(void *ptr, size_t size)
+{
+    void * res = realloc(ptr, size);
+    if(res) {
+        return res;
+    }
+    return heap_caps_realloc(ptr, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+}
+
+/* how each transform moves the source: mirrored, then transposed */
+typedef struct {
+    bool flip_x;
+    bool flip_y;
+    bool transpose;
+} transform_ops_t;
+
+/* in the order of jpg_transform_t */
+static const transform_ops_t transform_ops[] = {
+    { false, false, false },    /* JPG_TRANSFORM_NONE */
+    { true,  false, false },    /* JPG_TRANSFORM_FLIP_H */
+    { false, true,  false },    /* JPG_TRANSFORM_FLIP_V */
+    { true,  true,  false },    /* JPG_TRANSFORM_ROT_180 */
+    { false, false, true  },    /* JPG_TRANSFORM_TRANSPOSE */
+    { false, true,  true  },    /* JPG_TRANSFORM_ROT_90 */
+    { true,  false, true  },    /* JPG_TRANSFORM_ROT_270 */
+    { true,  true,  true  },    /* JPG_TRANSFORM_TRANSVERSE */
+};
+
+/*
+ * The quantized coefficients of a frame, only those that are not zero,
+ * which at the sensors' qualities is a small part of them. Each block is a
+ * count and then zigzag position and value for each coefficient, packed
+ * into pages that are allocated as the frame is decoded.
+ */
+typedef struct {
+    uint8_t **pages;
+    size_t page_count;
+    size_t page_limit;
+    size_t used;            /* of the last page */
+    uint32_t *blocks;       /* where each block starts, by component, row and column */
+    uint32_t base[JPG_COEFF_COMPONENTS];
+    uint16_t keep_w[JPG_COEFF_COMPONENTS];
+    uint16_t keep_h[JPG_COEFF_COMPONENTS];
+    bool failed;
+} store_t;
+
+static void store_free(store_t *s)
+{
+    for (size_t i = 0; i < s->page_count; i++) {
+        free(s->pages[i]);
+    }
+    free(s->pages);
+    free(s->blocks);
+}
+
+static bool store_block(void *arg, const jpg_coeff_info_t *info, const jpg_coeff_block_t *block)
+{
+    store_t *s = (store_t *)arg;
+    int c = block->component;
+
+    /* trimmed away */
+    if (block->x >= s->keep_w[c] || block->y >= s->keep_h[c]) {
+        return true;
+    }
+
+    if (s->page_count == 0 || s->used + STORE_BLOCK > STORE_PAGE) {
+        if (s->page_count == s->page_limit) {
+            size_t limit = s->page_limit ? s->page_limit * 2 : 16;
+            uint8_t **pages = (uint8_t **)_realloc(s->pages, limit * sizeof(uint8_t *));
+            if (!pages) {
+                s->failed = true;
+                return false;
+            }
+            s->pages = pages;
+            s->page_limit = limit;
+        }
+        if ((s->pages[s->page_count] = (uint8_t *)_malloc(STORE_PAGE)) == NULL) {
+            s->failed = true;
+            return false;
+        }
+        s->page_count++;
+        s->used = 0;
+    }
+
+    uint8_t *start = s->pages[s->page_count - 1] + s->used;
+    uint8_t *p = start + 1;
+    for (int i = 0; i < 64; i++) {
+        if (block->coef[i]) {
+            p[0] = i;
+            p[1] = block->coef[i] & 0xff;
+            p[2] = (uint16_t)block->coef[i] >> 8;
+            p += 3;
+        }
+    }
+    *start = (p - start - 1) / 3;
+
+    s->blocks[s->base[c] + block->y * s->keep_w[c] + block->x] = (s->page_count - 1) * STORE_PAGE + s->used;
+    s->used += p - start;
+    return true;
+}
+
+/* a stored block, each coefficient moved to where the transform puts it */
+static void store_load(const store_t *s, int c, int x, int y, const uint8_t *to, const int8_t *sign, int16_t *coef)
+{
+    uint32_t at = s->blocks[s->base[c] + y * s->keep_w[c] + x];
+
+    memset(coef, 0, 64 * sizeof(int16_t));
+    if (at == STORE_FLAT) {
+        return;
+    }
+    const uint8_t *p = s->pages[at / STORE_PAGE] + at % STORE_PAGE;
+    for (int n = *p++; n; n--, p += 3) {
+        coef[to[p[0]]] = sign[p[0]] * (int16_t)(p[1] | (p[2] << 8));
+    }
+}
+
+class recode_stream : public jpge::output_stream {
+protected:
+    jpg_out_cb ocb;
+    void * oarg;
+    size_t index;
+
+public:
+    recode_stream(jpg_out_cb cb, void * arg) : ocb(cb), oarg(arg), index(0) { }
+    virtual ~recode_stream() { }
+    virtual bool put_buf(const void* data, int len)
+    {
+        if (!data) {
+            return true;
+        }
+        size_t written = ocb(oarg, index, data, len);
+        index += written;
+        return written == (size_t)len;
+    }
+    virtual jpge::uint get_size() const
+    {
+        return index;
+    }
+};
+
+/* the two tables jpge codes with, luma and chroma, in zigzag order */
+static bool recode_tables(const jpg_coeff_info_t *info, uint16_t quant[2][64])
+{
+    if (info->components == 3 && info->component[1].tq != info->component[2].tq) {
+        return false;
+    }
+    memcpy(quant[0], info->quant[info->component[0].tq], sizeof(quant[0]));
+    memcpy(quant[1], info->quant[info->component[info->components == 3 ? 1 : 0].tq], sizeof(quant[1]));
+    return true;
+}
+
+bool jpg_transform_cb(const uint8_t *src, size_t src_len, jpg_transform_t transform, jpg_out_cb cb, void *arg)
+{
+    jpg_coeff_info_t info;
+    uint16_t quant[2][64];
+    uint16_t out_quant[2][64];
+    uint8_t h[JPG_COEFF_COMPONENTS];
+    uint8_t v[JPG_COEFF_COMPONENTS];
+    uint8_t from[64];
+    uint8_t to[64];
+    int8_t sign[64];
+    uint8_t natural[64];
+
+    if (!src || !cb || (unsigned)transform > JPG_TRANSFORM_TRANSVERSE) {
+        return false;
+    }
+    if (esp_jpg_coeff_info(src, src_len, &info) != ESP_OK || !recode_tables(&info, quant)) {
+        return false;
+    }
+
+    const transform_ops_t *ops = &transform_ops[transform];
+    int mcu_w = 8 * info.max_h;
+    int mcu_h = 8 * info.max_v;
+    int width = ops->flip_x ? info.width / mcu_w * mcu_w : info.width;
+    int height = ops->flip_y ? info.height / mcu_h * mcu_h : info.height;
+
+    if (width == 0 || height == 0) {
+        return false;
+    }
+
+    /* where each source coefficient goes, and whether it changes sign */
+    for (int i = 0; i < 64; i++) {
+        natural[jpg_coeff_zigzag[i]] = i;
+    }
+    for (int i = 0; i < 64; i++) {
+        int row = jpg_coeff_zigzag[i] / 8;
+        int col = jpg_coeff_zigzag[i] % 8;
+        to[i] = ops->transpose ? natural[col * 8 + row] : i;
+        from[to[i]] = i;
+        sign[i] = ((ops->flip_x && (col & 1)) != (ops->flip_y && (row & 1))) ? -1 : 1;
+    }
+    for (int t = 0; t < 2; t++) {
+        for (int i = 0; i < 64; i++) {
+            out_quant[t][i] = quant[t][from[i]];
+        }
+    }
+
+    store_t s;
+    memset(&s, 0, sizeof(s));
+    size_t total = 0;
+    for (int c = 0; c < info.components; c++) {
+        const jpg_coeff_component_t *comp = &info.component[c];
+        s.base[c] = total;
+        s.keep_w[c] = ops->flip_x ? width / mcu_w * comp->h : comp->blocks_w;
+        s.keep_h[c] = ops->flip_y ? height / mcu_h * comp->v : comp->blocks_h;
+        total += s.keep_w[c] * s.keep_h[c];
+        h[c] = ops->transpose ? comp->v : comp->h;
+        v[c] = ops->transpose ? comp->h : comp->v;
+    }
+
+    if ((s.blocks = (uint32_t *)_malloc(total * sizeof(uint32_t))) == NULL) {
+        return false;
+    }
+    memset(s.blocks, 0xff, total * sizeof(uint32_t));
+
+    if (esp_jpg_coeff_decode(src, src_len, JPG_COEFF_ALL, store_block, &s, NULL) != ESP_OK || s.failed) {
+        store_free(&s);
+        return false;
+    }
+
+    /* the output is coded MCU by MCU of its own, transposed if the frame is */
+    int out_w = ops->transpose ? height : width;
+    int out_h = ops->transpose ? width : height;
+    int out_max_h = ops->transpose ? info.max_v : info.max_h;
+    int out_max_v = ops->transpose ? info.max_h : info.max_v;
+    int mcus_x = (out_w + 8 * out_max_h - 1) / (8 * out_max_h);
+    int mcus_y = (out_h + 8 * out_max_v - 1) / (8 * out_max_v);
+    recode_stream stream(cb, arg);
+    jpge::jpeg_encoder encoder;
+    int16_t out[64];
+    bool ok = encoder.init_coefficients(&stream, out_w, out_h, info.components, h, v, out_quant);
+
+    for (int my = 0; ok && my < mcus_y; my++) {
+        for (int mx = 0; ok && mx < mcus_x; mx++) {
+            for (int c = 0; ok && c < info.components; c++) {
+                for (int by = 0; ok && by < v[c]; by++) {
+                    for (int bx = 0; ok && bx < h[c]; bx++) {
+                        int x = mx * h[c] + bx;
+                        int y = my * v[c] + by;
+                        if (ops->transpose) {
+                            int t = x;
+                            x = y;
+                            y = t;
+                        }
+                        if (ops->flip_x) {
+                            x = s.keep_w[c] - 1 - x;
+                        }
+                        if (ops->flip_y) {
+                            y = s.keep_h[c] - 1 - y;
+                        }
+                        store_load(&s, c, x, y, to, sign, out);
+                        ok = encoder.code_coefficients(c, out);
+                    }
+                }
+            }
+        }
+    }
+
+    store_free(&s);
+    return ok && encoder.finish_coefficients();
+}
+
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    size_t size;
+} growing_t;
+
+static size_t growing_write(void *arg, size_t index, const void *data, size_t len)
+{
+    growing_t *g = (growing_t *)arg;
+
+    if (g->len + len > g->size) {
+        size_t size = (g->len + len) * 5 / 4;
+        uint8_t *buf = (uint8_t *)_realloc(g->buf, size);
+        if (!buf) {
+            return 0;
+        }
+        g->buf = buf;
+        g->size = size;
+    }
+    memcpy(g->buf + g->len, data, len);
+    g->len += len;
+    return len;
+}
+
+bool jpg_transform(const uint8_t *src, size_t src_len, jpg_transform_t transform, uint8_t **out, size_t *out_len)
+{
+    /* the standard tables code a sensor frame in about the same size */
+    growing_t g = { (uint8_t *)_malloc(src_len + src_len / 8 + 1024), 0, src_len + src_len / 8 + 1024 };
+
+    if (!g.buf) {
+        return false;
+    }
+    if (!jpg_transform_cb(src, src_len, transform, growing_write, &g)) {
+        free(g.buf);
+        return false;
+    }
+    *out = g.buf;
+    *out_len = g.len;
+    return true;
+}
+
+typedef struct {
+    jpge::jpeg_encoder *encoder;
+    uint16_t from[JPG_COEFF_COMPONENTS][64];    /* the source table of each component */
+    uint16_t to[JPG_COEFF_COMPONENTS][64];      /* and the table it is coded with */
+    bool ok;
+} requantize_t;
+
+static bool requantize_block(void *arg, const jpg_coeff_info_t *info, const jpg_coeff_block_t *block)
+{
+    requantize_t *r = (requantize_t *)arg;
+    const uint16_t *from = r->from[block->component];
+    const uint16_t *to = r->to[block->component];
+    int16_t out[64];
+
+    for (int i = 0; i < 64; i++) {
+        int32_t c = block->coef[i];
+        if (c == 0 || from[i] == to[i]) {
+            out[i] = c;
+        } else if (c > 0) {
+            out[i] = (2 * c * from[i] + to[i]) / (2 * to[i]);
+        } else {
+            out[i] = -((-2 * c * from[i] + to[i]) / (2 * to[i]));
+        }
+    }
+    r->ok = r->encoder->code_coefficients(block->component, out);
+    return r->ok;
+}
+
+bool jpg_requantize_cb(const uint8_t *src, size_t src_len, int quality, jpg_out_cb cb, void *arg)
+{
+    jpg_coeff_info_t info;
+    uint16_t quant[2][64];
+    uint8_t h[JPG_COEFF_COMPONENTS];
+    uint8_t v[JPG_COEFF_COMPONENTS];
+
+    if (!src || !cb || quality < 1 || quality > 100) {
+        return false;
+    }
+    if (esp_jpg_coeff_info(src, src_len, &info) != ESP_OK) {
+        return false;
+    }
+
+    /* never finer than the source, which would only spend bits on its rounding */
+    jpge::jpeg_encoder::quality_tables(quality, quant);
+    for (int c = 0; c < info.components; c++) {
+        const uint16_t *from = info.quant[info.component[c].tq];
+        uint16_t *to = quant[c ? 1 : 0];
+        for (int i = 0; i < 64; i++) {
+            if (from[i] > to[i]) {
+                to[i] = from[i] > 255 ? 255 : from[i];
+            }
+        }
+        h[c] = info.component[c].h;
+        v[c] = info.component[c].v;
+    }
+
+    /* the chroma components share a table, so compare only once it is final */
+    requantize_t r;
+    bool same = true;
+    for (int c = 0; c < info.components; c++) {
+        memcpy(r.from[c], info.quant[info.component[c].tq], sizeof(r.from[c]));
+        memcpy(r.to[c], quant[c ? 1 : 0], sizeof(r.to[c]));
+        same = same && memcmp(r.from[c], r.to[c], sizeof(r.to[c])) == 0;
+    }
+
+    /* every coefficient would come out as it went in, the source is the answer */
+    if (same) {
+        return cb(arg, 0, src, src_len) == src_len;
+    }
+
+    recode_stream stream(cb, arg);
+    jpge::jpeg_encoder encoder;
+
+    r.encoder = &encoder;
+    r.ok = true;
+
+    if (!encoder.init_coefficients(&stream, info.width, info.height, info.components, h, v, quant)) {
+        return false;
+    }
+    if (esp_jpg_coeff_decode(src, src_len, JPG_COEFF_ALL, requantize_block, &r, NULL) != ESP_OK || !r.ok) {
+        return false;
+    }
+    return encoder.finish_coefficients();
+}
+
+bool jpg_requantize(const uint8_t *src, size_t src_len, int quality, uint8_t **out, size_t *out_len)
+{
+    /* coarser tables never make the frame much bigger */
+    growing_t g = { (uint8_t *)_malloc(src_len + 1024), 0, src_len + 1024 };
+
+    if (!g.buf) {
+        return false;
+    }
+    if (!jpg_requantize_cb(src, src_len, quality, growing_write, &g)) {
+        free(g.buf);
+        return false;
+    }
+    *out = g.buf;
+    *out_len = g.len;
+    return true;
+}
@@ -178,6 +178,24 @@ namespace jpge {
         }
     }
 
+    // The standard Huffman tables, shared by every encoder.
+    static void init_huffman_tables()
+    {
+        if(!m_huff_initialized){
+            m_huff_initialized = true;
+
+            memcpy(m_huff_bits[0+0], s_dc_lum_bits, 17);    memcpy(m_huff_val[0+0], s_dc_lum_val, DC_LUM_CODES);
+            memcpy(m_huff_bits[2+0], s_ac_lum_bits, 17);    memcpy(m_huff_val[2+0], s_ac_lum_val, AC_LUM_CODES);
+            memcpy(m_huff_bits[0+1], s_dc_chroma_bits, 17); memcpy(m_huff_val[0+1], s_dc_chroma_val, DC_CHROMA_CODES);
+            memcpy(m_huff_bits[2+1], s_ac_chroma_bits, 17); memcpy(m_huff_val[2+1], s_ac_chroma_val, AC_CHROMA_CODES);
+
+            compute_huffman_table(&m_huff_codes[0+0][0], &m_huff_code_sizes[0+0][0], m_huff_bits[0+0], m_huff_val[0+0]);
+            compute_huffman_table(&m_huff_codes[2+0][0], &m_huff_code_sizes[2+0][0], m_huff_bits[2+0], m_huff_val[2+0]);
+            compute_huffman_table(&m_huff_codes[0+1][0], &m_huff_code_sizes[0+1][0], m_huff_bits[0+1], m_huff_val[0+1]);
+            compute_huffman_table(&m_huff_codes[2+1][0], &m_huff_code_sizes[2+1][0], m_huff_bits[2+1], m_huff_val[2+1]);
+        }
+    }
+
     void jpeg_encoder::flush_output_buffer()
     {
         if (m_out_buf_left != JPGE_OUT_BUF_SIZE) {
@@ -546,13 +564,17 @@ namespace jpge {
     }
 
     // Quantization table generation.
-    void jpeg_encoder::compute_quant_table(int32 *pDst, const int16 *pSrc)
+    static int32 quant_scale(int quality)
     {
-        int32 q;
-        if (m_params.m_quality < 50)
-            q = 5000 / m_params.m_quality;
+        if (quality < 50)
+            return 5000 / quality;
         else
-            q = 200 - m_params.m_quality * 2;
+            return 200 - quality * 2;
+    }
+
+    void jpeg_encoder::compute_quant_table(int32 *pDst, const int16 *pSrc)
+    {
+        int32 q = quant_scale(m_params.m_quality);
         for (int i = 0; i < 64; i++)
         {
             int32 j = *pSrc++; j = (j * q + 50L) / 100L;
@@ -560,6 +582,16 @@ namespace jpge {
         }
     }
 
+    void jpeg_encoder::quality_tables(int quality, uint16 quant[2][64])
+    {
+        int32 q = quant_scale(JPGE_MIN(JPGE_MAX(quality, 1), 100));
+        for (int i = 0; i < 64; i++)
+        {
+            quant[0][i] = (uint16)JPGE_MIN(JPGE_MAX((s_std_lum_quant[i] * q + 50L) / 100L, 1), 255);
+            quant[1][i] = (uint16)JPGE_MIN(JPGE_MAX((s_std_croma_quant[i] * q + 50L) / 100L, 1), 255);
+        }
+    }
+
     // Higher-level methods.
     bool jpeg_encoder::jpg_open(int p_x_res, int p_y_res, int src_channels)
     {
@@ -619,20 +651,14 @@ namespace jpge {
             compute_quant_table(m_quantization_tables[1], s_std_croma_quant);
         }
 
-        if(!m_huff_initialized){
-            m_huff_initialized = true;
-
-            memcpy(m_huff_bits[0+0], s_dc_lum_bits, 17);    memcpy(m_huff_val[0+0], s_dc_lum_val, DC_LUM_CODES);
-            memcpy(m_huff_bits[2+0], s_ac_lum_bits, 17);    memcpy(m_huff_val[2+0], s_ac_lum_val, AC_LUM_CODES);
-            memcpy(m_huff_bits[0+1], s_dc_chroma_bits, 17); memcpy(m_huff_val[0+1], s_dc_chroma_val, DC_CHROMA_CODES);
-            memcpy(m_huff_bits[2+1], s_ac_chroma_bits, 17); memcpy(m_huff_val[2+1], s_ac_chroma_val, AC_CHROMA_CODES);
+        init_huffman_tables();
+        emit_headers();
 
-            compute_huffman_table(&m_huff_codes[0+0][0], &m_huff_code_sizes[0+0][0], m_huff_bits[0+0], m_huff_val[0+0]);
-            compute_huffman_table(&m_huff_codes[2+0][0], &m_huff_code_sizes[2+0][0], m_huff_bits[2+0], m_huff_val[2+0]);
-            compute_huffman_table(&m_huff_codes[0+1][0], &m_huff_code_sizes[0+1][0], m_huff_bits[0+1], m_huff_val[0+1]);
-            compute_huffman_table(&m_huff_codes[2+1][0], &m_huff_code_sizes[2+1][0], m_huff_bits[2+1], m_huff_val[2+1]);
-        }
+        return m_all_stream_writes_succeeded;
+    }
 
+    void jpeg_encoder::emit_headers()
+    {
         m_out_buf_left = JPGE_OUT_BUF_SIZE;
         m_pOut_buf = m_out_buf;
         m_bit_buffer = 0;
@@ -648,8 +674,15 @@ namespace jpge {
         emit_sof();
         emit_dhts();
         emit_sos();
+    }
 
-        return m_all_stream_writes_succeeded;
+    void jpeg_encoder::emit_end_of_image()
+    {
+        put_bits(0x7F, 7);
+        emit_marker(M_EOI);
+        flush_output_buffer();
+        m_all_stream_writes_succeeded = m_all_stream_writes_succeeded && m_pStream->put_buf(NULL, 0);
+        m_pass_num++; // purposely bump up m_pass_num, for debugging
     }
 
     bool jpeg_encoder::process_end_of_image()
@@ -663,11 +696,7 @@ namespace jpge {
             process_mcu_row();
         }
 
-        put_bits(0x7F, 7);
-        emit_marker(M_EOI);
-        flush_output_buffer();
-        m_all_stream_writes_succeeded = m_all_stream_writes_succeeded && m_pStream->put_buf(NULL, 0);
-        m_pass_num++; // purposely bump up m_pass_num, for debugging
+        emit_end_of_image();
         return true;
     }
 
@@ -703,6 +732,65 @@ namespace jpge {
         clear();
     }
 
+    bool jpeg_encoder::init_coefficients(output_stream *pStream, int width, int height, int num_components,
+                                         const uint8 *h_samp, const uint8 *v_samp, const uint16 quant[2][64])
+    {
+        deinit();
+        if ((!pStream) || (width < 1) || (height < 1) || (width > 65535) || (height > 65535) || ((num_components != 1) && (num_components != 3))) {
+            return false;
+        }
+        for (int i = 0; i < num_components; i++) {
+            if ((h_samp[i] < 1) || (h_samp[i] > 4) || (v_samp[i] < 1) || (v_samp[i] > 4)) {
+                return false;
+            }
+            m_comp_h_samp[i] = h_samp[i];
+            m_comp_v_samp[i] = v_samp[i];
+        }
+        for (int i = 0; i < ((num_components == 3) ? 2 : 1); i++) {
+            for (int j = 0; j < 64; j++) {
+                if ((quant[i][j] < 1) || (quant[i][j] > 255)) {
+                    return false;
+                }
+                m_quantization_tables[i][j] = quant[i][j];
+            }
+        }
+        // the tables no longer match any quality, the next image made from pixels computes them again
+        m_last_quality = 0;
+
+        m_pStream = pStream;
+        m_num_components = num_components;
+        m_image_x = width;
+        m_image_y = height;
+
+        init_huffman_tables();
+        emit_headers();
+
+        return m_all_stream_writes_succeeded;
+    }
+
+    bool jpeg_encoder::code_coefficients(int component_num, const int16 *pCoefficients)
+    {
+        if ((m_pass_num != 2) || (component_num < 0) || (component_num >= m_num_components)) {
+            return false;
+        }
+        if (m_all_stream_writes_succeeded) {
+            memcpy(m_coefficient_array, pCoefficients, sizeof(m_coefficient_array));
+            code_coefficients_pass_two(component_num);
+        }
+        return m_all_stream_writes_succeeded;
+    }
+
+    bool jpeg_encoder::finish_coefficients()
+    {
+        if (m_pass_num != 2) {
+            return false;
+        }
+        if (m_all_stream_writes_succeeded) {
+            emit_end_of_image();
+        }
+        return m_all_stream_writes_succeeded;
+    }
+
     bool jpeg_encoder::process_scanline(const void* pScanline)
     {
         if ((m_pass_num < 1) || (m_pass_num > 2)) {
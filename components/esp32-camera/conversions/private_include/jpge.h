@@ -73,6 +73,26 @@ namespace jpge
             // Deinitializes the compressor, freeing any allocated memory. May be called at any time.
             void deinit();
 
+            // Initializes the compressor for blocks that are already transformed and quantized, such
+            // as those read from another JPEG, so they can be coded again without an IDCT or DCT.
+            // h_samp, v_samp: Sampling factors of each component.
+            // quant: The quantization tables, in zigzag order, 0 for the first component and 1 for the others.
+            // Returns false if a parameter is out of range or a stream write fails.
+            bool init_coefficients(output_stream *pStream, int width, int height, int num_components,
+                                   const uint8 *h_samp, const uint8 *v_samp, const uint16 quant[2][64]);
+
+            // Codes one block of quantized coefficients, in zigzag order. Blocks must come in scan
+            // order: MCU by MCU, and within an MCU component by component, row by row.
+            // Returns false if a stream write fails.
+            bool code_coefficients(int component_num, const int16 *pCoefficients);
+
+            // Finishes an image begun with init_coefficients.
+            bool finish_coefficients();
+
+            // The quantization tables an image made from pixels at quality (1-100) is coded with, in
+            // zigzag order, 0 for the first component and 1 for the others.
+            static void quality_tables(int quality, uint16 quant[2][64]);
+
         private:
             jpeg_encoder(const jpeg_encoder &);
             jpeg_encoder &operator =(const jpeg_encoder &);
@@ -104,6 +124,8 @@ namespace jpge
             bool m_all_stream_writes_succeeded;
 
             bool jpg_open(int p_x_res, int p_y_res, int src_channels);
+            void emit_headers();
+            void emit_end_of_image();
 
             void flush_output_buffer();
             void put_bits(uint bits, uint len);
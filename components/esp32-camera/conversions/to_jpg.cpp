@@ -159,7 +159,7 @@ public:
         index += ocb(oarg, index, data, len);
         return true;
     }
-    virtual size_t get_size() const
+    virtual jpge::uint get_size() const
     {
         return index;
     }
@@ -195,7 +195,7 @@ public:
             return true;
         }
         if ((size_t)len > (max_len - index)) {
-            ESP_LOGW(TAG, "JPG output overflow: %d bytes", len - (max_len - index));
+            ESP_LOGW(TAG, "JPG output overflow: %zu bytes", len - (max_len - index));
             len = max_len - index;
         }
         if (len) {
@@ -205,7 +205,7 @@ public:
         return true;
     }
 
-    virtual size_t get_size() const
+    virtual jpge::uint get_size() const
     {
         return index;
     }
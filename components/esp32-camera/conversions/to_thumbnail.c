@@ -0,0 +1,124 @@
+#include <string.h>
+#include "esp_jpg_coeff.h"
+#include "img_converters.h"
+
+/*
+ * Every 8x8 luma block becomes one pixel, its mean, which is the DC
+ * coefficient with no IDCT. Chroma blocks cover more than one luma block
+ * when the frame is subsampled, 16x8 pixels for the sensors' 4:2:2, so the
+ * colour of a pixel is only known once the last block of its MCU has been
+ * decoded. Until then the luma waits in the output buffer.
+ */
+typedef struct {
+    uint8_t *out;
+    pixformat_t format;
+    uint16_t width;
+    uint16_t height;
+    uint8_t chroma[2][16];  /* Cb and Cr of the current MCU, by block */
+} thumbnail_t;
+
+static inline uint8_t clamp(int value)
+{
+    return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+/* JFIF YCbCr to RGB, full range, in 16.16 fixed point */
+static void ycc2rgb(int y, int cb, int cr, uint8_t *o)
+{
+    cb -= 128;
+    cr -= 128;
+    /* stored B, G, R like fmt2rgb888 does and fmt2jpg expects */
+    o[0] = clamp(y + ((116130 * cb) >> 16));
+    o[1] = clamp(y - ((22554 * cb + 46802 * cr) >> 16));
+    o[2] = clamp(y + ((91881 * cr) >> 16));
+}
+
+/* colours the luma blocks of the MCU whose last block just arrived */
+static void thumbnail_mcu(thumbnail_t *t, const jpg_coeff_info_t *info, int mx, int my)
+{
+    const jpg_coeff_component_t *luma = &info->component[0];
+    const jpg_coeff_component_t *cb = &info->component[1];
+    const jpg_coeff_component_t *cr = &info->component[2];
+
+    for (int ly = 0; ly < luma->v; ly++) {
+        int y = my * luma->v + ly;
+        if (y >= t->height) {
+            break;
+        }
+        for (int lx = 0; lx < luma->h; lx++) {
+            int x = mx * luma->h + lx;
+            if (x >= t->width) {
+                break;
+            }
+            uint8_t *o = t->out + (y * t->width + x) * 3;
+            int b = (ly * cb->v / luma->v) * cb->h + lx * cb->h / luma->h;
+            int r = (ly * cr->v / luma->v) * cr->h + lx * cr->h / luma->h;
+            ycc2rgb(o[1], t->chroma[0][b], t->chroma[1][r], o);
+        }
+    }
+}
+
+static bool thumbnail_block(void *arg, const jpg_coeff_info_t *info, const jpg_coeff_block_t *block)
+{
+    thumbnail_t *t = (thumbnail_t *)arg;
+    const jpg_coeff_component_t *c = &info->component[block->component];
+    /* the DC coefficient is eight times the block's mean, less the level shift */
+    uint8_t value = clamp(block->coef[0] * info->quant[c->tq][0] / 8 + 128);
+
+    if (block->component == 0) {
+        if (block->x < t->width && block->y < t->height) {
+            if (t->format == PIXFORMAT_GRAYSCALE) {
+                t->out[block->y * t->width + block->x] = value;
+            } else {
+                uint8_t *o = t->out + (block->y * t->width + block->x) * 3;
+                o[0] = o[1] = o[2] = value;
+            }
+        }
+        return true;
+    }
+
+    if (t->format == PIXFORMAT_GRAYSCALE) {
+        return true;
+    }
+
+    int bx = block->x % c->h;
+    int by = block->y % c->v;
+    t->chroma[block->component - 1][by * c->h + bx] = value;
+    if (block->component == info->components - 1 && bx == c->h - 1 && by == c->v - 1) {
+        thumbnail_mcu(t, info, block->x / c->h, block->y / c->v);
+    }
+    return true;
+}
+
+bool jpg2thumbnail(const uint8_t *src, size_t src_len, pixformat_t format, uint8_t *out, size_t out_len, uint16_t *width, uint16_t *height)
+{
+    jpg_coeff_info_t info;
+    thumbnail_t t;
+
+    if (!src || !out || (format != PIXFORMAT_RGB888 && format != PIXFORMAT_GRAYSCALE)) {
+        return false;
+    }
+    if (esp_jpg_coeff_info(src, src_len, &info) != ESP_OK) {
+        return false;
+    }
+
+    t.out = out;
+    t.format = format;
+    t.width = (info.width + 7) / 8;
+    t.height = (info.height + 7) / 8;
+    if (out_len < (size_t)t.width * t.height * (format == PIXFORMAT_GRAYSCALE ? 1 : 3)) {
+        return false;
+    }
+    memset(t.chroma, 128, sizeof(t.chroma));
+
+    if (esp_jpg_coeff_decode(src, src_len, JPG_COEFF_DC, thumbnail_block, &t, NULL) != ESP_OK) {
+        return false;
+    }
+    if (width) {
+        *width = t.width;
+    }
+    if (height) {
+        *height = t.height;
+    }
+    return true;
+}
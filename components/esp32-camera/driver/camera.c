@@ -16,6 +16,7 @@
 #include <string.h>
 #include "time.h"
 #include "sys/time.h"
+#include "sys/param.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
@@ -34,6 +35,7 @@
 #include "sensor.h"
 #include "sccb.h"
 #include "esp_camera.h"
+#include "camera_trace.h"
 #include "camera_common.h"
 #include "xclk.h"
 #if CONFIG_OV2640_SUPPORT
@@ -83,9 +85,22 @@ static const char* TAG = "camera";
 #endif
 static const char* CAMERA_SENSOR_NVS_KEY = "sensor";
 static const char* CAMERA_PIXFORMAT_NVS_KEY = "pixformat";
+static const char* CAMERA_PROBE_NVS_KEY = "probe";
+
+// sensor found on a previous boot, as kept in NVS
+typedef struct {
+    uint8_t slv_addr;
+    uint16_t pid;
+} camera_probe_record_t;
+
+// SCCB address to try before scanning the bus, zero to always scan
+static uint8_t s_probe_hint = 0;
 
 typedef void (*dma_filter_t)(const dma_elem_t* src, lldesc_t* dma_desc, uint8_t* dst);
 
+// queued to the filter task behind the last DMA buffer before a relayout
+#define DMA_SYNC (SIZE_MAX - 1)
+
 typedef struct camera_fb_s {
     uint8_t * buf;
     size_t len;
@@ -97,6 +112,7 @@ typedef struct camera_fb_s {
     uint8_t ref;
     uint8_t bad;
     struct camera_fb_s * next;
+    uint32_t frame;
 } camera_fb_int_t;
 
 typedef struct fb_s {
@@ -115,6 +131,9 @@ typedef struct {
 
     size_t width;
     size_t height;
+    size_t max_width;
+    size_t max_height;
+    framesize_t framesize;
     size_t in_bytes_per_pixel;
     size_t fb_bytes_per_pixel;
 
@@ -126,6 +145,8 @@ typedef struct {
 
     lldesc_t *dma_desc;
     dma_elem_t **dma_buf;
+    size_t dma_buf_size;
+    size_t dma_buf_count;
     size_t dma_desc_count;
     size_t dma_desc_cur;
 
@@ -137,7 +158,12 @@ typedef struct {
     QueueHandle_t fb_out;
 
     SemaphoreHandle_t frame_ready;
+    SemaphoreHandle_t dma_synced;
     TaskHandle_t dma_filter_task;
+
+    int (*sensor_set_framesize)(sensor_t *sensor, framesize_t framesize);
+
+    uint32_t frame_count;
 } camera_state_t;
 
 camera_state_t* s_state = NULL;
@@ -147,6 +173,7 @@ static int i2s_run();
 static void IRAM_ATTR vsync_isr(void* arg);
 static void IRAM_ATTR i2s_isr(void* arg);
 static esp_err_t dma_desc_init();
+static esp_err_t dma_desc_layout();
 static void dma_desc_deinit();
 static void dma_filter_task(void *pvParameters);
 static void dma_filter_grayscale(const dma_elem_t* src, lldesc_t* dma_desc, uint8_t* dst);
@@ -292,36 +319,47 @@ fail:
     return ESP_ERR_NO_MEM;
 }
 
-static esp_err_t dma_desc_init()
+static size_t dma_line_size(size_t width)
+{
+    return width * s_state->in_bytes_per_pixel * i2s_bytes_per_sample(s_state->sampling_mode);
+}
+
+/* splits a line in DMA buffers under 4 KB and no larger than limit */
+static size_t dma_line_split(size_t line_size, size_t limit, size_t *buf_size)
 {
-    assert(s_state->width % 4 == 0);
-    size_t line_size = s_state->width * s_state->in_bytes_per_pixel *
-                       i2s_bytes_per_sample(s_state->sampling_mode);
-    ESP_LOGD(TAG, "Line width (for DMA): %d bytes", line_size);
     size_t dma_per_line = 1;
-    size_t buf_size = line_size;
-    while (buf_size >= 4096) {
-        buf_size /= 2;
+    *buf_size = line_size;
+    while (*buf_size >= 4096 || *buf_size > limit) {
+        *buf_size /= 2;
         dma_per_line *= 2;
     }
-    size_t dma_desc_count = dma_per_line * 4;
-    s_state->dma_buf_width = line_size;
-    s_state->dma_per_line = dma_per_line;
-    s_state->dma_desc_count = dma_desc_count;
-    ESP_LOGD(TAG, "DMA buffer size: %d, DMA buffers per line: %d", buf_size, dma_per_line);
-    ESP_LOGD(TAG, "DMA buffer count: %d", dma_desc_count);
-    ESP_LOGD(TAG, "DMA buffer total: %d bytes", buf_size * dma_desc_count);
+    return dma_per_line;
+}
 
-    s_state->dma_buf = (dma_elem_t**) malloc(sizeof(dma_elem_t*) * dma_desc_count);
+/*
+ * Allocates the DMA buffers for the widest frame the camera may switch to.
+ * A narrower line never needs more buffers, nor larger ones.
+ */
+static esp_err_t dma_desc_init()
+{
+    assert(s_state->max_width % 4 == 0);
+    size_t buf_size;
+    size_t dma_per_line = dma_line_split(dma_line_size(s_state->max_width), SIZE_MAX, &buf_size);
+    size_t dma_buf_count = dma_per_line * 4;
+    ESP_LOGD(TAG, "DMA buffer size: %d, DMA buffer count: %d", buf_size, dma_buf_count);
+    ESP_LOGD(TAG, "DMA buffer total: %d bytes", buf_size * dma_buf_count);
+
+    s_state->dma_buf = (dma_elem_t**) calloc(dma_buf_count, sizeof(dma_elem_t*));
     if (s_state->dma_buf == NULL) {
         return ESP_ERR_NO_MEM;
     }
-    s_state->dma_desc = (lldesc_t*) malloc(sizeof(lldesc_t) * dma_desc_count);
+    s_state->dma_buf_size = buf_size;
+    s_state->dma_buf_count = dma_buf_count;
+    s_state->dma_desc = (lldesc_t*) malloc(sizeof(lldesc_t) * dma_buf_count);
     if (s_state->dma_desc == NULL) {
         return ESP_ERR_NO_MEM;
     }
-    size_t dma_sample_count = 0;
-    for (int i = 0; i < dma_desc_count; ++i) {
+    for (int i = 0; i < dma_buf_count; ++i) {
         ESP_LOGD(TAG, "Allocating DMA buffer #%d, size=%d", i, buf_size);
         dma_elem_t* buf = (dma_elem_t*) malloc(buf_size);
         if (buf == NULL) {
@@ -329,7 +367,33 @@ static esp_err_t dma_desc_init()
         }
         s_state->dma_buf[i] = buf;
         ESP_LOGV(TAG, "dma_buf[%d]=%p", i, buf);
+    }
+    return dma_desc_layout();
+}
+
+/*
+ * Links the descriptors for the current frame width. Only called while the
+ * bus is stopped and the filter task is done with the buffers.
+ */
+static esp_err_t dma_desc_layout()
+{
+    assert(s_state->width % 4 == 0);
+    size_t line_size = dma_line_size(s_state->width);
+    ESP_LOGD(TAG, "Line width (for DMA): %d bytes", line_size);
+    size_t buf_size;
+    size_t dma_per_line = dma_line_split(line_size, s_state->dma_buf_size, &buf_size);
+    size_t dma_desc_count = dma_per_line * 4;
+    if (dma_desc_count > s_state->dma_buf_count) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    s_state->dma_buf_width = line_size;
+    s_state->dma_per_line = dma_per_line;
+    s_state->dma_desc_count = dma_desc_count;
+    ESP_LOGD(TAG, "DMA buffer size: %d, DMA buffers per line: %d", buf_size, dma_per_line);
+    ESP_LOGD(TAG, "DMA buffer count: %d", dma_desc_count);
 
+    size_t dma_sample_count = 0;
+    for (int i = 0; i < dma_desc_count; ++i) {
         lldesc_t* pd = &s_state->dma_desc[i];
         pd->length = buf_size;
         if (s_state->sampling_mode == SM_0A0B_0B0C &&
@@ -340,7 +404,7 @@ static esp_err_t dma_desc_init()
         pd->size = pd->length;
         pd->owner = 1;
         pd->sosf = 1;
-        pd->buf = (uint8_t*) buf;
+        pd->buf = (uint8_t*) s_state->dma_buf[i];
         pd->offset = 0;
         pd->empty = 0;
         pd->eof = 1;
@@ -353,7 +417,7 @@ static esp_err_t dma_desc_init()
 static void dma_desc_deinit()
 {
     if (s_state->dma_buf) {
-        for (int i = 0; i < s_state->dma_desc_count; ++i) {
+        for (int i = 0; i < s_state->dma_buf_count; ++i) {
             free(s_state->dma_buf[i]);
         }
     }
@@ -590,6 +654,7 @@ static void IRAM_ATTR vsync_isr(void* arg)
     //if vsync is low and we have received some data, frame is done
     if (_gpio_get_level(s_state->config.pin_vsync) == 0) {
         if(s_state->dma_received_count > 0) {
+            camera_trace(CAMERA_TRACE_VSYNC, ++s_state->frame_count);
             signal_dma_buf_received(&need_yield);
             //ets_printf("end_vsync\n");
             if(s_state->dma_filtered_count > 1 || s_state->fb->bad || s_state->config.fb_count > 1) {
@@ -620,6 +685,8 @@ static void IRAM_ATTR camera_fb_done()
     camera_fb_int_t * fb = NULL, * fb2 = NULL;
     BaseType_t taskAwoken = 0;
 
+    camera_trace(CAMERA_TRACE_FB_DONE, s_state->fb->frame);
+
     if(s_state->config.fb_count == 1) {
         xSemaphoreGive(s_state->frame_ready);
         return;
@@ -711,6 +778,8 @@ static void IRAM_ATTR dma_finish_frame()
                     }
                 }
                 //send out the frame
+                s_state->fb->frame = s_state->frame_count;
+                camera_trace(CAMERA_TRACE_DMA_DONE, s_state->fb->frame);
                 camera_fb_done();
             } else if(s_state->config.fb_count == 1){
                 //frame was empty?
@@ -756,8 +825,8 @@ static void IRAM_ATTR dma_filter_buffer(size_t buf_idx)
             }
         }
         //set the frame properties
-        s_state->fb->width = resolution[s_state->sensor.status.framesize].width;
-        s_state->fb->height = resolution[s_state->sensor.status.framesize].height;
+        s_state->fb->width = s_state->width;
+        s_state->fb->height = s_state->height;
         s_state->fb->format = s_state->sensor.pixformat;
 
         uint64_t us = (uint64_t)esp_timer_get_time();
@@ -776,6 +845,14 @@ static void IRAM_ATTR dma_filter_task(void *pvParameters)
             if (buf_idx == SIZE_MAX) {
                 //this is the end of the frame
                 dma_finish_frame();
+            } else if (buf_idx == DMA_SYNC) {
+                //the bus was stopped, drop what there is of the frame
+                s_state->dma_filtered_count = 0;
+                if(!s_state->fb->ref) {
+                    s_state->fb->bad = 0;
+                    s_state->fb->len = 0;
+                }
+                xSemaphoreGive(s_state->dma_synced);
             } else {
                 dma_filter_buffer(buf_idx);
             }
@@ -952,6 +1029,14 @@ static void IRAM_ATTR dma_filter_rgb888_highspeed(const dma_elem_t* src, lldesc_
     }
 }
 
+static uint8_t camera_find_sensor()
+{
+    if (s_probe_hint != 0 && SCCB_Probe_Address(s_probe_hint) != 0) {
+        return s_probe_hint;
+    }
+    return SCCB_Probe();
+}
+
 /*
  * Public Methods
  * */
@@ -1006,7 +1091,7 @@ esp_err_t camera_probe(const camera_config_t* config, camera_model_t* out_camera
 
     ESP_LOGD(TAG, "Searching for camera address");
     vTaskDelay(10 / portTICK_PERIOD_MS);
-    uint8_t slv_addr = SCCB_Probe();
+    uint8_t slv_addr = camera_find_sensor();
     if (slv_addr == 0) {
         *out_camera_model = CAMERA_NONE;
         camera_disable_out_clock();
@@ -1024,7 +1109,7 @@ esp_err_t camera_probe(const camera_config_t* config, camera_model_t* out_camera
         SCCB_Write(0x30, 0xFF, 0x01);//bank sensor
         SCCB_Write(0x30, 0x12, 0x80);//reset
         vTaskDelay(10 / portTICK_PERIOD_MS);
-        slv_addr = SCCB_Probe();
+        slv_addr = camera_find_sensor();
     }
 #endif
 #if CONFIG_NT99141_SUPPORT
@@ -1120,6 +1205,65 @@ esp_err_t camera_probe(const camera_config_t* config, camera_model_t* out_camera
     return ESP_OK;
 }
 
+static bool camera_framesize_fits(framesize_t framesize)
+{
+    size_t width = resolution[framesize].width;
+    size_t height = resolution[framesize].height;
+    return width % 4 == 0 && width <= s_state->max_width
+        && width * height <= s_state->max_width * s_state->max_height;
+}
+
+/*
+ * Takes the place of the sensor's set_framesize once the camera runs. The
+ * sensor switches straight away, the DMA follows between frames in
+ * camera_relayout. A size larger than the buffers is refused.
+ */
+static int camera_set_framesize(sensor_t *sensor, framesize_t framesize)
+{
+    if (framesize >= FRAMESIZE_INVALID || !camera_framesize_fits(framesize)) {
+        ESP_LOGE(TAG, "Frame size %d does not fit the buffers", framesize);
+        return -1;
+    }
+    return s_state->sensor_set_framesize(sensor, framesize);
+}
+
+/*
+ * Lays the DMA out for the size the sensor was switched to. Called from
+ * esp_camera_fb_get, so the frame it returns next is the first one taken
+ * at the new size.
+ */
+static esp_err_t camera_relayout()
+{
+    framesize_t framesize = s_state->sensor.status.framesize;
+    if (!camera_framesize_fits(framesize)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    i2s_stop_bus();
+
+    //wait for the filter task to let go of the buffers
+    size_t sync = DMA_SYNC;
+    xQueueSend(s_state->data_ready, &sync, portMAX_DELAY);
+    xSemaphoreTake(s_state->dma_synced, portMAX_DELAY);
+
+    //a frame waiting to be taken still has the old size
+    camera_fb_int_t * fb = NULL;
+    while(s_state->fb_out && xQueueReceive(s_state->fb_out, &fb, 0) == pdTRUE) {
+        fb->ref = 0;
+        fb->len = 0;
+    }
+
+    s_state->width = resolution[framesize].width;
+    s_state->height = resolution[framesize].height;
+    esp_err_t err = dma_desc_layout();
+    if (err != ESP_OK) {
+        return err;
+    }
+    s_state->framesize = framesize;
+    ESP_LOGD(TAG, "Switched to %dx%d", s_state->width, s_state->height);
+    return ESP_OK;
+}
+
 esp_err_t camera_init(const camera_config_t* config)
 {
     if (!s_state) {
@@ -1131,57 +1275,60 @@ esp_err_t camera_init(const camera_config_t* config)
     memcpy(&s_state->config, config, sizeof(*config));
     esp_err_t err = ESP_OK;
     framesize_t frame_size = (framesize_t) config->frame_size;
+    framesize_t max_frame_size;
     pixformat_t pix_format = (pixformat_t) config->pixel_format;
 
     switch (s_state->sensor.id.PID) {
 #if CONFIG_OV2640_SUPPORT
         case OV2640_PID:
-            if (frame_size > FRAMESIZE_UXGA) {
-                frame_size = FRAMESIZE_UXGA;
-            }
+            max_frame_size = FRAMESIZE_UXGA;
             break;
 #endif
 #if CONFIG_OV7725_SUPPORT
         case OV7725_PID:
-            if (frame_size > FRAMESIZE_VGA) {
-                frame_size = FRAMESIZE_VGA;
-            }
+            max_frame_size = FRAMESIZE_VGA;
             break;
 #endif
 #if CONFIG_OV3660_SUPPORT
         case OV3660_PID:
-            if (frame_size > FRAMESIZE_QXGA) {
-                frame_size = FRAMESIZE_QXGA;
-            }
+            max_frame_size = FRAMESIZE_QXGA;
             break;
 #endif
 #if CONFIG_OV5640_SUPPORT
         case OV5640_PID:
-            if (frame_size > FRAMESIZE_QSXGA) {
-                frame_size = FRAMESIZE_QSXGA;
-            }
+            max_frame_size = FRAMESIZE_QSXGA;
             break;
 #endif
 #if CONFIG_OV7670_SUPPORT
         case OV7670_PID:
-            if (frame_size > FRAMESIZE_VGA) {
-                frame_size = FRAMESIZE_VGA;
-            }
+            max_frame_size = FRAMESIZE_VGA;
             break;
 #endif
 #if CONFIG_NT99141_SUPPORT
         case NT99141_PID:
-            if (frame_size > FRAMESIZE_HD) {
-                frame_size = FRAMESIZE_HD;
-            }
+            max_frame_size = FRAMESIZE_HD;
             break;
 #endif
         default:
             return ESP_ERR_CAMERA_NOT_SUPPORTED;
     }
 
-    s_state->width = resolution[frame_size].width;
-    s_state->height = resolution[frame_size].height;
+    if (frame_size > max_frame_size) {
+        frame_size = max_frame_size;
+    }
+    framesize_t buffer_size = config->max_frame_size;
+    if (buffer_size < frame_size) {
+        buffer_size = frame_size;
+    } else if (buffer_size > max_frame_size) {
+        buffer_size = max_frame_size;
+    }
+
+    //buffers are sized for the largest frame, the DMA is laid out for this one
+    s_state->framesize = frame_size;
+    s_state->max_width = MAX(resolution[frame_size].width, resolution[buffer_size].width);
+    s_state->max_height = MAX(resolution[frame_size].height, resolution[buffer_size].height);
+    s_state->width = s_state->max_width;
+    s_state->height = s_state->max_height;
 
     if (pix_format == PIXFORMAT_GRAYSCALE) {
         s_state->fb_size = s_state->width * s_state->height;
@@ -1262,6 +1409,9 @@ esp_err_t camera_init(const camera_config_t* config)
         goto fail;
     }
 
+    s_state->width = resolution[frame_size].width;
+    s_state->height = resolution[frame_size].height;
+
     ESP_LOGD(TAG, "in_bpp: %d, fb_bpp: %d, fb_size: %d, mode: %d, width: %d height: %d",
              s_state->in_bytes_per_pixel, s_state->fb_bytes_per_pixel,
              s_state->fb_size, s_state->sampling_mode,
@@ -1289,6 +1439,13 @@ esp_err_t camera_init(const camera_config_t* config)
         goto fail;
     }
 
+    s_state->dma_synced = xSemaphoreCreateBinary();
+    if (s_state->dma_synced == NULL) {
+        ESP_LOGE(TAG, "Failed to create semaphore");
+        err = ESP_ERR_NO_MEM;
+        goto fail;
+    }
+
     if(s_state->config.fb_count == 1) {
         s_state->frame_ready = xSemaphoreCreateBinary();
         if (s_state->frame_ready == NULL) {
@@ -1363,6 +1520,10 @@ esp_err_t camera_init(const camera_config_t* config)
         (*s_state->sensor.set_quality)(&s_state->sensor, config->jpeg_quality);
     }
     s_state->sensor.init_status(&s_state->sensor);
+
+    //later frame size changes go through the driver, see camera_set_framesize
+    s_state->sensor_set_framesize = s_state->sensor.set_framesize;
+    s_state->sensor.set_framesize = camera_set_framesize;
     return ESP_OK;
 
 fail:
@@ -1435,6 +1596,9 @@ esp_err_t esp_camera_deinit()
     if (s_state->frame_ready) {
         vSemaphoreDelete(s_state->frame_ready);
     }
+    if (s_state->dma_synced) {
+        vSemaphoreDelete(s_state->dma_synced);
+    }
     gpio_isr_handler_remove(s_state->config.pin_vsync);
     if (s_state->i2s_intr_handle) {
         esp_intr_disable(s_state->i2s_intr_handle);
@@ -1459,6 +1623,12 @@ camera_fb_t* esp_camera_fb_get()
     if (s_state == NULL) {
         return NULL;
     }
+    if (s_state->framesize != s_state->sensor.status.framesize) {
+        if (camera_relayout() != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to switch the DMA to the new frame size");
+            return NULL;
+        }
+    }
     if(!I2S0.conf.rx_start) {
         if(s_state->config.fb_count > 1) {
             ESP_LOGD(TAG, "i2s_run");
@@ -1474,6 +1644,7 @@ camera_fb_t* esp_camera_fb_get()
             ESP_LOGE(TAG, "Failed to get the frame on time!");
             return NULL;
         }
+        camera_trace(CAMERA_TRACE_FB_GET, s_state->fb->frame);
         return (camera_fb_t*)s_state->fb;
     }
     camera_fb_int_t * fb = NULL;
@@ -1483,6 +1654,7 @@ camera_fb_t* esp_camera_fb_get()
             ESP_LOGE(TAG, "Failed to get the frame on time!");
             return NULL;
         }
+        camera_trace(CAMERA_TRACE_FB_GET, fb->frame);
     }
     return (camera_fb_t*)fb;
 }
@@ -1495,6 +1667,11 @@ void esp_camera_fb_return(camera_fb_t * fb)
     xQueueSend(s_state->fb_in, &fb, portMAX_DELAY);
 }
 
+uint32_t camera_trace_frame(const camera_fb_t *fb)
+{
+    return ((const camera_fb_int_t *)fb)->frame;
+}
+
 sensor_t * esp_camera_sensor_get()
 {
     if (s_state == NULL) {
@@ -1520,9 +1697,11 @@ esp_err_t esp_camera_save_to_nvs(const char *key)
                 uint8_t pf = s->pixformat;
                 ret = nvs_set_u8(handle,CAMERA_PIXFORMAT_NVS_KEY,pf);
             }
-            return ret;
+            if (ret == ESP_OK) {
+                ret = nvs_commit(handle);
+            }
         } else {
-            return ESP_ERR_CAMERA_NOT_DETECTED; 
+            ret = ESP_ERR_CAMERA_NOT_DETECTED;
         }
         nvs_close(handle);
         return ret;
@@ -1581,6 +1760,7 @@ esp_err_t esp_camera_load_from_nvs(const char *key)
           s->set_pixformat(s,pf);
         }
       } else {
+          nvs_close(handle);
           return ESP_ERR_CAMERA_NOT_DETECTED;
       }
       nvs_close(handle);
@@ -1590,3 +1770,52 @@ esp_err_t esp_camera_load_from_nvs(const char *key)
       return ret;
   }
 }
+
+esp_err_t esp_camera_init_from_nvs(const camera_config_t* config, const char *key)
+{
+#if ESP_IDF_VERSION_MAJOR > 3
+    nvs_handle_t handle;
+#else
+    nvs_handle handle;
+#endif
+    camera_probe_record_t record = { 0 };
+    size_t size = sizeof(record);
+    bool known = false;
+
+    if (nvs_open(key, NVS_READWRITE, &handle) == ESP_OK) {
+        known = nvs_get_blob(handle, CAMERA_PROBE_NVS_KEY, &record, &size) == ESP_OK && size == sizeof(record);
+        nvs_close(handle);
+    }
+
+    if (known) {
+        ESP_LOGI(TAG, "Trying camera PID=0x%02x at address=0x%02x first", record.pid, record.slv_addr);
+    }
+
+    s_probe_hint = known ? record.slv_addr : 0;
+    esp_err_t err = esp_camera_init(config);
+    s_probe_hint = 0;
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    sensor_t *s = esp_camera_sensor_get();
+    if (known && record.slv_addr == s->slv_addr && record.pid == s->id.PID) {
+        // settings saved with esp_camera_save_to_nvs, if any
+        err = esp_camera_load_from_nvs(key);
+        if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
+            ESP_LOGW(TAG, "Restoring camera settings failed with error 0x%x", err);
+        }
+        return ESP_OK;
+    }
+
+    // a new or different sensor, remember it for the next boot
+    record.slv_addr = s->slv_addr;
+    record.pid = s->id.PID;
+    if (nvs_open(key, NVS_READWRITE, &handle) == ESP_OK) {
+        if (nvs_set_blob(handle, CAMERA_PROBE_NVS_KEY, &record, sizeof(record)) == ESP_OK) {
+            nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    return ESP_OK;
+}
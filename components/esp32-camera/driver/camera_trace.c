@@ -0,0 +1,79 @@
+#include "sdkconfig.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "camera_trace.h"
+
+#ifndef CONFIG_CAMERA_TRACE_EVENTS
+#define CONFIG_CAMERA_TRACE_EVENTS 256
+#endif
+
+typedef struct {
+    uint32_t sequence;          // position the slot was written for, plus one
+    camera_trace_event_t event;
+} trace_slot_t;
+
+#if CONFIG_CAMERA_TRACE_EVENTS > 0
+static DRAM_ATTR trace_slot_t s_slots[CONFIG_CAMERA_TRACE_EVENTS];
+#endif
+static DRAM_ATTR uint32_t s_next = 0;
+
+static const char *s_names[CAMERA_TRACE_STAGES] = {
+    "vsync", "dma done", "fb done", "fb get", "send first", "send last"
+};
+
+void IRAM_ATTR camera_trace(camera_trace_stage_t stage, uint32_t frame)
+{
+#if CONFIG_CAMERA_TRACE_EVENTS > 0
+    uint32_t position = __atomic_fetch_add(&s_next, 1, __ATOMIC_RELAXED);
+    trace_slot_t *slot = &s_slots[position % CONFIG_CAMERA_TRACE_EVENTS];
+
+    // invalidate the slot while it is rewritten
+    __atomic_store_n(&slot->sequence, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    slot->event.time = (uint32_t)esp_timer_get_time();
+    slot->event.frame = frame;
+    slot->event.stage = stage;
+    slot->event.core = xPortGetCoreID();
+
+    __atomic_store_n(&slot->sequence, position + 1, __ATOMIC_RELEASE);
+#endif
+}
+
+size_t camera_trace_read(camera_trace_event_t *events, size_t count)
+{
+    size_t copied = 0;
+#if CONFIG_CAMERA_TRACE_EVENTS > 0
+    uint32_t end = __atomic_load_n(&s_next, __ATOMIC_ACQUIRE);
+    uint32_t start = (end > CONFIG_CAMERA_TRACE_EVENTS) ? end - CONFIG_CAMERA_TRACE_EVENTS : 0;
+    if (end - start > count) {
+        start = end - count;
+    }
+
+    for (uint32_t position = start; position != end; position++) {
+        trace_slot_t *slot = &s_slots[position % CONFIG_CAMERA_TRACE_EVENTS];
+
+        if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != position + 1) {
+            continue;
+        }
+        camera_trace_event_t event = slot->event;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        // drop the copy if a writer lapped the reader meanwhile
+        if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) == position + 1) {
+            events[copied++] = event;
+        }
+    }
+#endif
+    return copied;
+}
+
+const char *camera_trace_name(camera_trace_stage_t stage)
+{
+    if (stage >= CAMERA_TRACE_STAGES) {
+        return "unknown";
+    }
+    return s_names[stage];
+}
@@ -0,0 +1,67 @@
+/*
+ * Frame pipeline tracing.
+ *
+ * Every stage a frame passes through, from the end of VSYNC to the last
+ * byte written to a viewer, can be stamped into a fixed-size ring. Recording
+ * is a single atomic increment and a 12 byte store, safe from interrupts,
+ * so the trace can stay enabled. Readers copy the ring out and skip any slot
+ * that was overwritten while being read.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_camera.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    CAMERA_TRACE_VSYNC,         /*!< End of frame seen by the VSYNC interrupt */
+    CAMERA_TRACE_DMA_DONE,      /*!< DMA filter task finished the frame */
+    CAMERA_TRACE_FB_DONE,       /*!< Frame handed to the frame buffer queue */
+    CAMERA_TRACE_FB_GET,        /*!< Frame taken by esp_camera_fb_get */
+    CAMERA_TRACE_SEND_FIRST,    /*!< First byte of the frame sent to a viewer */
+    CAMERA_TRACE_SEND_LAST,     /*!< Last byte of the frame sent to a viewer */
+    CAMERA_TRACE_STAGES
+} camera_trace_stage_t;
+
+typedef struct {
+    uint32_t time;              /*!< esp_timer_get_time, low 32 bits */
+    uint16_t frame;             /*!< Frame number, low 16 bits */
+    uint8_t stage;              /*!< camera_trace_stage_t */
+    uint8_t core;               /*!< Core the stage ran on */
+} camera_trace_event_t;
+
+/**
+ * @brief Record that a frame reached a stage
+ *
+ * @param stage  Stage reached
+ * @param frame  Frame number, see camera_trace_frame
+ */
+void camera_trace(camera_trace_stage_t stage, uint32_t frame);
+
+/**
+ * @brief Copy the recorded events out, oldest first
+ *
+ * @param events  Destination for the events
+ * @param count   Size of the destination
+ *
+ * @return Number of events copied
+ */
+size_t camera_trace_read(camera_trace_event_t *events, size_t count);
+
+/**
+ * @brief Frame number of a frame buffer returned by esp_camera_fb_get
+ */
+uint32_t camera_trace_frame(const camera_fb_t *fb);
+
+/**
+ * @brief Name of a stage
+ */
+const char *camera_trace_name(camera_trace_stage_t stage);
+
+#ifdef __cplusplus
+}
+#endif
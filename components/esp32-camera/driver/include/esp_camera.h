@@ -105,6 +105,7 @@ typedef struct {
 
     int jpeg_quality;               /*!< Quality of JPEG output. 0-63 lower means higher quality  */
     size_t fb_count;                /*!< Number of frame buffers to be allocated. If more than one, then each frame will be acquired (double speed)  */
+    framesize_t max_frame_size;     /*!< Largest size set_framesize may switch to without reinitializing. Buffers are allocated for it. Below frame_size means frame_size  */
 } camera_config_t;
 
 /**
@@ -155,6 +156,9 @@ esp_err_t esp_camera_deinit();
 /**
  * @brief Obtain pointer to a frame buffer.
  *
+ * After the sensor's set_framesize, the first frame returned is the first
+ * one taken at the new size.
+ *
  * @return pointer to the frame buffer
  */
 camera_fb_t* esp_camera_fb_get();
@@ -187,6 +191,21 @@ esp_err_t esp_camera_save_to_nvs(const char *key);
  */
 esp_err_t esp_camera_load_from_nvs(const char *key);
 
+/**
+ * @brief Initialize the camera driver, trying the sensor found on a previous boot first
+ *
+ * @note The SCCB address and model of the sensor are kept in NVS under the key, so
+ *       the bus scan is skipped when the same sensor answers there again. A missing
+ *       or different sensor falls back to a full probe and is remembered instead.
+ *       Settings saved with esp_camera_save_to_nvs under the key are then applied.
+ *
+ * @param config  Camera configuration parameters
+ * @param key     A unique nvs key name for the camera
+ *
+ * @return ESP_OK on success, as esp_camera_init otherwise
+ */
+esp_err_t esp_camera_init_from_nvs(const camera_config_t* config, const char *key);
+
 #ifdef __cplusplus
 }
 #endif
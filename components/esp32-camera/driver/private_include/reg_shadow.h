@@ -0,0 +1,58 @@
+/*
+ * Shadow copy of the sensor registers the driver has written.
+ *
+ * Every value a sensor driver writes is remembered, so changing a few bits
+ * of a register takes one SCCB write instead of a read and a write, and
+ * reading a register back costs no bus traffic at all. Only written values
+ * are kept: a register the driver never wrote is always read from the
+ * sensor. Registers the sensor updates by itself, such as exposure and gain
+ * while AEC and AGC run, must not be recorded; the drivers leave them out.
+ *
+ * Register addresses are 16 bits. The OV2640 uses the bank in bit 8.
+ */
+#ifndef __REG_SHADOW_H__
+#define __REG_SHADOW_H__
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct reg_shadow reg_shadow_t;
+
+/* allocates an empty shadow, NULL when out of memory */
+reg_shadow_t *reg_shadow_create(void);
+
+/* forgets every value, after a software reset or a power cycle */
+void reg_shadow_clear(reg_shadow_t *shadow);
+
+/* the value last written to reg, or -1 when it is not known */
+int reg_shadow_get(const reg_shadow_t *shadow, uint16_t reg);
+
+/* records a value written to reg */
+void reg_shadow_set(reg_shadow_t *shadow, uint16_t reg, uint8_t value);
+
+/* forgets the value of reg, after a failed write */
+void reg_shadow_forget(reg_shadow_t *shadow, uint16_t reg);
+
+/* how a sensor driver writes its registers, for reg_shadow_write_regs */
+typedef struct {
+    /* one register, through the shadow */
+    int (*write_reg)(uint8_t slv_addr, uint16_t reg, uint8_t value);
+    /* consecutive registers in one transaction, recording them in the shadow */
+    int (*write_burst)(uint8_t slv_addr, uint16_t reg, const uint8_t *data, size_t length);
+    /* registers always written alone and in table order, never skipped or batched */
+    bool (*direct)(uint16_t reg);
+} reg_shadow_writer_t;
+
+#define REG_SHADOW_BURST_MAX 32
+
+/*
+ * Writes a register table ended by tail, leaving out the registers the
+ * shadow says already hold their value and sending runs of consecutive
+ * registers as bursts. The pending burst is sent before a direct write or
+ * a delay, so the bus sees the writes in table order. A delay is only kept
+ * when something was written since the previous one.
+ */
+int reg_shadow_write_regs(reg_shadow_t *shadow, const reg_shadow_writer_t *writer, uint8_t slv_addr,
+                          const uint16_t (*regs)[2], uint16_t tail, uint16_t delay);
+
+#endif // __REG_SHADOW_H__
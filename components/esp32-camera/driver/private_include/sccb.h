@@ -9,10 +9,14 @@
 #ifndef __SCCB_H__
 #define __SCCB_H__
 #include <stdint.h>
+#include <stddef.h>
 int SCCB_Init(int pin_sda, int pin_scl);
 uint8_t SCCB_Probe();
+uint8_t SCCB_Probe_Address(uint8_t slv_addr);
 uint8_t SCCB_Read(uint8_t slv_addr, uint8_t reg);
 uint8_t SCCB_Write(uint8_t slv_addr, uint8_t reg, uint8_t data);
 uint8_t SCCB_Read16(uint8_t slv_addr, uint16_t reg);
 uint8_t SCCB_Write16(uint8_t slv_addr, uint16_t reg, uint8_t data);
+/* writes length bytes to consecutive registers from reg, for sensors that auto-increment */
+uint8_t SCCB_Write16_Burst(uint8_t slv_addr, uint16_t reg, const uint8_t *data, size_t length);
 #endif // __SCCB_H__
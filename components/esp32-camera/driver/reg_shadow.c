@@ -0,0 +1,139 @@
+#include <stdlib.h>
+#include "reg_shadow.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/*
+ * Open addressing with linear probing. The OV3660 register tables alone
+ * write about 210 distinct registers, so 512 slots keep the probes short.
+ * Entries are never removed, a forgotten register keeps its slot so the
+ * probe chains through it stay intact.
+ */
+#define REG_SHADOW_BITS  9
+#define REG_SHADOW_SLOTS (1 << REG_SHADOW_BITS)
+
+typedef enum {
+    SLOT_EMPTY,
+    SLOT_KNOWN,
+    SLOT_UNKNOWN,
+} slot_state_t;
+
+typedef struct {
+    uint16_t reg;
+    uint8_t value;
+    uint8_t state;
+} reg_shadow_slot_t;
+
+struct reg_shadow {
+    reg_shadow_slot_t slots[REG_SHADOW_SLOTS];
+};
+
+static inline uint32_t reg_shadow_hash(uint16_t reg)
+{
+    return ((uint16_t)(reg * 40503u)) >> (16 - REG_SHADOW_BITS);
+}
+
+/* the slot holding reg, or the empty slot it would go in, NULL when full */
+static reg_shadow_slot_t *reg_shadow_find(const reg_shadow_t *shadow, uint16_t reg)
+{
+    uint32_t index = reg_shadow_hash(reg);
+    for (int i = 0; i < REG_SHADOW_SLOTS; i++) {
+        const reg_shadow_slot_t *slot = &shadow->slots[(index + i) & (REG_SHADOW_SLOTS - 1)];
+        if (slot->state == SLOT_EMPTY || slot->reg == reg) {
+            return (reg_shadow_slot_t *)slot;
+        }
+    }
+    return NULL;
+}
+
+reg_shadow_t *reg_shadow_create(void)
+{
+    return calloc(1, sizeof(reg_shadow_t));
+}
+
+void reg_shadow_clear(reg_shadow_t *shadow)
+{
+    if (shadow) {
+        for (int i = 0; i < REG_SHADOW_SLOTS; i++) {
+            shadow->slots[i].state = SLOT_EMPTY;
+        }
+    }
+}
+
+int reg_shadow_get(const reg_shadow_t *shadow, uint16_t reg)
+{
+    if (!shadow) {
+        return -1;
+    }
+    const reg_shadow_slot_t *slot = reg_shadow_find(shadow, reg);
+    if (!slot || slot->state != SLOT_KNOWN) {
+        return -1;
+    }
+    return slot->value;
+}
+
+void reg_shadow_set(reg_shadow_t *shadow, uint16_t reg, uint8_t value)
+{
+    if (!shadow) {
+        return;
+    }
+    reg_shadow_slot_t *slot = reg_shadow_find(shadow, reg);
+    if (slot) {
+        slot->reg = reg;
+        slot->value = value;
+        slot->state = SLOT_KNOWN;
+    }
+}
+
+void reg_shadow_forget(reg_shadow_t *shadow, uint16_t reg)
+{
+    if (!shadow) {
+        return;
+    }
+    reg_shadow_slot_t *slot = reg_shadow_find(shadow, reg);
+    if (slot && slot->state == SLOT_KNOWN) {
+        slot->state = SLOT_UNKNOWN;
+    }
+}
+
+int reg_shadow_write_regs(reg_shadow_t *shadow, const reg_shadow_writer_t *writer, uint8_t slv_addr,
+                          const uint16_t (*regs)[2], uint16_t tail, uint16_t delay)
+{
+    uint8_t burst[REG_SHADOW_BURST_MAX];
+    uint16_t start = 0;
+    size_t length = 0;
+    bool written = false;
+    int i = 0, ret = 0;
+    while (!ret && regs[i][0] != tail) {
+        uint16_t reg = regs[i][0];
+        uint8_t value = regs[i][1];
+        bool alone = reg == delay || writer->direct(reg);
+        if (length && (alone || reg != start + length || length == REG_SHADOW_BURST_MAX)) {
+            ret = writer->write_burst(slv_addr, start, burst, length);
+            length = 0;
+            if (ret) {
+                break;
+            }
+        }
+        if (reg == delay) {
+            if (written) {
+                vTaskDelay(regs[i][1] / portTICK_PERIOD_MS);
+            }
+            written = false;
+        } else if (alone) {
+            ret = writer->write_reg(slv_addr, reg, value);
+            written = true;
+        } else if (reg_shadow_get(shadow, reg) != value) {
+            if (!length) {
+                start = reg;
+            }
+            burst[length++] = value;
+            written = true;
+        }
+        i++;
+    }
+    if (!ret && length) {
+        ret = writer->write_burst(slv_addr, start, burst, length);
+    }
+    return ret;
+}
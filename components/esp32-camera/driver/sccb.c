@@ -54,18 +54,26 @@ int SCCB_Init(int pin_sda, int pin_scl)
     return 0;
 }
 
+uint8_t SCCB_Probe_Address(uint8_t slv_addr)
+{
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, ( slv_addr << 1 ) | WRITE_BIT, ACK_CHECK_EN);
+    i2c_master_stop(cmd);
+    esp_err_t ret = i2c_master_cmd_begin(SCCB_I2C_PORT, cmd, 1000 / portTICK_RATE_MS);
+    i2c_cmd_link_delete(cmd);
+    if( ret == ESP_OK) {
+        ESP_SLAVE_ADDR = slv_addr;
+        return ESP_SLAVE_ADDR;
+    }
+    return 0;
+}
+
 uint8_t SCCB_Probe()
 {
     uint8_t slave_addr = 0x0;
     while(slave_addr < 0x7f) {
-        i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-        i2c_master_start(cmd);
-        i2c_master_write_byte(cmd, ( slave_addr << 1 ) | WRITE_BIT, ACK_CHECK_EN);
-        i2c_master_stop(cmd);
-        esp_err_t ret = i2c_master_cmd_begin(SCCB_I2C_PORT, cmd, 1000 / portTICK_RATE_MS);
-        i2c_cmd_link_delete(cmd);
-        if( ret == ESP_OK) {
-            ESP_SLAVE_ADDR = slave_addr;
+        if (SCCB_Probe_Address(slave_addr) != 0) {
             return ESP_SLAVE_ADDR;
         }
         slave_addr++;
@@ -163,3 +171,23 @@ uint8_t SCCB_Write16(uint8_t slv_addr, uint16_t reg, uint8_t data)
     }
     return ret == ESP_OK ? 0 : -1;
 }
+
+uint8_t SCCB_Write16_Burst(uint8_t slv_addr, uint16_t reg, const uint8_t *data, size_t length)
+{
+    esp_err_t ret = ESP_FAIL;
+    uint16_t reg_htons = LITTLETOBIG(reg);
+    uint8_t *reg_u8 = (uint8_t *)&reg_htons;
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, ( slv_addr << 1 ) | WRITE_BIT, ACK_CHECK_EN);
+    i2c_master_write_byte(cmd, reg_u8[0], ACK_CHECK_EN);
+    i2c_master_write_byte(cmd, reg_u8[1], ACK_CHECK_EN);
+    i2c_master_write(cmd, (uint8_t *)data, length, ACK_CHECK_EN);
+    i2c_master_stop(cmd);
+    ret = i2c_master_cmd_begin(SCCB_I2C_PORT, cmd, 1000 / portTICK_RATE_MS);
+    i2c_cmd_link_delete(cmd);
+    if(ret != ESP_OK) {
+        ESP_LOGE(TAG, "W [%04x]=%02x+%u fail\n", reg, data[0], (unsigned)(length - 1));
+    }
+    return ret == ESP_OK ? 0 : -1;
+}
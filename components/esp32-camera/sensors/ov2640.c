@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "sccb.h"
+#include "reg_shadow.h"
 #include "ov2640.h"
 #include "ov2640_regs.h"
 #include "ov2640_settings.h"
@@ -24,6 +25,16 @@ static const char* TAG = "ov2640";
 #endif
 
 static volatile ov2640_bank_t reg_bank = BANK_MAX;
+static reg_shadow_t *shadow = NULL;
+
+#define SHADOW_REG(bank, reg) ((uint16_t)(((bank) << 8) | (reg)))
+
+/* exposure and gain, which the sensor rewrites while AEC and AGC run */
+static bool reg_volatile(uint8_t bank, uint8_t reg)
+{
+    return bank == BANK_SENSOR && (reg == GAIN || reg == REG04 || reg == AEC || reg == REG45);
+}
+
 static int set_bank(sensor_t *sensor, ov2640_bank_t bank)
 {
     int res = 0;
@@ -34,14 +45,40 @@ static int set_bank(sensor_t *sensor, ov2640_bank_t bank)
     return res;
 }
 
+static int write_reg(sensor_t *sensor, ov2640_bank_t bank, uint8_t reg, uint8_t value)
+{
+    if (bank < BANK_MAX && reg_shadow_get(shadow, SHADOW_REG(bank, reg)) == value) {
+        return 0;
+    }
+    int ret = set_bank(sensor, bank);
+    if(!ret) {
+        ret = SCCB_Write(sensor->slv_addr, reg, value);
+    }
+    if (ret) {
+        reg_shadow_forget(shadow, SHADOW_REG(bank, reg));
+    } else if (bank == BANK_SENSOR && reg == COM7 && (value & COM7_SRST)) {
+        reg_shadow_clear(shadow);
+    } else if (bank < BANK_MAX && !reg_volatile(bank, reg)) {
+        reg_shadow_set(shadow, SHADOW_REG(bank, reg), value);
+    }
+    return ret;
+}
+
+/*
+ * Writes a register table, leaving out the registers the shadow says already
+ * hold their value. A bank is only selected once a register in it is
+ * written. The OV2640 takes one register per SCCB write, so there are no
+ * bursts.
+ */
 static int write_regs(sensor_t *sensor, const uint8_t (*regs)[2])
 {
     int i=0, res = 0;
+    ov2640_bank_t bank = reg_bank;
     while (regs[i][0]) {
         if (regs[i][0] == BANK_SEL) {
-            res = set_bank(sensor, regs[i][1]);
+            bank = regs[i][1];
         } else {
-            res = SCCB_Write(sensor->slv_addr, regs[i][0], regs[i][1]);
+            res = write_reg(sensor, bank, regs[i][0], regs[i][1]);
         }
         if (res) {
             return res;
@@ -51,38 +88,86 @@ static int write_regs(sensor_t *sensor, const uint8_t (*regs)[2])
     return res;
 }
 
-static int write_reg(sensor_t *sensor, ov2640_bank_t bank, uint8_t reg, uint8_t value)
-{
-    int ret = set_bank(sensor, bank);
-    if(!ret) {
-        ret = SCCB_Write(sensor->slv_addr, reg, value);
-    }
-    return ret;
-}
-
 static int set_reg_bits(sensor_t *sensor, uint8_t bank, uint8_t reg, uint8_t offset, uint8_t mask, uint8_t value)
 {
     int ret = 0;
     uint8_t c_value, new_value;
+    int known = reg_shadow_get(shadow, SHADOW_REG(bank, reg));
 
-    ret = set_bank(sensor, bank);
-    if(ret) {
-        return ret;
+    if (known < 0) {
+        ret = set_bank(sensor, bank);
+        if(ret) {
+            return ret;
+        }
+        c_value = SCCB_Read(sensor->slv_addr, reg);
+    } else {
+        c_value = known;
     }
-    c_value = SCCB_Read(sensor->slv_addr, reg);
     new_value = (c_value & ~(mask << offset)) | ((value & mask) << offset);
-    ret = SCCB_Write(sensor->slv_addr, reg, new_value);
+    ret = write_reg(sensor, bank, reg, new_value);
     return ret;
 }
 
 static int read_reg(sensor_t *sensor, ov2640_bank_t bank, uint8_t reg)
 {
+    int known = reg_shadow_get(shadow, SHADOW_REG(bank, reg));
+    if (known >= 0) {
+        return known;
+    }
     if(set_bank(sensor, bank)){
         return 0;
     }
     return SCCB_Read(sensor->slv_addr, reg);
 }
 
+/*
+ * Whether writing the table would leave a register with a value it does not
+ * already hold. Only the last write to each register counts, and the DVP
+ * reset the tables hold while the window changes is left aside.
+ */
+static bool regs_changed(const uint8_t (*regs)[2])
+{
+    ov2640_bank_t bank = reg_bank;
+    for (int i = 0; regs[i][0]; i++) {
+        if (regs[i][0] == BANK_SEL) {
+            bank = regs[i][1];
+            continue;
+        }
+        if (bank == BANK_DSP && regs[i][0] == RESET) {
+            continue;
+        }
+        bool last = true;
+        ov2640_bank_t later = bank;
+        for (int j = i + 1; regs[j][0] && last; j++) {
+            if (regs[j][0] == BANK_SEL) {
+                later = regs[j][1];
+            } else if (later == bank && regs[j][0] == regs[i][0]) {
+                last = false;
+            }
+        }
+        if (last && reg_shadow_get(shadow, SHADOW_REG(bank, regs[i][0])) != regs[i][1]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* appends a table to the one being put together, false when it does not fit */
+static bool regs_append(uint8_t (*regs)[2], int *count, int size, const uint8_t (*more)[2])
+{
+    for (int i = 0; more[i][0]; i++) {
+        if (*count >= size - 1) {
+            return false;
+        }
+        regs[*count][0] = more[i][0];
+        regs[*count][1] = more[i][1];
+        (*count)++;
+    }
+    regs[*count][0] = 0;
+    regs[*count][1] = 0;
+    return true;
+}
+
 static uint8_t get_reg_bits(sensor_t *sensor, uint8_t bank, uint8_t reg, uint8_t offset, uint8_t mask)
 {
     return (read_reg(sensor, bank, reg) >> offset) & mask;
@@ -106,25 +191,31 @@ static int reset(sensor_t *sensor)
     return ret;
 }
 
-static int set_pixformat(sensor_t *sensor, pixformat_t pixformat)
+static const uint8_t (*pixformat_regs(pixformat_t pixformat))[2]
 {
-    int ret = 0;
-    sensor->pixformat = pixformat;
     switch (pixformat) {
     case PIXFORMAT_RGB565:
     case PIXFORMAT_RGB888:
-        WRITE_REGS_OR_RETURN(ov2640_settings_rgb565);
-        break;
+        return ov2640_settings_rgb565;
     case PIXFORMAT_YUV422:
     case PIXFORMAT_GRAYSCALE:
-        WRITE_REGS_OR_RETURN(ov2640_settings_yuv422);
-        break;
+        return ov2640_settings_yuv422;
     case PIXFORMAT_JPEG:
-        WRITE_REGS_OR_RETURN(ov2640_settings_jpeg3);
-        break;
+        return ov2640_settings_jpeg3;
     default:
+        return NULL;
+    }
+}
+
+static int set_pixformat(sensor_t *sensor, pixformat_t pixformat)
+{
+    int ret = 0;
+    const uint8_t (*regs)[2] = pixformat_regs(pixformat);
+    sensor->pixformat = pixformat;
+    if (regs) {
+        WRITE_REGS_OR_RETURN(regs);
+    } else {
         ret = -1;
-        break;
     }
     if(!ret) {
         vTaskDelay(10 / portTICK_PERIOD_MS);
@@ -133,6 +224,8 @@ static int set_pixformat(sensor_t *sensor, pixformat_t pixformat)
     return ret;
 }
 
+#define WINDOW_REGS_MAX 96
+
 static int set_window(sensor_t *sensor, ov2640_sensor_mode_t mode, int offset_x, int offset_y, int max_x, int max_y, int w, int h){
     int ret = 0;
     const uint8_t (*regs)[2];
@@ -179,6 +272,26 @@ static int set_window(sensor_t *sensor, ov2640_sensor_mode_t mode, int offset_x,
         c.pclk_div = 12;
     }
 
+    // nothing to do when the sensor already has this window, as when saved settings are restored
+    uint8_t tail_regs[][2] = {
+        {BANK_SEL, BANK_SENSOR},
+        {CLKRC, c.clk},
+        {BANK_SEL, BANK_DSP},
+        {R_DVP_SP, c.pclk},
+        {R_BYPASS, R_BYPASS_DSP_EN},
+        {0, 0}
+    };
+    uint8_t all_regs[WINDOW_REGS_MAX][2];
+    int count = 0;
+    if (pixformat_regs(sensor->pixformat)
+        && regs_append(all_regs, &count, WINDOW_REGS_MAX, regs)
+        && regs_append(all_regs, &count, WINDOW_REGS_MAX, (const uint8_t (*)[2])win_regs)
+        && regs_append(all_regs, &count, WINDOW_REGS_MAX, (const uint8_t (*)[2])tail_regs)
+        && regs_append(all_regs, &count, WINDOW_REGS_MAX, pixformat_regs(sensor->pixformat))
+        && !regs_changed((const uint8_t (*)[2])all_regs)) {
+        return 0;
+    }
+
     WRITE_REG_OR_RETURN(BANK_DSP, R_BYPASS, R_BYPASS_DSP_BYPAS);
     WRITE_REGS_OR_RETURN(regs);
     WRITE_REGS_OR_RETURN(win_regs);
@@ -533,6 +646,13 @@ static int init_status(sensor_t *sensor){
 
 int ov2640_init(sensor_t *sensor)
 {
+    // the sensor may have been powered down since the last init
+    reg_bank = BANK_MAX;
+    if (!shadow) {
+        shadow = reg_shadow_create();
+    }
+    reg_shadow_clear(shadow);
+
     sensor->reset = reset;
     sensor->init_status = init_status;
     sensor->set_pixformat = set_pixformat;
@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "sccb.h"
+#include "reg_shadow.h"
 #include "ov5640.h"
 #include "ov5640_regs.h"
 #include "ov5640_settings.h"
@@ -25,8 +26,20 @@ static const char *TAG = "ov5640";
 
 //#define REG_DEBUG_ON
 
+static reg_shadow_t *shadow = NULL;
+
+/* group hold launch, AWB gains, exposure and gain: the sensor changes these itself */
+static bool reg_volatile(uint16_t reg)
+{
+    return reg == 0x3212 || (reg >= 0x3400 && reg <= 0x3405) || (reg >= 0x3500 && reg <= 0x350D);
+}
+
 static int read_reg(uint8_t slv_addr, const uint16_t reg){
-    int ret = SCCB_Read16(slv_addr, reg);
+    int ret = reg_shadow_get(shadow, reg);
+    if (ret >= 0) {
+        return ret;
+    }
+    ret = SCCB_Read16(slv_addr, reg);
 #ifdef REG_DEBUG_ON
     if (ret < 0) {
         ESP_LOGE(TAG, "READ REG 0x%04x FAILED: %d", reg, ret);
@@ -106,6 +119,9 @@ static int read_reg16(uint8_t slv_addr, const uint16_t reg){
 
 static int write_reg(uint8_t slv_addr, const uint16_t reg, uint8_t value){
     int ret = 0;
+    if (reg_shadow_get(shadow, reg) == value) {
+        return 0;
+    }
 #ifndef REG_DEBUG_ON
     ret = SCCB_Write16(slv_addr, reg, value);
 #else
@@ -124,6 +140,13 @@ static int write_reg(uint8_t slv_addr, const uint16_t reg, uint8_t value){
         ESP_LOGE(TAG, "WRITE REG 0x%04x FAILED: %d", reg, ret);
     }
 #endif
+    if (ret) {
+        reg_shadow_forget(shadow, reg);
+    } else if (reg == SYSTEM_CTROL0 && (value & 0x80)) {
+        reg_shadow_clear(shadow);
+    } else if (!reg_volatile(reg)) {
+        reg_shadow_set(shadow, reg, value);
+    }
     return ret;
 }
 
@@ -141,34 +164,63 @@ static int set_reg_bits(uint8_t slv_addr, uint16_t reg, uint8_t offset, uint8_t
     return ret;
 }
 
-static int write_regs(uint8_t slv_addr, const uint16_t (*regs)[2])
+/* one transaction for a run of consecutive registers, the sensor increments the address */
+static int write_burst(uint8_t slv_addr, uint16_t reg, const uint8_t *data, size_t length)
 {
-    int i = 0, ret = 0;
-    while (!ret && regs[i][0] != REGLIST_TAIL) {
-        if (regs[i][0] == REG_DLY) {
-            vTaskDelay(regs[i][1] / portTICK_PERIOD_MS);
+    int ret = 0;
+    if (length == 1) {
+        return write_reg(slv_addr, reg, data[0]);
+    }
+    if (length) {
+        ret = SCCB_Write16_Burst(slv_addr, reg, data, length);
+    }
+    for (size_t i = 0; i < length; i++) {
+        if (ret) {
+            reg_shadow_forget(shadow, reg + i);
         } else {
-            ret = write_reg(slv_addr, regs[i][0], regs[i][1]);
+            reg_shadow_set(shadow, reg + i, data[i]);
         }
-        i++;
     }
     return ret;
 }
 
+/* written alone: the registers the sensor changes itself, and the one that resets it */
+static bool reg_direct(uint16_t reg)
+{
+    return reg_volatile(reg) || reg == SYSTEM_CTROL0;
+}
+
+static const reg_shadow_writer_t writer = {
+    .write_reg = write_reg,
+    .write_burst = write_burst,
+    .direct = reg_direct,
+};
+
+static int write_regs(uint8_t slv_addr, const uint16_t (*regs)[2])
+{
+    return reg_shadow_write_regs(shadow, &writer, slv_addr, regs, REGLIST_TAIL, REG_DLY);
+}
+
 static int write_reg16(uint8_t slv_addr, const uint16_t reg, uint16_t value)
 {
-    if (write_reg(slv_addr, reg, value >> 8) || write_reg(slv_addr, reg + 1, value)) {
-        return -1;
-    }
-    return 0;
+    const uint16_t regs[][2] = {
+        {reg, value >> 8},
+        {reg + 1, value & 0xFF},
+        {REGLIST_TAIL, 0x00}
+    };
+    return write_regs(slv_addr, regs);
 }
 
 static int write_addr_reg(uint8_t slv_addr, const uint16_t reg, uint16_t x_value, uint16_t y_value)
 {
-    if (write_reg16(slv_addr, reg, x_value) || write_reg16(slv_addr, reg + 2, y_value)) {
-        return -1;
-    }
-    return 0;
+    const uint16_t regs[][2] = {
+        {reg, x_value >> 8},
+        {reg + 1, x_value & 0xFF},
+        {reg + 2, y_value >> 8},
+        {reg + 3, y_value & 0xFF},
+        {REGLIST_TAIL, 0x00}
+    };
+    return write_regs(slv_addr, regs);
 }
 
 #define write_reg_bits(slv_addr, reg, mask, enable) set_reg_bits(slv_addr, reg, 0, mask, (enable)?(mask):0)
@@ -1066,6 +1118,12 @@ static int init_status(sensor_t *sensor)
 
 int ov5640_init(sensor_t *sensor)
 {
+    // the sensor may have been powered down since the last init
+    if (!shadow) {
+        shadow = reg_shadow_create();
+    }
+    reg_shadow_clear(shadow);
+
     sensor->reset = reset;
     sensor->set_pixformat = set_pixformat;
     sensor->set_framesize = set_framesize;
@@ -0,0 +1,434 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "esp_camera.h"
+#include "Avi.h"
+
+//
+// Muxes frames of the simulated camera into AVI files the three ways the
+// bridge does, and reads each back with a RIFF parser of its own:
+//
+//   file     - into a file that seeks, the header written again at the end
+//   expected - in order only, with the sizes given up front, as a download
+//   stream   - in order only, with the sizes not known
+//
+// The parser walks every chunk and list and checks their sizes against
+// the file, the avih, strh and strf headers against the frames, and every
+// idx1 entry against the movi chunk it points to, whose data must be the
+// JPEG frame muxed, byte for byte. It exits non-zero on a failed check.
+// -o writes the seekable file out, for a player to open. AVI files given
+// as arguments are checked on their own instead.
+//
+
+static int failures = 0;
+
+static void fail (const char *output, const char *message, long value)
+{
+    if (failures++ < 20)
+    {
+        printf ("FAIL: %s: %s (%ld)\n", output, message, value);
+    }
+}
+
+// a file that grows and seeks, and an HTTP response that only appends
+struct output
+{
+    std::vector<uint8_t> data;
+    bool seekable;
+};
+
+static bool write (void *argument, size_t offset, const void *data, size_t length)
+{
+    output *out = (output *) argument;
+
+    if (offset != out->data.size ())
+    {
+        if (!out->seekable || (offset + length > out->data.size ()))
+        {
+            return (false);
+        }
+
+        memcpy (&out->data[offset], data, length);
+        return (true);
+    }
+
+    out->data.insert (out->data.end (), (const uint8_t *) data, (const uint8_t *) data + length);
+
+    return (true);
+}
+
+static uint32_t get32 (const std::vector<uint8_t> &data, size_t at)
+{
+    if (at + 4 > data.size ())
+    {
+        return (0);
+    }
+
+    return (data[at] | (data[at + 1] << 8) | (data[at + 2] << 16) | ((uint32_t) data[at + 3] << 24));
+}
+
+static bool is (const std::vector<uint8_t> &data, size_t at, const char *code)
+{
+    return ((at + 4 <= data.size ()) && (memcmp (&data[at], code, 4) == 0));
+}
+
+struct parsed
+{
+    uint32_t avih_frames;
+    uint32_t period;
+    uint32_t width;
+    uint32_t height;
+    uint32_t strh_length;
+    uint32_t scale;
+    uint32_t rate;
+    uint32_t strf_width;
+    uint32_t strf_height;
+    bool mjpg;
+    size_t movi;
+    std::vector<size_t> chunks;
+    std::vector<uint32_t> lengths;
+    size_t idx1;
+    uint32_t idx1_size;
+};
+
+//
+// walks the chunks of a list, or of the RIFF, from at to end; sizes of 0
+// on the RIFF and movi mean up to the end of the file, as when streamed
+//
+static void walk (const char *name, const std::vector<uint8_t> &data, size_t at, size_t end, parsed &avi, bool sized)
+{
+    while (at + 8 <= end)
+    {
+        uint32_t size = get32 (data, at + 4);
+
+        if (is (data, at, "LIST"))
+        {
+            size_t list_end = at + 8 + size;
+
+            if (!sized && (size == 0) && is (data, at + 8, "movi"))
+            {
+                // a streamed movi runs up to the index
+                list_end = end;
+                for (size_t scan = at + 12; scan + 8 <= end; scan += 8 + ((get32 (data, scan + 4) + 1) & ~1u))
+                {
+                    if (is (data, scan, "idx1"))
+                    {
+                        list_end = scan;
+                        break;
+                    }
+                }
+            }
+
+            if (list_end > end)
+            {
+                fail (name, "list runs past its parent", at);
+                return;
+            }
+
+            if (is (data, at + 8, "movi"))
+            {
+                avi.movi = at + 8;
+            }
+
+            walk (name, data, at + 12, list_end, avi, sized);
+            at = list_end + (list_end & 1);
+            continue;
+        }
+
+        if (at + 8 + size > end)
+        {
+            fail (name, "chunk runs past its list", at);
+            return;
+        }
+
+        if (is (data, at, "avih"))
+        {
+            avi.period = get32 (data, at + 8);
+            avi.avih_frames = get32 (data, at + 24);
+            avi.width = get32 (data, at + 40);
+            avi.height = get32 (data, at + 44);
+        }
+        else if (is (data, at, "strh"))
+        {
+            if (!is (data, at + 8, "vids"))
+            {
+                fail (name, "stream is not video", at);
+            }
+
+            avi.scale = get32 (data, at + 28);
+            avi.rate = get32 (data, at + 32);
+            avi.strh_length = get32 (data, at + 40);
+        }
+        else if (is (data, at, "strf"))
+        {
+            avi.strf_width = get32 (data, at + 12);
+            avi.strf_height = get32 (data, at + 16);
+            avi.mjpg = is (data, at + 24, "MJPG");
+        }
+        else if (is (data, at, "00dc"))
+        {
+            avi.chunks.push_back (at);
+            avi.lengths.push_back (size);
+        }
+        else if (is (data, at, "idx1"))
+        {
+            avi.idx1 = at;
+            avi.idx1_size = size;
+        }
+
+        at += 8 + size + (size & 1);
+    }
+
+    if (at != end)
+    {
+        fail (name, "list does not end on a chunk", at);
+    }
+}
+
+//
+// checks a file against the frames muxed into it, or without them and a
+// period, that every frame is a whole JPEG and the header agrees with itself
+//
+static void check (const char *name, const std::vector<uint8_t> &data, const std::vector<std::vector<uint8_t> > *frames,
+        bool sized, uint32_t period)
+{
+    parsed avi = parsed ();
+
+    if (!is (data, 0, "RIFF") || !is (data, 8, "AVI "))
+    {
+        fail (name, "not a RIFF AVI", 0);
+        return;
+    }
+
+    uint32_t riff = get32 (data, 4);
+    if (sized ? (riff + 8 != data.size ()) : (riff != 0))
+    {
+        fail (name, "RIFF size", riff);
+    }
+
+    walk (name, data, 12, data.size (), avi, sized);
+
+    uint32_t count = frames ? frames->size () : avi.chunks.size ();
+
+    if (sized && ((avi.avih_frames != count) || (avi.strh_length != count)))
+    {
+        fail (name, "frame count in the header", avi.avih_frames);
+    }
+
+    if ((avi.period != (period ? period : avi.period)) || (avi.period == 0) || (avi.scale != avi.period) || (avi.rate != 1000000))
+    {
+        fail (name, "frame rate in the header", avi.period);
+    }
+
+    if ((frames ? ((avi.width != 640) || (avi.height != 480)) : ((avi.width == 0) || (avi.height == 0)))
+            || (avi.strf_width != avi.width) || (avi.strf_height != avi.height) || !avi.mjpg)
+    {
+        fail (name, "frame format in the header", avi.width);
+    }
+
+    if (avi.chunks.size () != count)
+    {
+        fail (name, "frame chunks", avi.chunks.size ());
+        return;
+    }
+
+    uint32_t odd = 0;
+
+    for (uint32_t loop = 0; loop < count; loop++)
+    {
+        const uint8_t *jpeg = &data[avi.chunks[loop] + 8];
+        uint32_t length = avi.lengths[loop];
+
+        if (frames && ((length != (*frames)[loop].size ()) || memcmp (jpeg, (*frames)[loop].data (), length)))
+        {
+            fail (name, "frame data", loop);
+        }
+
+        if ((length < 4) || (jpeg[0] != 0xff) || (jpeg[1] != 0xd8) || (jpeg[length - 2] != 0xff) || (jpeg[length - 1] != 0xd9))
+        {
+            fail (name, "frame is not a whole JPEG", loop);
+        }
+
+        odd += length & 1;
+    }
+
+    if ((avi.idx1 == 0) || (avi.idx1_size != count * 16))
+    {
+        fail (name, "idx1 size", avi.idx1_size);
+        return;
+    }
+
+    for (uint32_t loop = 0; loop < count; loop++)
+    {
+        size_t entry = avi.idx1 + 8 + loop * 16;
+        size_t chunk = avi.movi + get32 (data, entry + 8);
+
+        if (!is (data, entry, "00dc") || !(get32 (data, entry + 4) & 0x10))
+        {
+            fail (name, "idx1 entry", loop);
+        }
+
+        if ((chunk != avi.chunks[loop]) || (get32 (data, entry + 12) != avi.lengths[loop]))
+        {
+            fail (name, "idx1 entry points elsewhere", loop);
+        }
+    }
+
+    printf ("  %-9s %8u bytes, %u frames of %ux%u every %.3f s, %u odd lengths padded, checked\n", name,
+            (unsigned) data.size (), count, avi.width, avi.height, avi.period / 1e6, odd);
+}
+
+int main (int argc, char *argv[])
+{
+    int count = 60;
+    uint32_t period = 200000;
+    const char *name = NULL;
+    int option;
+
+    while ((option = getopt (argc, argv, "n:p:o:")) != -1)
+    {
+        switch (option)
+        {
+            case 'n':
+                count = std::max (1, atoi (optarg));
+                break;
+            case 'p':
+                period = std::max (1, atoi (optarg)) * 1000;
+                break;
+            case 'o':
+                name = optarg;
+                break;
+            default:
+                fprintf (stderr, "usage: %s [-n frames] [-p period ms] [-o file.avi] [file.avi ...]\n", argv[0]);
+                return (1);
+        }
+    }
+
+    // the files given are checked on their own, downloads from the bridge say
+    if (optind < argc)
+    {
+        for (int loop = optind; loop < argc; loop++)
+        {
+            FILE *file = fopen (argv[loop], "rb");
+            std::vector<uint8_t> data;
+            uint8_t buffer[4096];
+            size_t bytes;
+
+            if (file == NULL)
+            {
+                fail (argv[loop], "cannot open", 0);
+                continue;
+            }
+
+            while ((bytes = fread (buffer, 1, sizeof (buffer), file)) > 0)
+            {
+                data.insert (data.end (), buffer, buffer + bytes);
+            }
+
+            fclose (file);
+            check (argv[loop], data, NULL, get32 (data, 4) != 0, 0);
+        }
+
+        printf ("%s\n", failures ? "FAILED" : "passed");
+
+        return (failures ? 1 : 0);
+    }
+
+    camera_config_t config;
+    memset (&config, 0, sizeof (config));
+    config.pixel_format = PIXFORMAT_JPEG;
+    config.frame_size = FRAMESIZE_VGA;
+    config.max_frame_size = FRAMESIZE_VGA;
+    config.jpeg_quality = 12;
+    config.fb_count = 1;
+
+    if (esp_camera_init (&config) != ESP_OK)
+    {
+        fprintf (stderr, "no camera\n");
+        return (1);
+    }
+
+    // every other frame a byte shorter, so some need padding whatever the encoder makes
+    std::vector<std::vector<uint8_t> > frames;
+    size_t bytes = 0;
+
+    for (int loop = 0; loop < count; loop++)
+    {
+        camera_fb_t *fb = esp_camera_fb_get ();
+        if (fb == NULL)
+        {
+            fprintf (stderr, "no frame\n");
+            return (1);
+        }
+
+        frames.push_back (std::vector<uint8_t> (fb->buf, fb->buf + fb->len));
+        esp_camera_fb_return (fb);
+
+        if (loop & 1)
+        {
+            frames.back ().erase (frames.back ().end () - 3);
+        }
+
+        bytes += (frames.back ().size () + 1) & ~(size_t) 1;
+    }
+
+    output file = { std::vector<uint8_t> (), true };
+    output expected = { std::vector<uint8_t> (), false };
+    output stream = { std::vector<uint8_t> (), false };
+    Avi file_avi (write, &file, count, period);
+    Avi expected_avi (write, &expected, count, period);
+    Avi stream_avi (write, &stream, count, period);
+
+    expected_avi.expect (count, bytes);
+
+    for (const std::vector<uint8_t> &frame : frames)
+    {
+        if (!file_avi.frame (frame.data (), frame.size ()) || !expected_avi.frame (frame.data (), frame.size ())
+                || !stream_avi.frame (frame.data (), frame.size ()))
+        {
+            fail ("all", "frame refused", 0);
+        }
+    }
+
+    if (file_avi.frame (frames[0].data (), frames[0].size ()))
+    {
+        fail ("file", "frame past the capacity taken", count);
+    }
+
+    if (!file_avi.finish (true) || !expected_avi.finish (false) || !stream_avi.finish (false))
+    {
+        fail ("all", "finish failed", 0);
+    }
+
+    if (expected.data.size () != Avi::length (count, bytes))
+    {
+        fail ("expected", "length differs from the size given ahead", expected.data.size ());
+    }
+
+    printf ("%d frames muxed, %u bytes of index in memory\n", count, (unsigned) (count * 8));
+
+    check ("file", file.data, &frames, true, period);
+    check ("expected", expected.data, &frames, true, period);
+    check ("stream", stream.data, &frames, false, period);
+
+    if (name)
+    {
+        FILE *out = fopen (name, "wb");
+
+        if (out)
+        {
+            fwrite (file.data.data (), 1, file.data.size (), out);
+            fclose (out);
+        }
+    }
+
+    printf ("%s\n", failures ? "FAILED" : "passed");
+
+    return (failures ? 1 : 0);
+}
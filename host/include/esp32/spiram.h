@@ -0,0 +1,6 @@
+#ifndef __SPIRAM_H__
+#define __SPIRAM_H__
+
+// included by the camera's JPEG encoder, which uses nothing from it
+
+#endif
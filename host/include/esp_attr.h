@@ -0,0 +1,11 @@
+#ifndef __ESP_ATTR_H__
+#define __ESP_ATTR_H__
+
+// memory placement has no meaning on the host
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define EXT_RAM_ATTR
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef __ESP_BT_H__
+#define __ESP_BT_H__
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// the controller is simulated together with the robot, see esp_spp_api.h
+
+typedef enum
+{
+    ESP_BT_MODE_IDLE = 0x00,
+    ESP_BT_MODE_BLE = 0x01,
+    ESP_BT_MODE_CLASSIC_BT = 0x02,
+    ESP_BT_MODE_BTDM = 0x03
+} esp_bt_mode_t;
+
+typedef struct
+{
+    uint32_t magic;
+} esp_bt_controller_config_t;
+
+#define BT_CONTROLLER_INIT_CONFIG_DEFAULT() { 0x5a5aa5a5 }
+
+esp_err_t esp_bt_controller_mem_release (esp_bt_mode_t mode);
+esp_err_t esp_bt_controller_init (esp_bt_controller_config_t *config);
+esp_err_t esp_bt_controller_enable (esp_bt_mode_t mode);
+esp_err_t esp_bt_controller_disable (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef __ESP_BT_DEFS_H__
+#define __ESP_BT_DEFS_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ESP_BD_ADDR_LEN 6
+
+typedef uint8_t esp_bd_addr_t[ESP_BD_ADDR_LEN];
+
+typedef enum
+{
+    ESP_BT_STATUS_SUCCESS = 0,
+    ESP_BT_STATUS_FAIL,
+    ESP_BT_STATUS_NOT_READY,
+    ESP_BT_STATUS_NOMEM,
+    ESP_BT_STATUS_BUSY,
+    ESP_BT_STATUS_DONE,
+    ESP_BT_STATUS_UNSUPPORTED
+} esp_bt_status_t;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef __ESP_BT_DEVICE_H__
+#define __ESP_BT_DEVICE_H__
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t esp_bt_dev_set_device_name (const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
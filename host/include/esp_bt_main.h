@@ -0,0 +1,19 @@
+#ifndef __ESP_BT_MAIN_H__
+#define __ESP_BT_MAIN_H__
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t esp_bluedroid_init (void);
+esp_err_t esp_bluedroid_enable (void);
+esp_err_t esp_bluedroid_disable (void);
+esp_err_t esp_bluedroid_deinit (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef __ESP_EVENT_H__
+#define __ESP_EVENT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef const char *esp_event_base_t;
+typedef void (*esp_event_handler_t) (void *arg, esp_event_base_t base, int32_t id, void *data);
+
+#define ESP_EVENT_DECLARE_BASE(id) extern esp_event_base_t id
+#define ESP_EVENT_DEFINE_BASE(id) esp_event_base_t id = #id
+
+#define ESP_EVENT_ANY_BASE  NULL
+#define ESP_EVENT_ANY_ID    -1
+
+// the default loop runs handlers on the thread posting the event
+esp_err_t esp_event_loop_create_default (void);
+esp_err_t esp_event_loop_delete_default (void);
+esp_err_t esp_event_handler_register (esp_event_base_t base, int32_t id, esp_event_handler_t handler, void *arg);
+esp_err_t esp_event_handler_unregister (esp_event_base_t base, int32_t id, esp_event_handler_t handler);
+esp_err_t esp_event_post (esp_event_base_t base, int32_t id, void *data, size_t size, TickType_t ticks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
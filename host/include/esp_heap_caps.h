@@ -0,0 +1,61 @@
+#ifndef __ESP_HEAP_CAPS_H__
+#define __ESP_HEAP_CAPS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MALLOC_CAP_EXEC             (1 << 0)
+#define MALLOC_CAP_32BIT            (1 << 1)
+#define MALLOC_CAP_8BIT             (1 << 2)
+#define MALLOC_CAP_DMA              (1 << 3)
+#define MALLOC_CAP_SPIRAM           (1 << 10)
+#define MALLOC_CAP_INTERNAL         (1 << 11)
+#define MALLOC_CAP_DEFAULT          (1 << 12)
+
+// every capability is served from the process heap
+static inline void *heap_caps_malloc (size_t size, uint32_t caps)
+{
+    (void) caps;
+    return (malloc (size));
+}
+
+static inline void *heap_caps_calloc (size_t count, size_t size, uint32_t caps)
+{
+    (void) caps;
+    return (calloc (count, size));
+}
+
+static inline void *heap_caps_realloc (void *pointer, size_t size, uint32_t caps)
+{
+    (void) caps;
+    return (realloc (pointer, size));
+}
+
+static inline void heap_caps_free (void *pointer)
+{
+    free (pointer);
+}
+
+// the process heap is not accounted, it reports as empty
+static inline size_t heap_caps_get_free_size (uint32_t caps)
+{
+    (void) caps;
+    return (0);
+}
+
+static inline size_t heap_caps_get_minimum_free_size (uint32_t caps)
+{
+    (void) caps;
+    return (0);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef __ESP_IDF_VERSION_H__
+#define __ESP_IDF_VERSION_H__
+
+// the ESP-IDF release the firmware is built with
+
+#define ESP_IDF_VERSION_MAJOR   4
+#define ESP_IDF_VERSION_MINOR   2
+#define ESP_IDF_VERSION_PATCH   0
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef __ESP_LOG_H__
+#define __ESP_LOG_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum
+{
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+void esp_log_level_set (const char *tag, esp_log_level_t level);
+void esp_log_write (esp_log_level_t level, const char *tag, const char *format, ...) __attribute__ ((format (printf, 3, 4)));
+uint32_t esp_log_timestamp (void);
+void esp_log_buffer_hex_internal (const char *tag, const void *buffer, uint16_t length, esp_log_level_t level);
+void esp_log_buffer_char_internal (const char *tag, const void *buffer, uint16_t length, esp_log_level_t level);
+
+#define esp_log_buffer_hex(tag, buffer, length) esp_log_buffer_hex_internal (tag, buffer, length, ESP_LOG_INFO)
+#define esp_log_buffer_char(tag, buffer, length) esp_log_buffer_char_internal (tag, buffer, length, ESP_LOG_INFO)
+
+#define HOST_LOG(level, letter, tag, format, ...) \
+    esp_log_write (level, tag, #letter " (%u) %s: " format "\n", esp_log_timestamp (), tag, ##__VA_ARGS__)
+
+#define ESP_LOGE(tag, format, ...) HOST_LOG (ESP_LOG_ERROR, E, tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) HOST_LOG (ESP_LOG_WARN, W, tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) HOST_LOG (ESP_LOG_INFO, I, tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) HOST_LOG (ESP_LOG_DEBUG, D, tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) HOST_LOG (ESP_LOG_VERBOSE, V, tag, format, ##__VA_ARGS__)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef __ESP_NETIF_H__
+#define __ESP_NETIF_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_event.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct esp_netif_obj esp_netif_t;
+
+typedef struct
+{
+    uint32_t addr;
+} esp_ip4_addr_t;
+
+typedef struct
+{
+    esp_ip4_addr_t ip;
+    esp_ip4_addr_t netmask;
+    esp_ip4_addr_t gw;
+} esp_netif_ip_info_t;
+
+typedef struct
+{
+    int if_index;
+    esp_netif_t *esp_netif;
+    esp_netif_ip_info_t ip_info;
+    bool ip_changed;
+} ip_event_got_ip_t;
+
+typedef enum
+{
+    IP_EVENT_STA_GOT_IP,
+    IP_EVENT_STA_LOST_IP,
+    IP_EVENT_AP_STAIPASSIGNED,
+    IP_EVENT_GOT_IP6,
+    IP_EVENT_ETH_GOT_IP,
+    IP_EVENT_PPP_GOT_IP,
+    IP_EVENT_PPP_LOST_IP
+} ip_event_t;
+
+ESP_EVENT_DECLARE_BASE (IP_EVENT);
+
+#define esp_ip4_addr1(ipaddr) (((const uint8_t *) (&(ipaddr)->addr))[0])
+#define esp_ip4_addr2(ipaddr) (((const uint8_t *) (&(ipaddr)->addr))[1])
+#define esp_ip4_addr3(ipaddr) (((const uint8_t *) (&(ipaddr)->addr))[2])
+#define esp_ip4_addr4(ipaddr) (((const uint8_t *) (&(ipaddr)->addr))[3])
+
+#define IPSTR "%d.%d.%d.%d"
+#define IP2STR(ipaddr) esp_ip4_addr1 (ipaddr), esp_ip4_addr2 (ipaddr), esp_ip4_addr3 (ipaddr), esp_ip4_addr4 (ipaddr)
+
+esp_err_t esp_netif_init (void);
+esp_netif_t *esp_netif_create_default_wifi_sta (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#include "tcpip_adapter.h"
+
+#endif
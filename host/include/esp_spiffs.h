@@ -0,0 +1,34 @@
+#ifndef __ESP_SPIFFS_H__
+#define __ESP_SPIFFS_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// the partition is a directory on the host, by default the project's
+// filesystem directory that the firmware build turns into the SPIFFS image
+//
+typedef struct
+{
+    const char *base_path;
+    const char *partition_label;
+    size_t max_files;
+    bool format_if_mount_failed;
+} esp_vfs_spiffs_conf_t;
+
+esp_err_t esp_vfs_spiffs_register (const esp_vfs_spiffs_conf_t *conf);
+esp_err_t esp_vfs_spiffs_unregister (const char *partition_label);
+bool esp_spiffs_mounted (const char *partition_label);
+esp_err_t esp_spiffs_info (const char *partition_label, size_t *total, size_t *used);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
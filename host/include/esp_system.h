@@ -0,0 +1,22 @@
+#ifndef __ESP_SYSTEM_H__
+#define __ESP_SYSTEM_H__
+
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_idf_version.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t esp_random (void);
+void esp_fill_random (void *buffer, size_t length);
+void esp_restart (void) __attribute__ ((noreturn));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef __ESP_TIMER_H__
+#define __ESP_TIMER_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// microseconds since the process started
+int64_t esp_timer_get_time (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
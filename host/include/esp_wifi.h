@@ -0,0 +1,122 @@
+#ifndef __ESP_WIFI_H__
+#define __ESP_WIFI_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+
+// the IDF headers pull esp_timer.h in along the way, the firmware relies on it
+#include "esp_timer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// the host is always on the network: starting the station connects at
+// once and reports the loopback address
+//
+
+typedef enum
+{
+    WIFI_MODE_NULL = 0,
+    WIFI_MODE_STA,
+    WIFI_MODE_AP,
+    WIFI_MODE_APSTA,
+    WIFI_MODE_MAX
+} wifi_mode_t;
+
+typedef enum
+{
+    ESP_IF_WIFI_STA = 0,
+    ESP_IF_WIFI_AP,
+    ESP_IF_ETH,
+    ESP_IF_MAX
+} wifi_interface_t;
+
+typedef enum
+{
+    WIFI_AUTH_OPEN = 0,
+    WIFI_AUTH_WEP,
+    WIFI_AUTH_WPA_PSK,
+    WIFI_AUTH_WPA2_PSK,
+    WIFI_AUTH_WPA_WPA2_PSK,
+    WIFI_AUTH_WPA2_ENTERPRISE,
+    WIFI_AUTH_MAX
+} wifi_auth_mode_t;
+
+typedef struct
+{
+    int8_t rssi;
+    wifi_auth_mode_t authmode;
+} wifi_scan_threshold_t;
+
+typedef struct
+{
+    bool capable;
+    bool required;
+} wifi_pmf_config_t;
+
+typedef struct
+{
+    uint8_t ssid[32];
+    uint8_t password[64];
+    bool bssid_set;
+    uint8_t bssid[6];
+    uint8_t channel;
+    wifi_scan_threshold_t threshold;
+    wifi_pmf_config_t pmf_cfg;
+} wifi_sta_config_t;
+
+typedef struct
+{
+    uint8_t ssid[32];
+    uint8_t password[64];
+    uint8_t ssid_len;
+    uint8_t channel;
+    wifi_auth_mode_t authmode;
+    uint8_t max_connection;
+} wifi_ap_config_t;
+
+typedef union
+{
+    wifi_ap_config_t ap;
+    wifi_sta_config_t sta;
+} wifi_config_t;
+
+typedef struct
+{
+    int magic;
+} wifi_init_config_t;
+
+#define WIFI_INIT_CONFIG_DEFAULT() { 0x1f2f3f4f }
+
+typedef enum
+{
+    WIFI_EVENT_WIFI_READY = 0,
+    WIFI_EVENT_SCAN_DONE,
+    WIFI_EVENT_STA_START,
+    WIFI_EVENT_STA_STOP,
+    WIFI_EVENT_STA_CONNECTED,
+    WIFI_EVENT_STA_DISCONNECTED
+} wifi_event_t;
+
+ESP_EVENT_DECLARE_BASE (WIFI_EVENT);
+
+esp_err_t esp_wifi_init (const wifi_init_config_t *config);
+esp_err_t esp_wifi_deinit (void);
+esp_err_t esp_wifi_set_mode (wifi_mode_t mode);
+esp_err_t esp_wifi_set_config (wifi_interface_t interface, wifi_config_t *config);
+esp_err_t esp_wifi_start (void);
+esp_err_t esp_wifi_stop (void);
+esp_err_t esp_wifi_connect (void);
+esp_err_t esp_wifi_disconnect (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
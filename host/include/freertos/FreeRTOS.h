@@ -0,0 +1,105 @@
+#ifndef __FREERTOS_H__
+#define __FREERTOS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "sdkconfig.h"
+
+// the target's port layer brings in the error codes with FreeRTOS
+#include "esp_err.h"
+
+//
+// FreeRTOS on top of POSIX threads
+//
+// Tasks are threads, queues, semaphores and event groups are built on
+// mutexes and condition variables. Task priorities and core affinity are
+// accepted and ignored, so the scheduling differs from the target but the
+// blocking behaviour and timeouts are the same.
+//
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t StackType_t;
+
+#define pdFALSE             ((BaseType_t) 0)
+#define pdTRUE              ((BaseType_t) 1)
+#define pdPASS              (pdTRUE)
+#define pdFAIL              (pdFALSE)
+
+#define portMAX_DELAY       ((TickType_t) 0xffffffffUL)
+#define configTICK_RATE_HZ  (CONFIG_FREERTOS_HZ)
+#define portTICK_PERIOD_MS  ((TickType_t) 1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)   ((TickType_t) (((TickType_t) (ms) * (TickType_t) configTICK_RATE_HZ) / (TickType_t) 1000))
+
+#define portNUM_PROCESSORS  (2)
+
+// critical sections are a process wide recursive lock
+typedef struct
+{
+    pthread_mutex_t mutex;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED { PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP }
+
+void vPortEnterCritical (portMUX_TYPE *mux);
+void vPortExitCritical (portMUX_TYPE *mux);
+
+#define portENTER_CRITICAL(mux)         vPortEnterCritical (mux)
+#define portEXIT_CRITICAL(mux)          vPortExitCritical (mux)
+#define portENTER_CRITICAL_ISR(mux)     vPortEnterCritical (mux)
+#define portEXIT_CRITICAL_ISR(mux)      vPortExitCritical (mux)
+#define portYIELD_FROM_ISR()            do { } while (0)
+
+// every task reports running on the first core
+static inline BaseType_t xPortGetCoreID (void)
+{
+    return (0);
+}
+
+#ifndef BIT0
+#define BIT31   0x80000000
+#define BIT30   0x40000000
+#define BIT29   0x20000000
+#define BIT28   0x10000000
+#define BIT27   0x08000000
+#define BIT26   0x04000000
+#define BIT25   0x02000000
+#define BIT24   0x01000000
+#define BIT23   0x00800000
+#define BIT22   0x00400000
+#define BIT21   0x00200000
+#define BIT20   0x00100000
+#define BIT19   0x00080000
+#define BIT18   0x00040000
+#define BIT17   0x00020000
+#define BIT16   0x00010000
+#define BIT15   0x00008000
+#define BIT14   0x00004000
+#define BIT13   0x00002000
+#define BIT12   0x00001000
+#define BIT11   0x00000800
+#define BIT10   0x00000400
+#define BIT9    0x00000200
+#define BIT8    0x00000100
+#define BIT7    0x00000080
+#define BIT6    0x00000040
+#define BIT5    0x00000020
+#define BIT4    0x00000010
+#define BIT3    0x00000008
+#define BIT2    0x00000004
+#define BIT1    0x00000002
+#define BIT0    0x00000001
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef __QUEUE_H__
+#define __QUEUE_H__
+
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct host_queue *QueueHandle_t;
+
+QueueHandle_t xQueueCreate (UBaseType_t length, UBaseType_t size);
+void vQueueDelete (QueueHandle_t queue);
+BaseType_t xQueueGenericSend (QueueHandle_t queue, const void *item, TickType_t ticks, BaseType_t front);
+BaseType_t xQueueReceive (QueueHandle_t queue, void *item, TickType_t ticks);
+BaseType_t xQueuePeek (QueueHandle_t queue, void *item, TickType_t ticks);
+BaseType_t xQueueReset (QueueHandle_t queue);
+UBaseType_t uxQueueMessagesWaiting (QueueHandle_t queue);
+UBaseType_t uxQueueSpacesAvailable (QueueHandle_t queue);
+
+#define xQueueSend(queue, item, ticks)              xQueueGenericSend (queue, item, ticks, pdFALSE)
+#define xQueueSendToBack(queue, item, ticks)        xQueueGenericSend (queue, item, ticks, pdFALSE)
+#define xQueueSendToFront(queue, item, ticks)       xQueueGenericSend (queue, item, ticks, pdTRUE)
+#define xQueueSendFromISR(queue, item, woken)       xQueueGenericSend (queue, item, 0, pdFALSE)
+#define xQueueReceiveFromISR(queue, item, woken)    xQueueReceive (queue, item, 0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
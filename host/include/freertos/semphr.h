@@ -0,0 +1,33 @@
+#ifndef __SEMPHR_H__
+#define __SEMPHR_H__
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// as in FreeRTOS, semaphores are queues of empty items: give sends one,
+// take receives one
+//
+typedef QueueHandle_t SemaphoreHandle_t;
+
+QueueHandle_t xQueueCreateCountingSemaphore (UBaseType_t maximum, UBaseType_t initial);
+
+#define xSemaphoreCreateBinary()                    xQueueCreate (1, 0)
+#define xSemaphoreCreateMutex()                     xQueueCreateCountingSemaphore (1, 1)
+#define xSemaphoreCreateCounting(maximum, initial)  xQueueCreateCountingSemaphore (maximum, initial)
+#define xSemaphoreTake(semaphore, ticks)            xQueueReceive (semaphore, NULL, ticks)
+#define xSemaphoreGive(semaphore)                   xQueueGenericSend (semaphore, NULL, 0, pdFALSE)
+#define xSemaphoreTakeFromISR(semaphore, woken)     xQueueReceive (semaphore, NULL, 0)
+#define xSemaphoreGiveFromISR(semaphore, woken)     xQueueGenericSend (semaphore, NULL, 0, pdFALSE)
+#define uxSemaphoreGetCount(semaphore)              uxQueueMessagesWaiting (semaphore)
+#define vSemaphoreDelete(semaphore)                 vQueueDelete (semaphore)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
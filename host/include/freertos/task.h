@@ -0,0 +1,42 @@
+#ifndef __TASK_H__
+#define __TASK_H__
+
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct host_task *TaskHandle_t;
+typedef void (*TaskFunction_t) (void *parameters);
+
+#define tskIDLE_PRIORITY    ((UBaseType_t) 0)
+#define tskNO_AFFINITY      ((BaseType_t) 0x7fffffff)
+
+BaseType_t xTaskCreatePinnedToCore (TaskFunction_t function, const char *name, uint32_t stack,
+        void *parameters, UBaseType_t priority, TaskHandle_t *created, BaseType_t core);
+void vTaskDelete (TaskHandle_t task);
+void vTaskDelay (TickType_t ticks);
+void vTaskDelayUntil (TickType_t *previous, TickType_t increment);
+TickType_t xTaskGetTickCount (void);
+TaskHandle_t xTaskGetCurrentTaskHandle (void);
+const char *pcTaskGetTaskName (TaskHandle_t task);
+uint32_t ulTaskNotifyTake (BaseType_t clear, TickType_t ticks);
+BaseType_t xTaskNotifyGive (TaskHandle_t task);
+void vTaskNotifyGiveFromISR (TaskHandle_t task, BaseType_t *woken);
+
+static inline BaseType_t xTaskCreate (TaskFunction_t function, const char *name, uint32_t stack,
+        void *parameters, UBaseType_t priority, TaskHandle_t *created)
+{
+    return (xTaskCreatePinnedToCore (function, name, stack, parameters, priority, created, tskNO_AFFINITY));
+}
+
+#define taskENTER_CRITICAL(mux)     portENTER_CRITICAL (mux)
+#define taskEXIT_CRITICAL(mux)      portEXIT_CRITICAL (mux)
+#define taskYIELD()                 vTaskDelay (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
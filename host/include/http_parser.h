@@ -0,0 +1,28 @@
+#ifndef __HTTP_PARSER_H__
+#define __HTTP_PARSER_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// request methods, numbered as in the parser bundled with ESP-IDF
+enum http_method
+{
+    HTTP_DELETE = 0,
+    HTTP_GET = 1,
+    HTTP_HEAD = 2,
+    HTTP_POST = 3,
+    HTTP_PUT = 4,
+    HTTP_CONNECT = 5,
+    HTTP_OPTIONS = 6,
+    HTTP_TRACE = 7,
+    HTTP_PATCH = 28
+};
+
+const char *http_method_str (enum http_method method);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
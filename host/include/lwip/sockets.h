@@ -0,0 +1,13 @@
+#ifndef __LWIP_SOCKETS_H__
+#define __LWIP_SOCKETS_H__
+
+//
+// lwIP socket API, which the host provides with the POSIX one
+//
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef __SDKCONFIG_H__
+#define __SDKCONFIG_H__
+
+//
+// configuration for the host build, the Kconfig defaults of the project
+// plus the few ESP-IDF settings the shims need
+//
+
+// Robot configuration
+#define CONFIG_MINDBRIDGE_MOTOR_LEFT 1
+#define CONFIG_MINDBRIDGE_MOTOR_RIGHT 2
+#define CONFIG_MINDBRIDGE_ROBOT_COMMAND_GAP 0
+#define CONFIG_MINDBRIDGE_TELEMETRY_S1_PERIOD 0
+#define CONFIG_MINDBRIDGE_TELEMETRY_S2_PERIOD 0
+#define CONFIG_MINDBRIDGE_TELEMETRY_S3_PERIOD 0
+#define CONFIG_MINDBRIDGE_TELEMETRY_S4_PERIOD 0
+#define CONFIG_MINDBRIDGE_TELEMETRY_TACHO_PERIOD 500
+#define CONFIG_MINDBRIDGE_TELEMETRY_PIPELINE 2
+#define CONFIG_MINDBRIDGE_TELEMETRY_SAMPLES 256
+
+// Control Bridge Configuration
+#define CONFIG_MINDBRIDGE_MDNS_HOSTNAME "mindbridge"
+#define CONFIG_MINDBRIDGE_ROBOT_SPP_NAME "Chad"
+#define CONFIG_MINDBRIDGE_ACTIVITY_LED 33
+#define CONFIG_MINDBRIDGE_HEADLIGHT_LED 4
+#define CONFIG_ESP_WIFI_SSID "host"
+#define CONFIG_ESP_WIFI_PASSWORD "host"
+#define CONFIG_ESP_MAXIMUM_RETRY 5
+#define CONFIG_MINDBRIDGE_HTTPD_SOCKETS 12
+#define CONFIG_MINDBRIDGE_HTTPD_CONTROL_SOCKETS 8
+#define CONFIG_MINDBRIDGE_HTTPD_KEEPALIVE 15
+#define CONFIG_MINDBRIDGE_HTTPD_VIDEO_SEND_TIMEOUT 2
+#define CONFIG_MINDBRIDGE_VIDEO_STREAMS 3
+#define CONFIG_MINDBRIDGE_VIDEO_STREAMS_DRIVING 2
+#define CONFIG_MINDBRIDGE_POLL_RATE 2
+#define CONFIG_MINDBRIDGE_POLL_BURST 5
+#define CONFIG_MINDBRIDGE_ROTATION_180 1
+#define CONFIG_MINDBRIDGE_ROTATION 180
+#define CONFIG_MINDBRIDGE_PROFILE_HIGH_QUALITY 50
+#define CONFIG_MINDBRIDGE_PROFILE_MEDIUM_QUALITY 50
+#define CONFIG_MINDBRIDGE_PROFILE_LOW_QUALITY 30
+#define CONFIG_MINDBRIDGE_MOTION_PERIOD 500
+#define CONFIG_MINDBRIDGE_MOTION_SENSITIVITY 50
+#define CONFIG_MINDBRIDGE_MOTION_TRIGGER 10
+#define CONFIG_MINDBRIDGE_MOTION_COLUMNS 4
+#define CONFIG_MINDBRIDGE_MOTION_ROWS 3
+#define CONFIG_MINDBRIDGE_RECORDER_SIZE 1024
+#define CONFIG_MINDBRIDGE_RECORDER_PERIOD 200
+#define CONFIG_MINDBRIDGE_RECORDER_HISTORY 5
+
+// Camera configuration
+#define CONFIG_CAMERA_TRACE_EVENTS 256
+
+// ESP-IDF
+#define CONFIG_IDF_TARGET_ESP32 1
+#define CONFIG_FREERTOS_HZ 100
+#define CONFIG_HTTPD_MAX_REQ_HDR_LEN 512
+#define CONFIG_HTTPD_MAX_URI_LEN 512
+
+#endif
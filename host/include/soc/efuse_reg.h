@@ -0,0 +1,6 @@
+#ifndef __EFUSE_REG_H__
+#define __EFUSE_REG_H__
+
+// included by the camera's JPEG encoder, which uses nothing from it
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef __TCPIP_ADAPTER_H__
+#define __TCPIP_ADAPTER_H__
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum
+{
+    TCPIP_ADAPTER_IF_STA = 0,
+    TCPIP_ADAPTER_IF_AP,
+    TCPIP_ADAPTER_IF_ETH,
+    TCPIP_ADAPTER_IF_MAX
+} tcpip_adapter_if_t;
+
+esp_err_t tcpip_adapter_set_hostname (tcpip_adapter_if_t interface, const char *hostname);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
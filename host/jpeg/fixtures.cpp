@@ -0,0 +1,177 @@
+#include <dirent.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <algorithm>
+
+#include "fixtures.h"
+
+vector_stream::vector_stream (std::vector<uint8_t> &output) :
+    _output (output)
+{
+}
+
+bool vector_stream::put_buf (const void *buffer, int length)
+{
+    if (buffer)
+    {
+        _output.insert (_output.end (), (const uint8_t *) buffer, (const uint8_t *) buffer + length);
+    }
+
+    return (true);
+}
+
+jpge::uint vector_stream::get_size () const
+{
+    return (_output.size ());
+}
+
+size_t append (void *argument, size_t index, const void *data, size_t length)
+{
+    std::vector<uint8_t> *output = (std::vector<uint8_t> *) argument;
+
+    if (data)
+    {
+        output->insert (output->end (), (const uint8_t *) data, (const uint8_t *) data + length);
+    }
+
+    return (length);
+}
+
+int encoder_quality (int quality)
+{
+    return (std::max (1, 100 - (quality * 100) / 64));
+}
+
+std::vector<uint8_t> scene (int width, int height)
+{
+    std::vector<uint8_t> pixels (width * height * 3);
+
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            uint8_t *pixel = &pixels[(y * width + x) * 3];
+            int shade = 128 + (int) (60 * sin (x / 37.0) * cos (y / 23.0));
+
+            pixel[0] = std::min (255, shade + ((x * 4 / width == 1) ? 80 : 0));
+            pixel[1] = std::min (255, shade + ((y * 3 / height == 1) ? 60 : 0));
+            pixel[2] = std::min (255, shade + (((x / 40 + y / 40) % 2) ? 50 : 0));
+        }
+    }
+
+    return (pixels);
+}
+
+bool encode (const std::vector<uint8_t> &pixels, int width, int height, int quality, std::vector<uint8_t> &output)
+{
+    jpge::params parameters;
+    parameters.m_quality = quality;
+    parameters.m_subsampling = jpge::H2V1;
+
+    vector_stream stream (output);
+    jpge::jpeg_encoder encoder;
+    std::vector<uint8_t> line (width * 3);
+
+    if (!encoder.init (&stream, width, height, 3, parameters))
+    {
+        return (false);
+    }
+
+    for (int row = 0; row < height; row++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            line[x * 3 + 0] = pixels[(row * width + x) * 3 + 2];
+            line[x * 3 + 1] = pixels[(row * width + x) * 3 + 1];
+            line[x * 3 + 2] = pixels[(row * width + x) * 3 + 0];
+        }
+
+        if (!encoder.process_scanline (line.data ()))
+        {
+            return (false);
+        }
+    }
+
+    return (encoder.process_scanline (NULL));
+}
+
+frame make (int width, int height, int quality)
+{
+    frame made;
+    char name[32];
+
+    snprintf (name, sizeof (name), "scene %dx%d", width, height);
+    made.name = name;
+
+    if (!encode (scene (width, height), width, height, quality, made.data))
+    {
+        fprintf (stderr, "failed to encode %s\n", name);
+        exit (1);
+    }
+
+    return (made);
+}
+
+void load (const char *directory, std::vector<frame> &frames)
+{
+    std::vector<std::string> names;
+
+    DIR *entries = opendir (directory);
+    if (entries == NULL)
+    {
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir (entries)) != NULL)
+    {
+        const char *dot = strrchr (entry->d_name, '.');
+
+        if (dot && ((strcasecmp (dot, ".jpg") == 0) || (strcasecmp (dot, ".jpeg") == 0)))
+        {
+            names.push_back (std::string (directory) + "/" + entry->d_name);
+        }
+    }
+
+    closedir (entries);
+    std::sort (names.begin (), names.end ());
+
+    for (const std::string &name : names)
+    {
+        FILE *file = fopen (name.c_str (), "rb");
+        if (file == NULL)
+        {
+            continue;
+        }
+
+        frame loaded;
+        uint8_t buffer[4096];
+        size_t bytes;
+
+        loaded.name = name;
+        while ((bytes = fread (buffer, 1, sizeof (buffer), file)) > 0)
+        {
+            loaded.data.insert (loaded.data.end (), buffer, buffer + bytes);
+        }
+
+        fclose (file);
+        frames.push_back (loaded);
+    }
+}
+
+double psnr (const std::vector<uint8_t> &a, const std::vector<uint8_t> &b)
+{
+    double error = 0;
+
+    for (size_t loop = 0; loop < a.size (); loop++)
+    {
+        double difference = (double) a[loop] - b[loop];
+        error += difference * difference;
+    }
+
+    return ((error == 0) ? 99.0 : 10 * log10 (255.0 * 255.0 / (error / a.size ())));
+}
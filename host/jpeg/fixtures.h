@@ -0,0 +1,57 @@
+#ifndef __FIXTURES_H__
+#define __FIXTURES_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "jpge.h"
+
+//
+// frames for the JPEG host tools, made up or read from disk
+//
+// The made up frames are a test scene encoded the way the OV2640 does,
+// 4:2:2 with jpge. Pixels are stored B, G, R like the camera converters.
+//
+
+struct frame
+{
+    std::string name;
+    std::vector<uint8_t> data;
+};
+
+// collects the encoder's output
+class vector_stream : public jpge::output_stream
+{
+    public:
+        vector_stream (std::vector<uint8_t> &output);
+        virtual bool put_buf (const void *buffer, int length);
+        virtual jpge::uint get_size () const;
+    private:
+        std::vector<uint8_t> &_output;
+};
+
+// a jpg_out_cb that appends to the std::vector<uint8_t> it is given
+size_t append (void *argument, size_t index, const void *data, size_t length);
+
+// sensor quality runs from 0 (best) to 63, the encoder's from 100 (best) to 1
+int encoder_quality (int quality);
+
+// a test scene with colour, edges and texture
+std::vector<uint8_t> scene (int width, int height);
+
+// 4:2:2 like the sensors, at the encoder's quality
+bool encode (const std::vector<uint8_t> &pixels, int width, int height, int quality, std::vector<uint8_t> &output);
+
+// the test scene encoded at the encoder's quality, exits when it cannot be
+frame make (int width, int height, int quality);
+
+// every .jpg and .jpeg file in a directory, in name order
+void load (const char *directory, std::vector<frame> &frames);
+
+// peak signal to noise ratio of two images of the same size, 99 when equal
+double psnr (const std::vector<uint8_t> &a, const std::vector<uint8_t> &b);
+
+#endif
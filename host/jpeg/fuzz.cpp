@@ -0,0 +1,321 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "esp_jpg_coeff.h"
+#include "fixtures.h"
+#include "img_converters.h"
+
+//
+// Feeds the coefficient decoder, and the thumbnail, transform and
+// requantize paths built on it, frames damaged the ways a frame off the
+// air or off a file can be. It checks that
+//
+//   - a Huffman table with more codes of a length than the length holds,
+//     255 codes of one bit or three of one and two bits, is refused
+//   - a table that uses every code there is, two of one bit, is taken
+//   - the intact frame decodes, with every block inside the frame
+//   - a damaged frame either fails or decodes with every block inside the
+//     frame it says it is
+//
+// The damaged frames are the test scene with bytes changed, runs cut out
+// or repeated, segment lengths changed and made up Huffman tables put in.
+// Build with -fsanitize=address,undefined to catch the reads and writes
+// out of bounds a failed check would not show. It exits non-zero on a
+// failed check.
+//
+
+static int failures = 0;
+
+static void fail (const std::string &name, const char *message)
+{
+    if (failures++ < 20)
+    {
+        printf ("FAIL: %s: %s\n", name.c_str (), message);
+    }
+}
+
+// --------
+// decoding
+// --------
+
+struct blocks
+{
+    long count;
+    long outside;
+};
+
+static bool inside (void *argument, const jpg_coeff_info_t *info, const jpg_coeff_block_t *block)
+{
+    blocks *seen = (blocks *) argument;
+
+    seen->count++;
+    if ((block->component >= info->components) || (block->x >= info->component[block->component].blocks_w)
+            || (block->y >= info->component[block->component].blocks_h))
+    {
+        seen->outside++;
+    }
+
+    return (true);
+}
+
+static size_t discard (void *argument, size_t index, const void *data, size_t length)
+{
+    return (length);
+}
+
+// every path over the frame, the result of the full coefficient decode
+static esp_err_t decode (const frame &input, blocks &seen)
+{
+    jpg_coeff_info_t info;
+    esp_err_t result = ESP_OK;
+    std::vector<uint8_t> thumbnail (80 * 60 * 3);
+    uint16_t width = 0;
+    uint16_t height = 0;
+
+    // a copy exactly as long as the frame, so a read past it is caught
+    std::vector<uint8_t> data (input.data);
+    const uint8_t *jpeg = data.empty () ? NULL : data.data ();
+
+    seen = blocks ();
+    esp_jpg_coeff_info (jpeg, data.size (), &info);
+    esp_jpg_coeff_decode (jpeg, data.size (), JPG_COEFF_DC, inside, &seen, NULL);
+
+    seen = blocks ();
+    result = esp_jpg_coeff_decode (jpeg, data.size (), JPG_COEFF_ALL, inside, &seen, &info);
+
+    jpg2thumbnail (jpeg, data.size (), PIXFORMAT_RGB888, thumbnail.data (), thumbnail.size (), &width, &height);
+    jpg_transform_cb (jpeg, data.size (), JPG_TRANSFORM_ROT_90, discard, NULL);
+    jpg_requantize_cb (jpeg, data.size (), 30, discard, NULL);
+
+    return (result);
+}
+
+// ------
+// frames
+// ------
+
+// where each marker segment of a frame starts, up to the scan
+static std::vector<size_t> segments (const std::vector<uint8_t> &data)
+{
+    std::vector<size_t> found;
+    size_t at = 2;
+
+    while ((at + 4 <= data.size ()) && (data[at] == 0xff))
+    {
+        found.push_back (at);
+        if (data[at + 1] == 0xda)
+        {
+            break;
+        }
+
+        at += 2 + ((data[at + 2] << 8) | data[at + 3]);
+    }
+
+    return (found);
+}
+
+// a DHT segment for one table, class 0 or 1, with the code counts of each length
+static std::vector<uint8_t> table (int type, const std::vector<int> &counts)
+{
+    int total = 0;
+    for (int count : counts)
+    {
+        total += count;
+    }
+
+    std::vector<uint8_t> segment = { 0xff, 0xc4, (uint8_t) ((19 + total) >> 8), (uint8_t) (19 + total),
+            (uint8_t) (type << 4) };
+
+    for (int length = 0; length < 16; length++)
+    {
+        segment.push_back ((length < (int) counts.size ()) ? counts[length] : 0);
+    }
+
+    for (int symbol = 0; symbol < total; symbol++)
+    {
+        segment.push_back (symbol);
+    }
+
+    return (segment);
+}
+
+// the Huffman table segments of a frame
+static std::vector<uint8_t> tables (const frame &input)
+{
+    std::vector<uint8_t> found;
+
+    for (size_t at : segments (input.data))
+    {
+        if (input.data[at + 1] == 0xc4)
+        {
+            found.insert (found.end (), input.data.begin () + at, input.data.begin () + at + 2 + ((input.data[at + 2] << 8) | input.data[at + 3]));
+        }
+    }
+
+    return (found);
+}
+
+// the frame with a table put in just before the scan, after its own tables, so it replaces them
+static frame with (const frame &input, const char *name, const std::vector<uint8_t> &segment)
+{
+    std::vector<size_t> found = segments (input.data);
+    frame changed;
+
+    changed.name = input.name + ", " + name;
+    changed.data = input.data;
+    changed.data.insert (changed.data.begin () + (found.empty () ? 2 : found.back ()), segment.begin (), segment.end ());
+
+    return (changed);
+}
+
+static frame damage (const frame &input, std::mt19937 &random)
+{
+    frame damaged;
+    std::vector<uint8_t> &data = damaged.data;
+    std::vector<size_t> found = segments (input.data);
+
+    damaged.name = input.name + ", damaged";
+    data = input.data;
+
+    for (int changes = 1 + random () % 4; changes > 0; changes--)
+    {
+        size_t at = data.empty () ? 0 : random () % data.size ();
+
+        switch (random () % 6)
+        {
+            case 0:
+                // some bytes, near the headers more often than not
+                if (!data.empty ())
+                {
+                    at = (random () % 2) ? at : at % std::min (data.size (), (size_t) 700);
+                    data[at] = random ();
+                }
+                break;
+            case 1:
+                data.erase (data.begin () + at, data.begin () + std::min (data.size (), at + 1 + random () % 64));
+                break;
+            case 2:
+                {
+                    std::vector<uint8_t> run (data.begin () + at, data.begin () + std::min (data.size (), at + 1 + random () % 64));
+                    data.insert (data.begin () + at, run.begin (), run.end ());
+                }
+                break;
+            case 3:
+                // a segment longer or shorter than it is
+                if (!found.empty () && (found.back () + 4 <= data.size ()))
+                {
+                    size_t segment = found[random () % found.size ()];
+                    data[segment + 2 + random () % 2] = random ();
+                }
+                break;
+            case 4:
+                // a table of random counts
+                {
+                    std::vector<int> counts (16);
+                    for (int &count : counts)
+                    {
+                        count = (random () % 3) ? 0 : random () % 20;
+                    }
+
+                    std::vector<uint8_t> segment = table (random () % 2, counts);
+                    data.insert (data.begin () + (found.empty () ? std::min (data.size (), (size_t) 2) : std::min (data.size (), found.back ())),
+                            segment.begin (), segment.end ());
+                }
+                break;
+            default:
+                data.resize (at);
+                break;
+        }
+    }
+
+    return (damaged);
+}
+
+int main (int argc, char *argv[])
+{
+    long rounds = 20000;
+    unsigned seed = 1;
+    int option;
+
+    while ((option = getopt (argc, argv, "n:s:")) != -1)
+    {
+        switch (option)
+        {
+            case 'n':
+                rounds = std::max (0, atoi (optarg));
+                break;
+            case 's':
+                seed = strtoul (optarg, NULL, 10);
+                break;
+            default:
+                fprintf (stderr, "usage: %s [-n damaged frames] [-s seed]\n", argv[0]);
+                return (1);
+        }
+    }
+
+    // small, so many damaged frames go through in a short run
+    frame scene = make (96, 64, encoder_quality (12));
+    blocks seen;
+
+    if ((decode (scene, seen) != ESP_OK) || (seen.count == 0) || seen.outside)
+    {
+        fail (scene.name, "the intact frame does not decode");
+    }
+
+    // 255 codes of one bit would fill the lookup far past its end
+    std::vector<int> ones = { 255 };
+    std::vector<int> three = { 2, 1 };
+
+    for (int type = 0; type < 2; type++)
+    {
+        if (decode (with (scene, "255 codes of one bit", table (type, ones)), seen) != ESP_FAIL)
+        {
+            fail (scene.name, "255 codes of one bit taken");
+        }
+
+        if (decode (with (scene, "three codes of one and two bits", table (type, three)), seen) != ESP_FAIL)
+        {
+            fail (scene.name, "three codes of one and two bits taken");
+        }
+    }
+
+    // two codes of one bit use every code there is, and the frame's own tables after it take over again
+    std::vector<uint8_t> complete = table (0, { 2 });
+    std::vector<uint8_t> own = tables (scene);
+
+    complete.insert (complete.end (), own.begin (), own.end ());
+    if ((decode (with (scene, "two codes of one bit", complete), seen) != ESP_OK) || seen.outside)
+    {
+        fail (scene.name, "two codes of one bit refused");
+    }
+
+    std::mt19937 random (seed);
+    long decoded = 0;
+
+    for (long loop = 0; loop < rounds; loop++)
+    {
+        frame damaged = damage (scene, random);
+
+        if (decode (damaged, seen) == ESP_OK)
+        {
+            decoded++;
+        }
+
+        if (seen.outside)
+        {
+            fail (damaged.name, "a block outside the frame");
+        }
+    }
+
+    printf ("%ld damaged frames, %ld of them decoded, seed %u\n", rounds, decoded, seed);
+    printf ("%s\n", failures ? "FAILED" : "passed");
+
+    return (failures ? 1 : 0);
+}
@@ -0,0 +1,258 @@
+#include <math.h>
+#include <string.h>
+
+#include "esp_jpg_coeff.h"
+#include "reference.h"
+
+struct decoder
+{
+    std::vector<uint8_t> planes[JPG_COEFF_COMPONENTS];
+    float quant[4][64];
+    bool scaled;
+};
+
+static inline uint8_t clamp (int value)
+{
+    return ((value < 0) ? 0 : ((value > 255) ? 255 : value));
+}
+
+// the AAN quantization scaling, in natural order
+static void scale_quant (decoder &state, const jpg_coeff_info_t *info)
+{
+    static const float aan[8] =
+    {
+        1.0f, 1.387039845f, 1.306562965f, 1.175875602f,
+        1.0f, 0.785694958f, 0.541196100f, 0.275899379f
+    };
+
+    for (int table = 0; table < 4; table++)
+    {
+        for (int k = 0; k < 64; k++)
+        {
+            int natural = jpg_coeff_zigzag[k];
+            state.quant[table][natural] = info->quant[table][k] * aan[natural / 8] * aan[natural % 8] / 8.0f;
+        }
+    }
+
+    state.scaled = true;
+}
+
+// the floating point AAN inverse DCT, as in the IJG jidctflt.c
+static void idct (const float *input, uint8_t *output, int stride)
+{
+    float workspace[64];
+
+    for (int column = 0; column < 8; column++)
+    {
+        const float *in = input + column;
+        float *ws = workspace + column;
+
+        float tmp0 = in[0];
+        float tmp1 = in[16];
+        float tmp2 = in[32];
+        float tmp3 = in[48];
+
+        float tmp10 = tmp0 + tmp2;
+        float tmp11 = tmp0 - tmp2;
+        float tmp13 = tmp1 + tmp3;
+        float tmp12 = (tmp1 - tmp3) * 1.414213562f - tmp13;
+
+        tmp0 = tmp10 + tmp13;
+        tmp3 = tmp10 - tmp13;
+        tmp1 = tmp11 + tmp12;
+        tmp2 = tmp11 - tmp12;
+
+        float tmp4 = in[8];
+        float tmp5 = in[24];
+        float tmp6 = in[40];
+        float tmp7 = in[56];
+
+        float z13 = tmp6 + tmp5;
+        float z10 = tmp6 - tmp5;
+        float z11 = tmp4 + tmp7;
+        float z12 = tmp4 - tmp7;
+
+        tmp7 = z11 + z13;
+        tmp11 = (z11 - z13) * 1.414213562f;
+        float z5 = (z10 + z12) * 1.847759065f;
+        tmp10 = 1.082392200f * z12 - z5;
+        tmp12 = -2.613125930f * z10 + z5;
+        tmp6 = tmp12 - tmp7;
+        tmp5 = tmp11 - tmp6;
+        tmp4 = tmp10 + tmp5;
+
+        ws[0] = tmp0 + tmp7;
+        ws[56] = tmp0 - tmp7;
+        ws[8] = tmp1 + tmp6;
+        ws[48] = tmp1 - tmp6;
+        ws[16] = tmp2 + tmp5;
+        ws[40] = tmp2 - tmp5;
+        ws[32] = tmp3 + tmp4;
+        ws[24] = tmp3 - tmp4;
+    }
+
+    for (int row = 0; row < 8; row++)
+    {
+        const float *ws = workspace + row * 8;
+        uint8_t *out = output + row * stride;
+
+        float tmp10 = ws[0] + ws[4];
+        float tmp11 = ws[0] - ws[4];
+        float tmp13 = ws[2] + ws[6];
+        float tmp12 = (ws[2] - ws[6]) * 1.414213562f - tmp13;
+
+        float tmp0 = tmp10 + tmp13;
+        float tmp3 = tmp10 - tmp13;
+        float tmp1 = tmp11 + tmp12;
+        float tmp2 = tmp11 - tmp12;
+
+        float z13 = ws[5] + ws[3];
+        float z10 = ws[5] - ws[3];
+        float z11 = ws[1] + ws[7];
+        float z12 = ws[1] - ws[7];
+
+        float tmp7 = z11 + z13;
+        tmp11 = (z11 - z13) * 1.414213562f;
+        float z5 = (z10 + z12) * 1.847759065f;
+        tmp10 = 1.082392200f * z12 - z5;
+        tmp12 = -2.613125930f * z10 + z5;
+        float tmp6 = tmp12 - tmp7;
+        float tmp5 = tmp11 - tmp6;
+        float tmp4 = tmp10 + tmp5;
+
+        out[0] = clamp (lrintf (tmp0 + tmp7) + 128);
+        out[7] = clamp (lrintf (tmp0 - tmp7) + 128);
+        out[1] = clamp (lrintf (tmp1 + tmp6) + 128);
+        out[6] = clamp (lrintf (tmp1 - tmp6) + 128);
+        out[2] = clamp (lrintf (tmp2 + tmp5) + 128);
+        out[5] = clamp (lrintf (tmp2 - tmp5) + 128);
+        out[4] = clamp (lrintf (tmp3 + tmp4) + 128);
+        out[3] = clamp (lrintf (tmp3 - tmp4) + 128);
+    }
+}
+
+static bool block (void *argument, const jpg_coeff_info_t *info, const jpg_coeff_block_t *block)
+{
+    decoder &state = *(decoder *) argument;
+    const jpg_coeff_component_t &component = info->component[block->component];
+    std::vector<uint8_t> &plane = state.planes[block->component];
+
+    if (!state.scaled)
+    {
+        scale_quant (state, info);
+    }
+
+    if (plane.empty ())
+    {
+        for (int loop = 0; loop < info->components; loop++)
+        {
+            state.planes[loop].resize (info->component[loop].blocks_w * 64 * info->component[loop].blocks_h);
+        }
+    }
+
+    float coefficients[64];
+    const float *quant = state.quant[component.tq];
+
+    memset (coefficients, 0, sizeof (coefficients));
+    for (int k = 0; k < 64; k++)
+    {
+        if (block->coef[k])
+        {
+            int natural = jpg_coeff_zigzag[k];
+            coefficients[natural] = block->coef[k] * quant[natural];
+        }
+    }
+
+    int stride = component.blocks_w * 8;
+    idct (coefficients, &plane[block->y * 8 * stride + block->x * 8], stride);
+
+    return (true);
+}
+
+bool reference_decode (const uint8_t *jpeg, size_t length, std::vector<uint8_t> &pixels, int *width, int *height)
+{
+    decoder state;
+    jpg_coeff_info_t info;
+
+    state.scaled = false;
+
+    if (esp_jpg_coeff_decode (jpeg, length, JPG_COEFF_ALL, block, &state, &info) != ESP_OK)
+    {
+        return (false);
+    }
+
+    *width = info.width;
+    *height = info.height;
+    pixels.resize (info.width * info.height * 3);
+
+    const jpg_coeff_component_t *components = info.component;
+
+    for (int y = 0; y < info.height; y++)
+    {
+        const uint8_t *luma = &state.planes[0][y * components[0].blocks_w * 8];
+        uint8_t *out = &pixels[y * info.width * 3];
+
+        if (info.components == 1)
+        {
+            for (int x = 0; x < info.width; x++)
+            {
+                out[x * 3 + 0] = out[x * 3 + 1] = out[x * 3 + 2] = luma[x];
+            }
+
+            continue;
+        }
+
+        int cy = y * components[1].v / info.max_v;
+        const uint8_t *cb = &state.planes[1][cy * components[1].blocks_w * 8];
+        const uint8_t *cr = &state.planes[2][cy * components[2].blocks_w * 8];
+
+        for (int x = 0; x < info.width; x++)
+        {
+            int cx = x * components[1].h / info.max_h;
+            int Y = luma[x];
+            int Cb = cb[cx] - 128;
+            int Cr = cr[cx] - 128;
+
+            out[x * 3 + 0] = clamp (Y + ((116130 * Cb) >> 16));
+            out[x * 3 + 1] = clamp (Y - ((22554 * Cb + 46802 * Cr) >> 16));
+            out[x * 3 + 2] = clamp (Y + ((91881 * Cr) >> 16));
+        }
+    }
+
+    return (true);
+}
+
+void reference_downscale (const std::vector<uint8_t> &pixels, int width, int height, int channels, int factor,
+        std::vector<uint8_t> &output, int *scaled_width, int *scaled_height)
+{
+    int w = (width + factor - 1) / factor;
+    int h = (height + factor - 1) / factor;
+
+    output.assign (w * h * channels, 0);
+
+    for (int y = 0; y < h; y++)
+    {
+        for (int x = 0; x < w; x++)
+        {
+            for (int channel = 0; channel < channels; channel++)
+            {
+                int sum = 0;
+                int count = 0;
+
+                for (int dy = 0; (dy < factor) && (y * factor + dy < height); dy++)
+                {
+                    for (int dx = 0; (dx < factor) && (x * factor + dx < width); dx++)
+                    {
+                        sum += pixels[((y * factor + dy) * width + x * factor + dx) * channels + channel];
+                        count++;
+                    }
+                }
+
+                output[(y * w + x) * channels + channel] = (sum + count / 2) / count;
+            }
+        }
+    }
+
+    *scaled_width = w;
+    *scaled_height = h;
+}
@@ -0,0 +1,23 @@
+#ifndef __REFERENCE_H__
+#define __REFERENCE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+//
+// a plain full size JPEG decoder for the host benchmarks
+//
+// The target decodes with the tjpgd in ROM, which the host does not have.
+// This does the same work the same way: entropy decoding, dequantization,
+// a float AAN inverse DCT, nearest neighbour chroma upsampling and JFIF
+// colour conversion. Pixels are stored B, G, R like the camera converters.
+//
+bool reference_decode (const uint8_t *jpeg, size_t length, std::vector<uint8_t> &pixels, int *width, int *height);
+
+// averages every factor x factor square of an image into one pixel
+void reference_downscale (const std::vector<uint8_t> &pixels, int width, int height, int channels, int factor,
+        std::vector<uint8_t> &output, int *scaled_width, int *scaled_height);
+
+#endif
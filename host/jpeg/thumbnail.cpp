@@ -0,0 +1,200 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "esp_jpg_coeff.h"
+#include "fixtures.h"
+#include "img_converters.h"
+#include "reference.h"
+
+//
+// Times the 1/8 scale thumbnail made from the DC coefficients against the
+// ways there are to get one otherwise: decoding every coefficient and
+// keeping the DC terms, which is what tjpgd does at JPG_SCALE_8X, and a full
+// decode followed by an 8x8 box downscale. It also checks how far the
+// thumbnail is from the downscaled full decode, and times encoding it as
+// the preview JPEG /thumbnail sends.
+//
+// Without arguments it encodes a VGA and an SVGA test scene the way the
+// OV2640 does, 4:2:2 at the bridge's quality; otherwise it reads the JPEG
+// files in the directories given. -o writes the preview of the first frame.
+//
+
+static double now (void)
+{
+    struct timespec time;
+    clock_gettime (CLOCK_MONOTONIC, &time);
+
+    return (time.tv_sec + time.tv_nsec / 1e9);
+}
+
+// the scene at the sensor's quality, and how well the reference decodes it
+static frame sample (int width, int height, int quality)
+{
+    frame made = make (width, height, encoder_quality (quality));
+    std::vector<uint8_t> decoded;
+    int w = 0;
+    int h = 0;
+
+    reference_decode (made.data.data (), made.data.size (), decoded, &w, &h);
+    printf ("%s: reference decode %.1f dB PSNR against the scene\n", made.name.c_str (), psnr (scene (width, height), decoded));
+
+    return (made);
+}
+
+static bool ignore (void *argument, const jpg_coeff_info_t *info, const jpg_coeff_block_t *block)
+{
+    return (true);
+}
+
+static void run (const frame &input, int repeat, const char *output)
+{
+    jpg_coeff_info_t info;
+    if (esp_jpg_coeff_info (input.data.data (), input.data.size (), &info) != ESP_OK)
+    {
+        printf ("%s: not a baseline JPEG\n", input.name.c_str ());
+        return;
+    }
+
+    const uint8_t *jpeg = input.data.data ();
+    size_t length = input.data.size ();
+    size_t size = ((info.width + 7) / 8) * ((info.height + 7) / 8) * 3;
+    std::vector<uint8_t> thumbnail (size);
+    std::vector<uint8_t> gray (size);
+    std::vector<uint8_t> full;
+    std::vector<uint8_t> scaled;
+    uint16_t width = 0;
+    uint16_t height = 0;
+    int w = 0;
+    int h = 0;
+
+    printf ("%s: %ux%u, %u components %ux%u sampled, %u bytes\n", input.name.c_str (), info.width, info.height,
+            info.components, info.component[0].h, info.component[0].v, (unsigned) length);
+
+    double start = now ();
+    for (int loop = 0; loop < repeat; loop++)
+    {
+        jpg2thumbnail (jpeg, length, PIXFORMAT_RGB888, thumbnail.data (), size, &width, &height);
+    }
+    double rgb = (now () - start) / repeat;
+
+    start = now ();
+    for (int loop = 0; loop < repeat; loop++)
+    {
+        jpg2thumbnail (jpeg, length, PIXFORMAT_GRAYSCALE, gray.data (), size, &width, &height);
+    }
+    double grayscale = (now () - start) / repeat;
+
+    start = now ();
+    for (int loop = 0; loop < repeat; loop++)
+    {
+        esp_jpg_coeff_decode (jpeg, length, JPG_COEFF_ALL, ignore, NULL, NULL);
+    }
+    double coefficients = (now () - start) / repeat;
+
+    start = now ();
+    for (int loop = 0; loop < repeat; loop++)
+    {
+        reference_decode (jpeg, length, full, &w, &h);
+        reference_downscale (full, w, h, 3, 8, scaled, &w, &h);
+    }
+    double decode = (now () - start) / repeat;
+
+    std::vector<uint8_t> preview;
+    start = now ();
+    for (int loop = 0; loop < repeat; loop++)
+    {
+        preview.clear ();
+        fmt2jpg_cb (thumbnail.data (), width * height * 3, width, height, PIXFORMAT_RGB888, 80, append, &preview);
+    }
+    double encode = (now () - start) / repeat;
+
+    // how far the DC terms are from the mean of the decoded pixels
+    double total = 0;
+    int worst = 0;
+    for (size_t loop = 0; loop < scaled.size (); loop++)
+    {
+        int difference = abs ((int) thumbnail[loop] - scaled[loop]);
+        total += difference;
+        worst = std::max (worst, difference);
+    }
+
+    printf ("  thumbnail RGB888       %8.3f ms  %ux%u\n", rgb * 1000, width, height);
+    printf ("  thumbnail grayscale    %8.3f ms\n", grayscale * 1000);
+    printf ("  all coefficients       %8.3f ms  %4.1fx the thumbnail\n", coefficients * 1000, coefficients / rgb);
+    printf ("  decode and downscale   %8.3f ms  %4.1fx the thumbnail\n", decode * 1000, decode / rgb);
+    printf ("  preview JPEG           %8.3f ms  %u bytes\n", encode * 1000, (unsigned) preview.size ());
+    printf ("  thumbnail against the downscaled decode: mean difference %.2f, largest %d\n",
+            total / scaled.size (), worst);
+
+    if (output)
+    {
+        FILE *file = fopen (output, "wb");
+        if (file)
+        {
+            fwrite (preview.data (), 1, preview.size (), file);
+            fclose (file);
+        }
+    }
+}
+
+int main (int argc, char *argv[])
+{
+    int quality = 12;
+    int repeat = 200;
+    const char *output = NULL;
+    int option;
+
+    while ((option = getopt (argc, argv, "q:n:o:")) != -1)
+    {
+        switch (option)
+        {
+            case 'q':
+                quality = atoi (optarg);
+                break;
+            case 'n':
+                repeat = std::max (1, atoi (optarg));
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                fprintf (stderr, "usage: %s [-q quality] [-n repeat] [-o preview.jpg] [directory ...]\n", argv[0]);
+                return (1);
+        }
+    }
+
+    std::vector<frame> frames;
+
+    if (optind < argc)
+    {
+        for (int loop = optind; loop < argc; loop++)
+        {
+            load (argv[loop], frames);
+        }
+
+        if (frames.empty ())
+        {
+            fprintf (stderr, "no JPEG files found\n");
+            return (1);
+        }
+    }
+    else
+    {
+        frames.push_back (sample (640, 480, quality));
+        frames.push_back (sample (800, 600, quality));
+    }
+
+    for (size_t loop = 0; loop < frames.size (); loop++)
+    {
+        run (frames[loop], repeat, loop ? NULL : output);
+    }
+
+    return (0);
+}
@@ -0,0 +1,307 @@
+#include <getopt.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <string>
+
+#include "Json.h"
+
+//
+// Times the /status body the three ways it has been made: with snprintf,
+// as it was, with the Json writer, and from the JsonCache when nothing it
+// shows has changed, which is most polls. First it checks that
+//
+//   - the writer gives the same text as snprintf for the status, across
+//     the values each field takes, and for the robot's status with its
+//     fixed point battery and keepalive and nested latency object; the
+//     values are not halfway between two outputs, where printf rounds to
+//     even and the writer away from zero
+//   - arrays, nested objects and escaped strings come out as JSON
+//   - output that does not fit is cut short, flagged and terminated
+//   - the cache renders again only when the version changes
+//
+// It exits non-zero on a failed check.
+//
+
+static int failures = 0;
+
+static void fail (const char *check, const std::string &got, const std::string &expected)
+{
+    if (failures++ < 20)
+    {
+        printf ("FAIL: %s:\n  got      %s\n  expected %s\n", check, got.c_str (), expected.c_str ());
+    }
+}
+
+static double now (void)
+{
+    struct timespec time;
+    clock_gettime (CLOCK_MONOTONIC, &time);
+
+    return (time.tv_sec + time.tv_nsec / 1e9);
+}
+
+// ------
+// status
+// ------
+
+struct status
+{
+    int32_t active;
+    int32_t connected;
+    uint32_t token;
+    int32_t streaming;
+    int32_t left;
+    int32_t right;
+    int32_t framesize;
+    int32_t motion;
+};
+
+static status shown;
+static int renders = 0;
+
+// as main.cpp renders it
+static void render (Json &json)
+{
+    renders++;
+
+    json.begin ()
+        .field ("active", shown.active)
+        .field ("connected", shown.connected)
+        .field ("token", shown.token)
+        .field ("streaming", shown.streaming)
+        .field ("left", shown.left)
+        .field ("right", shown.right)
+        .field ("framesize", shown.framesize)
+        .field ("motion", shown.motion)
+        .end ();
+}
+
+// as it was made before the writer
+static int print (char *buffer, size_t size, const status &values)
+{
+    return (snprintf (buffer, size,
+            "{"
+                "\"active\": %d, "
+                "\"connected\": %d, "
+                "\"token\": %u, "
+                "\"streaming\": %d, "
+                "\"left\": %d, "
+                "\"right\": %d, "
+                "\"framesize\": %d, "
+                "\"motion\": %d"
+            "}", values.active, values.connected, values.token, values.streaming, values.left, values.right,
+            values.framesize, values.motion));
+}
+
+// ------
+// checks
+// ------
+
+static void check_status (void)
+{
+    const status cases[] =
+    {
+        { 0, 0, 0, 0, 0, 0, 8, 0 },
+        { 1, 1, 3735928559U, 4, 100, -100, 13, 1 },
+        { 1, 1, UINT_MAX, 2, -1, 99, 0, 0 },
+        { 0, 1, 1, 1, INT_MIN, INT_MAX, 10, 1 },
+    };
+
+    for (const status &values : cases)
+    {
+        char written[JsonCache::SIZE];
+        char printed[JsonCache::SIZE];
+        Json json (written, sizeof (written));
+
+        shown = values;
+        render (json);
+        print (printed, sizeof (printed), values);
+
+        if ((strcmp (written, printed) != 0) || (json.length () != strlen (printed)) || json.overflow ())
+        {
+            fail ("status", written, printed);
+        }
+    }
+}
+
+static void check_robot (void)
+{
+    const struct
+    {
+        float battery;
+        float keepalive;
+        uint32_t replies;
+        uint32_t lost;
+        uint32_t p50;
+    } cases[] =
+    {
+        { 7.9f, 600.0f, 0, 0, 0 },
+        { 8.2341f, 60.04f, 1234, 5, 31000 },
+        { 0.0f, 0.0f, UINT_MAX, 1, 2 },
+        { 6.5f, 1.26f, 10, 0, 28671 },
+    };
+
+    for (const auto &values : cases)
+    {
+        char written[256];
+        char printed[256];
+        Json json (written, sizeof (written));
+
+        json.begin ()
+            .field ("connected", (int32_t) 1)
+            .field ("battery", values.battery, 3)
+            .field ("keepalive", values.keepalive, 1)
+            .begin ("latency")
+                .field ("replies", values.replies)
+                .field ("lost", values.lost)
+                .field ("p50", values.p50)
+            .end ()
+            .end ();
+
+        snprintf (printed, sizeof (printed), "{\"connected\": 1, \"battery\": %.3f, \"keepalive\": %.1f, "
+                "\"latency\": {\"replies\": %u, \"lost\": %u, \"p50\": %u}}", values.battery, values.keepalive,
+                values.replies, values.lost, values.p50);
+
+        if (strcmp (written, printed) != 0)
+        {
+            fail ("robot", written, printed);
+        }
+    }
+}
+
+static void check_shapes (void)
+{
+    char written[128];
+    Json json (written, sizeof (written));
+
+    json.begin ()
+        .array ("samples")
+            .field (NULL, (int32_t) -3)
+            .begin ().field ("t", (uint32_t) 1).end ()
+            .array ().end ()
+        .end ()
+        .field ("name", "say \"hi\"\\\n")
+        .field ("cold", -0.04f, 1)
+        .field ("huge", 1e12f, 0)
+        .end ();
+
+    const char *expected = "{\"samples\": [-3, {\"t\": 1}, []], \"name\": \"say \\\"hi\\\"\\\\\", \"cold\": 0.0, \"huge\": null}";
+
+    if (strcmp (written, expected) != 0)
+    {
+        fail ("shapes", written, expected);
+    }
+
+    // cut short, flagged, and still a string
+    char small[12];
+    Json cut (small, sizeof (small));
+
+    memset (small, 'x', sizeof (small));
+    cut.begin ().field ("connected", (int32_t) 1).end ();
+
+    if (!cut.overflow () || (strlen (small) != sizeof (small) - 1) || (strcmp (small, "{\"connected") != 0))
+    {
+        fail ("overflow", small, "{\"connected");
+    }
+}
+
+static void check_cache (void)
+{
+    JsonCache cache (render);
+    size_t length = 0;
+
+    shown = { 1, 1, 0, 0, 10, 20, 8, 0 };
+    renders = 0;
+
+    std::string first = cache.get (1, &length);
+    cache.get (1, &length);
+    cache.get (1, &length);
+
+    if (renders != 1)
+    {
+        fail ("cache", std::to_string (renders) + " renders", "1 render");
+    }
+
+    shown.left = -50;
+
+    std::string second = cache.get (2, &length);
+    if ((renders != 2) || (second == first) || (length != second.size ()))
+    {
+        fail ("cache", second, "rendered again for a new version");
+    }
+}
+
+int main (int argc, char *argv[])
+{
+    long repeat = 2000000;
+    int option;
+
+    while ((option = getopt (argc, argv, "n:")) != -1)
+    {
+        switch (option)
+        {
+            case 'n':
+                repeat = std::max (1, atoi (optarg));
+                break;
+            default:
+                fprintf (stderr, "usage: %s [-n bodies]\n", argv[0]);
+                return (1);
+        }
+    }
+
+    check_status ();
+    check_robot ();
+    check_shapes ();
+    check_cache ();
+
+    // the wheels change now and then, the body is made for every poll
+    char buffer[JsonCache::SIZE];
+    status values = { 1, 1, 0, 2, 40, -40, 8, 0 };
+    size_t total = 0;
+
+    double start = now ();
+    for (long loop = 0; loop < repeat; loop++)
+    {
+        values.left = (int32_t) (loop >> 4) % 200 - 100;
+        total += print (buffer, sizeof (buffer), values);
+    }
+    double printed = (now () - start) / repeat;
+
+    start = now ();
+    for (long loop = 0; loop < repeat; loop++)
+    {
+        Json json (buffer, sizeof (buffer));
+
+        shown = values;
+        shown.left = (int32_t) (loop >> 4) % 200 - 100;
+        render (json);
+        total += json.length ();
+    }
+    double written = (now () - start) / repeat;
+
+    JsonCache cache (render);
+    size_t length = 0;
+
+    start = now ();
+    for (long loop = 0; loop < repeat; loop++)
+    {
+        shown.left = (int32_t) (loop >> 4) % 200 - 100;
+        cache.get ((uint32_t) (loop >> 4), &length);
+        total += length;
+    }
+    double cached = (now () - start) / repeat;
+
+    printf ("/status body, %ld made, the wheels changing every 16\n", repeat);
+    printf ("  snprintf %8.1f ns\n", printed * 1e9);
+    printf ("  Json     %8.1f ns\n", written * 1e9);
+    printf ("  cache    %8.1f ns\n", cached * 1e9);
+
+    printf ("%s\n", (failures || (total == 0)) ? "FAILED" : "passed");
+
+    return ((failures || (total == 0)) ? 1 : 0);
+}
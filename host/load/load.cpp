@@ -0,0 +1,734 @@
+#include <errno.h>
+#include <getopt.h>
+#include <math.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//
+// Replays the sessions the web page produces against the bridge: one driver
+// that opens a session and sends motor values, MJPEG viewers and status
+// pollers. Latency is the time from sending a request to reading the whole
+// response; for /video it is the time to the first frame. With -f the driver
+// also switches the frame size through /camera, and "switch" is the time
+// from sending the request to a viewer's first frame at the new size.
+//
+
+typedef std::chrono::steady_clock clock_type;
+
+static std::atomic<bool> running (true);
+
+// -----------
+// measurement
+// -----------
+
+class Endpoint
+{
+    public:
+        void sample (int64_t microseconds)
+        {
+            std::lock_guard<std::mutex> lock (_mutex);
+            _samples.push_back (microseconds);
+        }
+        void error ()
+        {
+            std::lock_guard<std::mutex> lock (_mutex);
+            _errors++;
+        }
+        void report (const char *name)
+        {
+            std::lock_guard<std::mutex> lock (_mutex);
+            std::sort (_samples.begin (), _samples.end ());
+
+            printf ("%-12s %8u %8u %10.1f %10.1f %10.1f\n", name,
+                    (unsigned) _samples.size (), _errors,
+                    percentile (0.50) / 1000.0, percentile (0.99) / 1000.0,
+                    _samples.empty () ? 0.0 : _samples.back () / 1000.0);
+        }
+    private:
+        int64_t percentile (double fraction)
+        {
+            if (_samples.empty ())
+            {
+                return (0);
+            }
+
+            size_t index = (size_t) ceil (fraction * _samples.size ()) - 1;
+
+            return (_samples[std::min (index, _samples.size () - 1)]);
+        }
+
+        std::mutex _mutex;
+        std::vector<int64_t> _samples;
+        unsigned int _errors = 0;
+};
+
+static std::map<std::string, Endpoint> endpoints;
+static std::mutex endpoints_mutex;
+
+static Endpoint &endpoint (const std::string &name)
+{
+    std::lock_guard<std::mutex> lock (endpoints_mutex);
+
+    return (endpoints[name]);
+}
+
+static int64_t elapsed (clock_type::time_point start)
+{
+    return (std::chrono::duration_cast<std::chrono::microseconds> (clock_type::now () - start).count ());
+}
+
+// ----------
+// connection
+// ----------
+
+//
+// a keep-alive HTTP/1.1 client connection, reopened after any failure
+//
+class Connection
+{
+    public:
+        Connection (const std::string &host, const std::string &port) : _host (host), _port (port), _fd (-1)
+        {
+        }
+        ~Connection ()
+        {
+            close ();
+        }
+        bool get (const std::string &path, int &status, std::string &body)
+        {
+            if ((_fd < 0) && !open ())
+            {
+                return (false);
+            }
+
+            std::string request = "GET " + path + " HTTP/1.1\r\nHost: " + _host + "\r\n\r\n";
+
+            if (!write (request) || !read_response (status, body))
+            {
+                close ();
+                return (false);
+            }
+
+            return (true);
+        }
+        bool stream (const std::string &path, int &status)
+        {
+            if ((_fd < 0) && !open ())
+            {
+                return (false);
+            }
+
+            std::string request = "GET " + path + " HTTP/1.1\r\nHost: " + _host + "\r\n\r\n";
+            std::map<std::string, std::string> headers;
+
+            return (write (request) && read_head (status, headers));
+        }
+        bool read_part (std::string &frame)
+        {
+            std::map<std::string, std::string> headers;
+            std::string line;
+
+            // each part is headers, a blank line, the frame and a boundary line
+            while (true)
+            {
+                if (!read_line (line))
+                {
+                    return (false);
+                }
+
+                if (line.empty () || (line.compare (0, 2, "--") == 0))
+                {
+                    if (!headers.empty ())
+                    {
+                        break;
+                    }
+
+                    continue;
+                }
+
+                size_t colon = line.find (':');
+                if (colon != std::string::npos)
+                {
+                    headers[lower (line.substr (0, colon))] = trim (line.substr (colon + 1));
+                }
+            }
+
+            if (headers.find ("content-length") == headers.end ())
+            {
+                return (false);
+            }
+
+            frame.clear ();
+
+            return (read_bytes (strtoul (headers["content-length"].c_str (), NULL, 10), frame));
+        }
+        void close ()
+        {
+            if (_fd >= 0)
+            {
+                ::close (_fd);
+                _fd = -1;
+            }
+
+            _buffer.clear ();
+        }
+    private:
+        bool open ()
+        {
+            struct addrinfo hints;
+            struct addrinfo *addresses = NULL;
+
+            memset (&hints, 0, sizeof (hints));
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+
+            if (getaddrinfo (_host.c_str (), _port.c_str (), &hints, &addresses) != 0)
+            {
+                return (false);
+            }
+
+            for (struct addrinfo *address = addresses; address && (_fd < 0); address = address->ai_next)
+            {
+                _fd = socket (address->ai_family, address->ai_socktype, address->ai_protocol);
+                if (_fd < 0)
+                {
+                    continue;
+                }
+
+                struct timeval timeout = { 5, 0 };
+                int enable = 1;
+
+                setsockopt (_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout));
+                setsockopt (_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof (timeout));
+                setsockopt (_fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof (enable));
+
+                if (connect (_fd, address->ai_addr, address->ai_addrlen) != 0)
+                {
+                    ::close (_fd);
+                    _fd = -1;
+                }
+            }
+
+            freeaddrinfo (addresses);
+
+            return (_fd >= 0);
+        }
+        bool write (const std::string &data)
+        {
+            size_t sent = 0;
+
+            while (sent < data.length ())
+            {
+                ssize_t bytes = send (_fd, data.data () + sent, data.length () - sent, MSG_NOSIGNAL);
+                if (bytes <= 0)
+                {
+                    return (false);
+                }
+
+                sent += bytes;
+            }
+
+            return (true);
+        }
+        bool fill ()
+        {
+            char chunk[4096];
+
+            ssize_t bytes = recv (_fd, chunk, sizeof (chunk), 0);
+            if (bytes <= 0)
+            {
+                return (false);
+            }
+
+            _buffer.append (chunk, bytes);
+
+            return (true);
+        }
+        bool read_line (std::string &line)
+        {
+            size_t end;
+
+            while ((end = _buffer.find ("\r\n")) == std::string::npos)
+            {
+                if (!fill ())
+                {
+                    return (false);
+                }
+            }
+
+            line = _buffer.substr (0, end);
+            _buffer.erase (0, end + 2);
+
+            return (true);
+        }
+        bool read_bytes (size_t length, std::string &data)
+        {
+            while (_buffer.length () < length)
+            {
+                if (!fill ())
+                {
+                    return (false);
+                }
+            }
+
+            data.append (_buffer, 0, length);
+            _buffer.erase (0, length);
+
+            return (true);
+        }
+        bool read_head (int &status, std::map<std::string, std::string> &headers)
+        {
+            std::string line;
+
+            if (!read_line (line) || (line.compare (0, 5, "HTTP/") != 0))
+            {
+                return (false);
+            }
+
+            size_t space = line.find (' ');
+            status = (space != std::string::npos) ? atoi (line.c_str () + space + 1) : 0;
+
+            while (read_line (line))
+            {
+                if (line.empty ())
+                {
+                    return (true);
+                }
+
+                size_t colon = line.find (':');
+                if (colon != std::string::npos)
+                {
+                    headers[lower (line.substr (0, colon))] = trim (line.substr (colon + 1));
+                }
+            }
+
+            return (false);
+        }
+        bool read_response (int &status, std::string &body)
+        {
+            std::map<std::string, std::string> headers;
+
+            if (!read_head (status, headers))
+            {
+                return (false);
+            }
+
+            body.clear ();
+
+            if (lower (headers["transfer-encoding"]) == "chunked")
+            {
+                std::string line;
+
+                while (read_line (line))
+                {
+                    size_t length = strtoul (line.c_str (), NULL, 16);
+
+                    if (!read_bytes (length, body) || !read_line (line))
+                    {
+                        return (false);
+                    }
+
+                    if (length == 0)
+                    {
+                        return (true);
+                    }
+                }
+
+                return (false);
+            }
+
+            if (headers.find ("content-length") != headers.end ())
+            {
+                return (read_bytes (strtoul (headers["content-length"].c_str (), NULL, 10), body));
+            }
+
+            // no length, the body runs to the end of the connection
+            while (fill ())
+            {
+            }
+
+            body.swap (_buffer);
+            close ();
+
+            return (true);
+        }
+        static std::string lower (std::string text)
+        {
+            std::transform (text.begin (), text.end (), text.begin (), ::tolower);
+
+            return (text);
+        }
+        static std::string trim (const std::string &text)
+        {
+            size_t start = text.find_first_not_of (" \t");
+
+            return ((start == std::string::npos) ? "" : text.substr (start));
+        }
+
+        std::string _host;
+        std::string _port;
+        int _fd;
+        std::string _buffer;
+};
+
+// timed GET, counted against the endpoint
+static bool timed_get (Connection &connection, const char *name, const std::string &path, std::string &body)
+{
+    int status = 0;
+    clock_type::time_point start = clock_type::now ();
+
+    if (!connection.get (path, status, body) || (status != 200))
+    {
+        endpoint (name).error ();
+        return (false);
+    }
+
+    endpoint (name).sample (elapsed (start));
+
+    return (true);
+}
+
+// -------
+// clients
+// -------
+
+struct settings
+{
+    std::string host;
+    std::string port;
+    int duration;
+    int viewers;
+    int pollers;
+    double drive_rate;
+    double status_rate;
+    double switch_period;
+};
+
+// ------------------
+// frame size changes
+// ------------------
+
+// the sizes the driver cycles through, by FRAMESIZE_ number and width
+static const struct
+{
+    int framesize;
+    int width;
+} sizes[] = { { 8, 640 }, { 9, 800 }, { 5, 320 } };
+
+// the switch the driver made last
+static struct
+{
+    std::mutex mutex;
+    unsigned int generation;
+    int width;
+    clock_type::time_point start;
+} switching;
+
+// the width from the frame header of a JPEG, zero if there is none
+static int jpeg_width (const std::string &frame)
+{
+    const uint8_t *data = (const uint8_t *) frame.data ();
+    size_t position = 2;
+
+    while (position + 9 <= frame.length ())
+    {
+        if (data[position] != 0xff)
+        {
+            break;
+        }
+
+        uint8_t marker = data[position + 1];
+        size_t length = (data[position + 2] << 8) | data[position + 3];
+
+        if ((marker >= 0xc0) && (marker <= 0xc3))
+        {
+            return ((data[position + 7] << 8) | data[position + 8]);
+        }
+
+        position += 2 + length;
+    }
+
+    return (0);
+}
+
+//
+// the page asks for a session once a second until it gets a token, then
+// sends the joystick position at 4 Hz
+//
+static void driver (const settings &options)
+{
+    Connection connection (options.host, options.port);
+    std::string body;
+    unsigned int token = 0;
+
+    clock_type::time_point start = clock_type::now ();
+    clock_type::time_point next = start;
+    clock_type::time_point next_switch = start;
+    size_t size = 0;
+
+    while (running)
+    {
+        if ((token != 0) && (options.switch_period > 0) && (clock_type::now () >= next_switch))
+        {
+            size = (size + 1) % (sizeof (sizes) / sizeof (sizes[0]));
+
+            // the session lapses ten seconds after the last /open
+            char path[64];
+            snprintf (path, sizeof (path), "/open?T=%u", token);
+            timed_get (connection, "/open", path, body);
+
+            {
+                std::lock_guard<std::mutex> lock (switching.mutex);
+                switching.generation++;
+                switching.width = sizes[size].width;
+                switching.start = clock_type::now ();
+            }
+
+            snprintf (path, sizeof (path), "/camera?F=%d&T=%u", sizes[size].framesize, token);
+            timed_get (connection, "/camera", path, body);
+
+            next_switch += std::chrono::microseconds ((int64_t) (1000000 * options.switch_period));
+        }
+
+        if (token == 0)
+        {
+            if (timed_get (connection, "/open", "/open?T=0", body))
+            {
+                size_t field = body.find ("\"token\":");
+                if (field != std::string::npos)
+                {
+                    token = strtoul (body.c_str () + field + 8, NULL, 10);
+                }
+            }
+
+            next += std::chrono::seconds (1);
+        }
+        else
+        {
+            // sweep through turns in both directions
+            double phase = elapsed (start) / 1000000.0;
+            int left = (int) (50 * sin (phase));
+            int right = (int) (50 * cos (phase));
+
+            char path[64];
+            snprintf (path, sizeof (path), "/drive?L=%d&R=%d&T=%u", left, right, token);
+
+            timed_get (connection, "/drive", path, body);
+
+            next += std::chrono::microseconds ((int64_t) (1000000 / options.drive_rate));
+        }
+
+        std::this_thread::sleep_until (next);
+    }
+}
+
+static void poller (const settings &options)
+{
+    Connection connection (options.host, options.port);
+    std::string body;
+
+    clock_type::time_point next = clock_type::now ();
+
+    while (running)
+    {
+        timed_get (connection, "/status", "/status", body);
+
+        next += std::chrono::microseconds ((int64_t) (1000000 / options.status_rate));
+        std::this_thread::sleep_until (next);
+    }
+}
+
+struct viewing
+{
+    unsigned int frames;
+    uint64_t bytes;
+    int64_t microseconds;
+};
+
+static void viewer (const settings &options, viewing *result)
+{
+    Connection connection (options.host, options.port);
+
+    clock_type::time_point start = clock_type::now ();
+    int status = 0;
+    std::string frame;
+    unsigned int seen = 0;
+
+    if (!connection.stream ("/video", status) || (status != 200))
+    {
+        endpoint ("/video").error ();
+        return;
+    }
+
+    while (running && connection.read_part (frame))
+    {
+        if (result->frames == 0)
+        {
+            endpoint ("/video").sample (elapsed (start));
+        }
+
+        result->frames++;
+        result->bytes += frame.length ();
+
+        // the first frame at the size the driver switched to
+        std::lock_guard<std::mutex> lock (switching.mutex);
+
+        if ((switching.generation != seen) && (jpeg_width (frame) == switching.width))
+        {
+            if (result->frames > 1)
+            {
+                endpoint ("switch").sample (elapsed (switching.start));
+            }
+
+            seen = switching.generation;
+        }
+    }
+
+    result->microseconds = elapsed (start);
+
+    if (running)
+    {
+        endpoint ("/video").error ();
+    }
+}
+
+// ----
+// main
+// ----
+
+static void usage (const char *name)
+{
+    fprintf (stderr, "usage: %s [-d seconds] [-v viewers] [-s pollers] [-r drive Hz] [-p status Hz] [-f switch seconds] host[:port]\n", name);
+    exit (EXIT_FAILURE);
+}
+
+int main (int argc, char *argv[])
+{
+    settings options;
+    options.port = "80";
+    options.duration = 30;
+    options.viewers = 2;
+    options.pollers = 2;
+    options.drive_rate = 4;
+    options.status_rate = 1;
+    options.switch_period = 0;
+
+    int option;
+    while ((option = getopt (argc, argv, "d:v:s:r:p:f:")) != -1)
+    {
+        switch (option)
+        {
+            case 'd':
+                options.duration = atoi (optarg);
+                break;
+            case 'v':
+                options.viewers = atoi (optarg);
+                break;
+            case 's':
+                options.pollers = atoi (optarg);
+                break;
+            case 'r':
+                options.drive_rate = atof (optarg);
+                break;
+            case 'p':
+                options.status_rate = atof (optarg);
+                break;
+            case 'f':
+                options.switch_period = atof (optarg);
+                break;
+            default:
+                usage (argv[0]);
+        }
+    }
+
+    if ((optind != argc - 1) || (options.duration <= 0) || (options.drive_rate <= 0) || (options.status_rate <= 0))
+    {
+        usage (argv[0]);
+    }
+
+    options.host = argv[optind];
+
+    size_t colon = options.host.rfind (':');
+    if ((colon != std::string::npos) && (options.host.find (':') == colon))
+    {
+        options.port = options.host.substr (colon + 1);
+        options.host.erase (colon);
+    }
+
+    signal (SIGPIPE, SIG_IGN);
+
+    printf ("%s:%s for %d s: 1 driver at %.1f Hz, %d viewers, %d pollers at %.1f Hz\n",
+            options.host.c_str (), options.port.c_str (), options.duration, options.drive_rate,
+            options.viewers, options.pollers, options.status_rate);
+
+    std::vector<std::thread> threads;
+    std::vector<viewing> results (options.viewers, viewing { 0, 0, 0 });
+
+    threads.push_back (std::thread (driver, std::cref (options)));
+
+    for (int loop = 0; loop < options.pollers; loop++)
+    {
+        threads.push_back (std::thread (poller, std::cref (options)));
+    }
+
+    for (int loop = 0; loop < options.viewers; loop++)
+    {
+        threads.push_back (std::thread (viewer, std::cref (options), &results[loop]));
+    }
+
+    std::this_thread::sleep_for (std::chrono::seconds (options.duration));
+    running = false;
+
+    // viewers block in recv until the next frame or the socket timeout
+    for (size_t loop = 0; loop < threads.size (); loop++)
+    {
+        threads[loop].join ();
+    }
+
+    printf ("\n%-12s %8s %8s %10s %10s %10s\n", "endpoint", "requests", "errors", "p50 ms", "p99 ms", "max ms");
+
+    std::lock_guard<std::mutex> lock (endpoints_mutex);
+    for (std::map<std::string, Endpoint>::iterator entry = endpoints.begin (); entry != endpoints.end (); ++entry)
+    {
+        entry->second.report (entry->first.c_str ());
+    }
+
+    if (options.viewers > 0)
+    {
+        printf ("\n%-12s %8s %10s %10s\n", "viewer", "frames", "fps", "kB/s");
+    }
+
+    for (int loop = 0; loop < options.viewers; loop++)
+    {
+        double seconds = results[loop].microseconds / 1000000.0;
+
+        printf ("%-12d %8u %10.1f %10.1f\n", loop, results[loop].frames,
+                (seconds > 0) ? results[loop].frames / seconds : 0.0,
+                (seconds > 0) ? results[loop].bytes / seconds / 1024 : 0.0);
+    }
+
+    if (options.switch_period > 0)
+    {
+        printf ("\n%u frame size switches\n", switching.generation);
+    }
+
+    // all done
+    return (EXIT_SUCCESS);
+}
@@ -0,0 +1,451 @@
+#include <dirent.h>
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "esp_jpg_coeff.h"
+#include "jpge.h"
+#include "Motion.h"
+
+//
+// Runs the motion detector over sequences of JPEG frames and reports what
+// it found and how many frames a second it checks. Without arguments it
+// makes up VGA sequences the way the OV2640 encodes them, 4:2:2 at the
+// bridge's quality, and checks the detector against each:
+//
+//   still   - a fixed scene with sensor noise, must not trigger
+//   lights  - the same scene turning 30 levels brighter at once, must not
+//             trigger
+//   object  - a dark square crossing the scene, must trigger, and score
+//             highest in the middle row of regions
+//
+// With directories of recorded frames, played in name order, it prints the
+// frames where the detector started and stopped triggering instead. -w
+// writes the made up sequences out so the host build can stream them.
+//
+// For comparison, every sequence is also decoded with all the coefficients,
+// the entropy decoding a full decode does before its IDCT.
+//
+
+static const int WIDTH = 640;
+static const int HEIGHT = 480;
+static const int FRAMES = 40;
+
+struct sequence
+{
+    std::string name;
+    std::vector<std::vector<uint8_t> > frames;
+};
+
+struct options
+{
+    int sensitivity;
+    int trigger;
+    int columns;
+    int rows;
+    int quality;
+    int repeat;
+    bool verbose;
+};
+
+// ---------
+// sequences
+// ---------
+
+class vector_stream : public jpge::output_stream
+{
+    public:
+        vector_stream (std::vector<uint8_t> &output) : _output (output)
+        {
+        }
+        virtual bool put_buf (const void *buffer, int length)
+        {
+            if (buffer)
+            {
+                _output.insert (_output.end (), (const uint8_t *) buffer, (const uint8_t *) buffer + length);
+            }
+
+            return (true);
+        }
+        virtual jpge::uint get_size () const
+        {
+            return (_output.size ());
+        }
+    private:
+        std::vector<uint8_t> &_output;
+};
+
+static bool encode (const std::vector<uint8_t> &pixels, int quality, std::vector<uint8_t> &output)
+{
+    // sensor quality runs from 0 (best) to 63, the encoder's from 100 (best) to 1
+    jpge::params parameters;
+    parameters.m_quality = std::max (1, 100 - (quality * 100) / 64);
+    parameters.m_subsampling = jpge::H2V1;
+
+    vector_stream stream (output);
+    jpge::jpeg_encoder encoder;
+
+    if (!encoder.init (&stream, WIDTH, HEIGHT, 3, parameters))
+    {
+        return (false);
+    }
+
+    for (int row = 0; row < HEIGHT; row++)
+    {
+        if (!encoder.process_scanline (&pixels[row * WIDTH * 3]))
+        {
+            return (false);
+        }
+    }
+
+    return (encoder.process_scanline (NULL));
+}
+
+// a room: a lit wall with soft shading, a floor and some furniture edges
+static int scene (int x, int y)
+{
+    int value = 150 + (int) (40 * sin (x / 90.0) * cos (y / 70.0));
+
+    if (y > HEIGHT * 2 / 3)
+    {
+        value = 90 + (x % 160) / 8;
+    }
+
+    if ((x > 420) && (x < 520) && (y > 120) && (y < 340))
+    {
+        value = 60;
+    }
+
+    return (value);
+}
+
+static sequence make (const char *name, int quality, int brighten, bool object)
+{
+    std::mt19937 random (7);
+    std::normal_distribution<float> noise (0.0, 3.0);
+    std::vector<uint8_t> pixels (WIDTH * HEIGHT * 3);
+    sequence made;
+
+    made.name = name;
+
+    for (int frame = 0; frame < FRAMES; frame++)
+    {
+        int size = HEIGHT / 5;
+        int left = (WIDTH + size) * frame / FRAMES - size;
+        int top = (HEIGHT - size) / 2;
+
+        for (int y = 0; y < HEIGHT; y++)
+        {
+            for (int x = 0; x < WIDTH; x++)
+            {
+                int value = scene (x, y) + ((frame >= FRAMES / 2) ? brighten : 0);
+
+                if (object && (x >= left) && (x < left + size) && (y >= top) && (y < top + size))
+                {
+                    value = 20;
+                }
+
+                value += (int) lrintf (noise (random));
+                value = std::min (255, std::max (0, value));
+
+                // a slightly warm grey
+                pixels[(y * WIDTH + x) * 3 + 0] = std::min (255, value + 8);
+                pixels[(y * WIDTH + x) * 3 + 1] = value;
+                pixels[(y * WIDTH + x) * 3 + 2] = std::max (0, value - 8);
+            }
+        }
+
+        made.frames.push_back (std::vector<uint8_t> ());
+        if (!encode (pixels, quality, made.frames.back ()))
+        {
+            fprintf (stderr, "failed to encode %s frame %d\n", name, frame);
+            exit (1);
+        }
+    }
+
+    return (made);
+}
+
+static bool load (const char *directory, sequence &loaded)
+{
+    std::vector<std::string> names;
+
+    DIR *entries = opendir (directory);
+    if (entries == NULL)
+    {
+        return (false);
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir (entries)) != NULL)
+    {
+        const char *dot = strrchr (entry->d_name, '.');
+
+        if (dot && ((strcasecmp (dot, ".jpg") == 0) || (strcasecmp (dot, ".jpeg") == 0)))
+        {
+            names.push_back (std::string (directory) + "/" + entry->d_name);
+        }
+    }
+
+    closedir (entries);
+    std::sort (names.begin (), names.end ());
+
+    loaded.name = directory;
+
+    for (const std::string &name : names)
+    {
+        FILE *file = fopen (name.c_str (), "rb");
+        if (file == NULL)
+        {
+            continue;
+        }
+
+        std::vector<uint8_t> data;
+        uint8_t buffer[4096];
+        size_t bytes;
+        while ((bytes = fread (buffer, 1, sizeof (buffer), file)) > 0)
+        {
+            data.insert (data.end (), buffer, buffer + bytes);
+        }
+
+        fclose (file);
+        loaded.frames.push_back (data);
+    }
+
+    return (!loaded.frames.empty ());
+}
+
+static void save (const sequence &frames, const char *directory)
+{
+    for (size_t loop = 0; loop < frames.frames.size (); loop++)
+    {
+        char name[512];
+        snprintf (name, sizeof (name), "%s/%s-%03u.jpg", directory, frames.name.c_str (), (unsigned) loop);
+
+        FILE *file = fopen (name, "wb");
+        if (file == NULL)
+        {
+            fprintf (stderr, "cannot write %s\n", name);
+            exit (1);
+        }
+
+        fwrite (frames.frames[loop].data (), 1, frames.frames[loop].size (), file);
+        fclose (file);
+    }
+}
+
+// --------
+// the runs
+// --------
+
+static double now (void)
+{
+    struct timespec time;
+    clock_gettime (CLOCK_MONOTONIC, &time);
+
+    return (time.tv_sec + time.tv_nsec / 1e9);
+}
+
+static bool count_block (void *argument, const jpg_coeff_info_t *info, const jpg_coeff_block_t *block)
+{
+    (*(uint32_t *) argument)++;
+
+    return (true);
+}
+
+struct result
+{
+    uint32_t events;
+    int row;            // row of regions with the highest score seen
+    int level;          // highest score seen
+};
+
+// one pass of the detector over a sequence, printing what it found
+static result detect (const sequence &frames, const options &settings, bool report)
+{
+    Motion motion (settings.columns, settings.rows, settings.sensitivity, settings.trigger);
+    result found = {0, -1, 0};
+    bool triggered = false;
+
+    for (size_t loop = 0; loop < frames.frames.size (); loop++)
+    {
+        const std::vector<uint8_t> &frame = frames.frames[loop];
+
+        if (motion.analyze (frame.data (), frame.size ()) != ESP_OK)
+        {
+            if (report)
+            {
+                printf ("  frame %3u is not a baseline JPEG\n", (unsigned) loop);
+            }
+            continue;
+        }
+
+        for (int region = 0; region < motion.columns () * motion.rows (); region++)
+        {
+            if (motion.score (region) > found.level)
+            {
+                found.level = motion.score (region);
+                found.row = region / motion.columns ();
+            }
+        }
+
+        if (report && (settings.verbose || (motion.triggered () != triggered)))
+        {
+            printf ("  frame %3u %-9s level %3d%%, regions", (unsigned) loop,
+                    motion.triggered () ? "triggered" : "quiet", motion.level ());
+            for (int region = 0; region < motion.columns () * motion.rows (); region++)
+            {
+                printf ("%s%3d", (region % motion.columns ()) ? " " : " | ", motion.score (region));
+            }
+            printf ("\n");
+        }
+
+        triggered = motion.triggered ();
+    }
+
+    found.events = motion.events ();
+
+    return (found);
+}
+
+static result run (const sequence &frames, const options &settings)
+{
+    size_t bytes = 0;
+    for (const std::vector<uint8_t> &frame : frames.frames)
+    {
+        bytes += frame.size ();
+    }
+
+    printf ("%s: %u frames, %u bytes on average\n", frames.name.c_str (), (unsigned) frames.frames.size (),
+            (unsigned) (bytes / frames.frames.size ()));
+
+    result found = detect (frames, settings, true);
+
+    // the detector, timed
+    double start = now ();
+    for (int loop = 0; loop < settings.repeat; loop++)
+    {
+        detect (frames, settings, false);
+    }
+    double detection = now () - start;
+
+    // all the coefficients of every frame, for comparison
+    uint32_t blocks = 0;
+    start = now ();
+    for (int loop = 0; loop < settings.repeat; loop++)
+    {
+        for (const std::vector<uint8_t> &frame : frames.frames)
+        {
+            esp_jpg_coeff_decode (frame.data (), frame.size (), JPG_COEFF_ALL, count_block, &blocks, NULL);
+        }
+    }
+    double entropy = now () - start;
+
+    double count = (double) settings.repeat * frames.frames.size ();
+    printf ("  %u events, highest score %d%%\n", found.events, found.level);
+    printf ("  motion detection   %8.1f frames/s %7.3f ms/frame\n", count / detection, 1000 * detection / count);
+    printf ("  all coefficients   %8.1f frames/s %7.3f ms/frame\n", count / entropy, 1000 * entropy / count);
+
+    return (found);
+}
+
+static bool expect (bool condition, const char *what)
+{
+    printf ("  %s: %s\n", condition ? "ok" : "FAILED", what);
+
+    return (condition);
+}
+
+int main (int argc, char *argv[])
+{
+    options settings = {50, 10, 4, 3, 12, 20, false};
+    const char *output = NULL;
+    int option;
+
+    while ((option = getopt (argc, argv, "s:t:g:q:n:w:v")) != -1)
+    {
+        switch (option)
+        {
+            case 's':
+                settings.sensitivity = atoi (optarg);
+                break;
+            case 't':
+                settings.trigger = atoi (optarg);
+                break;
+            case 'g':
+                if (sscanf (optarg, "%dx%d", &settings.columns, &settings.rows) != 2)
+                {
+                    fprintf (stderr, "grid is columns x rows, as in 4x3\n");
+                    return (1);
+                }
+                break;
+            case 'q':
+                settings.quality = atoi (optarg);
+                break;
+            case 'n':
+                settings.repeat = std::max (1, atoi (optarg));
+                break;
+            case 'w':
+                output = optarg;
+                break;
+            case 'v':
+                settings.verbose = true;
+                break;
+            default:
+                fprintf (stderr, "usage: %s [-s sensitivity] [-t trigger] [-g columns x rows] [-q quality] [-n repeat] [-w directory] [-v] [directory ...]\n", argv[0]);
+                return (1);
+        }
+    }
+
+    // recorded sequences
+    if (optind < argc)
+    {
+        for (int loop = optind; loop < argc; loop++)
+        {
+            sequence frames;
+
+            if (!load (argv[loop], frames))
+            {
+                fprintf (stderr, "no JPEG files in %s\n", argv[loop]);
+                return (1);
+            }
+
+            run (frames, settings);
+        }
+
+        return (0);
+    }
+
+    // made up sequences with known answers
+    bool passed = true;
+    sequence still = make ("still", settings.quality, 0, false);
+    sequence lights = make ("lights", settings.quality, 30, false);
+    sequence object = make ("object", settings.quality, 0, true);
+
+    if (output)
+    {
+        save (still, output);
+        save (lights, output);
+        save (object, output);
+    }
+
+    result found = run (still, settings);
+    passed &= expect (found.events == 0, "sensor noise does not trigger");
+
+    found = run (lights, settings);
+    passed &= expect (found.events == 0, "a change of brightness does not trigger");
+
+    found = run (object, settings);
+    passed &= expect (found.events > 0, "the object triggers");
+    passed &= expect (found.row == settings.rows / 2, "the object scores highest in the middle row");
+
+    return (passed ? 0 : 1);
+}
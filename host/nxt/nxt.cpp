@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "NXT.h"
+
+//
+// Encodes every direct command the bridge sends and decodes every reply it
+// reads, and checks them byte for byte against messages written out by hand
+// from the NXT direct command appendix:
+//
+//   commands - each encodes to the bytes given, the length prefix counting
+//              everything after it, in exactly the size the static_asserts
+//              in NXT.h fix, and writes nothing past it
+//   replies  - each field of a reply written out by hand decodes to its
+//              value, the signed ones negative, match takes the reply and
+//              rejects other opcodes and commands, and reply_size gives
+//              the size the static_asserts fix
+//
+// It exits non-zero on a failed check.
+//
+
+static int failures = 0;
+
+static void fail (const char *message, const char *detail, long value)
+{
+    if (failures++ < 20)
+    {
+        printf ("FAIL: %s: %s (%ld)\n", message, detail, value);
+    }
+}
+
+// the encoded command against the bytes expected, and nothing written after it
+static void check (const char *name, const uint8_t *data, size_t length, size_t size,
+        const std::vector<uint8_t> &expected)
+{
+    if ((length != size) || (length != expected.size ()))
+    {
+        fail (name, "encoded length", length);
+        return;
+    }
+
+    for (size_t loop = 0; loop < length; loop++)
+    {
+        if (data[loop] != expected[loop])
+        {
+            fail (name, "byte differs at", loop);
+        }
+    }
+
+    for (size_t loop = length; loop < nxt::HEADER + nxt::MAXIMUM; loop++)
+    {
+        if (data[loop] != 0xa5)
+        {
+            fail (name, "written past the end at", loop);
+            break;
+        }
+    }
+
+    if ((size_t) (data[0] | (data[1] << 8)) != length - nxt::HEADER)
+    {
+        fail (name, "length prefix", data[0] | (data[1] << 8));
+    }
+}
+
+static void commands (void)
+{
+    uint8_t data[nxt::HEADER + nxt::MAXIMUM];
+    size_t length;
+
+    // 440 Hz for half a second, no reply
+    memset (data, 0xa5, sizeof (data));
+    length = nxt::PlayTone::encode (data, 440, 500);
+    check ("PlayTone", data, length, 8, { 0x06, 0x00, 0x80, 0x03, 0xb8, 0x01, 0xf4, 0x01 });
+
+    // port B backwards at 75%, regulated, running, no tacho limit
+    memset (data, 0xa5, sizeof (data));
+    length = nxt::SetOutputState::encode (data, 1, -75, nxt::MOTORON | nxt::BRAKE | nxt::REGULATED, 0x01, 0,
+            nxt::RUNSTATE_RUNNING, 0);
+    check ("SetOutputState", data, length, 14,
+            { 0x0c, 0x00, 0x80, 0x04, 0x01, 0xb5, 0x07, 0x01, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00 });
+
+    // every byte of the tacho limit in its place
+    memset (data, 0xa5, sizeof (data));
+    length = nxt::SetOutputState::encode (data, 2, 100, nxt::MOTORON, 0x00, -100, nxt::RUNSTATE_IDLE, 0x12345678);
+    check ("SetOutputState limit", data, length, 14,
+            { 0x0c, 0x00, 0x80, 0x04, 0x02, 0x64, 0x01, 0x00, 0x9c, 0x00, 0x78, 0x56, 0x34, 0x12 });
+
+    memset (data, 0xa5, sizeof (data));
+    length = nxt::GetOutputState::encode (data, 2);
+    check ("GetOutputState", data, length, 5, { 0x03, 0x00, 0x00, 0x06, 0x02 });
+
+    memset (data, 0xa5, sizeof (data));
+    length = nxt::GetInputValues::encode (data, 3);
+    check ("GetInputValues", data, length, 5, { 0x03, 0x00, 0x00, 0x07, 0x03 });
+
+    memset (data, 0xa5, sizeof (data));
+    length = nxt::GetBatteryLevel::encode (data);
+    check ("GetBatteryLevel", data, length, 4, { 0x02, 0x00, 0x00, 0x0b });
+
+    memset (data, 0xa5, sizeof (data));
+    length = nxt::KeepAlive::encode (data);
+    check ("KeepAlive", data, length, 4, { 0x02, 0x00, 0x00, 0x0d });
+
+    // only the commands whose replies are read ask for them
+    if (nxt::PlayTone::replies || nxt::SetOutputState::replies || !nxt::GetOutputState::replies
+            || !nxt::GetInputValues::replies || !nxt::GetBatteryLevel::replies || !nxt::KeepAlive::replies)
+    {
+        fail ("commands", "reply requested wrongly", 0);
+    }
+}
+
+template <typename REPLY> static void header (const char *name, const std::vector<uint8_t> &data, size_t size)
+{
+    if ((data.size () != size) || (REPLY::size != size) || (nxt::reply_size (REPLY::opcode) != size))
+    {
+        fail (name, "reply size", REPLY::size);
+    }
+
+    if ((size_t) (data[0] | (data[1] << 8)) != size - nxt::HEADER)
+    {
+        fail (name, "length prefix", data[0] | (data[1] << 8));
+    }
+
+    if (!REPLY::match (data.data ()) || (REPLY::status (data.data ()) != 0))
+    {
+        fail (name, "reply not matched", data[3]);
+    }
+
+    // the command as sent, and a reply to another opcode, are not the reply
+    std::vector<uint8_t> other (data);
+
+    other[2] = nxt::DIRECT;
+    if (REPLY::match (other.data ()))
+    {
+        fail (name, "command taken for its reply", other[2]);
+    }
+
+    other[2] = nxt::REPLY;
+    other[3] = REPLY::opcode ^ 0x40;
+    if (REPLY::match (other.data ()))
+    {
+        fail (name, "reply to another opcode matched", other[3]);
+    }
+}
+
+static void replies (void)
+{
+    // port B, -75%, regulated, running, tacho counts -1, 1000 and -123456
+    std::vector<uint8_t> state =
+    {
+        0x19, 0x00, 0x02, 0x06, 0x00,
+        0x01, 0xb5, 0x07, 0x01, 0x00, 0x20,
+        0x00, 0x00, 0x00, 0x00,
+        0xff, 0xff, 0xff, 0xff,
+        0xe8, 0x03, 0x00, 0x00,
+        0xc0, 0x1d, 0xfe, 0xff,
+    };
+    typedef nxt::OutputState S;
+
+    header<S> ("OutputState", state, 27);
+    if ((S::get<0> (state.data ()) != 1) || (S::get<1> (state.data ()) != -75) || (S::get<2> (state.data ()) != 0x07)
+            || (S::get<3> (state.data ()) != 0x01) || (S::get<4> (state.data ()) != 0)
+            || (S::get<5> (state.data ()) != nxt::RUNSTATE_RUNNING) || (S::get<6> (state.data ()) != 0)
+            || (S::get<7> (state.data ()) != -1) || (S::get<8> (state.data ()) != 1000)
+            || (S::get<9> (state.data ()) != -123456))
+    {
+        fail ("OutputState", "field decoded wrongly", S::get<9> (state.data ()));
+    }
+
+    // port 4, valid, a light sensor: raw 700, normalized 650, scaled -20, calibrated 300
+    std::vector<uint8_t> input =
+    {
+        0x10, 0x00, 0x02, 0x07, 0x00,
+        0x03, 0x01, 0x00, 0x05, 0x80,
+        0xbc, 0x02, 0x8a, 0x02, 0xec, 0xff, 0x2c, 0x01,
+    };
+    typedef nxt::InputValues I;
+
+    header<I> ("InputValues", input, 18);
+    if ((I::get<0> (input.data ()) != 3) || (I::get<1> (input.data ()) != 1) || (I::get<2> (input.data ()) != 0)
+            || (I::get<3> (input.data ()) != 0x05) || (I::get<4> (input.data ()) != 0x80)
+            || (I::get<5> (input.data ()) != 700) || (I::get<6> (input.data ()) != 650)
+            || (I::get<7> (input.data ()) != -20) || (I::get<8> (input.data ()) != 300))
+    {
+        fail ("InputValues", "field decoded wrongly", I::get<7> (input.data ()));
+    }
+
+    // 7.9 V
+    std::vector<uint8_t> battery = { 0x05, 0x00, 0x02, 0x0b, 0x00, 0xdc, 0x1e };
+
+    header<nxt::BatteryLevel> ("BatteryLevel", battery, 7);
+    if (nxt::BatteryLevel::get<0> (battery.data ()) != 7900)
+    {
+        fail ("BatteryLevel", "voltage decoded wrongly", nxt::BatteryLevel::get<0> (battery.data ()));
+    }
+
+    // ten minutes
+    std::vector<uint8_t> sleep = { 0x07, 0x00, 0x02, 0x0d, 0x00, 0xc0, 0x27, 0x09, 0x00 };
+
+    header<nxt::SleepTime> ("SleepTime", sleep, 9);
+    if (nxt::SleepTime::get<0> (sleep.data ()) != 600000)
+    {
+        fail ("SleepTime", "sleep time decoded wrongly", nxt::SleepTime::get<0> (sleep.data ()));
+    }
+
+    // a failed reply carries its status
+    battery[4] = 0xbd;
+    if (nxt::BatteryLevel::status (battery.data ()) != 0xbd)
+    {
+        fail ("BatteryLevel", "status", nxt::BatteryLevel::status (battery.data ()));
+    }
+
+    // nothing is known of the commands that send no reply
+    if ((nxt::reply_size (nxt::PlayTone::opcode) != 0) || (nxt::reply_size (nxt::SetOutputState::opcode) != 0))
+    {
+        fail ("reply_size", "a size for a command without a reply", 0);
+    }
+}
+
+int main (int argc, char *argv[])
+{
+    commands ();
+    replies ();
+
+    printf ("%s\n", failures ? "FAILED" : "passed");
+
+    return (failures ? 1 : 0);
+}
@@ -0,0 +1,371 @@
+#include <getopt.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "esp_http_server.h"
+
+#include "Query.h"
+
+//
+// Fuzzes the query tokenizer against a plain model of what it should find,
+// and times it against the way the handlers read their parameters before:
+// the query copied to the heap and httpd_query_key_value and strtol called
+// once per key. The model splits the query with std::string:
+//
+//   - the query starts after the first '?', fields are split on '&'
+//   - a key runs to the first '=', the value to the end of the field
+//   - fields with an empty key are dropped, past FIELDS are ignored
+//   - keys match ignoring case and the first of repeated keys wins
+//   - an integer is an optional sign and at least one digit, saturating
+//
+// The queries are made up from separators, the keys the handlers read,
+// digits, signs and any other byte, and their length runs past what the
+// server accepts. Build with -DCMAKE_BUILD_TYPE=Release for meaningful
+// times, and with -fsanitize=address,undefined to fuzz in earnest. It
+// exits non-zero on a failed check.
+//
+
+static int failures = 0;
+
+static void fail (const std::string &uri, const char *message, const std::string &key)
+{
+    if (failures++ < 20)
+    {
+        std::string shown;
+
+        for (unsigned char character : uri.substr (0, 120))
+        {
+            char escaped[8];
+
+            snprintf (escaped, sizeof (escaped), (character >= ' ' && character < 0x7f) ? "%c" : "\\x%02x", character);
+            shown += escaped;
+        }
+
+        printf ("FAIL: %s: %s \"%s\"\n", shown.c_str (), message, key.c_str ());
+    }
+}
+
+static double now (void)
+{
+    struct timespec time;
+    clock_gettime (CLOCK_MONOTONIC, &time);
+
+    return (time.tv_sec + time.tv_nsec / 1e9);
+}
+
+// -----
+// model
+// -----
+
+struct field
+{
+    std::string key;
+    std::string value;
+};
+
+static std::vector<field> model (const std::string &uri)
+{
+    std::vector<field> fields;
+    size_t question = uri.find ('?');
+
+    if (question == std::string::npos)
+    {
+        return (fields);
+    }
+
+    size_t start = question + 1;
+
+    while ((start <= uri.size ()) && ((int) fields.size () < Query::FIELDS))
+    {
+        size_t stop = std::min (uri.find ('&', start), uri.size ());
+        std::string text = uri.substr (start, stop - start);
+        size_t equals = text.find ('=');
+
+        if (equals != 0 && !text.empty ())
+        {
+            fields.push_back ({ text.substr (0, equals), (equals == std::string::npos) ? "" : text.substr (equals + 1) });
+        }
+
+        if (stop == uri.size ())
+        {
+            break;
+        }
+
+        start = stop + 1;
+    }
+
+    return (fields);
+}
+
+static const field *lookup (const std::vector<field> &fields, const std::string &key)
+{
+    for (const field &entry : fields)
+    {
+        if ((entry.key.size () == key.size ()) && (strncasecmp (entry.key.c_str (), key.c_str (), key.size ()) == 0))
+        {
+            return (&entry);
+        }
+    }
+
+    return (NULL);
+}
+
+static bool integer (const std::string &text, long *value)
+{
+    size_t position = ((text.size () > 0) && ((text[0] == '-') || (text[0] == '+'))) ? 1 : 0;
+
+    if ((position == text.size ()) || (text.find_first_not_of ("0123456789", position) != std::string::npos))
+    {
+        return (false);
+    }
+
+    unsigned long long result = 0;
+    for (size_t loop = position; loop < text.size (); loop++)
+    {
+        unsigned long long digit = text[loop] - '0';
+
+        result = (result > LONG_MAX / 10) ? LONG_MAX : std::min ((unsigned long long) LONG_MAX, result * 10 + digit);
+    }
+
+    *value = (text[0] == '-') ? -(long) result : (long) result;
+
+    return (true);
+}
+
+// ------
+// checks
+// ------
+
+static void check (const std::string &uri, const std::vector<std::string> &probes)
+{
+    Query query (uri.c_str ());
+    std::vector<field> fields = model (uri);
+
+    if (query.count () != (int) fields.size ())
+    {
+        fail (uri, "field count", std::to_string (query.count ()) + " against " + std::to_string (fields.size ()));
+    }
+
+    // every key found, with a key of another case and keys it does not have
+    std::vector<std::string> keys (probes);
+
+    for (const field &entry : fields)
+    {
+        std::string upper (entry.key);
+        std::transform (upper.begin (), upper.end (), upper.begin (), ::toupper);
+
+        keys.push_back (entry.key);
+        keys.push_back (upper);
+    }
+
+    for (const std::string &key : keys)
+    {
+        const field *expected = lookup (fields, key);
+        size_t length = 0;
+        const char *value = query.value (key.c_str (), &length);
+
+        if ((query.has (key.c_str ()) != (expected != NULL)) || ((value != NULL) != (expected != NULL)))
+        {
+            fail (uri, "key found wrongly", key);
+            continue;
+        }
+
+        if (expected && (std::string (value, length) != expected->value))
+        {
+            fail (uri, "value differs", key);
+        }
+
+        long got = 12345;
+        long wanted = 54321;
+        bool parsed = query.integer (key.c_str (), &got);
+
+        if ((parsed != (expected && integer (expected->value, &wanted))) || (parsed && (got != wanted)))
+        {
+            fail (uri, "integer differs", key);
+        }
+    }
+}
+
+static const char *fixed[] =
+{
+    "/drive", "/drive?", "/drive?&", "/drive?&&=&", "/drive?=1", "/drive?L", "/drive?L=", "/drive?L=1&L=2",
+    "/drive?l=-37&R=52&T=417", "/drive?L=abc", "/drive?L=+", "/drive?L=-", "/drive?L=1e3", "/drive?L= 1",
+    "/drive?L=99999999999999999999999", "/drive?L=-99999999999999999999999", "/drive?a=1?b=2", "/drive?a==1",
+    "/drive?a=1&b=2&c=3&d=4&e=5&f=6&g=7&h=8&i=9&j=10", "?L=1", "L=1", "",
+};
+
+static std::string made (std::mt19937 &random)
+{
+    static const char *pieces[] =
+    {
+        "?", "&", "=", "&&", "==", "L", "R", "T", "S", "l", "profile", "-", "+", "0", "7", "42", "-100",
+        "9223372036854775807", "9223372036854775808",
+    };
+    static const int PIECES = sizeof (pieces) / sizeof (pieces[0]);
+
+    std::string uri = (random () % 8) ? "/drive" : "";
+    int count = random () % ((random () % 16) ? 24 : 400);
+
+    for (int loop = 0; loop < count; loop++)
+    {
+        if (random () % 6)
+        {
+            uri += pieces[random () % PIECES];
+        }
+        else
+        {
+            uri += (char) (1 + random () % 255);
+        }
+    }
+
+    return (uri);
+}
+
+// --------
+// handlers
+// --------
+
+// /drive as it read its parameters before
+static long copied (const char *uri)
+{
+    const char *query = strchr (uri, '?');
+    long total = 0;
+
+    if ((query == NULL) || (query[1] == '\0'))
+    {
+        return (0);
+    }
+
+    size_t length = strlen (query + 1);
+    char *buffer = (char *) malloc (length + 1);
+    memcpy (buffer, query + 1, length + 1);
+
+    char parameter[32];
+    char *temp;
+
+    if (httpd_query_key_value (buffer, "T", parameter, sizeof (parameter)) == ESP_OK)
+    {
+        total += strtol (parameter, &temp, 10);
+
+        if (httpd_query_key_value (buffer, "L", parameter, sizeof (parameter)) == ESP_OK)
+        {
+            total += strtol (parameter, &temp, 10);
+        }
+
+        if (httpd_query_key_value (buffer, "R", parameter, sizeof (parameter)) == ESP_OK)
+        {
+            total += strtol (parameter, &temp, 10);
+        }
+    }
+
+    free (buffer);
+
+    return (total);
+}
+
+// and with the tokenizer
+static long tokenized (const char *uri)
+{
+    Query query (uri);
+    long total = 0;
+    long value = 0;
+
+    if (query.integer ("T", &value))
+    {
+        total += value;
+
+        if (query.integer ("L", &value))
+        {
+            total += value;
+        }
+
+        if (query.integer ("R", &value))
+        {
+            total += value;
+        }
+    }
+
+    return (total);
+}
+
+int main (int argc, char *argv[])
+{
+    long rounds = 200000;
+    long repeat = 2000000;
+    unsigned seed = 1;
+    int option;
+
+    while ((option = getopt (argc, argv, "f:n:s:")) != -1)
+    {
+        switch (option)
+        {
+            case 'f':
+                rounds = std::max (0, atoi (optarg));
+                break;
+            case 'n':
+                repeat = std::max (1, atoi (optarg));
+                break;
+            case 's':
+                seed = strtoul (optarg, NULL, 10);
+                break;
+            default:
+                fprintf (stderr, "usage: %s [-f queries fuzzed] [-n lookups timed] [-s seed]\n", argv[0]);
+                return (1);
+        }
+    }
+
+    std::vector<std::string> probes = { "L", "R", "T", "t", "profile", "", "LL", "a", "j", "L=" };
+
+    for (const char *uri : fixed)
+    {
+        check (uri, probes);
+    }
+
+    std::mt19937 random (seed);
+    for (long loop = 0; loop < rounds; loop++)
+    {
+        check (made (random), probes);
+    }
+
+    printf ("%zu fixed and %ld made up queries checked, seed %u\n", sizeof (fixed) / sizeof (fixed[0]), rounds, seed);
+
+    // a drive request as the page sends it, four times a second
+    const char *drive = "/drive?L=-37&R=52&T=417";
+    volatile long sink = 0;
+
+    if (copied (drive) != tokenized (drive))
+    {
+        fail (drive, "the two ways disagree", "");
+    }
+
+    double start = now ();
+    for (long loop = 0; loop < repeat; loop++)
+    {
+        sink += copied (drive);
+    }
+    double before = (now () - start) / repeat;
+
+    start = now ();
+    for (long loop = 0; loop < repeat; loop++)
+    {
+        sink += tokenized (drive);
+    }
+    double after = (now () - start) / repeat;
+
+    printf ("%s\n", drive);
+    printf ("  copied and looked up %8.1f ns\n", before * 1e9);
+    printf ("  tokenized            %8.1f ns\n", after * 1e9);
+
+    printf ("%s\n", failures ? "FAILED" : "passed");
+
+    return (failures ? 1 : 0);
+}
@@ -0,0 +1,314 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "esp_camera.h"
+#include "esp_timer.h"
+#include "Recorder.h"
+
+//
+// Records the simulated camera into a small ring, so it wraps many times,
+// and checks the recorder against a copy of every frame it was given:
+//
+//   - the ring holds exactly the most recent frames, in order, none missing,
+//     each byte for byte as it was taken, with its capture time
+//   - the frame and byte counts match what the ring holds, and it stays
+//     reasonably full once it has wrapped
+//   - a frozen clip starts at the first frame of the history asked for and
+//     ends with the newest, and nothing is recorded while it is frozen
+//
+// The sensor quality steps every second so the frames vary in size. The
+// camera runs at MINDBRIDGE_FPS, or replays MINDBRIDGE_FRAMES, as it does
+// for the host build. It also times the copy into the ring. -o writes the
+// last clip frozen as raw MJPEG.
+//
+
+typedef std::map<int64_t, std::vector<uint8_t> > frames_t;
+
+static int failures = 0;
+
+static double now (void)
+{
+    struct timespec time;
+    clock_gettime (CLOCK_MONOTONIC, &time);
+
+    return (time.tv_sec + time.tv_nsec / 1e9);
+}
+
+static void fail (const char *message, int64_t timestamp)
+{
+    if (failures++ < 10)
+    {
+        printf ("FAIL: %s, frame at %lld us\n", message, (long long) timestamp);
+    }
+}
+
+// reads the clip back and compares it with the frames taken, from first on
+static uint32_t check (Recorder &recorder, const frames_t &taken, frames_t::const_iterator first)
+{
+    Recorder::cursor position;
+    const uint8_t *data;
+    size_t length = 0;
+    int64_t timestamp = 0;
+    uint32_t count = 0;
+    size_t bytes = 0;
+
+    recorder.rewind (position);
+
+    while ((data = recorder.next (position, &length, &timestamp)) != NULL)
+    {
+        if (first == taken.end ())
+        {
+            fail ("frame past the newest taken", timestamp);
+            break;
+        }
+
+        if (timestamp != first->first)
+        {
+            fail ("frame out of order or missing", first->first);
+        }
+        else if ((length != first->second.size ()) || memcmp (data, first->second.data (), length))
+        {
+            fail ("frame data differs", timestamp);
+        }
+
+        bytes += length;
+        count++;
+        ++first;
+    }
+
+    if (first != taken.end ())
+    {
+        fail ("newest frames missing", first->first);
+    }
+
+    if ((count != recorder.clip_frames ()) || (bytes != recorder.clip_bytes ()))
+    {
+        fail ("clip counts differ from its frames", 0);
+    }
+
+    return (count);
+}
+
+// the whole ring as a clip, then recording again
+static uint32_t check_ring (Recorder &recorder, const frames_t &taken)
+{
+    uint32_t frames = recorder.frames ();
+    size_t bytes = recorder.bytes ();
+
+    if (frames > taken.size ())
+    {
+        fail ("more frames than were taken", 0);
+        return (0);
+    }
+
+    frames_t::const_iterator first = taken.end ();
+    std::advance (first, -(long) frames);
+
+    recorder.freeze (UINT32_MAX / 1000000);
+
+    if ((recorder.clip_frames () != frames) || (recorder.clip_bytes () != bytes))
+    {
+        fail ("ring counts differ from its frames", 0);
+    }
+
+    uint32_t count = check (recorder, taken, first);
+    recorder.release ();
+
+    return (count);
+}
+
+int main (int argc, char *argv[])
+{
+    size_t size = 256;
+    int seconds = 8;
+    int history = 2;
+    const char *output = NULL;
+    int option;
+
+    while ((option = getopt (argc, argv, "s:d:h:o:")) != -1)
+    {
+        switch (option)
+        {
+            case 's':
+                size = std::max (1, atoi (optarg));
+                break;
+            case 'd':
+                seconds = std::max (1, atoi (optarg));
+                break;
+            case 'h':
+                history = std::max (1, atoi (optarg));
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                fprintf (stderr, "usage: %s [-s ring KB] [-d seconds] [-h history seconds] [-o clip.mjpeg]\n", argv[0]);
+                return (1);
+        }
+    }
+
+    camera_config_t config;
+    memset (&config, 0, sizeof (config));
+    config.pixel_format = PIXFORMAT_JPEG;
+    config.frame_size = FRAMESIZE_VGA;
+    config.max_frame_size = FRAMESIZE_VGA;
+    config.jpeg_quality = 12;
+    config.fb_count = 1;
+
+    if (esp_camera_init (&config) != ESP_OK)
+    {
+        fprintf (stderr, "no camera\n");
+        return (1);
+    }
+
+    sensor_t *sensor = esp_camera_sensor_get ();
+    Recorder recorder (size * 1024);
+    frames_t taken;
+    double copying = 0;
+    size_t largest = 0;
+    size_t unused = 0;
+    uint32_t checked = 0;
+    int64_t end = esp_timer_get_time () + seconds * 1000000LL;
+    int step = 0;
+
+    if (!recorder.enabled ())
+    {
+        fprintf (stderr, "no memory for the ring\n");
+        return (1);
+    }
+
+    while (esp_timer_get_time () < end)
+    {
+        // from the bridge's quality to twice the detail and back
+        int second = (int) (esp_timer_get_time () / 1000000);
+        if (second != step)
+        {
+            static const int qualities[] = { 12, 8, 5, 8 };
+
+            step = second;
+            sensor->set_quality (sensor, qualities[step % 4]);
+        }
+
+        camera_fb_t *fb = esp_camera_fb_get ();
+        if (fb == NULL)
+        {
+            fprintf (stderr, "no frame\n");
+            return (1);
+        }
+
+        int64_t timestamp = fb->timestamp.tv_sec * 1000000LL + fb->timestamp.tv_usec;
+        uint32_t overwritten = recorder.overwritten ();
+
+        double start = now ();
+        bool recorded = recorder.record (fb->buf, fb->len, timestamp);
+        copying += now () - start;
+
+        if (!recorded)
+        {
+            fail ("frame not recorded", timestamp);
+        }
+
+        taken[timestamp].assign (fb->buf, fb->buf + fb->len);
+        largest = std::max (largest, (size_t) fb->len);
+        esp_camera_fb_return (fb);
+
+        // the room left once frames had to go makes up for the frame sizes
+        if (recorder.overwritten () != overwritten)
+        {
+            unused = std::max (unused, recorder.size () - recorder.bytes ());
+        }
+
+        checked += check_ring (recorder, taken);
+    }
+
+    uint32_t recorded = recorder.recorded ();
+
+    printf ("%u frames of up to %u bytes into a %u KB ring, %u overwritten, %u frames checked in the ring\n",
+            recorded, (unsigned) largest, (unsigned) size, recorder.overwritten (), checked);
+    printf ("  holds %u frames, %u bytes over %.2f s, at most %u bytes unused once full\n",
+            recorder.frames (), (unsigned) recorder.bytes (), (recorder.newest () - recorder.oldest ()) / 1e6,
+            (unsigned) unused);
+    printf ("  copy into the ring %.1f us a frame\n", copying / recorded * 1e6);
+
+    if (recorder.overwritten () == 0)
+    {
+        fail ("the ring never wrapped, run longer or make it smaller", 0);
+    }
+    else if (unused > 2 * (largest + 64))
+    {
+        fail ("the ring kept more room unused than two frames", 0);
+    }
+
+    // the history before now, as the trigger freezes it
+    int64_t newest = recorder.newest ();
+    int64_t cutoff = newest - history * 1000000LL;
+
+    if (!recorder.freeze (history))
+    {
+        fail ("could not freeze", newest);
+    }
+
+    frames_t::const_iterator first = taken.lower_bound (cutoff);
+    int64_t oldest = recorder.oldest ();
+
+    if (first->first < oldest)
+    {
+        first = taken.find (oldest);
+    }
+
+    uint32_t frames = check (recorder, taken, first);
+
+    if ((recorder.clip_start () != first->first) || (recorder.clip_end () != newest))
+    {
+        fail ("clip does not span the history", recorder.clip_start ());
+    }
+
+    if (recorder.record (taken.rbegin ()->second.data (), taken.rbegin ()->second.size (), newest + 1))
+    {
+        fail ("recorded while frozen", newest + 1);
+    }
+
+    printf ("  froze %u frames over %.2f s for %d s of history\n", frames,
+            (recorder.clip_end () - recorder.clip_start ()) / 1e6, history);
+
+    if (output)
+    {
+        FILE *file = fopen (output, "wb");
+        Recorder::cursor position;
+        const uint8_t *data;
+        size_t length = 0;
+
+        recorder.rewind (position);
+        while (file && ((data = recorder.next (position, &length, NULL)) != NULL))
+        {
+            fwrite (data, 1, length, file);
+        }
+
+        if (file)
+        {
+            fclose (file);
+        }
+    }
+
+    // a new clip ends the reading of the old one
+    Recorder::cursor stale;
+    recorder.rewind (stale);
+    recorder.release ();
+    recorder.freeze (history);
+
+    if (recorder.next (stale, NULL, NULL) != NULL)
+    {
+        fail ("read a clip that had gone", 0);
+    }
+
+    printf ("%s\n", failures ? "FAILED" : "passed");
+
+    return (failures ? 1 : 0);
+}
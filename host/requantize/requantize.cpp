@@ -0,0 +1,289 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "esp_jpg_coeff.h"
+#include "fixtures.h"
+#include "img_converters.h"
+#include "reference.h"
+
+//
+// Checks and times jpg_requantize against the full transcode the bridge
+// does otherwise, decoding the frame and encoding it again with fmt2jpg,
+// at each of the output qualities given. For every frame it checks that
+//
+//   - requantizing at quality 100, never finer than the source, gives
+//     back the source frame byte for byte, so only the coarser tables lose
+//   - requantizing a requantized frame again at its own quality gives it
+//     back byte for byte
+//   - every coefficient of each requantized frame is the source's scaled by
+//     its source table over its new one and rounded, block for block
+//   - each requantized frame decodes at the source size and stays close
+//     to the decoded source
+//
+// and reports the time, size and PSNR against the decoded source of both
+// ways. fmt2jpg codes 4:2:0 where the requantized frame keeps the source's
+// sampling, so at the same quality its frames are smaller for the colour
+// it drops. Without arguments it encodes test scenes the way the OV2640
+// does, 4:2:2, at sensor qualities 10, 12 and 20; otherwise it reads the
+// JPEG files in the directories given. It exits non-zero on a failed check.
+//
+
+static int failures = 0;
+
+static double now (void)
+{
+    struct timespec time;
+    clock_gettime (CLOCK_MONOTONIC, &time);
+
+    return (time.tv_sec + time.tv_nsec / 1e9);
+}
+
+static void fail (const std::string &name, int quality, const char *message)
+{
+    if (failures++ < 20)
+    {
+        printf ("FAIL: %s, quality %d: %s\n", name.c_str (), quality, message);
+    }
+}
+
+struct coefficients
+{
+    jpg_coeff_info_t info;
+    std::vector<uint8_t> components;
+    std::vector<int16_t> all;
+};
+
+static bool keep (void *argument, const jpg_coeff_info_t *info, const jpg_coeff_block_t *block)
+{
+    coefficients *kept = (coefficients *) argument;
+
+    kept->components.push_back (block->component);
+    kept->all.insert (kept->all.end (), block->coef, block->coef + 64);
+
+    return (true);
+}
+
+static bool decode (const std::vector<uint8_t> &jpeg, coefficients &kept)
+{
+    return ((esp_jpg_coeff_info (jpeg.data (), jpeg.size (), &kept.info) == ESP_OK)
+            && (esp_jpg_coeff_decode (jpeg.data (), jpeg.size (), JPG_COEFF_ALL, keep, &kept, NULL) == ESP_OK));
+}
+
+// each coefficient of the requantized frame against round (c * from / to)
+static void check_coefficients (const frame &input, int quality, const std::vector<uint8_t> &requantized)
+{
+    coefficients source;
+    coefficients output;
+
+    if (!decode (input.data, source) || !decode (requantized, output) || (output.components != source.components))
+    {
+        fail (input.name, quality, "requantized, the blocks differ from the source");
+        return;
+    }
+
+    for (size_t block = 0; block < source.components.size (); block++)
+    {
+        int component = source.components[block];
+        const uint16_t *from = source.info.quant[source.info.component[component].tq];
+        const uint16_t *to = output.info.quant[output.info.component[component].tq];
+
+        for (int i = 0; i < 64; i++)
+        {
+            long expected = lround ((double) source.all[block * 64 + i] * from[i] / to[i]);
+
+            if (output.all[block * 64 + i] != expected)
+            {
+                fail (input.name, quality, "requantized, a coefficient is not the source's rescaled");
+                return;
+            }
+        }
+    }
+}
+
+struct totals
+{
+    double requantize;
+    double transcode;
+    size_t source_bytes;
+    size_t requantized_bytes;
+    size_t transcoded_bytes;
+};
+
+static void run (const frame &input, const std::vector<int> &qualities, int repeat, std::vector<totals> &sums)
+{
+    std::vector<uint8_t> pixels;
+    int width = 0;
+    int height = 0;
+
+    if (!reference_decode (input.data.data (), input.data.size (), pixels, &width, &height))
+    {
+        printf ("%s: not a baseline JPEG\n", input.name.c_str ());
+        return;
+    }
+
+    printf ("%s: %dx%d, %u bytes\n", input.name.c_str (), width, height, (unsigned) input.data.size ());
+    printf ("  %-7s %9s %8s %8s %11s %8s %8s %8s\n", "quality", "requant ms", "bytes", "PSNR dB", "transcode ms", "bytes", "PSNR dB",
+            "speedup");
+
+    // no coarser than the source, the source is passed through
+    std::vector<uint8_t> same;
+
+    if (!jpg_requantize_cb (input.data.data (), input.data.size (), 100, append, &same) || (same != input.data))
+    {
+        fail (input.name, 100, "requantized, the frame differs from the source");
+    }
+
+    for (size_t index = 0; index < qualities.size (); index++)
+    {
+        int quality = qualities[index];
+        std::vector<uint8_t> requantized;
+
+        double start = now ();
+        for (int loop = 0; loop < repeat; loop++)
+        {
+            requantized.clear ();
+            if (!jpg_requantize_cb (input.data.data (), input.data.size (), quality, append, &requantized))
+            {
+                break;
+            }
+        }
+        double requantize = (now () - start) / repeat;
+
+        std::vector<uint8_t> decoded;
+        int w = 0;
+        int h = 0;
+
+        if (requantized.empty () || !reference_decode (requantized.data (), requantized.size (), decoded, &w, &h)
+                || (w != width) || (h != height))
+        {
+            fail (input.name, quality, "requantized frame has the wrong size");
+            continue;
+        }
+
+        check_coefficients (input, quality, requantized);
+
+        std::vector<uint8_t> again;
+        if (!jpg_requantize_cb (requantized.data (), requantized.size (), quality, append, &again) || (again != requantized))
+        {
+            fail (input.name, quality, "requantized again, the frame changed");
+        }
+
+        double requantized_psnr = psnr (decoded, pixels);
+        if (requantized_psnr < 24)
+        {
+            fail (input.name, quality, "requantized frame is far from the source");
+        }
+
+        // decode and encode again, as the transcoding profiles do
+        std::vector<uint8_t> full;
+        std::vector<uint8_t> transcoded;
+
+        start = now ();
+        for (int loop = 0; loop < repeat; loop++)
+        {
+            transcoded.clear ();
+            reference_decode (input.data.data (), input.data.size (), full, &w, &h);
+            fmt2jpg_cb (full.data (), full.size (), w, h, PIXFORMAT_RGB888, quality, append, &transcoded);
+        }
+        double transcode = (now () - start) / repeat;
+
+        reference_decode (transcoded.data (), transcoded.size (), decoded, &w, &h);
+
+        printf ("  %-7d %9.3f %8u %8.1f %11.3f %8u %8.1f %7.1fx\n", quality, requantize * 1000, (unsigned) requantized.size (),
+                requantized_psnr, transcode * 1000, (unsigned) transcoded.size (), psnr (decoded, pixels), transcode / requantize);
+
+        sums[index].requantize += requantize;
+        sums[index].transcode += transcode;
+        sums[index].source_bytes += input.data.size ();
+        sums[index].requantized_bytes += requantized.size ();
+        sums[index].transcoded_bytes += transcoded.size ();
+    }
+}
+
+int main (int argc, char *argv[])
+{
+    std::vector<int> qualities;
+    int repeat = 20;
+    int option;
+
+    while ((option = getopt (argc, argv, "Q:n:")) != -1)
+    {
+        switch (option)
+        {
+            case 'Q':
+                qualities.push_back (std::min (100, std::max (1, atoi (optarg))));
+                break;
+            case 'n':
+                repeat = std::max (1, atoi (optarg));
+                break;
+            default:
+                fprintf (stderr, "usage: %s [-Q output quality ...] [-n repeat] [directory ...]\n", argv[0]);
+                return (1);
+        }
+    }
+
+    if (qualities.empty ())
+    {
+        qualities.push_back (70);
+        qualities.push_back (50);
+        qualities.push_back (30);
+    }
+
+    std::vector<frame> frames;
+
+    if (optind < argc)
+    {
+        for (int loop = optind; loop < argc; loop++)
+        {
+            load (argv[loop], frames);
+        }
+
+        if (frames.empty ())
+        {
+            fprintf (stderr, "no JPEG files found\n");
+            return (1);
+        }
+    }
+    else
+    {
+        for (int quality : { 10, 12, 20 })
+        {
+            for (frame made : { make (640, 480, encoder_quality (quality)), make (800, 600, encoder_quality (quality)) })
+            {
+                made.name += " q" + std::to_string (quality);
+                frames.push_back (made);
+            }
+        }
+    }
+
+    std::vector<totals> sums (qualities.size (), totals ());
+
+    for (const frame &input : frames)
+    {
+        run (input, qualities, repeat, sums);
+    }
+
+    for (size_t index = 0; index < qualities.size (); index++)
+    {
+        const totals &sum = sums[index];
+
+        if (sum.source_bytes)
+        {
+            printf ("quality %d: requantized %.0f%% of the source bytes, transcoded %.0f%%, requantizing %.1fx faster\n",
+                    qualities[index], 100.0 * sum.requantized_bytes / sum.source_bytes,
+                    100.0 * sum.transcoded_bytes / sum.source_bytes, sum.transcode / sum.requantize);
+        }
+    }
+
+    printf ("%s\n", failures ? "FAILED" : "passed");
+
+    return (failures ? 1 : 0);
+}
@@ -0,0 +1,370 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_spp_api.h"
+#include "esp_timer.h"
+
+#include "NXT.h"
+#include "Robot.h"
+#include "Scheduler.h"
+
+//
+// Times the robot's command sender the two ways it has been written: the
+// Robot class as it is, its task woken by a notification when motor()
+// queues a setpoint, and a model of the loop it replaced, which woke every
+// 10 ms to poll the queue. A driver sends setpoints for both ports at the
+// rate given, through motor() for the Robot and straight into a Scheduler
+// for the model, and the link records how long each waited before it, or a
+// newer setpoint for its port, went out. The Robot's link is esp_spp_write,
+// defined here, which takes the place of the Bluetooth stack. After
+// driving, both senders are left idle for a while.
+//
+// It reports the latency of the setpoints, the wakeups a second of the
+// model and the CPU time each sender took while idle, and fails if the
+// Robot leaves a setpoint unsent, writes a port's setpoint other than the
+// last one given, or writes a setpoint on an idle wire. The host runs
+// FreeRTOS tasks as threads, so the latencies include the host's thread
+// wakeup time, and the Robot's idle time includes its telemetry polls.
+//
+
+// the ports the setpoints are sent to, and the link handle of the robot
+#define LEFT_PORT   (1)
+#define RIGHT_PORT  (2)
+#define HANDLE      (0x81)
+
+static int failures = 0;
+
+static void fail (const char *mode, const char *message, long value)
+{
+    if (failures++ < 20)
+    {
+        printf ("FAIL: %s: %s (%ld)\n", mode, message, value);
+    }
+}
+
+// the process CPU time, which is the sender's while the driver sleeps
+static int64_t cpu (void)
+{
+    struct timespec now;
+
+    clock_gettime (CLOCK_PROCESS_CPUTIME_ID, &now);
+
+    return (now.tv_sec * 1000000LL + now.tv_nsec / 1000);
+}
+
+static int64_t percentile (std::vector<int64_t> samples, int percent)
+{
+    if (samples.empty ())
+    {
+        return (0);
+    }
+
+    std::sort (samples.begin (), samples.end ());
+
+    return (samples[std::min (samples.size () - 1, samples.size () * percent / 100)]);
+}
+
+// ----
+// link
+// ----
+
+//
+// setpoints given and not yet on the wire, per port, and what the link saw
+//
+static struct
+{
+    std::mutex mutex;
+    std::deque<std::pair<int64_t, int8_t> > waiting[3];
+    std::vector<int64_t> latencies;
+    int8_t last[3];
+    uint32_t sent;
+    uint32_t idle;
+    bool idling;
+} wire;
+
+static void given (uint8_t port, int8_t speed)
+{
+    std::lock_guard<std::mutex> lock (wire.mutex);
+
+    wire.waiting[port].push_back (std::make_pair (esp_timer_get_time (), speed));
+}
+
+// a setpoint on the wire settles every one of its port given up to it
+static void written (uint8_t port, int8_t speed)
+{
+    std::lock_guard<std::mutex> lock (wire.mutex);
+    std::deque<std::pair<int64_t, int8_t> > &waiting = wire.waiting[port];
+    int64_t now = esp_timer_get_time ();
+
+    while (!waiting.empty ())
+    {
+        std::pair<int64_t, int8_t> setpoint = waiting.front ();
+
+        waiting.pop_front ();
+        wire.latencies.push_back (now - setpoint.first);
+
+        if (setpoint.second == speed)
+        {
+            break;
+        }
+    }
+
+    wire.last[port] = speed;
+    wire.sent++;
+    wire.idle += wire.idling ? 1 : 0;
+}
+
+esp_err_t esp_spp_write (uint32_t handle, int len, uint8_t *p_data)
+{
+    // [length] [type] [opcode] [port] [power] ...
+    if ((handle == HANDLE) && (len >= 6) && (p_data[3] == nxt::SetOutputState::opcode) && (p_data[4] < 3))
+    {
+        written (p_data[4], (int8_t) p_data[5]);
+    }
+
+    return (ESP_OK);
+}
+
+static void report (const char *name, uint32_t sent, const std::vector<int64_t> &latencies, const char *wakeups, double idle)
+{
+    printf ("  %-8s %8u %8.2f %8.2f %8.2f %10s %13.2f\n", name, sent, percentile (latencies, 50) / 1000.0,
+            percentile (latencies, 99) / 1000.0, percentile (latencies, 100) / 1000.0, wakeups, idle);
+}
+
+// the speed of a port on a step, never zero and never the one before
+static int8_t speed (uint8_t port, int step)
+{
+    int8_t value = (int8_t) (1 + step % 100);
+
+    return ((port == LEFT_PORT) ? value : -value);
+}
+
+// ticks until the next step of the drive
+static void pace (int64_t start, int64_t period, int step)
+{
+    int64_t wait = start + (step + 1) * period - esp_timer_get_time ();
+
+    if (wait > 0)
+    {
+        vTaskDelay (std::max (1, (int) (wait / 1000 / portTICK_PERIOD_MS)));
+    }
+}
+
+// -----
+// robot
+// -----
+
+static void run_robot (int seconds, int rate, int idle)
+{
+    // its task runs on, so it is never freed
+    Robot &robot = *new Robot ("robot");
+
+    robot.connected (true, HANDLE);
+
+    int64_t start = esp_timer_get_time ();
+    int64_t period = 1000000 / rate;
+
+    for (int step = 0; step < seconds * rate; step++)
+    {
+        given (LEFT_PORT, speed (LEFT_PORT, step));
+        robot.motor (LEFT_PORT, speed (LEFT_PORT, step));
+        given (RIGHT_PORT, speed (RIGHT_PORT, step));
+        robot.motor (RIGHT_PORT, speed (RIGHT_PORT, step));
+
+        pace (start, period, step);
+    }
+
+    vTaskDelay (100 / portTICK_PERIOD_MS);
+
+    // and leave it alone
+    wire.idling = true;
+    int64_t used = cpu ();
+    vTaskDelay (idle * 1000 / portTICK_PERIOD_MS);
+    used = cpu () - used;
+
+    robot.connected (false, 0);
+
+    std::lock_guard<std::mutex> lock (wire.mutex);
+    report ("robot", wire.sent, wire.latencies, "-", used / 1000.0 / idle);
+
+    long unsent = wire.waiting[LEFT_PORT].size () + wire.waiting[RIGHT_PORT].size ();
+    if (unsent != 0)
+    {
+        fail ("robot", "setpoints not sent", unsent);
+    }
+
+    int last = seconds * rate - 1;
+    if ((wire.last[LEFT_PORT] != speed (LEFT_PORT, last)) || (wire.last[RIGHT_PORT] != speed (RIGHT_PORT, last)))
+    {
+        fail ("robot", "not the last setpoint on the wire", wire.last[LEFT_PORT]);
+    }
+
+    if (wire.idle > 0)
+    {
+        fail ("robot", "setpoints written on an idle link", wire.idle);
+    }
+}
+
+// -------
+// polling
+// -------
+
+//
+// the sender as it was, waking every 10 ms to send whatever is queued
+//
+struct polled
+{
+    volatile bool running;
+    Scheduler scheduler;
+    SemaphoreHandle_t semaphore;
+    SemaphoreHandle_t done;
+    uint32_t wakeups;
+    uint32_t sent;
+    std::vector<int64_t> latencies;
+};
+
+static void polled_task (void *parameters)
+{
+    polled *model = (polled *) parameters;
+
+    while (model->running)
+    {
+        while (true)
+        {
+            uint16_t length = 0;
+            int64_t queued = 0;
+
+            xSemaphoreTake (model->semaphore, portMAX_DELAY);
+
+            uint8_t *next = model->scheduler.front (&length);
+            if (next)
+            {
+                memcpy (&queued, &next[6], sizeof (queued));
+                model->scheduler.release ();
+            }
+
+            xSemaphoreGive (model->semaphore);
+
+            if (next == NULL)
+            {
+                break;
+            }
+
+            model->latencies.push_back (esp_timer_get_time () - queued);
+            model->sent++;
+        }
+
+        vTaskDelay (10 / portTICK_PERIOD_MS);
+        model->wakeups++;
+    }
+
+    xSemaphoreGive (model->done);
+    vTaskDelete (NULL);
+}
+
+// a setpoint for a port, stamped after its power with the time it was queued
+static void setpoint (polled *model, uint8_t port, int8_t speed)
+{
+    uint8_t data[Scheduler::SIZE] = { 0 };
+    int64_t now = esp_timer_get_time ();
+
+    nxt::SetOutputState::encode (data, port, speed, 0, 0, 0, 0, 0);
+    memcpy (&data[6], &now, sizeof (now));
+
+    xSemaphoreTake (model->semaphore, portMAX_DELAY);
+    model->scheduler.push (Scheduler::MOTOR, data, port);
+    xSemaphoreGive (model->semaphore);
+}
+
+static void run_polled (int seconds, int rate, int idle)
+{
+    polled model;
+
+    model.running = true;
+    model.wakeups = 0;
+    model.sent = 0;
+    model.semaphore = xSemaphoreCreateMutex ();
+    model.done = xSemaphoreCreateBinary ();
+
+    xTaskCreate (polled_task, "polled", 4096, &model, ROBOT_PRIORITY, NULL);
+
+    int64_t start = esp_timer_get_time ();
+    int64_t period = 1000000 / rate;
+
+    for (int step = 0; step < seconds * rate; step++)
+    {
+        setpoint (&model, LEFT_PORT, speed (LEFT_PORT, step));
+        setpoint (&model, RIGHT_PORT, speed (RIGHT_PORT, step));
+
+        pace (start, period, step);
+    }
+
+    vTaskDelay (100 / portTICK_PERIOD_MS);
+
+    uint32_t driving = model.wakeups;
+    int64_t used = cpu ();
+    vTaskDelay (idle * 1000 / portTICK_PERIOD_MS);
+    used = cpu () - used;
+
+    char wakeups[16];
+    snprintf (wakeups, sizeof (wakeups), "%.1f", (double) (model.wakeups - driving) / idle);
+
+    model.running = false;
+    xSemaphoreTake (model.done, portMAX_DELAY);
+
+    report ("poll", model.sent, model.latencies, wakeups, used / 1000.0 / idle);
+
+    vSemaphoreDelete (model.semaphore);
+    vSemaphoreDelete (model.done);
+}
+
+int main (int argc, char *argv[])
+{
+    int seconds = 3;
+    int rate = 4;
+    int idle = 2;
+    int option;
+
+    while ((option = getopt (argc, argv, "d:r:i:")) != -1)
+    {
+        switch (option)
+        {
+            case 'd':
+                seconds = std::max (1, atoi (optarg));
+                break;
+            case 'r':
+                rate = std::min (100, std::max (1, atoi (optarg)));
+                break;
+            case 'i':
+                idle = std::max (1, atoi (optarg));
+                break;
+            default:
+                fprintf (stderr, "usage: %s [-d seconds driving] [-r setpoints per second] [-i seconds idle]\n", argv[0]);
+                return (1);
+        }
+    }
+
+    // the Robot logs every command it sends at info level
+    setenv ("MINDBRIDGE_LOG", "warn", 0);
+
+    printf ("%d s driving at %d setpoints a second per port, %d s idle\n", seconds, rate, idle);
+    printf ("  %-8s %8s %8s %8s %8s %10s %13s\n", "", "sent", "p50 ms", "p99 ms", "max ms", "wakeups/s", "idle CPU ms/s");
+
+    run_polled (seconds, rate, idle);
+    run_robot (seconds, rate, idle);
+
+    printf ("%s\n", failures ? "FAILED" : "passed");
+
+    return (failures ? 1 : 0);
+}
@@ -0,0 +1,292 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "esp_http_server.h"
+
+#include "Router.h"
+
+#include "assets.h"
+
+//
+// Times the router's dispatch against the walk the web server makes over
+// its registered handlers, which is how every request was routed before:
+// one handler per service and per static file, each tried in turn with
+// the wildcard matcher until one takes the request. Both route the same
+// mix of requests, the services the bridge registers, every file in the
+// filesystem directory, some with query strings, and some unknown. First
+// it checks that the router sends
+//
+//   - every service to its own handler, with or without a query string
+//   - every file to the file handler, with the file's asset as context
+//   - anything else to a 404
+//
+// It exits non-zero on a failed check. The server here is a stand-in that
+// only registers the router's handler and counts the 404s sent.
+//
+
+static const char *services[] =
+{
+    "/open", "/status", "/robot", "/telemetry", "/video", "/drive", "/camera", "/motion", "/thumbnail", "/recording",
+    "/metrics", "/trace",
+};
+
+static const int SERVICES = sizeof (services) / sizeof (services[0]);
+
+static int failures = 0;
+
+static void fail (const char *uri, const char *message)
+{
+    if (failures++ < 20)
+    {
+        printf ("FAIL: %s: %s\n", uri, message);
+    }
+}
+
+static double now (void)
+{
+    struct timespec time;
+    clock_gettime (CLOCK_MONOTONIC, &time);
+
+    return (time.tv_sec + time.tv_nsec / 1e9);
+}
+
+// ----------
+// stand-ins
+// ----------
+
+static httpd_uri_t registered;
+static int missing = 0;
+
+esp_err_t httpd_register_uri_handler (httpd_handle_t handle, const httpd_uri_t *uri_handler)
+{
+    registered = *uri_handler;
+
+    return (ESP_OK);
+}
+
+esp_err_t httpd_resp_send_err (httpd_req_t *req, httpd_err_code_t error, const char *msg)
+{
+    missing++;
+
+    return (ESP_OK);
+}
+
+// which handler took the last request, and with what
+static int handled = -1;
+static const void *context = NULL;
+
+template <int N> static esp_err_t service (httpd_req_t *request)
+{
+    handled = N;
+
+    return (ESP_OK);
+}
+
+static esp_err_t file (httpd_req_t *request)
+{
+    handled = SERVICES;
+    context = request->user_ctx;
+
+    return (ESP_OK);
+}
+
+static Router::handler_t table[] =
+{
+    service<0>, service<1>, service<2>, service<3>, service<4>, service<5>, service<6>, service<7>, service<8>, service<9>,
+    service<10>, service<11>,
+};
+
+static_assert (sizeof (table) / sizeof (table[0]) == SERVICES, "one handler per service");
+
+// ---------
+// requests
+// ---------
+
+// allocated as the server does, the URI is fixed once the request is made
+static httpd_req_t *request (const std::string &uri)
+{
+    httpd_req_t *made = (httpd_req_t *) calloc (1, sizeof (httpd_req_t));
+
+    strncpy ((char *) made->uri, uri.c_str (), HTTPD_MAX_URI_LEN);
+
+    return (made);
+}
+
+static esp_err_t route (const std::string &uri)
+{
+    httpd_req_t *into = request (uri);
+    into->user_ctx = registered.user_ctx;
+
+    handled = -1;
+    context = NULL;
+
+    esp_err_t result = registered.handler (into);
+    free (into);
+
+    return (result);
+}
+
+static void check (void)
+{
+    for (int loop = 0; loop < SERVICES; loop++)
+    {
+        route (services[loop]);
+        if (handled != loop)
+        {
+            fail (services[loop], "not sent to its handler");
+        }
+
+        route (std::string (services[loop]) + "?profile=low&x=1");
+        if (handled != loop)
+        {
+            fail (services[loop], "not sent to its handler with a query string");
+        }
+    }
+
+    for (int slot = 0; slot < ASSET_SLOTS; slot++)
+    {
+        if (ASSETS[slot].uri == NULL)
+        {
+            continue;
+        }
+
+        route (ASSETS[slot].uri);
+        // the router's copy of the table, not this one
+        const asset_t *served = (const asset_t *) context;
+
+        if ((handled != SERVICES) || (served == NULL) || (strcmp (served->path, ASSETS[slot].path) != 0))
+        {
+            fail (ASSETS[slot].uri, "not served as its file");
+        }
+    }
+
+    const char *unknown[] = { "/nothing", "/statu", "/status/", "/index.htm", "/favicon", "/video2" };
+
+    for (const char *uri : unknown)
+    {
+        int before = missing;
+
+        route (uri);
+        if ((handled != -1) || (missing != before + 1))
+        {
+            fail (uri, "not a 404");
+        }
+    }
+}
+
+// the server's own dispatch: the handlers in registration order, the first match wins
+static esp_err_t walk (const std::vector<httpd_uri_t> &table, httpd_req_t *into)
+{
+    size_t length = strcspn (into->uri, "?");
+
+    for (const httpd_uri_t &entry : table)
+    {
+        if (httpd_uri_match_wildcard (entry.uri, into->uri, length))
+        {
+            into->user_ctx = entry.user_ctx;
+            return (entry.handler (into));
+        }
+    }
+
+    return (httpd_resp_send_404 (into));
+}
+
+int main (int argc, char *argv[])
+{
+    long repeat = 200000;
+    int option;
+
+    while ((option = getopt (argc, argv, "n:")) != -1)
+    {
+        switch (option)
+        {
+            case 'n':
+                repeat = std::max (1, atoi (optarg));
+                break;
+            default:
+                fprintf (stderr, "usage: %s [-n rounds]\n", argv[0]);
+                return (1);
+        }
+    }
+
+    Router router (file);
+    for (int loop = 0; loop < SERVICES; loop++)
+    {
+        router.add (services[loop], table[loop]);
+    }
+
+    router.register_with (NULL);
+    check ();
+
+    // the handlers the server walked, services first as they were registered
+    std::vector<httpd_uri_t> walked;
+    std::vector<std::string> uris;
+
+    for (int loop = 0; loop < SERVICES; loop++)
+    {
+        walked.push_back ({ services[loop], HTTP_GET, table[loop], NULL });
+        uris.push_back (services[loop]);
+    }
+
+    for (int slot = 0; slot < ASSET_SLOTS; slot++)
+    {
+        if (ASSETS[slot].uri)
+        {
+            walked.push_back ({ ASSETS[slot].uri, HTTP_GET, file, (void *) &ASSETS[slot] });
+            uris.push_back (ASSETS[slot].uri);
+        }
+    }
+
+    uris.push_back ("/video?profile=low");
+    uris.push_back ("/drive?left=50&right=-50");
+    uris.push_back ("/nothing");
+    uris.push_back ("/apple-touch-icon.png");
+
+    std::vector<httpd_req_t *> requests;
+    for (const std::string &uri : uris)
+    {
+        requests.push_back (request (uri));
+    }
+
+    // both ways over the same requests
+    double start = now ();
+    for (long round = 0; round < repeat; round++)
+    {
+        for (httpd_req_t *into : requests)
+        {
+            into->user_ctx = registered.user_ctx;
+            registered.handler (into);
+        }
+    }
+    double routed = (now () - start) / (repeat * requests.size ());
+
+    start = now ();
+    for (long round = 0; round < repeat; round++)
+    {
+        for (httpd_req_t *into : requests)
+        {
+            walk (walked, into);
+        }
+    }
+    double matched = (now () - start) / (repeat * requests.size ());
+
+    printf ("%d services, %d files, %d request URIs\n", SERVICES, (int) Router::assets (), (int) uris.size ());
+    printf ("  router       %8.1f ns a request\n", routed * 1e9);
+    printf ("  handler walk %8.1f ns a request, %zu handlers\n", matched * 1e9, walked.size ());
+
+    for (httpd_req_t *into : requests)
+    {
+        free (into);
+    }
+
+    printf ("%s\n", failures ? "FAILED" : "passed");
+
+    return (failures ? 1 : 0);
+}
@@ -0,0 +1,469 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+extern "C"
+{
+#include "sccb.h"
+#include "reg_shadow.h"
+#include "sensor.h"
+#include "ov2640.h"
+#include "ov3660.h"
+#include "ov5640.h"
+}
+
+//
+// Runs the OV2640, OV3660 and OV5640 drivers against a simulated SCCB bus
+// and counts the transactions each step of a camera's life costs: the
+// start-up the driver does in esp_camera_init, restoring saved settings
+// from NVS, a run of the adjustments a user makes from the web page, and
+// twenty resolution switches, four in five of them to a new size.
+// The bus time assumes 100 kHz and counts nine clocks per byte plus the
+// start and stop conditions of every phase. The delays the drivers wait
+// for the sensor to settle are added up instead of slept.
+//
+// The simulated sensor keeps a register file, selects the OV2640 register
+// bank through 0xFF, clears itself on a software reset and, like a sensor
+// running automatic exposure and gain, changes its exposure and gain
+// registers between steps. Afterwards every register the driver wrote is
+// read back through the driver and compared with the bus, so a register
+// cache that went stale shows up as a mismatch. The table writer the
+// OV3660 and OV5640 share is also checked to keep the bus writes in table
+// order around the registers it writes alone. It exits non-zero when a
+// register differs or the writes come out of order.
+//
+
+// -------
+// the bus
+// -------
+
+static struct
+{
+    bool banked;
+    std::map<uint16_t, uint8_t> registers;
+    std::set<uint16_t> written;
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t clocks;
+    uint32_t delay;
+} bus;
+
+// the register a transaction reaches, after the OV2640 bank select
+static uint16_t address (uint16_t reg)
+{
+    if (bus.banked && (reg != 0xff))
+    {
+        return (((bus.registers[0xff] & 0x01) << 8) | reg);
+    }
+
+    return (reg);
+}
+
+static void write (uint16_t reg, uint8_t data, int bytes)
+{
+    bus.writes++;
+    bus.clocks += (bytes + 1) * 9 + 2;
+
+    uint16_t target = address (reg);
+
+    // a software reset returns every register to its default
+    if ((bus.banked && (target == 0x112) && (data & 0x80)) || (!bus.banked && (target == 0x3008) && (data & 0x80)))
+    {
+        uint8_t bank = bus.registers[0xff];
+
+        bus.registers.clear ();
+        bus.registers[0xff] = bank;
+        data &= 0x7f;
+    }
+
+    bus.registers[target] = data;
+    bus.written.insert (target);
+}
+
+// a sequential write, the sensor increments the register after each byte
+static void burst (uint16_t reg, const uint8_t *data, size_t length)
+{
+    bus.writes++;
+    bus.clocks += (2 + length + 1) * 9 + 2;
+
+    for (size_t loop = 0; loop < length; loop++)
+    {
+        bus.registers[reg + loop] = data[loop];
+        bus.written.insert (reg + loop);
+    }
+}
+
+static uint8_t read (uint16_t reg, int bytes)
+{
+    bus.reads++;
+    bus.clocks += (bytes * 9 + 2) + (2 * 9 + 2);
+
+    return (bus.registers[address (reg)]);
+}
+
+// automatic exposure and gain at work
+static void expose (std::mt19937 &random)
+{
+    static const uint16_t wide[] = {0x3500, 0x3501, 0x3502, 0x350a, 0x350b};
+
+    if (bus.banked)
+    {
+        bus.registers[0x100] = random ();
+        bus.registers[0x110] = random ();
+        bus.registers[0x104] = (bus.registers[0x104] & 0xfc) | (random () & 0x03);
+        bus.registers[0x145] = (bus.registers[0x145] & 0xc0) | (random () & 0x3f);
+    }
+    else
+    {
+        for (uint16_t reg : wide)
+        {
+            bus.registers[reg] = random () & ((reg == 0x3500) ? 0x0f : 0xff);
+        }
+    }
+}
+
+extern "C"
+{
+
+int SCCB_Init (int pin_sda, int pin_scl)
+{
+    return (0);
+}
+
+uint8_t SCCB_Probe (void)
+{
+    return (0);
+}
+
+uint8_t SCCB_Probe_Address (uint8_t slv_addr)
+{
+    return (slv_addr);
+}
+
+uint8_t SCCB_Read (uint8_t slv_addr, uint8_t reg)
+{
+    return (read (reg, 2));
+}
+
+uint8_t SCCB_Write (uint8_t slv_addr, uint8_t reg, uint8_t data)
+{
+    write (reg, data, 3);
+    return (0);
+}
+
+uint8_t SCCB_Read16 (uint8_t slv_addr, uint16_t reg)
+{
+    return (read (reg, 3));
+}
+
+uint8_t SCCB_Write16 (uint8_t slv_addr, uint16_t reg, uint8_t data)
+{
+    write (reg, data, 4);
+    return (0);
+}
+
+uint8_t SCCB_Write16_Burst (uint8_t slv_addr, uint16_t reg, const uint8_t *data, size_t length)
+{
+    burst (reg, data, length);
+    return (0);
+}
+
+// the drivers' settling delays count towards the time instead of passing
+void vTaskDelay (TickType_t ticks)
+{
+    bus.delay += ticks * portTICK_PERIOD_MS;
+}
+
+esp_err_t xclk_timer_conf (int ledc_timer, int xclk_freq_hz)
+{
+    return (ESP_OK);
+}
+
+}
+
+// ---------
+// the steps
+// ---------
+
+struct count
+{
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t clocks;
+    uint32_t delay;
+};
+
+static count snapshot (void)
+{
+    count now = {bus.reads, bus.writes, bus.clocks, bus.delay};
+
+    return (now);
+}
+
+static void report (const char *step, const count &before)
+{
+    uint32_t reads = bus.reads - before.reads;
+    uint32_t writes = bus.writes - before.writes;
+    uint32_t clocks = bus.clocks - before.clocks;
+    uint32_t delay = bus.delay - before.delay;
+
+    printf ("  %-10s %6u reads %6u writes %8.1f ms bus %6u ms delay\n", step, reads, writes, clocks / 100.0, delay);
+}
+
+// what esp_camera_init and init_camera do once the sensor is known
+static void start (sensor_t *sensor, int (*init) (sensor_t *))
+{
+    init (sensor);
+    sensor->reset (sensor);
+    sensor->set_framesize (sensor, FRAMESIZE_VGA);
+    sensor->set_pixformat (sensor, PIXFORMAT_JPEG);
+
+    if (sensor->id.PID == OV2640_PID)
+    {
+        sensor->set_gainceiling (sensor, GAINCEILING_2X);
+        sensor->set_bpc (sensor, false);
+        sensor->set_wpc (sensor, true);
+        sensor->set_lenc (sensor, true);
+    }
+
+    sensor->set_quality (sensor, 12);
+    sensor->init_status (sensor);
+
+    sensor->set_hmirror (sensor, true);
+    sensor->set_vflip (sensor, true);
+}
+
+// what esp_camera_load_from_nvs does with the saved status
+static void restore (sensor_t *sensor)
+{
+    camera_status_t st = sensor->status;
+
+    sensor->set_ae_level (sensor, st.ae_level);
+    sensor->set_aec2 (sensor, st.aec2);
+    sensor->set_aec_value (sensor, st.aec_value);
+    sensor->set_agc_gain (sensor, st.agc_gain);
+    sensor->set_awb_gain (sensor, st.awb_gain);
+    sensor->set_bpc (sensor, st.bpc);
+    sensor->set_brightness (sensor, st.brightness);
+    sensor->set_colorbar (sensor, st.colorbar);
+    sensor->set_contrast (sensor, st.contrast);
+    sensor->set_dcw (sensor, st.dcw);
+    sensor->set_denoise (sensor, st.denoise);
+    sensor->set_exposure_ctrl (sensor, st.aec);
+    sensor->set_framesize (sensor, st.framesize);
+    sensor->set_gain_ctrl (sensor, st.agc);
+    sensor->set_gainceiling (sensor, (gainceiling_t) st.gainceiling);
+    sensor->set_hmirror (sensor, st.hmirror);
+    sensor->set_lenc (sensor, st.lenc);
+    sensor->set_quality (sensor, st.quality);
+    sensor->set_raw_gma (sensor, st.raw_gma);
+    sensor->set_saturation (sensor, st.saturation);
+    sensor->set_sharpness (sensor, st.sharpness);
+    sensor->set_special_effect (sensor, st.special_effect);
+    sensor->set_vflip (sensor, st.vflip);
+    sensor->set_wb_mode (sensor, st.wb_mode);
+    sensor->set_whitebal (sensor, st.awb);
+    sensor->set_wpc (sensor, st.wpc);
+}
+
+// a user working the image controls, with the exposure moving in between
+static void adjust (sensor_t *sensor, std::mt19937 &random, int rounds)
+{
+    for (int loop = 0; loop < rounds; loop++)
+    {
+        expose (random);
+
+        switch (random () % 8)
+        {
+            case 0: sensor->set_hmirror (sensor, random () & 1); break;
+            case 1: sensor->set_vflip (sensor, random () & 1); break;
+            case 2: sensor->set_whitebal (sensor, random () & 1); break;
+            case 3: sensor->set_awb_gain (sensor, random () & 1); break;
+            case 4: sensor->set_gain_ctrl (sensor, random () & 1); break;
+            case 5: sensor->set_exposure_ctrl (sensor, random () & 1); break;
+            case 6: sensor->set_lenc (sensor, random () & 1); break;
+            case 7: sensor->set_colorbar (sensor, random () & 1); break;
+        }
+
+        sensor->get_reg (sensor, (sensor->id.PID == OV2640_PID) ? 0x0c3 : 0x3821, 0xff);
+    }
+}
+
+// the viewer switching resolutions, and once to the one it already has
+static void resize (sensor_t *sensor, int rounds)
+{
+    static const framesize_t sizes[] = {FRAMESIZE_QVGA, FRAMESIZE_VGA, FRAMESIZE_SVGA, FRAMESIZE_VGA, FRAMESIZE_VGA};
+
+    for (int loop = 0; loop < rounds; loop++)
+    {
+        sensor->set_framesize (sensor, sizes[loop % (sizeof (sizes) / sizeof (sizes[0]))]);
+    }
+}
+
+// every register the driver wrote, as the driver sees it against the bus
+static int verify (sensor_t *sensor)
+{
+    int mismatches = 0;
+    std::set<uint16_t> written = bus.written;
+
+    for (uint16_t reg : written)
+    {
+        if (bus.banked && (reg == 0xff))
+        {
+            continue;
+        }
+
+        int seen = sensor->get_reg (sensor, reg, 0xff);
+        uint8_t actual = bus.registers[reg];
+
+        if ((seen & 0xff) != actual)
+        {
+            if (mismatches < 5)
+            {
+                printf ("  register 0x%04x reads 0x%02x, the sensor holds 0x%02x\n", reg, seen & 0xff, actual);
+            }
+            mismatches++;
+        }
+    }
+
+    return (mismatches);
+}
+
+// ----------------
+// the table writer
+// ----------------
+
+static std::string order;
+
+static int order_reg (uint8_t slv_addr, uint16_t reg, uint8_t value)
+{
+    char text[16];
+    snprintf (text, sizeof (text), "w%x ", reg);
+    order += text;
+
+    return (0);
+}
+
+static int order_burst (uint8_t slv_addr, uint16_t reg, const uint8_t *data, size_t length)
+{
+    char text[24];
+    snprintf (text, sizeof (text), "b%x+%zu ", reg, length);
+    order += text;
+
+    return (0);
+}
+
+static bool order_direct (uint16_t reg)
+{
+    return ((reg & 0xff) >= 0x80);
+}
+
+// a register written alone or a delay sends the burst before it, even one it would continue
+static int check_order (void)
+{
+    const uint16_t table[][2] =
+    {
+        { 0x10, 1 }, { 0x11, 2 }, { 0x12, 3 },
+        { 0x80, 4 }, { 0x81, 5 },
+        { 0x20, 6 }, { 0x21, 7 }, { 0xffff, 10 }, { 0x22, 8 },
+        { 0x7f, 9 }, { 0x80, 10 }, { 0x30, 11 },
+        { 0, 0 },
+    };
+    const char *expected = "b10+3 w80 w81 b20+2 b22+1 b7f+1 w80 b30+1 ";
+    const reg_shadow_writer_t writer = { order_reg, order_burst, order_direct };
+    reg_shadow_t *shadow = reg_shadow_create ();
+
+    order.clear ();
+    reg_shadow_write_regs (shadow, &writer, 0x3c, table, 0, 0xffff);
+    free (shadow);
+
+    printf ("table writer\n  %s\n", order.c_str ());
+    if (order != expected)
+    {
+        printf ("  out of order, expected\n  %s\n", expected);
+        return (1);
+    }
+
+    return (0);
+}
+
+static int run (const char *name, uint16_t pid, uint8_t slv_addr, int (*init) (sensor_t *), int rounds)
+{
+    std::mt19937 random (1);
+    sensor_t sensor;
+    count before;
+
+    memset (&sensor, 0, sizeof (sensor));
+    bus.banked = (pid == OV2640_PID);
+    bus.registers.clear ();
+    bus.written.clear ();
+
+    sensor.id.PID = pid;
+    sensor.slv_addr = slv_addr;
+    sensor.xclk_freq_hz = 20000000;
+    sensor.pixformat = PIXFORMAT_JPEG;
+    sensor.status.framesize = FRAMESIZE_VGA;
+
+    printf ("%s\n", name);
+
+    before = snapshot ();
+    start (&sensor, init);
+    report ("start", before);
+
+    expose (random);
+    before = snapshot ();
+    restore (&sensor);
+    report ("restore", before);
+
+    before = snapshot ();
+    adjust (&sensor, random, rounds);
+    report ("adjust", before);
+
+    before = snapshot ();
+    resize (&sensor, 20);
+    report ("framesize", before);
+
+    expose (random);
+    int mismatches = verify (&sensor);
+    printf ("  %d of %u written registers differ from the sensor\n", mismatches, (unsigned) bus.written.size ());
+
+    return (mismatches);
+}
+
+int main (int argc, char *argv[])
+{
+    int rounds = 200;
+    int option;
+
+    while ((option = getopt (argc, argv, "n:")) != -1)
+    {
+        switch (option)
+        {
+            case 'n':
+                rounds = atoi (optarg);
+                break;
+            default:
+                fprintf (stderr, "usage: %s [-n adjustments]\n", argv[0]);
+                return (1);
+        }
+    }
+
+    int failures = check_order ();
+
+    failures += run ("OV2640", OV2640_PID, 0x30, ov2640_init, rounds);
+    failures += run ("OV3660", OV3660_PID, 0x3c, ov3660_init, rounds);
+    failures += run ("OV5640", OV5640_PID, 0x3c, ov5640_init, rounds);
+
+    printf ("%s\n", failures ? "FAILED" : "passed");
+
+    return (failures ? 1 : 0);
+}
@@ -0,0 +1,426 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "Scheduler.h"
+
+//
+// Checks the Bluetooth command scheduler and simulates the link it feeds,
+// deterministically, in whole microseconds. The checks drive reserve, push,
+// front and release directly:
+//
+//   order     - commands leave stop first, then motor, tone and telemetry
+//   collapse  - a motor setpoint replaces the queued one of its port, but
+//               not the one being sent, and a stop drops them all
+//   congested - nothing leaves while the link is congested
+//   full      - a full class drops its oldest command and reports its key
+//
+// The simulation then runs a driver sending motor setpoints for both ports
+// every 20 ms, telemetry polls every 50 ms, a tone every second and a stop
+// every 500 ms, over a link that takes 1 ms a command and is congested for
+// 150 ms in every 400. It reports the latency of each class through the
+// scheduler and through one queue in arrival order, as the robot had, and
+// fails if a stop ever waits longer than the congestion it arrived in plus
+// the command already on the air. It exits non-zero on a failed check.
+//
+
+static int failures = 0;
+
+static void fail (const char *check, const char *message, long value)
+{
+    if (failures++ < 20)
+    {
+        printf ("FAIL: %s: %s (%ld)\n", check, message, value);
+    }
+}
+
+// a command of the length given, the NXT length prefix first, tagged
+static void command (uint8_t *data, int length, uint8_t tag, uint8_t value = 0)
+{
+    memset (data, 0, Scheduler::SIZE);
+    data[0] = (uint8_t) (length - 2);
+    data[1] = 0;
+    data[2] = tag;
+    data[3] = value;
+}
+
+static bool push (Scheduler &scheduler, int priority, uint8_t tag, uint8_t value = 0, int key = -1)
+{
+    uint8_t data[Scheduler::SIZE];
+
+    command (data, 8, tag, value);
+
+    return (scheduler.push (priority, data, key));
+}
+
+// the tag of the next command out, and sends it
+static int next (Scheduler &scheduler, uint8_t *value = NULL)
+{
+    uint16_t length = 0;
+    uint8_t *data = scheduler.front (&length);
+
+    if (data == NULL)
+    {
+        return (-1);
+    }
+
+    int tag = data[2];
+    if (value)
+    {
+        *value = data[3];
+    }
+
+    scheduler.release ();
+
+    return (tag);
+}
+
+static void check_order (void)
+{
+    Scheduler scheduler;
+
+    push (scheduler, Scheduler::TELEMETRY, 'T');
+    push (scheduler, Scheduler::TONE, 'B');
+    push (scheduler, Scheduler::MOTOR, 'M', 0, 0);
+    push (scheduler, Scheduler::TELEMETRY, 't');
+    push (scheduler, Scheduler::MOTOR, 'm', 0, 1);
+
+    // a stop goes ahead of all of them, once the one on the air has gone
+    if (next (scheduler) != 'M')
+    {
+        fail ("order", "motor setpoint not ahead of tones and telemetry", 0);
+    }
+
+    push (scheduler, Scheduler::STOP, 'S');
+
+    const char *expected = "SBTt";
+    for (const char *tag = expected; *tag; tag++)
+    {
+        int got = next (scheduler);
+
+        if (got != *tag)
+        {
+            fail ("order", "command out of priority order", got);
+        }
+    }
+
+    if (!scheduler.empty () || (next (scheduler) != -1))
+    {
+        fail ("order", "commands left over", 0);
+    }
+}
+
+static void check_collapse (void)
+{
+    Scheduler scheduler;
+    uint8_t value = 0;
+
+    // the newest setpoint of each port, in the place of the first
+    push (scheduler, Scheduler::MOTOR, 'L', 10, 1);
+    push (scheduler, Scheduler::MOTOR, 'R', 20, 2);
+    push (scheduler, Scheduler::MOTOR, 'L', 30, 1);
+    push (scheduler, Scheduler::MOTOR, 'L', 40, 1);
+
+    if (scheduler.collapsed () != 2)
+    {
+        fail ("collapse", "setpoints collapsed", scheduler.collapsed ());
+    }
+
+    if ((next (scheduler, &value) != 'L') || (value != 40) || (next (scheduler, &value) != 'R') || (value != 20)
+            || !scheduler.empty ())
+    {
+        fail ("collapse", "not the newest setpoint of each port", value);
+    }
+
+    // the setpoint on the air stays as it is, the next one queues behind it
+    uint16_t length = 0;
+    push (scheduler, Scheduler::MOTOR, 'L', 50, 1);
+    uint8_t *sending = scheduler.front (&length);
+    push (scheduler, Scheduler::MOTOR, 'L', 60, 1);
+
+    if ((sending == NULL) || (sending[3] != 50))
+    {
+        fail ("collapse", "the command being sent was replaced", sending ? sending[3] : -1);
+    }
+
+    scheduler.release ();
+    if ((next (scheduler, &value) != 'L') || (value != 60))
+    {
+        fail ("collapse", "setpoint behind the one being sent lost", value);
+    }
+
+    // a stop drops every setpoint still waiting
+    push (scheduler, Scheduler::MOTOR, 'L', 70, 1);
+    push (scheduler, Scheduler::MOTOR, 'R', 80, 2);
+    push (scheduler, Scheduler::STOP, 'S');
+
+    if ((next (scheduler) != 'S') || !scheduler.empty ())
+    {
+        fail ("collapse", "setpoints left behind a stop", 0);
+    }
+}
+
+static void check_congested (void)
+{
+    Scheduler scheduler;
+    uint16_t length = 0;
+
+    push (scheduler, Scheduler::STOP, 'S');
+    scheduler.congested (true);
+
+    if (scheduler.front (&length) || (length != 0))
+    {
+        fail ("congested", "a command left while congested", length);
+    }
+
+    scheduler.congested (false);
+
+    if ((scheduler.front (&length) == NULL) || (length != 8))
+    {
+        fail ("congested", "the command did not leave afterwards", length);
+    }
+}
+
+static void check_full (void)
+{
+    Scheduler scheduler;
+
+    for (int loop = 0; loop < Scheduler::DEPTH + 3; loop++)
+    {
+        push (scheduler, Scheduler::TELEMETRY, 'T', loop);
+    }
+
+    uint8_t value = 0;
+    if ((scheduler.dropped () != 3) || (next (scheduler, &value) != 'T') || (value != 3))
+    {
+        fail ("full", "not the oldest commands dropped", value);
+    }
+
+    // the key of the dropped command comes back, so a poll can be cancelled
+    uint8_t data[Scheduler::SIZE];
+    int dropped = 0;
+
+    command (data, 8, 'K');
+    scheduler.clear ();
+    for (int loop = 0; loop < Scheduler::DEPTH; loop++)
+    {
+        scheduler.push (Scheduler::TELEMETRY, data, 0x100 + loop, &dropped);
+        if (dropped != -1)
+        {
+            fail ("full", "a drop reported with room left", dropped);
+        }
+    }
+
+    scheduler.push (Scheduler::TELEMETRY, data, 0x200, &dropped);
+    if (dropped != 0x100)
+    {
+        fail ("full", "not the key of the dropped command", dropped);
+    }
+}
+
+// ----------
+// simulation
+// ----------
+
+struct command_sent
+{
+    int priority;
+    long queued;
+};
+
+struct latency
+{
+    std::vector<long> samples;
+
+    void add (long value)
+    {
+        samples.push_back (value);
+    }
+    long percentile (int percent)
+    {
+        if (samples.empty ())
+        {
+            return (0);
+        }
+
+        std::vector<long> sorted (samples);
+        std::sort (sorted.begin (), sorted.end ());
+
+        return (sorted[std::min (sorted.size () - 1, sorted.size () * percent / 100)]);
+    }
+    long worst (void)
+    {
+        return (samples.empty () ? 0 : *std::max_element (samples.begin (), samples.end ()));
+    }
+};
+
+static const char *names[Scheduler::CLASSES] = { "stop", "motor", "tone", "telemetry" };
+
+//
+// one simulated run, through the scheduler or in arrival order; the time
+// a command is queued is written into it, as the stack would see it
+//
+static void simulate (bool prioritized, long duration, long transmit, long period, long congestion, latency *latencies,
+        long *stop_bound)
+{
+    Scheduler scheduler;
+    std::vector<command_sent> fifo;
+    long busy_until = 0;
+    long stop_waiting = -1;
+    uint16_t length = 0;
+
+    *stop_bound = 0;
+
+    for (long now = 0; now < duration; now++)
+    {
+        bool congested = (now % period) < congestion;
+        long congestion_end = now - (now % period) + congestion;
+
+        // the driver and the telemetry poller
+        struct
+        {
+            int priority;
+            long every;
+            long offset;
+            int key;
+        } sources[] =
+        {
+            { Scheduler::MOTOR, 20000, 0, 0 },
+            { Scheduler::MOTOR, 20000, 0, 1 },
+            { Scheduler::TELEMETRY, 50000, 3000, 2 },
+            { Scheduler::TELEMETRY, 50000, 3000, 3 },
+            { Scheduler::TONE, 1000000, 7000, -1 },
+            { Scheduler::STOP, 500000, 251000, -1 },
+        };
+
+        for (const auto &source : sources)
+        {
+            if ((now % source.every) != source.offset)
+            {
+                continue;
+            }
+
+            if (prioritized)
+            {
+                uint8_t data[Scheduler::SIZE];
+
+                command (data, 16, source.priority);
+                memcpy (&data[4], &now, sizeof (now));
+                scheduler.push (source.priority, data, source.key);
+            }
+            else
+            {
+                fifo.push_back ({ source.priority, now });
+            }
+
+            // the longest a stop may wait: what is left of the congestion and the command on the air
+            if (source.priority == Scheduler::STOP)
+            {
+                stop_waiting = (congested ? congestion_end : now) + std::max (0L, busy_until - now) + transmit;
+            }
+        }
+
+        scheduler.congested (congested);
+
+        if (now < busy_until)
+        {
+            continue;
+        }
+
+        int priority = -1;
+        long queued = 0;
+
+        if (prioritized)
+        {
+            uint8_t *data = scheduler.front (&length);
+
+            if (data)
+            {
+                priority = data[2];
+                memcpy (&queued, &data[4], sizeof (queued));
+                scheduler.release ();
+            }
+        }
+        else if (!congested && !fifo.empty ())
+        {
+            priority = fifo.front ().priority;
+            queued = fifo.front ().queued;
+            fifo.erase (fifo.begin ());
+        }
+
+        if (priority < 0)
+        {
+            continue;
+        }
+
+        busy_until = now + transmit;
+        latencies[priority].add (busy_until - queued);
+
+        if ((priority == Scheduler::STOP) && (stop_waiting >= 0))
+        {
+            *stop_bound = std::max (*stop_bound, busy_until - stop_waiting);
+            stop_waiting = -1;
+        }
+    }
+}
+
+int main (int argc, char *argv[])
+{
+    long duration = 60;
+    int option;
+
+    while ((option = getopt (argc, argv, "s:")) != -1)
+    {
+        switch (option)
+        {
+            case 's':
+                duration = std::max (1, atoi (optarg));
+                break;
+            default:
+                fprintf (stderr, "usage: %s [-s simulated seconds]\n", argv[0]);
+                return (1);
+        }
+    }
+
+    check_order ();
+    check_collapse ();
+    check_congested ();
+    check_full ();
+
+    printf ("link 1 ms a command, congested 150 ms in every 400, %ld s simulated\n", duration);
+    printf ("  %-10s %29s   %29s\n", "", "scheduled p50 / p99 / max ms", "arrival order p50 / p99 / max ms");
+
+    latency scheduled[Scheduler::CLASSES];
+    latency arrival[Scheduler::CLASSES];
+    long stop_bound = 0;
+    long unused = 0;
+
+    simulate (true, duration * 1000000, 1000, 400000, 150000, scheduled, &stop_bound);
+    simulate (false, duration * 1000000, 1000, 400000, 150000, arrival, &unused);
+
+    for (int priority = 0; priority < Scheduler::CLASSES; priority++)
+    {
+        printf ("  %-10s %9.1f %9.1f %9.1f   %9.1f %9.1f %9.1f\n", names[priority],
+                scheduled[priority].percentile (50) / 1000.0, scheduled[priority].percentile (99) / 1000.0,
+                scheduled[priority].worst () / 1000.0, arrival[priority].percentile (50) / 1000.0,
+                arrival[priority].percentile (99) / 1000.0, arrival[priority].worst () / 1000.0);
+    }
+
+    if (scheduled[Scheduler::STOP].samples.empty ())
+    {
+        fail ("simulation", "no stop was sent", 0);
+    }
+
+    if (stop_bound > 0)
+    {
+        fail ("simulation", "a stop waited behind other commands, us", stop_bound);
+    }
+
+    printf ("%s\n", failures ? "FAILED" : "passed");
+
+    return (failures ? 1 : 0);
+}
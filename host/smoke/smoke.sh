@@ -0,0 +1,67 @@
+#!/bin/sh
+#
+# Starts the host build on a copy of the filesystem and checks that /, /status,
+# /open, /robot and /video all answer once the simulated robot has connected.
+#
+# smoke.sh build-host/mindbridge filesystem [port]
+#
+
+server=$1
+filesystem=$2
+port=${3:-18178}
+url=http://localhost:$port
+
+work=$(mktemp -d)
+trap 'kill $pid 2> /dev/null; wait $pid 2> /dev/null; rm -rf "$work"' EXIT
+
+cp -r "$filesystem" "$work/filesystem"
+
+MINDBRIDGE_FILESYSTEM="$work/filesystem" MINDBRIDGE_PORT=$port MINDBRIDGE_LOG=warn "$server" > "$work/log" 2>&1 &
+pid=$!
+
+# the robot connects a moment after the server starts
+for attempt in $(seq 1 30)
+do
+    if curl -s --max-time 1 $url/status | grep -q '"connected": 1'
+    then
+        break
+    fi
+
+    if [ $attempt -eq 30 ]
+    then
+        echo "FAIL: the robot never connected"
+        cat "$work/log"
+        exit 1
+    fi
+
+    sleep 0.5
+done
+
+failed=0
+
+for path in / /status /open /robot
+do
+    code=$(curl -s -o /dev/null -w '%{http_code}' --max-time 3 $url$path)
+
+    if [ "$code" != 200 ]
+    then
+        echo "FAIL: $path answered $code"
+        failed=1
+    fi
+done
+
+# a stream never ends, the first frame is enough
+if ! curl -s --max-time 2 $url/video | head -c 4096 | grep -a -q 'Content-Type: image/jpeg'
+then
+    echo "FAIL: /video sent no frame"
+    failed=1
+fi
+
+if [ $failed -ne 0 ]
+then
+    cat "$work/log"
+    echo "FAILED"
+    exit 1
+fi
+
+echo "passed"
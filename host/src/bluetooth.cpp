@@ -0,0 +1,600 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "esp_bt.h"
+#include "esp_bt_device.h"
+#include "esp_bt_main.h"
+#include "esp_gap_bt_api.h"
+#include "esp_log.h"
+#include "esp_spp_api.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+#include "NXT.h"
+
+static const char *TAG = "bluetooth";
+
+// the link handle and address of the simulated robot
+#define ROBOT_HANDLE    (0x81)
+
+static const esp_bd_addr_t robot_address = { 0x00, 0x16, 0x53, 0x0a, 0x0b, 0x0c };
+
+// -----------------
+// callback delivery
+// -----------------
+
+//
+// all callbacks run on one thread in the order they are due, standing in
+// for the Bluetooth task of the target
+//
+static std::mutex mutex;
+static std::condition_variable changed;
+static std::multimap<int64_t, std::function<void ()> > events;
+static bool started = false;
+
+static void *event_task (void *argument)
+{
+    (void) argument;
+
+    std::unique_lock<std::mutex> lock (mutex);
+
+    while (true)
+    {
+        if (events.empty ())
+        {
+            changed.wait (lock);
+            continue;
+        }
+
+        int64_t wait = events.begin ()->first - esp_timer_get_time ();
+        if (wait > 0)
+        {
+            changed.wait_for (lock, std::chrono::microseconds (wait));
+            continue;
+        }
+
+        std::function<void ()> event = events.begin ()->second;
+        events.erase (events.begin ());
+
+        lock.unlock ();
+        event ();
+        lock.lock ();
+    }
+
+    return (NULL);
+}
+
+static void post (int64_t delay, std::function<void ()> event)
+{
+    std::lock_guard<std::mutex> lock (mutex);
+
+    if (!started)
+    {
+        pthread_t thread;
+
+        pthread_create (&thread, NULL, event_task, NULL);
+        pthread_detach (thread);
+        started = true;
+    }
+
+    // events due at the same time keep their order
+    events.insert (std::make_pair (esp_timer_get_time () + delay, event));
+    changed.notify_one ();
+}
+
+static int64_t setting (const char *name, int64_t fallback)
+{
+    const char *value = getenv (name);
+
+    return ((value != NULL) ? atoll (value) : fallback);
+}
+
+// ----------------
+// simulated robot
+// ----------------
+
+//
+// The robot answers the direct commands the bridge uses. Motors turn at a
+// rate proportional to their power, input port 1 reads a slowly varying
+// light level and the battery drains a little with every motor command.
+//
+static struct
+{
+    std::string name;
+    int64_t latency;
+    int8_t power[3];
+    uint8_t mode[3];
+    uint8_t state[3];
+    double tacho[3];
+    int64_t updated;
+    uint16_t battery;
+} robot;
+
+static void robot_init (void)
+{
+    const char *name = getenv ("MINDBRIDGE_ROBOT_NAME");
+
+    robot.name = (name != NULL) ? name : CONFIG_MINDBRIDGE_ROBOT_SPP_NAME;
+    robot.latency = setting ("MINDBRIDGE_ROBOT_LATENCY", 30) * 1000;
+    robot.updated = esp_timer_get_time ();
+    robot.battery = 8200;
+}
+
+static void robot_update (void)
+{
+    int64_t now = esp_timer_get_time ();
+    double seconds = (now - robot.updated) / 1e6;
+
+    // about 900 degrees per second at full power
+    for (int port = 0; port < 3; port++)
+    {
+        if (robot.mode[port] & nxt::MOTORON)
+        {
+            robot.tacho[port] += robot.power[port] * 9.0 * seconds;
+        }
+    }
+
+    robot.updated = now;
+}
+
+//
+// build the reply to a direct command, returns its size or zero if the
+// command does not get one
+//
+static size_t robot_reply (const uint8_t *command, uint8_t *reply)
+{
+    uint8_t type = command[2];
+    uint8_t opcode = command[3];
+
+    if (type & nxt::NO_REPLY)
+    {
+        if (opcode == nxt::SetOutputState::opcode)
+        {
+            uint8_t port = command[4];
+
+            if (port < 3)
+            {
+                robot_update ();
+                robot.power[port] = (int8_t) command[5];
+                robot.mode[port] = command[6];
+                robot.state[port] = command[9];
+                robot.battery = (robot.battery > 6500) ? robot.battery - 1 : robot.battery;
+            }
+        }
+
+        return (0);
+    }
+
+    size_t size = nxt::reply_size (opcode);
+    if (size == 0)
+    {
+        // unknown to the bridge as well, answer with status only
+        size = nxt::HEADER + 3;
+    }
+
+    memset (reply, 0, size);
+    nxt::store<uint16_t> (reply, size - nxt::HEADER);
+    reply[2] = nxt::REPLY;
+    reply[3] = opcode;
+    reply[4] = 0;
+
+    uint8_t *fields = reply + nxt::HEADER + 3;
+    uint8_t port = command[4];
+
+    switch (opcode)
+    {
+        case nxt::OutputState::opcode:
+            if (port < 3)
+            {
+                robot_update ();
+
+                int32_t count = (int32_t) robot.tacho[port];
+                nxt::put (fields, port, robot.power[port], robot.mode[port], (uint8_t) 0, (int8_t) 0,
+                        robot.state[port], (uint32_t) 0, count, count, count);
+            }
+            else
+            {
+                reply[4] = 0xc0;
+            }
+            break;
+        case nxt::InputValues::opcode:
+            if (port < 4)
+            {
+                // a light sensor on port 1, nothing on the others
+                bool light = (port == 0);
+                double level = 0.5 + 0.4 * sin (esp_timer_get_time () / 1e6);
+                uint16_t raw = light ? (uint16_t) (1023 * (1.0 - level)) : 1023;
+                int16_t scaled = light ? (int16_t) (100 * level) : 0;
+
+                nxt::put (fields, port, (uint8_t) 1, (uint8_t) 0, (uint8_t) (light ? 0x05 : 0x00),
+                        (uint8_t) (light ? 0x80 : 0x00), raw, raw, scaled, scaled);
+            }
+            else
+            {
+                reply[4] = 0xc0;
+            }
+            break;
+        case nxt::BatteryLevel::opcode:
+            nxt::put (fields, robot.battery);
+            break;
+        case nxt::SleepTime::opcode:
+            nxt::put (fields, (uint32_t) 600000);
+            break;
+        default:
+            break;
+    }
+
+    return (size);
+}
+
+// ----------
+// controller
+// ----------
+
+esp_err_t esp_bt_controller_mem_release (esp_bt_mode_t mode)
+{
+    (void) mode;
+
+    return (ESP_OK);
+}
+
+esp_err_t esp_bt_controller_init (esp_bt_controller_config_t *config)
+{
+    (void) config;
+
+    robot_init ();
+
+    return (ESP_OK);
+}
+
+esp_err_t esp_bt_controller_enable (esp_bt_mode_t mode)
+{
+    (void) mode;
+
+    return (ESP_OK);
+}
+
+esp_err_t esp_bt_controller_disable (void)
+{
+    return (ESP_OK);
+}
+
+esp_err_t esp_bluedroid_init (void)
+{
+    return (ESP_OK);
+}
+
+esp_err_t esp_bluedroid_enable (void)
+{
+    return (ESP_OK);
+}
+
+esp_err_t esp_bluedroid_disable (void)
+{
+    return (ESP_OK);
+}
+
+esp_err_t esp_bluedroid_deinit (void)
+{
+    return (ESP_OK);
+}
+
+esp_err_t esp_bt_dev_set_device_name (const char *name)
+{
+    (void) name;
+
+    return (ESP_OK);
+}
+
+// ---
+// GAP
+// ---
+
+static esp_bt_gap_cb_t gap_callback = NULL;
+static std::atomic<bool> discovering (false);
+static std::atomic<bool> connected (false);
+
+esp_err_t esp_bt_gap_register_callback (esp_bt_gap_cb_t callback)
+{
+    gap_callback = callback;
+
+    return (ESP_OK);
+}
+
+esp_err_t esp_bt_gap_set_scan_mode (esp_bt_connection_mode_t c_mode, esp_bt_discovery_mode_t d_mode)
+{
+    (void) c_mode;
+    (void) d_mode;
+
+    return (ESP_OK);
+}
+
+esp_err_t esp_bt_gap_start_discovery (esp_bt_inq_mode_t mode, uint8_t inq_len, uint8_t num_rsps)
+{
+    (void) mode;
+    (void) inq_len;
+    (void) num_rsps;
+
+    if (discovering || connected)
+    {
+        return (ESP_OK);
+    }
+
+    discovering = true;
+
+    // the robot answers the inquiry with its name
+    post (100 * 1000, [] ()
+    {
+        esp_bt_gap_cb_param_t param;
+        esp_bt_gap_dev_prop_t property;
+        char name[ESP_BT_GAP_MAX_BDNAME_LEN + 1];
+
+        snprintf (name, sizeof (name), "%s", robot.name.c_str ());
+
+        property.type = ESP_BT_GAP_DEV_PROP_BDNAME;
+        property.len = strlen (name);
+        property.val = name;
+
+        memset (&param, 0, sizeof (param));
+        memcpy (param.disc_res.bda, robot_address, ESP_BD_ADDR_LEN);
+        param.disc_res.num_prop = 1;
+        param.disc_res.prop = &property;
+
+        if (gap_callback && discovering)
+        {
+            gap_callback (ESP_BT_GAP_DISC_RES_EVT, &param);
+        }
+    });
+
+    return (ESP_OK);
+}
+
+esp_err_t esp_bt_gap_cancel_discovery (void)
+{
+    discovering = false;
+
+    return (ESP_OK);
+}
+
+uint8_t *esp_bt_gap_resolve_eir_data (uint8_t *eir, esp_bt_eir_type_t type, uint8_t *length)
+{
+    (void) eir;
+    (void) type;
+
+    // discovery results carry the plain name rather than extended inquiry data
+    *length = 0;
+
+    return (NULL);
+}
+
+esp_err_t esp_bt_gap_set_security_param (esp_bt_sp_param_t param_type, void *value, uint8_t len)
+{
+    (void) param_type;
+    (void) value;
+    (void) len;
+
+    return (ESP_OK);
+}
+
+esp_err_t esp_bt_gap_set_pin (esp_bt_pin_type_t pin_type, uint8_t pin_code_len, esp_bt_pin_code_t pin_code)
+{
+    (void) pin_type;
+    (void) pin_code_len;
+    (void) pin_code;
+
+    return (ESP_OK);
+}
+
+esp_err_t esp_bt_gap_pin_reply (esp_bd_addr_t bd_addr, bool accept, uint8_t pin_code_len, esp_bt_pin_code_t pin_code)
+{
+    (void) bd_addr;
+    (void) accept;
+    (void) pin_code_len;
+    (void) pin_code;
+
+    return (ESP_OK);
+}
+
+esp_err_t esp_bt_gap_ssp_confirm_reply (esp_bd_addr_t bd_addr, bool accept)
+{
+    (void) bd_addr;
+    (void) accept;
+
+    return (ESP_OK);
+}
+
+// ---
+// SPP
+// ---
+
+static esp_spp_cb_t *spp_callback = NULL;
+static std::atomic<bool> opening (false);
+
+static void spp_event (esp_spp_cb_event_t event, esp_spp_cb_param_t *param)
+{
+    if (spp_callback)
+    {
+        spp_callback (event, param);
+    }
+}
+
+esp_err_t esp_spp_register_callback (esp_spp_cb_t *callback)
+{
+    spp_callback = callback;
+
+    return (ESP_OK);
+}
+
+esp_err_t esp_spp_init (esp_spp_mode_t mode)
+{
+    if (mode != ESP_SPP_MODE_CB)
+    {
+        return (ESP_ERR_NOT_SUPPORTED);
+    }
+
+    post (0, [] ()
+    {
+        esp_spp_cb_param_t param;
+
+        memset (&param, 0, sizeof (param));
+        param.init.status = ESP_SPP_SUCCESS;
+        spp_event (ESP_SPP_INIT_EVT, &param);
+    });
+
+    return (ESP_OK);
+}
+
+esp_err_t esp_spp_deinit (void)
+{
+    return (ESP_OK);
+}
+
+esp_err_t esp_spp_start_discovery (esp_bd_addr_t bd_addr)
+{
+    bool found = (memcmp (bd_addr, robot_address, ESP_BD_ADDR_LEN) == 0);
+
+    post (50 * 1000, [found] ()
+    {
+        esp_spp_cb_param_t param;
+
+        memset (&param, 0, sizeof (param));
+        param.disc_comp.status = found ? ESP_SPP_SUCCESS : ESP_SPP_FAILURE;
+        param.disc_comp.scn_num = found ? 1 : 0;
+        param.disc_comp.scn[0] = 1;
+        spp_event (ESP_SPP_DISCOVERY_COMP_EVT, &param);
+    });
+
+    return (ESP_OK);
+}
+
+esp_err_t esp_spp_connect (esp_spp_sec_t sec_mask, esp_spp_role_t role, uint8_t remote_scn, esp_bd_addr_t peer_bd_addr)
+{
+    (void) sec_mask;
+    (void) role;
+    (void) remote_scn;
+
+    if (memcmp (peer_bd_addr, robot_address, ESP_BD_ADDR_LEN) != 0)
+    {
+        return (ESP_FAIL);
+    }
+
+    // the bridge asks twice, the link opens once
+    if (opening || connected)
+    {
+        return (ESP_OK);
+    }
+
+    opening = true;
+
+    post (200 * 1000, [] ()
+    {
+        esp_spp_cb_param_t param;
+
+        opening = false;
+        connected = true;
+        discovering = false;
+
+        memset (&param, 0, sizeof (param));
+        param.open.status = ESP_SPP_SUCCESS;
+        param.open.handle = ROBOT_HANDLE;
+        memcpy (param.open.rem_bda, robot_address, ESP_BD_ADDR_LEN);
+        spp_event (ESP_SPP_OPEN_EVT, &param);
+
+        ESP_LOGI (TAG, "simulated robot %s connected", robot.name.c_str ());
+    });
+
+    return (ESP_OK);
+}
+
+esp_err_t esp_spp_disconnect (uint32_t handle)
+{
+    if (!connected || (handle != ROBOT_HANDLE))
+    {
+        return (ESP_FAIL);
+    }
+
+    post (0, [] ()
+    {
+        esp_spp_cb_param_t param;
+
+        connected = false;
+
+        memset (&param, 0, sizeof (param));
+        param.close.status = ESP_SPP_SUCCESS;
+        param.close.handle = ROBOT_HANDLE;
+        spp_event (ESP_SPP_CLOSE_EVT, &param);
+    });
+
+    return (ESP_OK);
+}
+
+esp_err_t esp_spp_write (uint32_t handle, int len, uint8_t *p_data)
+{
+    if (!connected || (handle != ROBOT_HANDLE))
+    {
+        return (ESP_FAIL);
+    }
+
+    std::vector<uint8_t> command (p_data, p_data + len);
+
+    post (0, [len] ()
+    {
+        esp_spp_cb_param_t param;
+
+        memset (&param, 0, sizeof (param));
+        param.write.status = ESP_SPP_SUCCESS;
+        param.write.handle = ROBOT_HANDLE;
+        param.write.len = len;
+        param.write.cong = false;
+        spp_event (ESP_SPP_WRITE_EVT, &param);
+    });
+
+    // the robot handles the command once it has crossed the link
+    post (robot.latency / 2, [command] ()
+    {
+        uint8_t *reply = new uint8_t[nxt::HEADER + nxt::MAXIMUM];
+        size_t size = 0;
+
+        if ((command.size () >= 4) && connected)
+        {
+            size = robot_reply (command.data (), reply);
+        }
+
+        if (size == 0)
+        {
+            delete[] reply;
+            return;
+        }
+
+        post (robot.latency / 2, [reply, size] ()
+        {
+            esp_spp_cb_param_t param;
+
+            memset (&param, 0, sizeof (param));
+            param.data_ind.status = ESP_SPP_SUCCESS;
+            param.data_ind.handle = ROBOT_HANDLE;
+            param.data_ind.len = size;
+            param.data_ind.data = reply;
+
+            if (connected)
+            {
+                spp_event (ESP_SPP_DATA_IND_EVT, &param);
+            }
+
+            delete[] reply;
+        });
+    });
+
+    return (ESP_OK);
+}
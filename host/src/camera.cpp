@@ -0,0 +1,437 @@
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "camera_trace.h"
+#include "esp_camera.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "jpge.h"
+
+static const char *TAG = "camera";
+
+// ------
+// frames
+// ------
+
+//
+// The camera either replays the JPEG files found in MINDBRIDGE_FRAMES, in
+// name order, or encodes one second of a moving test pattern at the
+// configured frame size and quality. Frames are delivered at MINDBRIDGE_FPS
+// (default 25) and at most fb_count of them are out at once, so a slow
+// reader blocks the way it does on the target.
+//
+// Like the driver, a new frame size or quality takes effect with the next
+// frame taken; the pattern is encoded one frame at a time as it is needed.
+//
+typedef std::shared_ptr<std::vector<uint8_t> > frame_data;
+
+static struct
+{
+    std::mutex mutex;
+    std::condition_variable returned;
+    camera_config_t config;
+    sensor_t sensor;
+    std::vector<frame_data> frames;
+    bool files;
+    framesize_t framesize;
+    int quality;
+    size_t max_width;
+    size_t max_height;
+    size_t next;
+    size_t out;
+    int64_t period;
+    int64_t last;
+    uint32_t frame_count;
+} camera;
+
+// a frame buffer, the number of the frame it holds and its data
+struct frame_buffer
+{
+    camera_fb_t fb;
+    uint32_t frame;
+    frame_data data;
+};
+
+class vector_stream : public jpge::output_stream
+{
+    public:
+        vector_stream (std::vector<uint8_t> &output) : _output (output)
+        {
+        }
+        virtual bool put_buf (const void *buffer, int length)
+        {
+            if (buffer)
+            {
+                _output.insert (_output.end (), (const uint8_t *) buffer, (const uint8_t *) buffer + length);
+            }
+
+            return (true);
+        }
+        virtual jpge::uint get_size () const
+        {
+            return (_output.size ());
+        }
+    private:
+        std::vector<uint8_t> &_output;
+};
+
+// colour bars with a white square crossing them
+static void pattern (uint8_t *line, int width, int height, int row, int frame, int frames)
+{
+    static const uint8_t bars[7][3] =
+    {
+        { 192, 192, 192 }, { 192, 192, 0 }, { 0, 192, 192 }, { 0, 192, 0 },
+        { 192, 0, 192 }, { 192, 0, 0 }, { 0, 0, 192 }
+    };
+
+    int size = height / 4;
+    int x = (width - size) * frame / frames;
+    int y = (height - size) / 2;
+
+    for (int column = 0; column < width; column++)
+    {
+        const uint8_t *colour = bars[column * 7 / width];
+        bool square = (column >= x) && (column < x + size) && (row >= y) && (row < y + size);
+
+        line[column * 3 + 0] = square ? 255 : colour[0];
+        line[column * 3 + 1] = square ? 255 : colour[1];
+        line[column * 3 + 2] = square ? 255 : colour[2];
+    }
+}
+
+static bool encode_pattern (framesize_t size, int quality, int frame, int count, std::vector<uint8_t> &output)
+{
+    int width = resolution[size].width;
+    int height = resolution[size].height;
+
+    // sensor quality runs from 0 (best) to 63, the encoder's from 100 (best) to 1
+    jpge::params parameters;
+    parameters.m_quality = std::max (1, 100 - (quality * 100) / 64);
+    parameters.m_subsampling = jpge::H2V2;
+
+    std::vector<uint8_t> line (width * 3);
+    vector_stream stream (output);
+    jpge::jpeg_encoder encoder;
+
+    if (!encoder.init (&stream, width, height, 3, parameters))
+    {
+        return (false);
+    }
+
+    for (int row = 0; row < height; row++)
+    {
+        pattern (line.data (), width, height, row, frame, count);
+
+        if (!encoder.process_scanline (line.data ()))
+        {
+            return (false);
+        }
+    }
+
+    return (encoder.process_scanline (NULL));
+}
+
+static bool load_files (const char *directory)
+{
+    std::vector<std::string> names;
+
+    DIR *entries = opendir (directory);
+    if (entries == NULL)
+    {
+        return (false);
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir (entries)) != NULL)
+    {
+        const char *dot = strrchr (entry->d_name, '.');
+
+        if (dot && ((strcasecmp (dot, ".jpg") == 0) || (strcasecmp (dot, ".jpeg") == 0)))
+        {
+            names.push_back (std::string (directory) + "/" + entry->d_name);
+        }
+    }
+
+    closedir (entries);
+    std::sort (names.begin (), names.end ());
+
+    for (size_t loop = 0; loop < names.size (); loop++)
+    {
+        FILE *file = fopen (names[loop].c_str (), "rb");
+        if (file == NULL)
+        {
+            continue;
+        }
+
+        std::vector<uint8_t> frame;
+        uint8_t buffer[4096];
+        size_t bytes;
+
+        while ((bytes = fread (buffer, 1, sizeof (buffer), file)) > 0)
+        {
+            frame.insert (frame.end (), buffer, buffer + bytes);
+        }
+
+        fclose (file);
+        camera.frames.push_back (std::make_shared<std::vector<uint8_t> > (frame));
+    }
+
+    ESP_LOGI (TAG, "%u frames from %s", (unsigned) camera.frames.size (), directory);
+
+    return (!camera.frames.empty ());
+}
+
+// ------
+// sensor
+// ------
+
+// the frame buffers are sized for the larger of frame_size and max_frame_size
+static bool framesize_fits (framesize_t framesize)
+{
+    size_t width = resolution[framesize].width;
+    size_t height = resolution[framesize].height;
+
+    return ((width <= camera.max_width) && (width * height <= camera.max_width * camera.max_height));
+}
+
+static int sensor_framesize (sensor_t *sensor, framesize_t framesize)
+{
+    if ((framesize >= FRAMESIZE_INVALID) || camera.files || !framesize_fits (framesize))
+    {
+        return (-1);
+    }
+
+    std::lock_guard<std::mutex> lock (camera.mutex);
+    sensor->status.framesize = framesize;
+
+    return (0);
+}
+
+static int sensor_quality (sensor_t *sensor, int quality)
+{
+    if ((quality < 0) || (quality > 63) || camera.files)
+    {
+        return (-1);
+    }
+
+    std::lock_guard<std::mutex> lock (camera.mutex);
+    sensor->status.quality = quality;
+
+    return (0);
+}
+
+static int sensor_hmirror (sensor_t *sensor, int enable)
+{
+    sensor->status.hmirror = enable;
+
+    return (0);
+}
+
+static int sensor_vflip (sensor_t *sensor, int enable)
+{
+    sensor->status.vflip = enable;
+
+    return (0);
+}
+
+// ---
+// API
+// ---
+
+esp_err_t esp_camera_init (const camera_config_t *config)
+{
+    if (config->pixel_format != PIXFORMAT_JPEG)
+    {
+        return (ESP_ERR_CAMERA_NOT_SUPPORTED);
+    }
+
+    const char *fps = getenv ("MINDBRIDGE_FPS");
+    const char *directory = getenv ("MINDBRIDGE_FRAMES");
+
+    camera.config = *config;
+    camera.period = 1000000 / ((fps != NULL) ? std::max (1, atoi (fps)) : 25);
+    camera.last = 0;
+    camera.out = 0;
+    camera.files = (directory != NULL);
+    camera.framesize = config->frame_size;
+    camera.quality = config->jpeg_quality;
+    camera.max_width = std::max (resolution[config->frame_size].width, resolution[config->max_frame_size].width);
+    camera.max_height = std::max (resolution[config->frame_size].height, resolution[config->max_frame_size].height);
+    camera.frames.clear ();
+    camera.next = 0;
+
+    memset (&camera.sensor, 0, sizeof (camera.sensor));
+    camera.sensor.id.PID = OV2640_PID;
+    camera.sensor.pixformat = config->pixel_format;
+    camera.sensor.xclk_freq_hz = config->xclk_freq_hz;
+    camera.sensor.status.framesize = config->frame_size;
+    camera.sensor.status.quality = config->jpeg_quality;
+    camera.sensor.set_framesize = sensor_framesize;
+    camera.sensor.set_quality = sensor_quality;
+    camera.sensor.set_hmirror = sensor_hmirror;
+    camera.sensor.set_vflip = sensor_vflip;
+
+    if (camera.files)
+    {
+        if (!load_files (directory))
+        {
+            ESP_LOGE (TAG, "no frames to deliver");
+            return (ESP_ERR_CAMERA_NOT_DETECTED);
+        }
+    }
+    else
+    {
+        camera.frames.resize (1000000 / camera.period);
+
+        ESP_LOGI (TAG, "%u test frames of %dx%d", (unsigned) camera.frames.size (),
+                resolution[camera.framesize].width, resolution[camera.framesize].height);
+    }
+
+    return (ESP_OK);
+}
+
+esp_err_t esp_camera_init_from_nvs (const camera_config_t *config, const char *key)
+{
+    // there is no sensor to probe, nor NVS to remember it in
+    (void) key;
+
+    return (esp_camera_init (config));
+}
+
+esp_err_t esp_camera_deinit ()
+{
+    std::lock_guard<std::mutex> lock (camera.mutex);
+    camera.frames.clear ();
+
+    return (ESP_OK);
+}
+
+camera_fb_t *esp_camera_fb_get ()
+{
+    std::unique_lock<std::mutex> lock (camera.mutex);
+
+    if (camera.frames.empty ())
+    {
+        return (NULL);
+    }
+
+    // every frame buffer is out, wait for one to come back
+    while (camera.out >= std::max ((size_t) 1, camera.config.fb_count))
+    {
+        camera.returned.wait (lock);
+    }
+
+    camera.out++;
+
+    // the next frame is the one that starts after the previous was taken
+    int64_t due = camera.last + camera.period;
+    int64_t now = esp_timer_get_time ();
+
+    if (due > now)
+    {
+        lock.unlock ();
+
+        struct timespec pause = { (time_t) ((due - now) / 1000000), (long) ((due - now) % 1000000) * 1000 };
+        nanosleep (&pause, NULL);
+
+        lock.lock ();
+        now = esp_timer_get_time ();
+    }
+
+    camera.last = now;
+
+    // the sensor was switched since the last frame, the pattern follows
+    if (!camera.files && ((camera.framesize != camera.sensor.status.framesize) || (camera.quality != camera.sensor.status.quality)))
+    {
+        camera.framesize = camera.sensor.status.framesize;
+        camera.quality = camera.sensor.status.quality;
+
+        for (size_t loop = 0; loop < camera.frames.size (); loop++)
+        {
+            camera.frames[loop].reset ();
+        }
+    }
+
+    size_t index = camera.next;
+    camera.next = (camera.next + 1) % camera.frames.size ();
+
+    if (!camera.frames[index])
+    {
+        frame_data frame = std::make_shared<std::vector<uint8_t> > ();
+
+        if (!encode_pattern (camera.framesize, camera.quality, index, camera.frames.size (), *frame))
+        {
+            camera.out--;
+            return (NULL);
+        }
+
+        camera.frames[index] = frame;
+    }
+
+    // the frame is captured and filtered the moment it is due
+    frame_buffer *buffer = new frame_buffer;
+    buffer->frame = ++camera.frame_count;
+    buffer->data = camera.frames[index];
+
+    camera_trace (CAMERA_TRACE_VSYNC, buffer->frame);
+    camera_trace (CAMERA_TRACE_DMA_DONE, buffer->frame);
+    camera_trace (CAMERA_TRACE_FB_DONE, buffer->frame);
+    camera_trace (CAMERA_TRACE_FB_GET, buffer->frame);
+
+    camera_fb_t *fb = &buffer->fb;
+    fb->buf = buffer->data->data ();
+    fb->len = buffer->data->size ();
+    fb->width = resolution[camera.framesize].width;
+    fb->height = resolution[camera.framesize].height;
+    fb->format = PIXFORMAT_JPEG;
+    fb->timestamp.tv_sec = now / 1000000;
+    fb->timestamp.tv_usec = now % 1000000;
+
+    return (fb);
+}
+
+void esp_camera_fb_return (camera_fb_t *fb)
+{
+    std::lock_guard<std::mutex> lock (camera.mutex);
+
+    delete (frame_buffer *) fb;
+
+    camera.out--;
+    camera.returned.notify_one ();
+}
+
+uint32_t camera_trace_frame (const camera_fb_t *fb)
+{
+    return (((const frame_buffer *) fb)->frame);
+}
+
+sensor_t *esp_camera_sensor_get ()
+{
+    return (&camera.sensor);
+}
+
+esp_err_t esp_camera_save_to_nvs (const char *key)
+{
+    // nothing to keep the settings in, as if they were kept
+    (void) key;
+
+    return (ESP_OK);
+}
+
+esp_err_t esp_camera_load_from_nvs (const char *key)
+{
+    (void) key;
+
+    return (ESP_ERR_NOT_SUPPORTED);
+}
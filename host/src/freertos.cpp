@@ -0,0 +1,541 @@
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <string>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+// -------
+// waiting
+// -------
+
+// condition variables timed against the monotonic clock
+static void condition_init (pthread_cond_t *condition)
+{
+    pthread_condattr_t attributes;
+
+    pthread_condattr_init (&attributes);
+    pthread_condattr_setclock (&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init (condition, &attributes);
+    pthread_condattr_destroy (&attributes);
+}
+
+static struct timespec deadline (TickType_t ticks)
+{
+    struct timespec now;
+    clock_gettime (CLOCK_MONOTONIC, &now);
+
+    uint64_t msec = (uint64_t) ticks * portTICK_PERIOD_MS;
+
+    now.tv_sec += msec / 1000;
+    now.tv_nsec += (msec % 1000) * 1000000;
+    if (now.tv_nsec >= 1000000000)
+    {
+        now.tv_sec++;
+        now.tv_nsec -= 1000000000;
+    }
+
+    return (now);
+}
+
+//
+// wait on a condition until it is signalled or the deadline passes, returns
+// false on timeout; the caller holds the mutex and re-checks its predicate
+//
+static bool wait (pthread_cond_t *condition, pthread_mutex_t *mutex, TickType_t ticks, const struct timespec *until)
+{
+    if (ticks == portMAX_DELAY)
+    {
+        pthread_cond_wait (condition, mutex);
+        return (true);
+    }
+
+    return (pthread_cond_timedwait (condition, mutex, until) != ETIMEDOUT);
+}
+
+// -----------------
+// critical sections
+// -----------------
+
+void vPortEnterCritical (portMUX_TYPE *mux)
+{
+    pthread_mutex_lock (&mux->mutex);
+}
+
+void vPortExitCritical (portMUX_TYPE *mux)
+{
+    pthread_mutex_unlock (&mux->mutex);
+}
+
+// -----
+// tasks
+// -----
+
+struct host_task
+{
+    pthread_t thread;
+    std::string name;
+    TaskFunction_t function;
+    void *parameters;
+    pthread_mutex_t mutex;
+    pthread_cond_t condition;
+    uint32_t notifications;
+};
+
+static thread_local host_task *current = NULL;
+
+static host_task *task_create (const char *name)
+{
+    host_task *task = new host_task;
+
+    task->name = name;
+    task->function = NULL;
+    task->parameters = NULL;
+    task->notifications = 0;
+    pthread_mutex_init (&task->mutex, NULL);
+    condition_init (&task->condition);
+
+    return (task);
+}
+
+static void *task_entry (void *argument)
+{
+    host_task *task = (host_task *) argument;
+
+    current = task;
+    task->function (task->parameters);
+
+    // a FreeRTOS task must not return, treat it as deleting itself
+    vTaskDelete (NULL);
+
+    return (NULL);
+}
+
+BaseType_t xTaskCreatePinnedToCore (TaskFunction_t function, const char *name, uint32_t stack,
+        void *parameters, UBaseType_t priority, TaskHandle_t *created, BaseType_t core)
+{
+    (void) priority;
+    (void) core;
+
+    host_task *task = task_create (name);
+    task->function = function;
+    task->parameters = parameters;
+
+    // the handle is valid before the task runs, as on the target
+    if (created)
+    {
+        *created = task;
+    }
+
+    pthread_attr_t attributes;
+    pthread_attr_init (&attributes);
+    pthread_attr_setdetachstate (&attributes, PTHREAD_CREATE_DETACHED);
+
+    // task stacks are sized for the target, leave room for host libraries
+    pthread_attr_setstacksize (&attributes, (stack < 65536) ? 65536 : stack);
+
+    int result = pthread_create (&task->thread, &attributes, task_entry, task);
+    pthread_attr_destroy (&attributes);
+
+    if (result != 0)
+    {
+        if (created)
+        {
+            *created = NULL;
+        }
+
+        delete task;
+        return (pdFAIL);
+    }
+
+    return (pdPASS);
+}
+
+void vTaskDelete (TaskHandle_t task)
+{
+    if ((task == NULL) || (task == current))
+    {
+        pthread_exit (NULL);
+    }
+
+    // other threads cannot be stopped safely, the task keeps running detached
+}
+
+void vTaskDelay (TickType_t ticks)
+{
+    if (ticks == 0)
+    {
+        sched_yield ();
+        return;
+    }
+
+    struct timespec until = deadline (ticks);
+
+    while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) == EINTR)
+    {
+    }
+}
+
+// wakes a period after the last wake, at once when that has passed
+void vTaskDelayUntil (TickType_t *previous, TickType_t increment)
+{
+    TickType_t now = xTaskGetTickCount ();
+    TickType_t wake = *previous + increment;
+
+    *previous = wake;
+
+    if ((TickType_t) (wake - now) <= increment)
+    {
+        vTaskDelay (wake - now);
+    }
+}
+
+TickType_t xTaskGetTickCount (void)
+{
+    struct timespec now;
+    clock_gettime (CLOCK_MONOTONIC, &now);
+
+    uint64_t msec = (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+
+    return ((TickType_t) (msec / portTICK_PERIOD_MS));
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle (void)
+{
+    // threads not created as tasks, like the one running app_main, get a handle on first use
+    if (current == NULL)
+    {
+        current = task_create ("main");
+        current->thread = pthread_self ();
+    }
+
+    return (current);
+}
+
+const char *pcTaskGetTaskName (TaskHandle_t task)
+{
+    if (task == NULL)
+    {
+        task = xTaskGetCurrentTaskHandle ();
+    }
+
+    return (task->name.c_str ());
+}
+
+uint32_t ulTaskNotifyTake (BaseType_t clear, TickType_t ticks)
+{
+    host_task *task = xTaskGetCurrentTaskHandle ();
+    struct timespec until = deadline (ticks);
+
+    pthread_mutex_lock (&task->mutex);
+
+    while ((task->notifications == 0) && (ticks > 0))
+    {
+        if (!wait (&task->condition, &task->mutex, ticks, &until))
+        {
+            break;
+        }
+    }
+
+    uint32_t value = task->notifications;
+    if (value > 0)
+    {
+        task->notifications = clear ? 0 : value - 1;
+    }
+
+    pthread_mutex_unlock (&task->mutex);
+
+    return (value);
+}
+
+BaseType_t xTaskNotifyGive (TaskHandle_t task)
+{
+    pthread_mutex_lock (&task->mutex);
+    task->notifications++;
+    pthread_cond_signal (&task->condition);
+    pthread_mutex_unlock (&task->mutex);
+
+    return (pdPASS);
+}
+
+void vTaskNotifyGiveFromISR (TaskHandle_t task, BaseType_t *woken)
+{
+    xTaskNotifyGive (task);
+
+    if (woken)
+    {
+        *woken = pdFALSE;
+    }
+}
+
+// ------
+// queues
+// ------
+
+struct host_queue
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t readable;
+    pthread_cond_t writable;
+    UBaseType_t length;
+    UBaseType_t size;
+    UBaseType_t head;
+    UBaseType_t count;
+    uint8_t *items;
+};
+
+QueueHandle_t xQueueCreate (UBaseType_t length, UBaseType_t size)
+{
+    if (length == 0)
+    {
+        return (NULL);
+    }
+
+    host_queue *queue = new host_queue;
+
+    pthread_mutex_init (&queue->mutex, NULL);
+    condition_init (&queue->readable);
+    condition_init (&queue->writable);
+    queue->length = length;
+    queue->size = size;
+    queue->head = 0;
+    queue->count = 0;
+    queue->items = (size > 0) ? (uint8_t *) malloc (length * size) : NULL;
+
+    return (queue);
+}
+
+QueueHandle_t xQueueCreateCountingSemaphore (UBaseType_t maximum, UBaseType_t initial)
+{
+    host_queue *queue = xQueueCreate (maximum, 0);
+
+    if (queue)
+    {
+        queue->count = (initial < maximum) ? initial : maximum;
+    }
+
+    return (queue);
+}
+
+void vQueueDelete (QueueHandle_t queue)
+{
+    pthread_mutex_destroy (&queue->mutex);
+    pthread_cond_destroy (&queue->readable);
+    pthread_cond_destroy (&queue->writable);
+    free (queue->items);
+
+    delete queue;
+}
+
+BaseType_t xQueueGenericSend (QueueHandle_t queue, const void *item, TickType_t ticks, BaseType_t front)
+{
+    struct timespec until = deadline (ticks);
+
+    pthread_mutex_lock (&queue->mutex);
+
+    while (queue->count == queue->length)
+    {
+        if ((ticks == 0) || !wait (&queue->writable, &queue->mutex, ticks, &until))
+        {
+            pthread_mutex_unlock (&queue->mutex);
+            return (pdFAIL);
+        }
+    }
+
+    UBaseType_t slot = 0;
+    if (front)
+    {
+        queue->head = (queue->head + queue->length - 1) % queue->length;
+        slot = queue->head;
+    }
+    else
+    {
+        slot = (queue->head + queue->count) % queue->length;
+    }
+
+    if (queue->size > 0)
+    {
+        memcpy (queue->items + slot * queue->size, item, queue->size);
+    }
+
+    queue->count++;
+
+    pthread_cond_signal (&queue->readable);
+    pthread_mutex_unlock (&queue->mutex);
+
+    return (pdPASS);
+}
+
+static BaseType_t queue_read (QueueHandle_t queue, void *item, TickType_t ticks, bool remove)
+{
+    struct timespec until = deadline (ticks);
+
+    pthread_mutex_lock (&queue->mutex);
+
+    while (queue->count == 0)
+    {
+        if ((ticks == 0) || !wait (&queue->readable, &queue->mutex, ticks, &until))
+        {
+            pthread_mutex_unlock (&queue->mutex);
+            return (pdFAIL);
+        }
+    }
+
+    if ((queue->size > 0) && item)
+    {
+        memcpy (item, queue->items + queue->head * queue->size, queue->size);
+    }
+
+    if (remove)
+    {
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+
+        pthread_cond_signal (&queue->writable);
+    }
+
+    pthread_mutex_unlock (&queue->mutex);
+
+    return (pdPASS);
+}
+
+BaseType_t xQueueReceive (QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    return (queue_read (queue, item, ticks, true));
+}
+
+BaseType_t xQueuePeek (QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    return (queue_read (queue, item, ticks, false));
+}
+
+BaseType_t xQueueReset (QueueHandle_t queue)
+{
+    pthread_mutex_lock (&queue->mutex);
+    queue->head = 0;
+    queue->count = 0;
+    pthread_cond_broadcast (&queue->writable);
+    pthread_mutex_unlock (&queue->mutex);
+
+    return (pdPASS);
+}
+
+UBaseType_t uxQueueMessagesWaiting (QueueHandle_t queue)
+{
+    pthread_mutex_lock (&queue->mutex);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock (&queue->mutex);
+
+    return (count);
+}
+
+UBaseType_t uxQueueSpacesAvailable (QueueHandle_t queue)
+{
+    pthread_mutex_lock (&queue->mutex);
+    UBaseType_t spaces = queue->length - queue->count;
+    pthread_mutex_unlock (&queue->mutex);
+
+    return (spaces);
+}
+
+// ------------
+// event groups
+// ------------
+
+struct host_event_group
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t condition;
+    EventBits_t bits;
+};
+
+EventGroupHandle_t xEventGroupCreate (void)
+{
+    host_event_group *group = new host_event_group;
+
+    pthread_mutex_init (&group->mutex, NULL);
+    condition_init (&group->condition);
+    group->bits = 0;
+
+    return (group);
+}
+
+void vEventGroupDelete (EventGroupHandle_t group)
+{
+    pthread_mutex_destroy (&group->mutex);
+    pthread_cond_destroy (&group->condition);
+
+    delete group;
+}
+
+EventBits_t xEventGroupSetBits (EventGroupHandle_t group, EventBits_t bits)
+{
+    pthread_mutex_lock (&group->mutex);
+    group->bits |= bits;
+    EventBits_t value = group->bits;
+    pthread_cond_broadcast (&group->condition);
+    pthread_mutex_unlock (&group->mutex);
+
+    return (value);
+}
+
+EventBits_t xEventGroupClearBits (EventGroupHandle_t group, EventBits_t bits)
+{
+    pthread_mutex_lock (&group->mutex);
+    EventBits_t value = group->bits;
+    group->bits &= ~bits;
+    pthread_mutex_unlock (&group->mutex);
+
+    return (value);
+}
+
+EventBits_t xEventGroupGetBits (EventGroupHandle_t group)
+{
+    pthread_mutex_lock (&group->mutex);
+    EventBits_t value = group->bits;
+    pthread_mutex_unlock (&group->mutex);
+
+    return (value);
+}
+
+EventBits_t xEventGroupWaitBits (EventGroupHandle_t group, EventBits_t bits, BaseType_t clear,
+        BaseType_t all, TickType_t ticks)
+{
+    struct timespec until = deadline (ticks);
+
+    pthread_mutex_lock (&group->mutex);
+
+    while (true)
+    {
+        EventBits_t set = group->bits & bits;
+
+        if (all ? (set == bits) : (set != 0))
+        {
+            break;
+        }
+
+        if ((ticks == 0) || !wait (&group->condition, &group->mutex, ticks, &until))
+        {
+            break;
+        }
+    }
+
+    // the bits as they were before any clearing, as FreeRTOS reports them
+    EventBits_t value = group->bits;
+
+    if (clear && (all ? ((value & bits) == bits) : ((value & bits) != 0)))
+    {
+        group->bits &= ~bits;
+    }
+
+    pthread_mutex_unlock (&group->mutex);
+
+    return (value);
+}
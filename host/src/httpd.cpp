@@ -0,0 +1,1104 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "esp_http_server.h"
+#include "esp_log.h"
+
+static const char *TAG = "httpd";
+
+// ------
+// server
+// ------
+
+struct session
+{
+    int fd;
+    uint64_t used;              // least recently used ordering
+    std::string input;          // received and not yet parsed
+};
+
+struct work
+{
+    httpd_work_fn_t function;
+    void *argument;
+};
+
+struct server
+{
+    httpd_config_t config;
+    int listener;
+    int wake[2];
+    pthread_t thread;
+    bool running;
+    uint64_t clock;
+    std::vector<httpd_uri_t> handlers;
+    std::vector<session> sessions;
+    std::mutex mutex;
+    std::deque<work> queue;
+};
+
+//
+// per request state, reached through httpd_req_t::aux
+//
+struct request
+{
+    server *owner;
+    session *client;
+    std::vector<std::string> lines;         // request header lines
+    size_t remaining;                       // body bytes not yet read
+    const char *status;
+    const char *type;
+    std::vector<std::pair<const char *, const char *> > headers;
+    bool started;                           // headers of a chunked response sent
+};
+
+uint16_t httpd_host_port (void)
+{
+    const char *setting = getenv ("MINDBRIDGE_PORT");
+
+    return ((setting != NULL) ? (uint16_t) atoi (setting) : 8080);
+}
+
+const char *http_method_str (enum http_method method)
+{
+    switch (method)
+    {
+        case HTTP_DELETE:
+            return ("DELETE");
+        case HTTP_GET:
+            return ("GET");
+        case HTTP_HEAD:
+            return ("HEAD");
+        case HTTP_POST:
+            return ("POST");
+        case HTTP_PUT:
+            return ("PUT");
+        case HTTP_CONNECT:
+            return ("CONNECT");
+        case HTTP_OPTIONS:
+            return ("OPTIONS");
+        case HTTP_TRACE:
+            return ("TRACE");
+        case HTTP_PATCH:
+            return ("PATCH");
+        default:
+            return ("<unknown>");
+    }
+}
+
+static int method_from_string (const std::string &name)
+{
+    const http_method methods[] = { HTTP_DELETE, HTTP_GET, HTTP_HEAD, HTTP_POST, HTTP_PUT,
+        HTTP_CONNECT, HTTP_OPTIONS, HTTP_TRACE, HTTP_PATCH };
+
+    for (size_t loop = 0; loop < sizeof (methods) / sizeof (methods[0]); loop++)
+    {
+        if (name == http_method_str (methods[loop]))
+        {
+            return (methods[loop]);
+        }
+    }
+
+    return (-1);
+}
+
+// -------
+// sockets
+// -------
+
+int httpd_default_send (httpd_handle_t hd, int sockfd, const char *buf, size_t buf_len, int flags)
+{
+    (void) hd;
+
+    if (buf == NULL)
+    {
+        return (HTTPD_SOCK_ERR_INVALID);
+    }
+
+    ssize_t sent = send (sockfd, buf, buf_len, flags | MSG_NOSIGNAL);
+    if (sent < 0)
+    {
+        return (((errno == EAGAIN) || (errno == EWOULDBLOCK)) ? HTTPD_SOCK_ERR_TIMEOUT : HTTPD_SOCK_ERR_FAIL);
+    }
+
+    return ((int) sent);
+}
+
+int httpd_default_recv (httpd_handle_t hd, int sockfd, char *buf, size_t buf_len, int flags)
+{
+    (void) hd;
+
+    if (buf == NULL)
+    {
+        return (HTTPD_SOCK_ERR_INVALID);
+    }
+
+    ssize_t received = recv (sockfd, buf, buf_len, flags);
+    if (received < 0)
+    {
+        return (((errno == EAGAIN) || (errno == EWOULDBLOCK)) ? HTTPD_SOCK_ERR_TIMEOUT : HTTPD_SOCK_ERR_FAIL);
+    }
+
+    return ((int) received);
+}
+
+static esp_err_t send_all (server *owner, int fd, const char *data, size_t length)
+{
+    while (length > 0)
+    {
+        int sent = httpd_default_send (owner, fd, data, length, 0);
+        if (sent <= 0)
+        {
+            return (ESP_ERR_HTTPD_RESP_SEND);
+        }
+
+        data += sent;
+        length -= sent;
+    }
+
+    return (ESP_OK);
+}
+
+static void close_session (server *owner, size_t index)
+{
+    int fd = owner->sessions[index].fd;
+
+    if (owner->config.close_fn)
+    {
+        owner->config.close_fn (owner, fd);
+    }
+    else
+    {
+        close (fd);
+    }
+
+    owner->sessions.erase (owner->sessions.begin () + index);
+}
+
+static int find_session (server *owner, int fd)
+{
+    for (size_t loop = 0; loop < owner->sessions.size (); loop++)
+    {
+        if (owner->sessions[loop].fd == fd)
+        {
+            return ((int) loop);
+        }
+    }
+
+    return (-1);
+}
+
+static void accept_session (server *owner)
+{
+    int fd = accept (owner->listener, NULL, NULL);
+    if (fd < 0)
+    {
+        return;
+    }
+
+    // with LRU purge enabled, a new connection displaces the idlest session
+    if (owner->sessions.size () >= owner->config.max_open_sockets)
+    {
+        size_t oldest = 0;
+
+        for (size_t loop = 1; loop < owner->sessions.size (); loop++)
+        {
+            if (owner->sessions[loop].used < owner->sessions[oldest].used)
+            {
+                oldest = loop;
+            }
+        }
+
+        ESP_LOGD (TAG, "purging least recently used session %d", owner->sessions[oldest].fd);
+        close_session (owner, oldest);
+    }
+
+    struct timeval timeout;
+
+    timeout.tv_sec = owner->config.recv_wait_timeout;
+    timeout.tv_usec = 0;
+    setsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout));
+
+    timeout.tv_sec = owner->config.send_wait_timeout;
+    setsockopt (fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof (timeout));
+
+    if (owner->config.open_fn && (owner->config.open_fn (owner, fd) != ESP_OK))
+    {
+        close (fd);
+        return;
+    }
+
+    session client;
+    client.fd = fd;
+    client.used = ++owner->clock;
+    owner->sessions.push_back (client);
+}
+
+// --------
+// requests
+// --------
+
+static const char *error_status (httpd_err_code_t error)
+{
+    switch (error)
+    {
+        case HTTPD_501_METHOD_NOT_IMPLEMENTED:
+            return ("501 Method Not Implemented");
+        case HTTPD_505_VERSION_NOT_SUPPORTED:
+            return ("505 Version Not Supported");
+        case HTTPD_400_BAD_REQUEST:
+            return ("400 Bad Request");
+        case HTTPD_404_NOT_FOUND:
+            return ("404 Not Found");
+        case HTTPD_405_METHOD_NOT_ALLOWED:
+            return ("405 Method Not Allowed");
+        case HTTPD_408_REQ_TIMEOUT:
+            return ("408 Request Timeout");
+        case HTTPD_411_LENGTH_REQUIRED:
+            return ("411 Length Required");
+        case HTTPD_414_URI_TOO_LONG:
+            return ("414 URI Too Long");
+        case HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE:
+            return ("431 Request Header Fields Too Large");
+        default:
+            return ("500 Internal Server Error");
+    }
+}
+
+static const char *error_message (httpd_err_code_t error)
+{
+    switch (error)
+    {
+        case HTTPD_501_METHOD_NOT_IMPLEMENTED:
+            return ("Request method is not supported by server");
+        case HTTPD_505_VERSION_NOT_SUPPORTED:
+            return ("HTTP version not supported by server");
+        case HTTPD_400_BAD_REQUEST:
+            return ("Server unable to understand request due to invalid syntax");
+        case HTTPD_404_NOT_FOUND:
+            return ("This URI does not exist");
+        case HTTPD_405_METHOD_NOT_ALLOWED:
+            return ("Request method for this URI is not handled by server");
+        case HTTPD_408_REQ_TIMEOUT:
+            return ("Server closed this connection");
+        case HTTPD_414_URI_TOO_LONG:
+            return ("URI is too long for server to interpret");
+        case HTTPD_411_LENGTH_REQUIRED:
+            return ("Chunked encoding not supported by server");
+        case HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE:
+            return ("Header fields are too long for server to interpret");
+        default:
+            return ("Server has encountered an unexpected error");
+    }
+}
+
+//
+// send an error response outside of a handler, for requests that could not
+// be parsed or routed
+//
+static void send_error (server *owner, int fd, httpd_err_code_t error)
+{
+    char response[256];
+    const char *message = error_message (error);
+
+    snprintf (response, sizeof (response),
+            "HTTP/1.1 %s\r\nContent-Type: text/html\r\nContent-Length: %u\r\n\r\n%s",
+            error_status (error), (unsigned) strlen (message), message);
+
+    send_all (owner, fd, response, strlen (response));
+}
+
+//
+// read until the header block is complete, blocking for at most the
+// receive timeout like the target's server task does
+//
+static httpd_err_code_t read_header (server *owner, session &client, size_t *end)
+{
+    while (true)
+    {
+        size_t found = client.input.find ("\r\n\r\n");
+        if (found != std::string::npos)
+        {
+            *end = found + 4;
+            return ((found + 4 > HTTPD_MAX_REQ_HDR_LEN) ? HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE : HTTPD_ERR_CODE_MAX);
+        }
+
+        if (client.input.size () > HTTPD_MAX_REQ_HDR_LEN)
+        {
+            return (HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE);
+        }
+
+        char buffer[512];
+        int received = httpd_default_recv (owner, client.fd, buffer, sizeof (buffer), 0);
+
+        if (received == HTTPD_SOCK_ERR_TIMEOUT)
+        {
+            return (HTTPD_408_REQ_TIMEOUT);
+        }
+
+        if (received <= 0)
+        {
+            return (HTTPD_500_INTERNAL_SERVER_ERROR);
+        }
+
+        client.input.append (buffer, received);
+    }
+}
+
+static const httpd_uri_t *find_handler (server *owner, const char *uri, size_t length, int method, bool *exists)
+{
+    *exists = false;
+
+    for (size_t loop = 0; loop < owner->handlers.size (); loop++)
+    {
+        const httpd_uri_t &handler = owner->handlers[loop];
+        bool match = false;
+
+        if (owner->config.uri_match_fn)
+        {
+            match = owner->config.uri_match_fn (handler.uri, uri, length);
+        }
+        else
+        {
+            match = (strlen (handler.uri) == length) && (strncmp (handler.uri, uri, length) == 0);
+        }
+
+        if (match)
+        {
+            *exists = true;
+
+            if ((int) handler.method == method)
+            {
+                return (&handler);
+            }
+        }
+    }
+
+    return (NULL);
+}
+
+//
+// parse and dispatch one request, returns false if the session is to be closed
+//
+static bool process_request (server *owner, size_t index)
+{
+    session &client = owner->sessions[index];
+    size_t end = 0;
+
+    httpd_err_code_t error = read_header (owner, client, &end);
+    if (error != HTTPD_ERR_CODE_MAX)
+    {
+        if (error != HTTPD_500_INTERNAL_SERVER_ERROR)
+        {
+            send_error (owner, client.fd, error);
+        }
+
+        return (false);
+    }
+
+    std::string header = client.input.substr (0, end - 4);
+    client.input.erase (0, end);
+
+    request state;
+    state.owner = owner;
+    state.client = &client;
+    state.remaining = 0;
+    state.status = HTTPD_200;
+    state.type = HTTPD_TYPE_TEXT;
+    state.started = false;
+
+    size_t start = 0;
+    while (start <= header.size ())
+    {
+        size_t stop = header.find ("\r\n", start);
+        if (stop == std::string::npos)
+        {
+            stop = header.size ();
+        }
+
+        state.lines.push_back (header.substr (start, stop - start));
+        start = stop + 2;
+    }
+
+    // request line: method, URI and version
+    const std::string &line = state.lines[0];
+    size_t first = line.find (' ');
+    size_t second = line.rfind (' ');
+
+    if ((first == std::string::npos) || (second == first) || (line.compare (second + 1, 5, "HTTP/") != 0))
+    {
+        send_error (owner, client.fd, HTTPD_400_BAD_REQUEST);
+        return (false);
+    }
+
+    std::string uri = line.substr (first + 1, second - first - 1);
+    int method = method_from_string (line.substr (0, first));
+
+    if (method < 0)
+    {
+        send_error (owner, client.fd, HTTPD_501_METHOD_NOT_IMPLEMENTED);
+        return (false);
+    }
+
+    if (uri.size () > HTTPD_MAX_URI_LEN)
+    {
+        send_error (owner, client.fd, HTTPD_414_URI_TOO_LONG);
+        return (false);
+    }
+
+    httpd_req_t *r = (httpd_req_t *) calloc (1, sizeof (httpd_req_t));
+    r->handle = owner;
+    r->method = method;
+    strcpy ((char *) r->uri, uri.c_str ());
+    r->aux = &state;
+
+    char length[16];
+    if (httpd_req_get_hdr_value_str (r, "Content-Length", length, sizeof (length)) == ESP_OK)
+    {
+        r->content_len = strtoul (length, NULL, 10);
+        state.remaining = r->content_len;
+    }
+
+    bool keep = true;
+    bool exists = false;
+    size_t path = uri.find ('?');
+    const httpd_uri_t *handler = find_handler (owner, r->uri, (path == std::string::npos) ? uri.size () : path,
+            method, &exists);
+
+    if (handler == NULL)
+    {
+        httpd_resp_send_err (r, exists ? HTTPD_405_METHOD_NOT_ALLOWED : HTTPD_404_NOT_FOUND, NULL);
+    }
+    else
+    {
+        r->user_ctx = handler->user_ctx;
+
+        if (handler->handler (r) != ESP_OK)
+        {
+            ESP_LOGW (TAG, "handler for %s failed, closing session", handler->uri);
+            keep = false;
+        }
+    }
+
+    // drop whatever part of the body the handler did not read
+    while (keep && (state.remaining > 0))
+    {
+        char buffer[512];
+
+        if (httpd_req_recv (r, buffer, sizeof (buffer)) <= 0)
+        {
+            keep = false;
+        }
+    }
+
+    free (r);
+
+    return (keep);
+}
+
+// -----------
+// server task
+// -----------
+
+static void run_work (server *owner)
+{
+    // only the work queued so far, so re-queued work waits for the next pass
+    std::deque<work> pending;
+    {
+        std::lock_guard<std::mutex> lock (owner->mutex);
+        pending.swap (owner->queue);
+    }
+
+    while (!pending.empty ())
+    {
+        work item = pending.front ();
+        pending.pop_front ();
+
+        item.function (item.argument);
+    }
+}
+
+static void *server_task (void *argument)
+{
+    server *owner = (server *) argument;
+
+    while (owner->running)
+    {
+        fd_set readable;
+        FD_ZERO (&readable);
+        FD_SET (owner->wake[0], &readable);
+        int highest = owner->wake[0];
+
+        // without LRU purge, connections beyond the limit wait in the backlog
+        if (owner->config.lru_purge_enable || (owner->sessions.size () < owner->config.max_open_sockets))
+        {
+            FD_SET (owner->listener, &readable);
+            highest = (owner->listener > highest) ? owner->listener : highest;
+        }
+
+        bool buffered = false;
+        for (size_t loop = 0; loop < owner->sessions.size (); loop++)
+        {
+            FD_SET (owner->sessions[loop].fd, &readable);
+            highest = (owner->sessions[loop].fd > highest) ? owner->sessions[loop].fd : highest;
+            buffered = buffered || !owner->sessions[loop].input.empty ();
+        }
+
+        // pipelined requests already read do not make the socket readable
+        struct timeval poll = { 0, 0 };
+        if (select (highest + 1, &readable, NULL, NULL, buffered ? &poll : NULL) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            ESP_LOGE (TAG, "select failed: %s", strerror (errno));
+            break;
+        }
+
+        if (FD_ISSET (owner->wake[0], &readable))
+        {
+            char buffer[64];
+
+            while (read (owner->wake[0], buffer, sizeof (buffer)) > 0)
+            {
+            }
+        }
+
+        run_work (owner);
+
+        // sessions are matched by descriptor as handlers and work may close any of them
+        std::vector<int> ready;
+        for (size_t loop = 0; loop < owner->sessions.size (); loop++)
+        {
+            if (FD_ISSET (owner->sessions[loop].fd, &readable) || !owner->sessions[loop].input.empty ())
+            {
+                ready.push_back (owner->sessions[loop].fd);
+            }
+        }
+
+        for (size_t loop = 0; loop < ready.size (); loop++)
+        {
+            int index = find_session (owner, ready[loop]);
+            if (index < 0)
+            {
+                continue;
+            }
+
+            owner->sessions[index].used = ++owner->clock;
+
+            if (!process_request (owner, index))
+            {
+                index = find_session (owner, ready[loop]);
+                if (index >= 0)
+                {
+                    close_session (owner, index);
+                }
+            }
+        }
+
+        if (FD_ISSET (owner->listener, &readable))
+        {
+            accept_session (owner);
+        }
+    }
+
+    while (!owner->sessions.empty ())
+    {
+        close_session (owner, owner->sessions.size () - 1);
+    }
+
+    return (NULL);
+}
+
+// ---
+// API
+// ---
+
+esp_err_t httpd_start (httpd_handle_t *handle, const httpd_config_t *config)
+{
+    if ((handle == NULL) || (config == NULL))
+    {
+        return (ESP_ERR_INVALID_ARG);
+    }
+
+    server *owner = new server;
+    owner->config = *config;
+    owner->running = true;
+    owner->clock = 0;
+
+    owner->listener = socket (AF_INET6, SOCK_STREAM, 0);
+    if (owner->listener < 0)
+    {
+        delete owner;
+        return (ESP_ERR_HTTPD_TASK);
+    }
+
+    int enable = 1;
+    int disable = 0;
+    setsockopt (owner->listener, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof (enable));
+    setsockopt (owner->listener, IPPROTO_IPV6, IPV6_V6ONLY, &disable, sizeof (disable));
+
+    struct sockaddr_in6 address;
+    memset (&address, 0, sizeof (address));
+    address.sin6_family = AF_INET6;
+    address.sin6_addr = in6addr_any;
+    address.sin6_port = htons (config->server_port);
+
+    if ((bind (owner->listener, (struct sockaddr *) &address, sizeof (address)) < 0)
+            || (listen (owner->listener, config->backlog_conn) < 0))
+    {
+        ESP_LOGE (TAG, "unable to listen on port %d: %s", config->server_port, strerror (errno));
+        close (owner->listener);
+        delete owner;
+        return (ESP_ERR_HTTPD_TASK);
+    }
+
+    if (pipe (owner->wake) < 0)
+    {
+        close (owner->listener);
+        delete owner;
+        return (ESP_ERR_HTTPD_TASK);
+    }
+
+    fcntl (owner->wake[0], F_SETFL, O_NONBLOCK);
+
+    if (pthread_create (&owner->thread, NULL, server_task, owner) != 0)
+    {
+        close (owner->listener);
+        close (owner->wake[0]);
+        close (owner->wake[1]);
+        delete owner;
+        return (ESP_ERR_HTTPD_TASK);
+    }
+
+    *handle = owner;
+
+    return (ESP_OK);
+}
+
+esp_err_t httpd_stop (httpd_handle_t handle)
+{
+    server *owner = (server *) handle;
+
+    if (owner == NULL)
+    {
+        return (ESP_ERR_INVALID_ARG);
+    }
+
+    owner->running = false;
+    if (write (owner->wake[1], "x", 1) < 0)
+    {
+        ESP_LOGE (TAG, "unable to wake the server task");
+    }
+
+    pthread_join (owner->thread, NULL);
+
+    close (owner->listener);
+    close (owner->wake[0]);
+    close (owner->wake[1]);
+
+    if (owner->config.global_user_ctx_free_fn)
+    {
+        owner->config.global_user_ctx_free_fn (owner->config.global_user_ctx);
+    }
+    else
+    {
+        free (owner->config.global_user_ctx);
+    }
+
+    delete owner;
+
+    return (ESP_OK);
+}
+
+esp_err_t httpd_register_uri_handler (httpd_handle_t handle, const httpd_uri_t *uri_handler)
+{
+    server *owner = (server *) handle;
+
+    if ((owner == NULL) || (uri_handler == NULL))
+    {
+        return (ESP_ERR_INVALID_ARG);
+    }
+
+    for (size_t loop = 0; loop < owner->handlers.size (); loop++)
+    {
+        if ((owner->handlers[loop].method == uri_handler->method)
+                && (strcmp (owner->handlers[loop].uri, uri_handler->uri) == 0))
+        {
+            ESP_LOGW (TAG, "handler %s already registered", uri_handler->uri);
+            return (ESP_ERR_HTTPD_HANDLER_EXISTS);
+        }
+    }
+
+    if (owner->handlers.size () >= owner->config.max_uri_handlers)
+    {
+        ESP_LOGW (TAG, "no slots left for registering handler %s", uri_handler->uri);
+        return (ESP_ERR_HTTPD_HANDLERS_FULL);
+    }
+
+    httpd_uri_t copy = *uri_handler;
+    copy.uri = strdup (uri_handler->uri);
+    owner->handlers.push_back (copy);
+
+    return (ESP_OK);
+}
+
+esp_err_t httpd_unregister_uri_handler (httpd_handle_t handle, const char *uri, httpd_method_t method)
+{
+    server *owner = (server *) handle;
+
+    for (size_t loop = 0; loop < owner->handlers.size (); loop++)
+    {
+        if ((owner->handlers[loop].method == method) && (strcmp (owner->handlers[loop].uri, uri) == 0))
+        {
+            free ((void *) owner->handlers[loop].uri);
+            owner->handlers.erase (owner->handlers.begin () + loop);
+            return (ESP_OK);
+        }
+    }
+
+    return (ESP_ERR_NOT_FOUND);
+}
+
+esp_err_t httpd_unregister_uri (httpd_handle_t handle, const char *uri)
+{
+    server *owner = (server *) handle;
+    bool found = false;
+
+    for (size_t loop = owner->handlers.size (); loop > 0; loop--)
+    {
+        if (strcmp (owner->handlers[loop - 1].uri, uri) == 0)
+        {
+            free ((void *) owner->handlers[loop - 1].uri);
+            owner->handlers.erase (owner->handlers.begin () + loop - 1);
+            found = true;
+        }
+    }
+
+    return (found ? ESP_OK : ESP_ERR_NOT_FOUND);
+}
+
+esp_err_t httpd_queue_work (httpd_handle_t handle, httpd_work_fn_t work, void *arg)
+{
+    server *owner = (server *) handle;
+
+    if ((owner == NULL) || (work == NULL))
+    {
+        return (ESP_ERR_INVALID_ARG);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock (owner->mutex);
+        owner->queue.push_back ({ work, arg });
+    }
+
+    if (write (owner->wake[1], "w", 1) < 0)
+    {
+        return (ESP_FAIL);
+    }
+
+    return (ESP_OK);
+}
+
+static void trigger_close (void *argument)
+{
+    std::pair<server *, int> *target = (std::pair<server *, int> *) argument;
+
+    int index = find_session (target->first, target->second);
+    if (index >= 0)
+    {
+        close_session (target->first, index);
+    }
+
+    delete target;
+}
+
+esp_err_t httpd_sess_trigger_close (httpd_handle_t handle, int sockfd)
+{
+    // closed from the server task, as on the target
+    return (httpd_queue_work (handle, trigger_close, new std::pair<server *, int> ((server *) handle, sockfd)));
+}
+
+esp_err_t httpd_sess_update_lru_counter (httpd_handle_t handle, int sockfd)
+{
+    server *owner = (server *) handle;
+
+    int index = find_session (owner, sockfd);
+    if (index < 0)
+    {
+        return (ESP_ERR_NOT_FOUND);
+    }
+
+    owner->sessions[index].used = ++owner->clock;
+
+    return (ESP_OK);
+}
+
+void *httpd_get_global_user_ctx (httpd_handle_t handle)
+{
+    return (((server *) handle)->config.global_user_ctx);
+}
+
+int httpd_req_to_sockfd (httpd_req_t *r)
+{
+    if ((r == NULL) || (r->aux == NULL))
+    {
+        return (-1);
+    }
+
+    return (((request *) r->aux)->client->fd);
+}
+
+// -----------------
+// request accessors
+// -----------------
+
+size_t httpd_req_get_url_query_len (httpd_req_t *r)
+{
+    const char *query = strchr (r->uri, '?');
+
+    return ((query == NULL) ? 0 : strlen (query + 1));
+}
+
+esp_err_t httpd_req_get_url_query_str (httpd_req_t *r, char *buf, size_t buf_len)
+{
+    const char *query = strchr (r->uri, '?');
+
+    if (query == NULL)
+    {
+        return (ESP_ERR_NOT_FOUND);
+    }
+
+    query++;
+    snprintf (buf, buf_len, "%s", query);
+
+    return ((strlen (query) >= buf_len) ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK);
+}
+
+static const char *header_value (httpd_req_t *r, const char *field, size_t *length)
+{
+    request *state = (request *) r->aux;
+    size_t size = strlen (field);
+
+    for (size_t loop = 1; loop < state->lines.size (); loop++)
+    {
+        const std::string &line = state->lines[loop];
+
+        if ((line.size () > size) && (line[size] == ':') && (strncasecmp (line.c_str (), field, size) == 0))
+        {
+            const char *value = line.c_str () + size + 1;
+
+            while (*value == ' ')
+            {
+                value++;
+            }
+
+            *length = strlen (value);
+            return (value);
+        }
+    }
+
+    return (NULL);
+}
+
+size_t httpd_req_get_hdr_value_len (httpd_req_t *r, const char *field)
+{
+    size_t length = 0;
+
+    return ((header_value (r, field, &length) == NULL) ? 0 : length);
+}
+
+esp_err_t httpd_req_get_hdr_value_str (httpd_req_t *r, const char *field, char *val, size_t val_size)
+{
+    size_t length = 0;
+    const char *value = header_value (r, field, &length);
+
+    if (value == NULL)
+    {
+        return (ESP_ERR_NOT_FOUND);
+    }
+
+    snprintf (val, val_size, "%s", value);
+
+    return ((length >= val_size) ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK);
+}
+
+int httpd_req_recv (httpd_req_t *r, char *buf, size_t buf_len)
+{
+    request *state = (request *) r->aux;
+    session *client = state->client;
+
+    if (state->remaining == 0)
+    {
+        return (0);
+    }
+
+    buf_len = (buf_len < state->remaining) ? buf_len : state->remaining;
+
+    // body bytes that arrived with the header come first
+    int received = 0;
+    if (!client->input.empty ())
+    {
+        received = (int) ((client->input.size () < buf_len) ? client->input.size () : buf_len);
+        memcpy (buf, client->input.data (), received);
+        client->input.erase (0, received);
+    }
+    else
+    {
+        received = httpd_default_recv (state->owner, client->fd, buf, buf_len, 0);
+        if (received <= 0)
+        {
+            return ((received == 0) ? HTTPD_SOCK_ERR_FAIL : received);
+        }
+    }
+
+    state->remaining -= received;
+
+    return (received);
+}
+
+// ---------
+// responses
+// ---------
+
+esp_err_t httpd_resp_set_status (httpd_req_t *r, const char *status)
+{
+    ((request *) r->aux)->status = status;
+
+    return (ESP_OK);
+}
+
+esp_err_t httpd_resp_set_type (httpd_req_t *r, const char *type)
+{
+    ((request *) r->aux)->type = type;
+
+    return (ESP_OK);
+}
+
+esp_err_t httpd_resp_set_hdr (httpd_req_t *r, const char *field, const char *value)
+{
+    request *state = (request *) r->aux;
+
+    // like the target, only the pointers are kept until the response is sent
+    if (state->headers.size () >= state->owner->config.max_resp_headers)
+    {
+        return (ESP_ERR_HTTPD_RESP_HDR);
+    }
+
+    state->headers.push_back (std::make_pair (field, value));
+
+    return (ESP_OK);
+}
+
+static std::string response_header (request *state, const char *framing)
+{
+    std::string header = std::string ("HTTP/1.1 ") + state->status + "\r\n";
+
+    header += std::string ("Content-Type: ") + state->type + "\r\n";
+    header += framing;
+
+    for (size_t loop = 0; loop < state->headers.size (); loop++)
+    {
+        header += std::string (state->headers[loop].first) + ": " + state->headers[loop].second + "\r\n";
+    }
+
+    header += "\r\n";
+
+    return (header);
+}
+
+esp_err_t httpd_resp_send (httpd_req_t *r, const char *buf, ssize_t buf_len)
+{
+    request *state = (request *) r->aux;
+
+    if (buf_len == HTTPD_RESP_USE_STRLEN)
+    {
+        buf_len = (buf == NULL) ? 0 : strlen (buf);
+    }
+
+    char framing[48];
+    snprintf (framing, sizeof (framing), "Content-Length: %u\r\n", (unsigned) buf_len);
+
+    std::string header = response_header (state, framing);
+
+    if (send_all (state->owner, state->client->fd, header.data (), header.size ()) != ESP_OK)
+    {
+        return (ESP_ERR_HTTPD_RESP_SEND);
+    }
+
+    if ((buf_len > 0) && (send_all (state->owner, state->client->fd, buf, buf_len) != ESP_OK))
+    {
+        return (ESP_ERR_HTTPD_RESP_SEND);
+    }
+
+    return (ESP_OK);
+}
+
+esp_err_t httpd_resp_send_chunk (httpd_req_t *r, const char *buf, ssize_t buf_len)
+{
+    request *state = (request *) r->aux;
+    int fd = state->client->fd;
+
+    if (buf_len == HTTPD_RESP_USE_STRLEN)
+    {
+        buf_len = (buf == NULL) ? 0 : strlen (buf);
+    }
+
+    if (!state->started)
+    {
+        std::string header = response_header (state, "Transfer-Encoding: chunked\r\n");
+
+        if (send_all (state->owner, fd, header.data (), header.size ()) != ESP_OK)
+        {
+            return (ESP_ERR_HTTPD_RESP_SEND);
+        }
+
+        state->started = true;
+    }
+
+    // a zero length chunk ends the response
+    char size[16];
+    snprintf (size, sizeof (size), "%x\r\n", (unsigned) buf_len);
+
+    if (send_all (state->owner, fd, size, strlen (size)) != ESP_OK)
+    {
+        return (ESP_ERR_HTTPD_RESP_SEND);
+    }
+
+    if (buf && (buf_len > 0) && (send_all (state->owner, fd, buf, buf_len) != ESP_OK))
+    {
+        return (ESP_ERR_HTTPD_RESP_SEND);
+    }
+
+    if (send_all (state->owner, fd, "\r\n", 2) != ESP_OK)
+    {
+        return (ESP_ERR_HTTPD_RESP_SEND);
+    }
+
+    return (ESP_OK);
+}
+
+esp_err_t httpd_resp_send_err (httpd_req_t *req, httpd_err_code_t error, const char *msg)
+{
+    httpd_resp_set_status (req, error_status (error));
+    httpd_resp_set_type (req, HTTPD_TYPE_TEXT);
+
+    return (httpd_resp_send (req, (msg != NULL) ? msg : error_message (error), HTTPD_RESP_USE_STRLEN));
+}
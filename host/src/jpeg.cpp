@@ -0,0 +1,86 @@
+#include <vector>
+
+#include "esp_jpg_decode.h"
+#include "reference.h"
+
+// ------
+// decode
+// ------
+
+//
+// The target decodes with the tjpgd in ROM, which scales in its inverse DCT.
+// The host decodes with the reference decoder at full size and averages the
+// pixels down instead, which gives much the same picture for more work, then
+// hands them to the writer the way the ROM does: the size first, the pixels
+// R, G, B a strip at a time, and the size again at the end.
+//
+esp_err_t esp_jpg_decode (size_t len, jpg_scale_t scale, jpg_reader_cb reader, jpg_writer_cb writer, void *arg)
+{
+    std::vector<uint8_t> jpeg (len);
+    size_t index = 0;
+
+    while (index < len)
+    {
+        size_t bytes = reader (arg, index, &jpeg[index], len - index);
+
+        if (bytes == 0)
+        {
+            break;
+        }
+
+        index += bytes;
+    }
+
+    std::vector<uint8_t> pixels;
+    std::vector<uint8_t> scaled;
+    int width = 0;
+    int height = 0;
+    int scaled_width = 0;
+    int scaled_height = 0;
+    int factor = 1 << scale;
+
+    if ((index < len) || !reference_decode (jpeg.data (), len, pixels, &width, &height))
+    {
+        return (ESP_FAIL);
+    }
+
+    reference_downscale (pixels, width, height, 3, factor, scaled, &scaled_width, &scaled_height);
+
+    // the ROM drops a partly covered edge
+    uint16_t output_width = width / factor;
+    uint16_t output_height = height / factor;
+
+    if (!writer (arg, 0, 0, output_width, output_height, NULL))
+    {
+        return (ESP_FAIL);
+    }
+
+    std::vector<uint8_t> strip (output_width * 16 * 3);
+
+    for (int y = 0; y < output_height; y += 16)
+    {
+        int rows = (output_height - y < 16) ? (output_height - y) : 16;
+        uint8_t *out = strip.data ();
+
+        for (int row = 0; row < rows; row++)
+        {
+            const uint8_t *in = &scaled[((y + row) * scaled_width) * 3];
+
+            for (int x = 0; x < output_width; x++, in += 3, out += 3)
+            {
+                out[0] = in[2];
+                out[1] = in[1];
+                out[2] = in[0];
+            }
+        }
+
+        if (!writer (arg, 0, y, output_width, rows, strip.data ()))
+        {
+            return (ESP_FAIL);
+        }
+    }
+
+    writer (arg, output_width, output_height, output_width, output_height, NULL);
+
+    return (ESP_OK);
+}
@@ -0,0 +1,22 @@
+#include <signal.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+extern "C" void app_main ();
+
+int main (int argc, char *argv[])
+{
+    (void) argc;
+    (void) argv;
+
+    // a client dropping a stream must not take the server down
+    signal (SIGPIPE, SIG_IGN);
+
+    app_main ();
+
+    // app_main returns once the tasks are started, keep them running
+    vTaskDelete (NULL);
+
+    return (0);
+}
@@ -0,0 +1,143 @@
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <string>
+
+#include "esp_log.h"
+#include "esp_spiffs.h"
+
+static const char *TAG = "spiffs";
+
+// ------
+// SPIFFS
+// ------
+
+static std::string base_path;
+static std::string directory;
+
+//
+// the directory standing in for the partition, MINDBRIDGE_FILESYSTEM or
+// the project's filesystem directory
+//
+static std::string partition_directory (void)
+{
+    const char *setting = getenv ("MINDBRIDGE_FILESYSTEM");
+
+    return ((setting != NULL) ? setting : HOST_FILESYSTEM);
+}
+
+esp_err_t esp_vfs_spiffs_register (const esp_vfs_spiffs_conf_t *conf)
+{
+    if ((conf == NULL) || (conf->base_path == NULL))
+    {
+        return (ESP_ERR_INVALID_ARG);
+    }
+
+    if (!base_path.empty ())
+    {
+        return (ESP_ERR_INVALID_STATE);
+    }
+
+    struct stat status;
+    std::string path = partition_directory ();
+
+    if ((stat (path.c_str (), &status) != 0) || !S_ISDIR (status.st_mode))
+    {
+        ESP_LOGE (TAG, "%s is not a directory", path.c_str ());
+        return (ESP_ERR_NOT_FOUND);
+    }
+
+    base_path = conf->base_path;
+    directory = path;
+
+    ESP_LOGI (TAG, "%s mounted from %s", base_path.c_str (), directory.c_str ());
+
+    return (ESP_OK);
+}
+
+esp_err_t esp_vfs_spiffs_unregister (const char *partition_label)
+{
+    (void) partition_label;
+
+    if (base_path.empty ())
+    {
+        return (ESP_ERR_INVALID_STATE);
+    }
+
+    base_path.clear ();
+    directory.clear ();
+
+    return (ESP_OK);
+}
+
+bool esp_spiffs_mounted (const char *partition_label)
+{
+    (void) partition_label;
+
+    return (!base_path.empty ());
+}
+
+esp_err_t esp_spiffs_info (const char *partition_label, size_t *total, size_t *used)
+{
+    (void) partition_label;
+
+    if (base_path.empty ())
+    {
+        return (ESP_ERR_INVALID_STATE);
+    }
+
+    *used = 0;
+
+    DIR *entries = opendir (directory.c_str ());
+    if (entries != NULL)
+    {
+        struct dirent *entry;
+
+        while ((entry = readdir (entries)) != NULL)
+        {
+            struct stat status;
+            std::string path = directory + "/" + entry->d_name;
+
+            if ((stat (path.c_str (), &status) == 0) && S_ISREG (status.st_mode))
+            {
+                *used += status.st_size;
+            }
+        }
+
+        closedir (entries);
+    }
+
+    // the size of the storage partition in partitions.csv, unless the files take more
+    *total = std::max (*used, (size_t) 320 * 1024);
+
+    return (ESP_OK);
+}
+
+// ---
+// VFS
+// ---
+
+//
+// The firmware opens files by their VFS path. The executable is linked with
+// --wrap=fopen so those calls land here and resolve against the directory
+// standing in for the partition.
+//
+extern "C" FILE *__real_fopen (const char *path, const char *mode);
+
+extern "C" FILE *__wrap_fopen (const char *path, const char *mode)
+{
+    size_t length = base_path.length ();
+
+    // paths below the base path resolve into the partition directory
+    if ((length > 0) && (strncmp (path, base_path.c_str (), length) == 0) && (path[length] == '/'))
+    {
+        std::string translated = directory + (path + length);
+
+        return (__real_fopen (translated.c_str (), mode));
+    }
+
+    return (__real_fopen (path, mode));
+}
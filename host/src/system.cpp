@@ -0,0 +1,468 @@
+#include <ctype.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "driver/gpio.h"
+#include "esp_err.h"
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "mdns.h"
+#include "nvs_flash.h"
+
+// -------
+// logging
+// -------
+
+//
+// the level comes from MINDBRIDGE_LOG (none, error, warn, info, debug or
+// verbose); the robot logs every command it sends at info level, so use
+// warn when putting the server under load
+//
+static esp_log_level_t configured_level (void)
+{
+    const char *names[] = { "none", "error", "warn", "info", "debug", "verbose" };
+    const char *setting = getenv ("MINDBRIDGE_LOG");
+
+    for (int loop = 0; setting && (loop <= ESP_LOG_VERBOSE); loop++)
+    {
+        if (strcasecmp (setting, names[loop]) == 0)
+        {
+            return ((esp_log_level_t) loop);
+        }
+    }
+
+    return (ESP_LOG_INFO);
+}
+
+static esp_log_level_t log_level (void)
+{
+    static const esp_log_level_t level = configured_level ();
+
+    return (level);
+}
+
+static std::mutex log_mutex;
+
+void esp_log_level_set (const char *tag, esp_log_level_t level)
+{
+    (void) tag;
+    (void) level;
+}
+
+uint32_t esp_log_timestamp (void)
+{
+    return ((uint32_t) (esp_timer_get_time () / 1000));
+}
+
+void esp_log_write (esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    (void) tag;
+
+    if (level > log_level ())
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock (log_mutex);
+
+    va_list arguments;
+    va_start (arguments, format);
+    vfprintf (stderr, format, arguments);
+    va_end (arguments);
+}
+
+void esp_log_buffer_hex_internal (const char *tag, const void *buffer, uint16_t length, esp_log_level_t level)
+{
+    const uint8_t *bytes = (const uint8_t *) buffer;
+
+    for (uint16_t offset = 0; offset < length; offset += 16)
+    {
+        char line[16 * 3 + 1];
+        int used = 0;
+
+        for (uint16_t loop = offset; (loop < length) && (loop < offset + 16); loop++)
+        {
+            used += snprintf (line + used, sizeof (line) - used, "%02x ", bytes[loop]);
+        }
+
+        esp_log_write (level, tag, "%c (%u) %s: %s\n", "NEWIDV"[level], esp_log_timestamp (), tag, line);
+    }
+}
+
+void esp_log_buffer_char_internal (const char *tag, const void *buffer, uint16_t length, esp_log_level_t level)
+{
+    const char *chars = (const char *) buffer;
+
+    for (uint16_t offset = 0; offset < length; offset += 16)
+    {
+        char line[16 + 1];
+        uint16_t count = ((length - offset) < 16) ? (length - offset) : 16;
+
+        memcpy (line, chars + offset, count);
+        line[count] = '\0';
+
+        esp_log_write (level, tag, "%c (%u) %s: %s\n", "NEWIDV"[level], esp_log_timestamp (), tag, line);
+    }
+}
+
+// ------
+// errors
+// ------
+
+const char *esp_err_to_name (esp_err_t code)
+{
+    switch (code)
+    {
+        case ESP_OK:
+            return ("ESP_OK");
+        case ESP_FAIL:
+            return ("ESP_FAIL");
+        case ESP_ERR_NO_MEM:
+            return ("ESP_ERR_NO_MEM");
+        case ESP_ERR_INVALID_ARG:
+            return ("ESP_ERR_INVALID_ARG");
+        case ESP_ERR_INVALID_STATE:
+            return ("ESP_ERR_INVALID_STATE");
+        case ESP_ERR_INVALID_SIZE:
+            return ("ESP_ERR_INVALID_SIZE");
+        case ESP_ERR_NOT_FOUND:
+            return ("ESP_ERR_NOT_FOUND");
+        case ESP_ERR_NOT_SUPPORTED:
+            return ("ESP_ERR_NOT_SUPPORTED");
+        case ESP_ERR_TIMEOUT:
+            return ("ESP_ERR_TIMEOUT");
+        default:
+            return ("UNKNOWN ERROR");
+    }
+}
+
+// ------
+// system
+// ------
+
+int64_t esp_timer_get_time (void)
+{
+    static struct timespec start = { 0, 0 };
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+    pthread_once (&once, [] () { clock_gettime (CLOCK_MONOTONIC, &start); });
+
+    struct timespec now;
+    clock_gettime (CLOCK_MONOTONIC, &now);
+
+    return ((int64_t) (now.tv_sec - start.tv_sec) * 1000000 + (now.tv_nsec - start.tv_nsec) / 1000);
+}
+
+uint32_t esp_random (void)
+{
+    static std::mutex mutex;
+    static std::random_device device;
+
+    std::lock_guard<std::mutex> lock (mutex);
+
+    return (device ());
+}
+
+void esp_fill_random (void *buffer, size_t length)
+{
+    uint8_t *bytes = (uint8_t *) buffer;
+
+    for (size_t loop = 0; loop < length; loop++)
+    {
+        bytes[loop] = (uint8_t) esp_random ();
+    }
+}
+
+void esp_restart (void)
+{
+    ESP_LOGW ("host", "restart requested, exiting");
+    exit (EXIT_SUCCESS);
+}
+
+// ----------
+// event loop
+// ----------
+
+ESP_EVENT_DEFINE_BASE (WIFI_EVENT);
+ESP_EVENT_DEFINE_BASE (IP_EVENT);
+
+struct registration
+{
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t handler;
+    void *arg;
+};
+
+static std::recursive_mutex event_mutex;
+static std::vector<registration> registrations;
+
+esp_err_t esp_event_loop_create_default (void)
+{
+    return (ESP_OK);
+}
+
+esp_err_t esp_event_loop_delete_default (void)
+{
+    std::lock_guard<std::recursive_mutex> lock (event_mutex);
+    registrations.clear ();
+
+    return (ESP_OK);
+}
+
+esp_err_t esp_event_handler_register (esp_event_base_t base, int32_t id, esp_event_handler_t handler, void *arg)
+{
+    std::lock_guard<std::recursive_mutex> lock (event_mutex);
+    registrations.push_back ({ base, id, handler, arg });
+
+    return (ESP_OK);
+}
+
+esp_err_t esp_event_handler_unregister (esp_event_base_t base, int32_t id, esp_event_handler_t handler)
+{
+    std::lock_guard<std::recursive_mutex> lock (event_mutex);
+
+    for (size_t loop = 0; loop < registrations.size (); loop++)
+    {
+        if ((registrations[loop].base == base) && (registrations[loop].id == id)
+                && (registrations[loop].handler == handler))
+        {
+            registrations.erase (registrations.begin () + loop);
+            return (ESP_OK);
+        }
+    }
+
+    return (ESP_ERR_INVALID_ARG);
+}
+
+esp_err_t esp_event_post (esp_event_base_t base, int32_t id, void *data, size_t size, TickType_t ticks)
+{
+    (void) size;
+    (void) ticks;
+
+    // handlers may register or unregister while the event is delivered
+    std::vector<registration> targets;
+    {
+        std::lock_guard<std::recursive_mutex> lock (event_mutex);
+        targets = registrations;
+    }
+
+    for (size_t loop = 0; loop < targets.size (); loop++)
+    {
+        const registration &target = targets[loop];
+
+        if (((target.base == ESP_EVENT_ANY_BASE) || (target.base == base))
+                && ((target.id == ESP_EVENT_ANY_ID) || (target.id == id)))
+        {
+            target.handler (target.arg, base, id, data);
+        }
+    }
+
+    return (ESP_OK);
+}
+
+// -------
+// network
+// -------
+
+esp_err_t esp_netif_init (void)
+{
+    return (ESP_OK);
+}
+
+esp_netif_t *esp_netif_create_default_wifi_sta (void)
+{
+    return (NULL);
+}
+
+esp_err_t tcpip_adapter_set_hostname (tcpip_adapter_if_t interface, const char *hostname)
+{
+    (void) interface;
+    (void) hostname;
+
+    return (ESP_OK);
+}
+
+esp_err_t esp_wifi_init (const wifi_init_config_t *config)
+{
+    (void) config;
+
+    return (ESP_OK);
+}
+
+esp_err_t esp_wifi_deinit (void)
+{
+    return (ESP_OK);
+}
+
+esp_err_t esp_wifi_set_mode (wifi_mode_t mode)
+{
+    (void) mode;
+
+    return (ESP_OK);
+}
+
+esp_err_t esp_wifi_set_config (wifi_interface_t interface, wifi_config_t *config)
+{
+    (void) interface;
+    (void) config;
+
+    return (ESP_OK);
+}
+
+esp_err_t esp_wifi_start (void)
+{
+    return (esp_event_post (WIFI_EVENT, WIFI_EVENT_STA_START, NULL, 0, portMAX_DELAY));
+}
+
+esp_err_t esp_wifi_stop (void)
+{
+    return (esp_event_post (WIFI_EVENT, WIFI_EVENT_STA_STOP, NULL, 0, portMAX_DELAY));
+}
+
+static void associate (void)
+{
+    ip_event_got_ip_t event;
+    memset (&event, 0, sizeof (event));
+
+    // 127.0.0.1, stored in network byte order
+    uint8_t *address = (uint8_t *) &event.ip_info.ip.addr;
+    address[0] = 127;
+    address[3] = 1;
+
+    esp_event_post (WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, NULL, 0, portMAX_DELAY);
+    esp_event_post (IP_EVENT, IP_EVENT_STA_GOT_IP, &event, sizeof (event), portMAX_DELAY);
+}
+
+esp_err_t esp_wifi_connect (void)
+{
+    // MINDBRIDGE_WIFI_LATENCY simulates the time to associate and get an address
+    const char *setting = getenv ("MINDBRIDGE_WIFI_LATENCY");
+    int latency = (setting != NULL) ? atoi (setting) : 0;
+
+    if (latency <= 0)
+    {
+        associate ();
+        return (ESP_OK);
+    }
+
+    std::thread ([latency] ()
+    {
+        struct timespec pause = { latency / 1000, (latency % 1000) * 1000000L };
+        nanosleep (&pause, NULL);
+
+        associate ();
+    }).detach ();
+
+    return (ESP_OK);
+}
+
+esp_err_t esp_wifi_disconnect (void)
+{
+    return (esp_event_post (WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, NULL, 0, portMAX_DELAY));
+}
+
+esp_err_t mdns_init (void)
+{
+    return (ESP_OK);
+}
+
+void mdns_free (void)
+{
+}
+
+esp_err_t mdns_hostname_set (const char *hostname)
+{
+    (void) hostname;
+
+    return (ESP_OK);
+}
+
+esp_err_t mdns_instance_name_set (const char *instance)
+{
+    (void) instance;
+
+    return (ESP_OK);
+}
+
+esp_err_t mdns_service_add (const char *instance, const char *service, const char *protocol,
+        uint16_t port, mdns_txt_item_t txt[], size_t count)
+{
+    (void) instance;
+    (void) service;
+    (void) protocol;
+    (void) port;
+    (void) txt;
+    (void) count;
+
+    return (ESP_OK);
+}
+
+// ---
+// NVS
+// ---
+
+esp_err_t nvs_flash_init (void)
+{
+    return (ESP_OK);
+}
+
+esp_err_t nvs_flash_erase (void)
+{
+    return (ESP_OK);
+}
+
+// ----
+// GPIO
+// ----
+
+static int levels[GPIO_NUM_MAX];
+
+esp_err_t gpio_config (const gpio_config_t *config)
+{
+    if (config->pin_bit_mask >> GPIO_NUM_MAX)
+    {
+        return (ESP_ERR_INVALID_ARG);
+    }
+
+    return (ESP_OK);
+}
+
+esp_err_t gpio_set_level (gpio_num_t pin, uint32_t level)
+{
+    if ((pin < 0) || (pin >= GPIO_NUM_MAX))
+    {
+        return (ESP_ERR_INVALID_ARG);
+    }
+
+    int value = level ? 1 : 0;
+    if (__atomic_exchange_n (&levels[pin], value, __ATOMIC_RELAXED) != value)
+    {
+        ESP_LOGD ("gpio", "GPIO %d: %d", pin, value);
+    }
+
+    return (ESP_OK);
+}
+
+int gpio_get_level (gpio_num_t pin)
+{
+    if ((pin < 0) || (pin >= GPIO_NUM_MAX))
+    {
+        return (0);
+    }
+
+    return (__atomic_load_n (&levels[pin], __ATOMIC_RELAXED));
+}
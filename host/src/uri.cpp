@@ -0,0 +1,110 @@
+#include <string.h>
+#include <strings.h>
+
+#include "esp_http_server.h"
+
+//
+// The server's own URI matcher and query lookup, as in esp_http_server.
+// They are kept apart from the server so mindbridge-router can time the
+// handler walk it makes, and mindbridge-query the lookups Query replaced.
+//
+
+// --------
+// matching
+// --------
+
+bool httpd_uri_match_wildcard (const char *uri_template, const char *uri_to_match, size_t match_upto)
+{
+    // a trailing '*' matches any rest, a trailing '?' makes the character before it optional
+    size_t length = strlen (uri_template);
+    char last = (length > 0) ? uri_template[length - 1] : 0;
+    char before = (length > 1) ? uri_template[length - 2] : 0;
+    bool asterisk = (last == '*') || ((before == '*') && (last == '?'));
+    bool question = (last == '?') || ((before == '?') && (last == '*'));
+    size_t special = (asterisk ? 1 : 0) + (question ? 2 : 0);
+
+    if (length < special)
+    {
+        return (false);
+    }
+
+    size_t exact = length - special;
+
+    if (match_upto < exact)
+    {
+        return (false);
+    }
+
+    if (!question)
+    {
+        if (!asterisk && (match_upto != exact))
+        {
+            return (false);
+        }
+
+        return (strncmp (uri_template, uri_to_match, exact) == 0);
+    }
+
+    if ((match_upto > exact) && (uri_template[exact] != uri_to_match[exact]))
+    {
+        return (false);
+    }
+
+    if (strncmp (uri_template, uri_to_match, exact) != 0)
+    {
+        return (false);
+    }
+
+    return (asterisk || (match_upto <= exact + 1));
+}
+
+// -----
+// query
+// -----
+
+esp_err_t httpd_query_key_value (const char *qry, const char *key, char *val, size_t val_size)
+{
+    if ((qry == NULL) || (key == NULL) || (val == NULL))
+    {
+        return (ESP_ERR_INVALID_ARG);
+    }
+
+    size_t length = strlen (key);
+
+    while (*qry)
+    {
+        const char *equals = strchr (qry, '=');
+        if (equals == NULL)
+        {
+            break;
+        }
+
+        // keys compare case insensitively, as on the target
+        if (((size_t) (equals - qry) != length) || (strncasecmp (qry, key, length) != 0))
+        {
+            qry = strchr (equals, '&');
+            if (qry == NULL)
+            {
+                break;
+            }
+
+            qry++;
+            continue;
+        }
+
+        const char *value = equals + 1;
+        const char *stop = strchr (value, '&');
+        size_t needed = ((stop == NULL) ? strlen (value) : (size_t) (stop - value)) + 1;
+        size_t copied = (needed < val_size) ? needed : val_size;
+
+        if (copied > 0)
+        {
+            memcpy (val, value, copied - 1);
+            val[copied - 1] = '\0';
+        }
+
+        return ((val_size < needed) ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK);
+    }
+
+    return (ESP_ERR_NOT_FOUND);
+}
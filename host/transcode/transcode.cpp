@@ -0,0 +1,247 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "esp_jpg_decode.h"
+#include "fixtures.h"
+#include "img_converters.h"
+#include "reference.h"
+#include "sdkconfig.h"
+#include "Transcoder.h"
+
+//
+// Times the video stream profiles the way the bridge runs them, through
+// the Transcoder, and splits the time between the decode at the profile's
+// scale and the encode at its quality; the full scale profile requantizes
+// and does neither, and for it the split is what decoding and encoding
+// again would have taken. For every frame and profile it
+// checks that the transcoded frame decodes at the scaled size and is close
+// to the source decoded and averaged down, and reports the time, the size
+// against the source, and the share of one core the profile takes at the
+// frame rate given, however many viewers share it. Without arguments it
+// encodes test scenes the way the OV2640 does, 4:2:2 at the bridge's
+// quality; otherwise it reads the JPEG files in the directories given. It
+// exits non-zero on a failed check.
+//
+// The host decodes with the reference decoder at full size and averages
+// the pixels down, where the ROM decoder on the target scales in its IDCT,
+// so the decode times here are an upper bound on the work; the encode is
+// the same jpge code the target runs.
+//
+
+struct profile
+{
+    const char *name;
+    jpg_scale_t scale;
+    int quality;
+};
+
+static const profile profiles[] =
+{
+    { "high", JPG_SCALE_NONE, CONFIG_MINDBRIDGE_PROFILE_HIGH_QUALITY },
+    { "medium", JPG_SCALE_2X, CONFIG_MINDBRIDGE_PROFILE_MEDIUM_QUALITY },
+    { "low", JPG_SCALE_4X, CONFIG_MINDBRIDGE_PROFILE_LOW_QUALITY },
+};
+
+static int failures = 0;
+
+static double now (void)
+{
+    struct timespec time;
+    clock_gettime (CLOCK_MONOTONIC, &time);
+
+    return (time.tv_sec + time.tv_nsec / 1e9);
+}
+
+static void fail (const std::string &name, const char *profile, const char *message)
+{
+    if (failures++ < 20)
+    {
+        printf ("FAIL: %s, %s: %s\n", name.c_str (), profile, message);
+    }
+}
+
+static size_t reader (void *argument, size_t index, uint8_t *buffer, size_t length)
+{
+    const frame *input = (const frame *) argument;
+
+    length = std::min (length, input->data.size () - std::min (index, input->data.size ()));
+    if (buffer)
+    {
+        memcpy (buffer, &input->data[index], length);
+    }
+
+    return (length);
+}
+
+static bool discard (void *argument, uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint8_t *data)
+{
+    return (true);
+}
+
+static void run (const frame &input, int repeat, int rate, double *busiest)
+{
+    std::vector<uint8_t> pixels;
+    int width = 0;
+    int height = 0;
+
+    if (!reference_decode (input.data.data (), input.data.size (), pixels, &width, &height))
+    {
+        printf ("%s: not a baseline JPEG\n", input.name.c_str ());
+        return;
+    }
+
+    printf ("%s: %dx%d, %u bytes\n", input.name.c_str (), width, height, (unsigned) input.data.size ());
+    printf ("  %-7s %9s %8s %8s %9s %8s %8s %8s\n", "", "size", "ms", "decode", "encode", "bytes", "of full", "PSNR dB");
+
+    for (size_t index = 0; index < sizeof (profiles) / sizeof (profiles[0]); index++)
+    {
+        const profile &how = profiles[index];
+        Transcoder transcoder (how.name, how.scale, how.quality);
+
+        transcoder.join ();
+
+        double start = now ();
+        for (int loop = 0; loop < repeat; loop++)
+        {
+            if (!transcoder.transcode (input.data.data (), input.data.size ()))
+            {
+                break;
+            }
+        }
+        double total = (now () - start) / repeat;
+
+        if ((transcoder.sequence () != (uint32_t) repeat) || (transcoder.length () == 0))
+        {
+            fail (input.name, how.name, "not transcoded");
+            continue;
+        }
+
+        start = now ();
+        for (int loop = 0; loop < repeat; loop++)
+        {
+            esp_jpg_decode (input.data.size (), how.scale, reader, discard, (void *) &input);
+        }
+        double decode = (now () - start) / repeat;
+
+        // what the viewer sees against the source averaged down to its size
+        std::vector<uint8_t> scaled;
+        std::vector<uint8_t> expected;
+        std::vector<uint8_t> decoded;
+        int scaled_width = 0;
+        int scaled_height = 0;
+        int w = 0;
+        int h = 0;
+
+        reference_downscale (pixels, width, height, 3, 1 << how.scale, scaled, &scaled_width, &scaled_height);
+
+        std::vector<uint8_t> output (transcoder.data (), transcoder.data () + transcoder.length ());
+        if (!reference_decode (output.data (), output.size (), decoded, &w, &h)
+                || (w != (width >> how.scale)) || (h != (height >> how.scale)))
+        {
+            fail (input.name, how.name, "transcoded frame has the wrong size");
+            continue;
+        }
+
+        for (int y = 0; y < h; y++)
+        {
+            expected.insert (expected.end (), &scaled[y * scaled_width * 3], &scaled[(y * scaled_width + w) * 3]);
+        }
+
+        double quality = psnr (decoded, expected);
+        if (quality < 24)
+        {
+            fail (input.name, how.name, "transcoded frame is far from the source");
+        }
+
+        // and the encoder on its own, on pixels the size the decoder gives
+        std::vector<uint8_t> encoded;
+
+        start = now ();
+        for (int loop = 0; loop < repeat; loop++)
+        {
+            encoded.clear ();
+            fmt2jpg_cb (expected.data (), expected.size (), w, h, PIXFORMAT_RGB888, how.quality, append, &encoded);
+        }
+        double encode = (now () - start) / repeat;
+
+        char size[16];
+        snprintf (size, sizeof (size), "%dx%d", w, h);
+        printf ("  %-7s %9s %8.3f %8.3f %9.3f %8u %7.1f%% %8.1f\n", how.name, size, total * 1000, decode * 1000,
+                encode * 1000, (unsigned) output.size (), 100.0 * output.size () / input.data.size (), quality);
+
+        busiest[index] = std::max (busiest[index], total * rate * 100);
+    }
+}
+
+int main (int argc, char *argv[])
+{
+    int quality = 12;
+    int repeat = 50;
+    int rate = 25;
+    int option;
+
+    while ((option = getopt (argc, argv, "q:n:r:")) != -1)
+    {
+        switch (option)
+        {
+            case 'q':
+                quality = atoi (optarg);
+                break;
+            case 'n':
+                repeat = std::max (1, atoi (optarg));
+                break;
+            case 'r':
+                rate = std::max (1, atoi (optarg));
+                break;
+            default:
+                fprintf (stderr, "usage: %s [-q quality] [-n repeat] [-r frames per second] [directory ...]\n", argv[0]);
+                return (1);
+        }
+    }
+
+    // sensor quality runs from 0 (best) to 63, the encoder's from 100 (best) to 1
+    std::vector<frame> frames;
+
+    if (optind < argc)
+    {
+        for (int loop = optind; loop < argc; loop++)
+        {
+            load (argv[loop], frames);
+        }
+
+        if (frames.empty ())
+        {
+            fprintf (stderr, "no JPEG files found\n");
+            return (1);
+        }
+    }
+    else
+    {
+        frames.push_back (make (640, 480, encoder_quality (quality)));
+        frames.push_back (make (800, 600, encoder_quality (quality)));
+        frames.push_back (make (320, 240, encoder_quality (quality)));
+    }
+
+    double busiest[sizeof (profiles) / sizeof (profiles[0])] = { 0 };
+
+    for (const frame &input : frames)
+    {
+        run (input, repeat, rate, busiest);
+    }
+
+    for (size_t index = 0; index < sizeof (profiles) / sizeof (profiles[0]); index++)
+    {
+        printf ("%s at %d frames per second, at most %.0f%% of a core\n", profiles[index].name, rate, busiest[index]);
+    }
+
+    printf ("%s\n", failures ? "FAILED" : "passed");
+
+    return (failures ? 1 : 0);
+}
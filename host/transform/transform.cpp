@@ -0,0 +1,314 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "esp_jpg_coeff.h"
+#include "fixtures.h"
+#include "img_converters.h"
+#include "reference.h"
+
+//
+// Checks and times the lossless rotations and mirrorings of jpg_transform
+// against the way there is otherwise: a full decode, moving the pixels and
+// encoding again. For every frame and transform it checks that
+//
+//   - the transformed frame decodes to the decoded source moved the same
+//     way, trimmed to whole MCUs along a mirrored axis, within the rounding
+//     of the inverse DCT
+//   - transforming it back gives exactly the source coefficients, so
+//     nothing was lost
+//
+// and reports the time and size of both ways, and how far the re-encoded
+// frame is from the decoded source. Without arguments it encodes test
+// scenes the way the OV2640 does, 4:2:2 at the bridge's quality, one of
+// them not a whole number of MCUs; otherwise it reads the JPEG files in the
+// directories given. It exits non-zero on a failed check. -o writes the
+// first frame rotated 90 degrees.
+//
+
+struct transform
+{
+    jpg_transform_t type;
+    const char *name;
+    bool flip_x;
+    bool flip_y;
+    bool transpose;
+    jpg_transform_t inverse;
+};
+
+static const transform transforms[] =
+{
+    { JPG_TRANSFORM_FLIP_H, "flip h", true, false, false, JPG_TRANSFORM_FLIP_H },
+    { JPG_TRANSFORM_FLIP_V, "flip v", false, true, false, JPG_TRANSFORM_FLIP_V },
+    { JPG_TRANSFORM_ROT_180, "rotate 180", true, true, false, JPG_TRANSFORM_ROT_180 },
+    { JPG_TRANSFORM_TRANSPOSE, "transpose", false, false, true, JPG_TRANSFORM_TRANSPOSE },
+    { JPG_TRANSFORM_ROT_90, "rotate 90", false, true, true, JPG_TRANSFORM_ROT_270 },
+    { JPG_TRANSFORM_ROT_270, "rotate 270", true, false, true, JPG_TRANSFORM_ROT_90 },
+    { JPG_TRANSFORM_TRANSVERSE, "transverse", true, true, true, JPG_TRANSFORM_TRANSVERSE },
+};
+
+static int failures = 0;
+
+static double now (void)
+{
+    struct timespec time;
+    clock_gettime (CLOCK_MONOTONIC, &time);
+
+    return (time.tv_sec + time.tv_nsec / 1e9);
+}
+
+static void fail (const std::string &name, const char *transform, const char *message)
+{
+    if (failures++ < 20)
+    {
+        printf ("FAIL: %s, %s: %s\n", name.c_str (), transform, message);
+    }
+}
+
+// every coefficient of a frame, by component, block row and column
+struct coefficients
+{
+    jpg_coeff_info_t info;
+    std::vector<int16_t> blocks[JPG_COEFF_COMPONENTS];
+};
+
+static bool keep (void *argument, const jpg_coeff_info_t *info, const jpg_coeff_block_t *block)
+{
+    coefficients *all = (coefficients *) argument;
+    const jpg_coeff_component_t &component = info->component[block->component];
+    std::vector<int16_t> &blocks = all->blocks[block->component];
+
+    blocks.resize (component.blocks_w * component.blocks_h * 64);
+    memcpy (&blocks[(block->y * component.blocks_w + block->x) * 64], block->coef, sizeof (block->coef));
+
+    return (true);
+}
+
+static bool decode_coefficients (const std::vector<uint8_t> &jpeg, coefficients &all)
+{
+    return (esp_jpg_coeff_decode (jpeg.data (), jpeg.size (), JPG_COEFF_ALL, keep, &all, &all.info) == ESP_OK);
+}
+
+// the pixels moved as the transform moves them, from width by height trimmed
+static void move (const std::vector<uint8_t> &pixels, int width, int trimmed_width, int trimmed_height,
+        const transform &how, std::vector<uint8_t> &output)
+{
+    int out_width = how.transpose ? trimmed_height : trimmed_width;
+    int out_height = how.transpose ? trimmed_width : trimmed_height;
+
+    output.resize (out_width * out_height * 3);
+
+    for (int y = 0; y < out_height; y++)
+    {
+        for (int x = 0; x < out_width; x++)
+        {
+            int sx = how.transpose ? y : x;
+            int sy = how.transpose ? x : y;
+
+            sx = how.flip_x ? (trimmed_width - 1 - sx) : sx;
+            sy = how.flip_y ? (trimmed_height - 1 - sy) : sy;
+            memcpy (&output[(y * out_width + x) * 3], &pixels[(sy * width + sx) * 3], 3);
+        }
+    }
+}
+
+static void run (const frame &input, int repeat, int quality, const char *output)
+{
+    coefficients source;
+    if (!decode_coefficients (input.data, source))
+    {
+        printf ("%s: not a baseline JPEG\n", input.name.c_str ());
+        return;
+    }
+
+    const jpg_coeff_info_t &info = source.info;
+    std::vector<uint8_t> pixels;
+    int width = 0;
+    int height = 0;
+
+    reference_decode (input.data.data (), input.data.size (), pixels, &width, &height);
+
+    printf ("%s: %ux%u, %u components %ux%u sampled, %u bytes\n", input.name.c_str (), info.width, info.height,
+            info.components, info.component[0].h, info.component[0].v, (unsigned) input.data.size ());
+    printf ("  %-11s %9s %8s %11s %8s %8s %8s\n", "", "DCT ms", "bytes", "re-code ms", "bytes", "speedup", "PSNR dB");
+
+    for (const transform &how : transforms)
+    {
+        std::vector<uint8_t> transformed;
+
+        double start = now ();
+        for (int loop = 0; loop < repeat; loop++)
+        {
+            transformed.clear ();
+            if (!jpg_transform_cb (input.data.data (), input.data.size (), how.type, append, &transformed))
+            {
+                break;
+            }
+        }
+        double lossless = (now () - start) / repeat;
+
+        if (transformed.empty ())
+        {
+            fail (input.name, how.name, "not transformed");
+            continue;
+        }
+
+        // what the decoder shows, moved in pixels
+        int mcu_width = 8 * info.max_h;
+        int mcu_height = 8 * info.max_v;
+        int trimmed_width = how.flip_x ? (width / mcu_width * mcu_width) : width;
+        int trimmed_height = how.flip_y ? (height / mcu_height * mcu_height) : height;
+        std::vector<uint8_t> expected;
+        std::vector<uint8_t> decoded;
+        int w = 0;
+        int h = 0;
+
+        move (pixels, width, trimmed_width, trimmed_height, how, expected);
+
+        if (!reference_decode (transformed.data (), transformed.size (), decoded, &w, &h)
+                || (w != (how.transpose ? trimmed_height : trimmed_width))
+                || (h != (how.transpose ? trimmed_width : trimmed_height)))
+        {
+            fail (input.name, how.name, "transformed frame has the wrong size");
+            continue;
+        }
+
+        int worst = 0;
+        for (size_t loop = 0; loop < decoded.size (); loop++)
+        {
+            worst = std::max (worst, abs ((int) decoded[loop] - expected[loop]));
+        }
+
+        if (worst > 3)
+        {
+            fail (input.name, how.name, "transformed frame differs from the moved pixels");
+        }
+
+        // and back again, coefficient for coefficient
+        std::vector<uint8_t> back;
+        coefficients restored;
+
+        if (!jpg_transform_cb (transformed.data (), transformed.size (), how.inverse, append, &back)
+                || !decode_coefficients (back, restored))
+        {
+            fail (input.name, how.name, "could not transform back");
+            continue;
+        }
+
+        for (int component = 0; component < info.components; component++)
+        {
+            const jpg_coeff_component_t &was = info.component[component];
+            const jpg_coeff_component_t &is = restored.info.component[component];
+            bool same = (is.h == was.h) && (is.v == was.v) && (is.blocks_w <= was.blocks_w) && (is.blocks_h <= was.blocks_h);
+
+            for (int y = 0; same && (y < is.blocks_h); y++)
+            {
+                same = (memcmp (&restored.blocks[component][y * is.blocks_w * 64],
+                        &source.blocks[component][y * was.blocks_w * 64], is.blocks_w * 64 * sizeof (int16_t)) == 0);
+            }
+
+            if (!same)
+            {
+                fail (input.name, how.name, "transformed back, the coefficients differ from the source");
+                break;
+            }
+        }
+
+        // decode, move and encode again, as without the transform
+        std::vector<uint8_t> full;
+        std::vector<uint8_t> moved;
+        std::vector<uint8_t> encoded;
+
+        start = now ();
+        for (int loop = 0; loop < repeat; loop++)
+        {
+            encoded.clear ();
+            reference_decode (input.data.data (), input.data.size (), full, &w, &h);
+            move (full, w, trimmed_width, trimmed_height, how, moved);
+            encode (moved, how.transpose ? trimmed_height : trimmed_width, how.transpose ? trimmed_width : trimmed_height,
+                    quality, encoded);
+        }
+        double recode = (now () - start) / repeat;
+
+        std::vector<uint8_t> reencoded;
+        reference_decode (encoded.data (), encoded.size (), reencoded, &w, &h);
+
+        printf ("  %-11s %9.3f %8u %11.3f %8u %7.1fx %8.1f\n", how.name, lossless * 1000, (unsigned) transformed.size (),
+                recode * 1000, (unsigned) encoded.size (), recode / lossless, psnr (reencoded, expected));
+
+        if (output && (how.type == JPG_TRANSFORM_ROT_90))
+        {
+            FILE *file = fopen (output, "wb");
+            if (file)
+            {
+                fwrite (transformed.data (), 1, transformed.size (), file);
+                fclose (file);
+            }
+        }
+    }
+}
+
+int main (int argc, char *argv[])
+{
+    int quality = 12;
+    int repeat = 50;
+    const char *output = NULL;
+    int option;
+
+    while ((option = getopt (argc, argv, "q:n:o:")) != -1)
+    {
+        switch (option)
+        {
+            case 'q':
+                quality = atoi (optarg);
+                break;
+            case 'n':
+                repeat = std::max (1, atoi (optarg));
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                fprintf (stderr, "usage: %s [-q quality] [-n repeat] [-o rotated.jpg] [directory ...]\n", argv[0]);
+                return (1);
+        }
+    }
+
+    // sensor quality runs from 0 (best) to 63, the encoder's from 100 (best) to 1
+    std::vector<frame> frames;
+
+    if (optind < argc)
+    {
+        for (int loop = optind; loop < argc; loop++)
+        {
+            load (argv[loop], frames);
+        }
+
+        if (frames.empty ())
+        {
+            fprintf (stderr, "no JPEG files found\n");
+            return (1);
+        }
+    }
+    else
+    {
+        frames.push_back (make (640, 480, encoder_quality (quality)));
+        frames.push_back (make (800, 600, encoder_quality (quality)));
+        frames.push_back (make (203, 157, encoder_quality (quality)));
+    }
+
+    for (size_t loop = 0; loop < frames.size (); loop++)
+    {
+        run (frames[loop], repeat, encoder_quality (quality), loop ? NULL : output);
+    }
+
+    printf ("%s\n", failures ? "FAILED" : "passed");
+
+    return (failures ? 1 : 0);
+}
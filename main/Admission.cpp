@@ -0,0 +1,113 @@
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+
+#include "Admission.h"
+#include "Metrics.h"
+
+static const char *TAG = "admission";
+
+static Counter streams_rejected ("mindbridge_admission_rejected_total", "reason=\"streams\"", "Video streams refused by admission control");
+static Counter driving_rejected ("mindbridge_admission_rejected_total", "reason=\"driving\"", "Video streams refused by admission control");
+static Counter polls_throttled ("mindbridge_admission_throttled_total", NULL, "Polls refused to clients without the session");
+
+Admission::Admission (int streams, int driving, uint32_t rate, uint32_t burst) :
+    _streams (streams),
+    _driving (driving),
+    _interval (1000000 / rate),
+    _tolerance ((int64_t) (burst - 1) * (1000000 / rate))
+{
+    memset (_peers, 0, sizeof (_peers));
+}
+
+//
+// whether another video stream may start
+//
+bool Admission::stream (int streaming, bool driving)
+{
+    if (streaming >= _streams)
+    {
+        streams_rejected.add ();
+        ESP_LOGW (TAG, "refusing stream, %d open", streaming);
+        return (false);
+    }
+
+    if (driving && (streaming >= _driving))
+    {
+        driving_rejected.add ();
+        ESP_LOGW (TAG, "refusing stream, %d open while driving", streaming);
+        return (false);
+    }
+
+    return (true);
+}
+
+//
+// whether a poll from a client without the session may go ahead, if not the
+// seconds until it may is left in retry
+//
+bool Admission::poll (httpd_req_t *request, uint32_t *retry)
+{
+    struct sockaddr_storage storage;
+    socklen_t size = sizeof (storage);
+    uint8_t address[16];
+
+    memset (&storage, 0, sizeof (storage));
+    memset (address, 0, sizeof (address));
+
+    if (getpeername (httpd_req_to_sockfd (request), (struct sockaddr *) &storage, &size) != 0)
+    {
+        return (true);
+    }
+
+    // IPv4 peers are kept in their IPv4-mapped form
+    if (storage.ss_family == AF_INET6)
+    {
+        memcpy (address, &((struct sockaddr_in6 *) &storage)->sin6_addr, 16);
+    }
+    else
+    {
+        address[10] = 0xff;
+        address[11] = 0xff;
+        memcpy (address + 12, &((struct sockaddr_in *) &storage)->sin_addr, 4);
+    }
+
+    int64_t now = esp_timer_get_time ();
+
+    // the address, or else the entry that has been idle the longest
+    peer *entry = &_peers[0];
+    for (int loop = 0; loop < PEERS; loop++)
+    {
+        if (memcmp (_peers[loop].address, address, sizeof (address)) == 0)
+        {
+            entry = &_peers[loop];
+            break;
+        }
+
+        if (_peers[loop].arrival < entry->arrival)
+        {
+            entry = &_peers[loop];
+        }
+    }
+
+    if (memcmp (entry->address, address, sizeof (address)) != 0)
+    {
+        memcpy (entry->address, address, sizeof (address));
+        entry->arrival = now;
+    }
+
+    int64_t arrival = (entry->arrival > now) ? entry->arrival : now;
+
+    if (arrival - now > _tolerance)
+    {
+        polls_throttled.add ();
+        *retry = (uint32_t) ((arrival - now - _tolerance + 999999) / 1000000);
+        return (false);
+    }
+
+    entry->arrival = arrival + _interval;
+
+    return (true);
+}
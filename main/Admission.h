@@ -0,0 +1,48 @@
+#ifndef __ADMISSION_H__
+#define __ADMISSION_H__
+
+#include <stdint.h>
+
+#include "esp_http_server.h"
+
+// ---------
+// admission
+// ---------
+
+//
+// admission control that keeps the bridge responsive for the driver
+//
+// Video streams are capped, and capped lower while someone holds the
+// session, as every stream takes a share of the web server task that the
+// drive requests also need. Polls from clients that do not hold the
+// session are rate limited per address with a generic cell rate algorithm:
+// each address has a theoretical arrival time that every accepted poll
+// pushes one interval further, and a poll is refused when that time runs
+// more than the burst ahead of now. Requests carrying the session token are
+// never limited.
+//
+// Only the web server task calls in, so the tables take no lock.
+//
+class Admission
+{
+    public:
+        static const int PEERS = 8;
+    public:
+        Admission (int streams, int driving, uint32_t rate, uint32_t burst);
+        bool stream (int streaming, bool driving);
+        bool poll (httpd_req_t *request, uint32_t *retry);
+    private:
+        struct peer
+        {
+            uint8_t address[16];
+            int64_t arrival;
+        };
+    private:
+        int _streams;
+        int _driving;
+        int64_t _interval;
+        int64_t _tolerance;
+        peer _peers[PEERS];
+};
+
+#endif
@@ -0,0 +1,289 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_jpg_coeff.h"
+
+#include "Avi.h"
+
+// an AVI 1.0 file, RIFF sizes and idx1 offsets are 32 bits and players stop at 1 GB
+#define AVI_LIMIT       (1UL << 30)
+
+// idx1 flag for a frame that decodes on its own, every JPEG does
+#define AVIIF_KEYFRAME  (0x10)
+#define AVIF_HASINDEX   (0x10)
+
+// the movi fourcc, which idx1 offsets count from
+#define AVI_MOVI        (Avi::HEADER - 4)
+
+static void put16 (uint8_t *at, uint16_t value)
+{
+    at[0] = value;
+    at[1] = value >> 8;
+}
+
+static void put32 (uint8_t *at, uint32_t value)
+{
+    at[0] = value;
+    at[1] = value >> 8;
+    at[2] = value >> 16;
+    at[3] = value >> 24;
+}
+
+static void fourcc (uint8_t *at, const char *code)
+{
+    memcpy (at, code, 4);
+}
+
+Avi::Avi (output_t output, void *argument, uint32_t capacity, uint32_t period) :
+    _output (output),
+    _argument (argument),
+    _index (NULL),
+    _capacity (capacity),
+    _period (period ? period : 1),
+    _frames (0),
+    _bytes (0),
+    _largest (0),
+    _expected_frames (0),
+    _expected_bytes (0),
+    _width (0),
+    _height (0),
+    _offset (0),
+    _failed (false)
+{
+    _index = (entry *) malloc (capacity * sizeof (entry));
+
+    if (_index == NULL)
+    {
+        _capacity = 0;
+    }
+}
+
+Avi::~Avi ()
+{
+    free (_index);
+}
+
+// frames written so far
+uint32_t Avi::frames (void)
+{
+    return (_frames);
+}
+
+// bytes written so far
+size_t Avi::size (void)
+{
+    return (_offset);
+}
+
+//
+// the size of the file for this many frames, bytes being their JPEG data
+// with each rounded up to an even length
+//
+size_t Avi::length (uint32_t frames, size_t bytes)
+{
+    return (HEADER + frames * 8 + bytes + 8 + frames * 16);
+}
+
+//
+// the sizes to put in a header written before the frames, for an output
+// that cannot seek back; bytes are counted as for length
+//
+void Avi::expect (uint32_t frames, size_t bytes)
+{
+    _expected_frames = frames;
+    _expected_bytes = bytes;
+}
+
+bool Avi::write (const void *data, size_t length)
+{
+    if (_failed || !_output (_argument, _offset, data, length))
+    {
+        _failed = true;
+        return (false);
+    }
+
+    _offset += length;
+
+    return (true);
+}
+
+// RIFF, hdrl with the stream's avih, strh and strf, and the start of movi
+bool Avi::header (uint32_t frames, size_t bytes)
+{
+    uint8_t header[HEADER];
+    uint32_t movi = 4 + frames * 8 + bytes;
+    uint32_t riff = (frames || bytes) ? (length (frames, bytes) - 8) : 0;
+    uint32_t rate = (uint32_t) ((uint64_t) _largest * 1000000 / _period);
+
+    memset (header, 0, sizeof (header));
+
+    fourcc (header + 0, "RIFF");
+    put32 (header + 4, riff);
+    fourcc (header + 8, "AVI ");
+
+    fourcc (header + 12, "LIST");
+    put32 (header + 16, 192);
+    fourcc (header + 20, "hdrl");
+
+    fourcc (header + 24, "avih");
+    put32 (header + 28, 56);
+    put32 (header + 32, _period);
+    put32 (header + 36, rate);
+    put32 (header + 44, AVIF_HASINDEX);
+    put32 (header + 48, frames);
+    put32 (header + 56, 1);
+    put32 (header + 60, _largest);
+    put32 (header + 64, _width);
+    put32 (header + 68, _height);
+
+    fourcc (header + 88, "LIST");
+    put32 (header + 92, 116);
+    fourcc (header + 96, "strl");
+
+    // one video stream, frames come every period microseconds
+    fourcc (header + 100, "strh");
+    put32 (header + 104, 56);
+    fourcc (header + 108, "vids");
+    fourcc (header + 112, "MJPG");
+    put32 (header + 128, _period);
+    put32 (header + 132, 1000000);
+    put32 (header + 140, frames);
+    put32 (header + 144, _largest);
+    put32 (header + 148, 0xffffffff);
+    put16 (header + 160, _width);
+    put16 (header + 162, _height);
+
+    fourcc (header + 164, "strf");
+    put32 (header + 168, 40);
+    put32 (header + 172, 40);
+    put32 (header + 176, _width);
+    put32 (header + 180, _height);
+    put16 (header + 184, 1);
+    put16 (header + 186, 24);
+    fourcc (header + 188, "MJPG");
+    put32 (header + 192, _width * _height * 3);
+
+    fourcc (header + 212, "LIST");
+    put32 (header + 216, (frames || bytes) ? movi : 0);
+    fourcc (header + 220, "movi");
+
+    return (write (header, sizeof (header)));
+}
+
+//
+// write a JPEG frame as the next chunk, the first also writes the header
+//
+bool Avi::frame (const uint8_t *jpeg, size_t length)
+{
+    size_t padded = (length + 1) & ~(size_t) 1;
+
+    if (_failed || (_frames >= _capacity) || (this->length (_frames + 1, _bytes + padded) > AVI_LIMIT))
+    {
+        return (false);
+    }
+
+    if (_offset == 0)
+    {
+        jpg_coeff_info_t info;
+
+        if (esp_jpg_coeff_info (jpeg, length, &info) == ESP_OK)
+        {
+            _width = info.width;
+            _height = info.height;
+        }
+
+        // the largest frame is not known ahead, the frame size serves as a guide
+        _largest = _width * _height / 4;
+
+        if (!header (_expected_frames, _expected_bytes))
+        {
+            return (false);
+        }
+    }
+
+    uint8_t chunk[8];
+    static const uint8_t pad = 0;
+
+    fourcc (chunk, "00dc");
+    put32 (chunk + 4, length);
+
+    _index[_frames].offset = _offset - AVI_MOVI;
+    _index[_frames].length = length;
+
+    if (!write (chunk, sizeof (chunk)) || !write (jpeg, length) || ((padded != length) && !write (&pad, 1)))
+    {
+        return (false);
+    }
+
+    _frames++;
+    _bytes += padded;
+
+    return (true);
+}
+
+//
+// write the index, and with an output that seeks the header again
+//
+bool Avi::finish (bool seekable)
+{
+    if (_failed || (_offset == 0))
+    {
+        return (false);
+    }
+
+    uint8_t buffer[8 + 16 * 16];
+    size_t used = 8;
+
+    fourcc (buffer, "idx1");
+    put32 (buffer + 4, _frames * 16);
+
+    // a few entries at a time, the index is the only copy of them
+    for (uint32_t loop = 0; loop < _frames; loop++)
+    {
+        if (used + 16 > sizeof (buffer))
+        {
+            if (!write (buffer, used))
+            {
+                return (false);
+            }
+
+            used = 0;
+        }
+
+        uint8_t *entry = buffer + used;
+
+        fourcc (entry, "00dc");
+        put32 (entry + 4, AVIIF_KEYFRAME);
+        put32 (entry + 8, _index[loop].offset);
+        put32 (entry + 12, _index[loop].length);
+        used += 16;
+    }
+
+    if ((used > 0) && !write (buffer, used))
+    {
+        return (false);
+    }
+
+    if (!seekable)
+    {
+        return (true);
+    }
+
+    // the sizes are known now, the largest frame too
+    size_t end = _offset;
+
+    _largest = 0;
+    for (uint32_t loop = 0; loop < _frames; loop++)
+    {
+        if (_index[loop].length > _largest)
+        {
+            _largest = _index[loop].length;
+        }
+    }
+
+    _offset = 0;
+    bool written = header (_frames, _bytes);
+    _offset = end;
+
+    return (written);
+}
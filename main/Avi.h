@@ -0,0 +1,68 @@
+#ifndef __AVI_H__
+#define __AVI_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ---
+// avi
+// ---
+
+//
+// streaming MJPEG AVI (RIFF) muxer
+//
+// The JPEG frames are written out as they arrive, each as one 00dc chunk
+// of the movi list, and the frame size is taken from the first of them.
+// Only the idx1 index is kept, 8 bytes a frame up to the capacity given,
+// and written out at the end. An output that can seek gets the header
+// written again at the end with the final sizes; one that cannot, such as
+// an HTTP response, needs the frame count and JPEG bytes given up front
+// with expect, or its header says 0 frames and sizes, which most players
+// take as a stream to read to its end.
+//
+// The output is handed each piece with its offset in the file; writing in
+// order is enough unless the output seeks. Frames past the capacity or the
+// 1 GB an AVI 1.0 file can hold are refused; there are no OpenDML extended
+// indexes.
+//
+class Avi
+{
+    public:
+        typedef bool (*output_t) (void *argument, size_t offset, const void *data, size_t length);
+        static const size_t HEADER = 224;
+    public:
+        Avi (output_t output, void *argument, uint32_t capacity, uint32_t period);
+        ~Avi ();
+        void expect (uint32_t frames, size_t bytes);
+        bool frame (const uint8_t *jpeg, size_t length);
+        bool finish (bool seekable);
+        uint32_t frames (void);
+        size_t size (void);
+        static size_t length (uint32_t frames, size_t bytes);
+    private:
+        struct entry
+        {
+            uint32_t offset;
+            uint32_t length;
+        };
+    private:
+        bool write (const void *data, size_t length);
+        bool header (uint32_t frames, size_t bytes);
+    private:
+        output_t _output;
+        void *_argument;
+        entry *_index;
+        uint32_t _capacity;
+        uint32_t _period;
+        uint32_t _frames;
+        size_t _bytes;
+        size_t _largest;
+        uint32_t _expected_frames;
+        size_t _expected_bytes;
+        uint16_t _width;
+        uint16_t _height;
+        size_t _offset;
+        bool _failed;
+};
+
+#endif
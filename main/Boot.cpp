@@ -0,0 +1,125 @@
+#include <atomic>
+#include <string>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "Boot.h"
+#include "Metrics.h"
+
+static const char *TAG = "boot";
+
+static const char *PHASE_NAMES[Boot::PHASES] =
+{
+    "nvs", "wifi", "mdns", "filesystem", "httpd", "bluetooth", "camera"
+};
+
+static const char *MILESTONE_NAMES[Boot::MILESTONES] =
+{
+    "serving", "first_request", "first_frame", "ready"
+};
+
+// microseconds since boot, zero until recorded; 32 bits cover the first hour
+static std::atomic<uint32_t> starts[Boot::PHASES];
+static std::atomic<uint32_t> ends[Boot::PHASES];
+static std::atomic<uint32_t> milestones[Boot::MILESTONES];
+
+static uint32_t now (void)
+{
+    uint32_t time = (uint32_t) esp_timer_get_time ();
+
+    return ((time > 0) ? time : 1);
+}
+
+void Boot::begin (phase which)
+{
+    starts[which].store (now ());
+}
+
+void Boot::end (phase which)
+{
+    ends[which].store (now ());
+}
+
+void Boot::reached (milestone which)
+{
+    // only the first time counts, later calls cost a load
+    if (milestones[which].load (std::memory_order_relaxed) == 0)
+    {
+        uint32_t expected = 0;
+        milestones[which].compare_exchange_strong (expected, now ());
+    }
+}
+
+void Boot::report (void)
+{
+    for (int loop = 0; loop < PHASES; loop++)
+    {
+        uint32_t start = starts[loop].load ();
+        uint32_t end = ends[loop].load ();
+
+        if (start && end)
+        {
+            ESP_LOGI (TAG, "%-10s %7.3f .. %7.3f s, %7.3f s", PHASE_NAMES[loop],
+                    start / 1e6, end / 1e6, (end - start) / 1e6);
+        }
+    }
+
+    for (int loop = 0; loop < MILESTONES; loop++)
+    {
+        uint32_t time = milestones[loop].load ();
+
+        if (time)
+        {
+            ESP_LOGI (TAG, "%-13s at %7.3f s", MILESTONE_NAMES[loop], time / 1e6);
+        }
+    }
+}
+
+// -------
+// metrics
+// -------
+
+//
+// phase durations or milestone times, one sample for each one recorded
+//
+class BootMetric : public Metric
+{
+    public:
+        BootMetric (const char *name, const char *help, bool phases) :
+            Metric (name, NULL, help),
+            _phases (phases)
+        {
+        }
+    protected:
+        virtual const char *type (void)
+        {
+            return ("gauge");
+        }
+        virtual void samples (std::string &output)
+        {
+            int count = _phases ? (int) Boot::PHASES : (int) Boot::MILESTONES;
+
+            for (int loop = 0; loop < count; loop++)
+            {
+                uint32_t start = _phases ? starts[loop].load () : 0;
+                uint32_t end = _phases ? ends[loop].load () : milestones[loop].load ();
+
+                if ((_phases && (start == 0)) || (end == 0))
+                {
+                    continue;
+                }
+
+                std::string label = _phases ? "phase=\"" : "milestone=\"";
+                label += _phases ? PHASE_NAMES[loop] : MILESTONE_NAMES[loop];
+                label += "\"";
+
+                sample (output, NULL, label.c_str (), "%.6f", (end - start) / 1e6);
+            }
+        }
+    private:
+        bool _phases;
+};
+
+static BootMetric phase_metric ("mindbridge_boot_phase_seconds", "Time taken by each start-up phase", true);
+static BootMetric milestone_metric ("mindbridge_boot_milestone_seconds", "Time from boot until each start-up milestone", false);
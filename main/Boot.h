@@ -0,0 +1,47 @@
+#ifndef __BOOT_H__
+#define __BOOT_H__
+
+#include <stdint.h>
+
+// ----
+// boot
+// ----
+
+//
+// start-up timing
+//
+// Each phase of the start-up records when it began and ended, and the
+// milestones a user notices record when they were first reached, all in
+// microseconds since boot. Phases that run in parallel overlap. The times
+// are logged once the bridge is ready and exported as metrics.
+//
+class Boot
+{
+    public:
+        enum phase
+        {
+            NVS,
+            WIFI,
+            MDNS,
+            FILESYSTEM,
+            HTTPD,
+            BLUETOOTH,
+            CAMERA,
+            PHASES
+        };
+        enum milestone
+        {
+            SERVING,
+            FIRST_REQUEST,
+            FIRST_FRAME,
+            READY,
+            MILESTONES
+        };
+    public:
+        static void begin (phase which);
+        static void end (phase which);
+        static void reached (milestone which);
+        static void report (void);
+};
+
+#endif
@@ -0,0 +1,100 @@
+#include "Histogram.h"
+
+Histogram::Histogram ()
+{
+    reset ();
+}
+
+int Histogram::index (uint32_t usec)
+{
+    if (usec < SUBBUCKETS)
+    {
+        return (usec);
+    }
+
+    // the top set bit selects the power of two, the next two bits the sub-bucket
+    int msb = 31 - __builtin_clz (usec);
+    int sub = (usec >> (msb - 2)) & (SUBBUCKETS - 1);
+
+    return ((msb - 1) * SUBBUCKETS + sub);
+}
+
+uint32_t Histogram::upper (int index)
+{
+    if (index < SUBBUCKETS)
+    {
+        return (index);
+    }
+
+    int msb = index / SUBBUCKETS + 1;
+    uint64_t lower = (uint64_t) (SUBBUCKETS + index % SUBBUCKETS) << (msb - 2);
+
+    return ((uint32_t) (lower + (1ULL << (msb - 2)) - 1));
+}
+
+void Histogram::record (uint32_t usec)
+{
+    _buckets[index (usec)].fetch_add (1, std::memory_order_relaxed);
+    _count.fetch_add (1, std::memory_order_relaxed);
+    _sum.fetch_add (usec, std::memory_order_relaxed);
+}
+
+void Histogram::reset (void)
+{
+    for (int loop = 0; loop < BUCKETS; loop++)
+    {
+        _buckets[loop].store (0, std::memory_order_relaxed);
+    }
+
+    _count.store (0, std::memory_order_relaxed);
+    _sum.store (0, std::memory_order_relaxed);
+}
+
+uint32_t Histogram::count (void)
+{
+    return (_count.load (std::memory_order_relaxed));
+}
+
+uint32_t Histogram::sum (void)
+{
+    return (_sum.load (std::memory_order_relaxed));
+}
+
+uint32_t Histogram::bucket (int index)
+{
+    return (_buckets[index].load (std::memory_order_relaxed));
+}
+
+uint32_t Histogram::percentile (float fraction)
+{
+    uint32_t total = count ();
+    if (total == 0)
+    {
+        return (0);
+    }
+
+    // rank of the requested sample, rounded up
+    uint32_t target = (uint32_t) (fraction * total);
+    if (target < fraction * total)
+    {
+        target++;
+    }
+
+    if (target == 0)
+    {
+        target = 1;
+    }
+
+    uint32_t seen = 0;
+    for (int loop = 0; loop < BUCKETS; loop++)
+    {
+        seen += bucket (loop);
+
+        if (seen >= target)
+        {
+            return (upper (loop));
+        }
+    }
+
+    return (upper (BUCKETS - 1));
+}
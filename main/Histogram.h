@@ -0,0 +1,42 @@
+#ifndef __HISTOGRAM_H__
+#define __HISTOGRAM_H__
+
+#include <atomic>
+#include <stdint.h>
+
+// ---------
+// histogram
+// ---------
+
+//
+// fixed-memory latency histogram with logarithmic buckets
+//
+// Each power of two is split into four linear sub-buckets, which keeps the
+// percentile error under 25% from 1us up to about an hour. The exact sum of
+// the samples is kept alongside for averages; it is 32 bits, as the ESP32
+// has no 64 bit atomics, and wraps every 2^32us, about 71 minutes of
+// samples. Recording is a few atomic additions and never allocates or locks.
+//
+class Histogram
+{
+    public:
+        static const int SUBBUCKETS = 4;
+        static const int BUCKETS = 32 * SUBBUCKETS;
+    public:
+        Histogram ();
+        void record (uint32_t usec);
+        void reset (void);
+        uint32_t count (void);
+        uint32_t sum (void);
+        uint32_t percentile (float fraction);
+        uint32_t bucket (int index);
+        static uint32_t upper (int index);
+    private:
+        static int index (uint32_t usec);
+    private:
+        std::atomic<uint32_t> _buckets[BUCKETS];
+        std::atomic<uint32_t> _count;
+        std::atomic<uint32_t> _sum;
+};
+
+#endif
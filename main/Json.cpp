@@ -0,0 +1,248 @@
+#include <math.h>
+
+#include "Json.h"
+
+Json::Json (char *buffer, size_t size) :
+    _buffer (buffer),
+    _size (size),
+    _length (0),
+    _overflow (size == 0),
+    _depth (0),
+    _first (1),
+    _arrays (0)
+{
+    if (size > 0)
+    {
+        _buffer[0] = '\0';
+    }
+}
+
+void Json::put (char character)
+{
+    // keep room for the terminator
+    if (_length + 1 < _size)
+    {
+        _buffer[_length++] = character;
+        _buffer[_length] = '\0';
+    }
+    else
+    {
+        _overflow = true;
+    }
+}
+
+void Json::put (const char *text)
+{
+    while (*text)
+    {
+        put (*text++);
+    }
+}
+
+void Json::number (uint32_t value, int minimum)
+{
+    char digits[10];
+    int count = 0;
+
+    do
+    {
+        digits[count++] = '0' + (value % 10);
+        value /= 10;
+    }
+    while ((value > 0) || (count < minimum));
+
+    while (count > 0)
+    {
+        put (digits[--count]);
+    }
+}
+
+void Json::key (const char *name)
+{
+    // one bit per nesting level records whether a member was written yet
+    if ((_first & (1U << _depth)) == 0)
+    {
+        put (", ");
+    }
+
+    _first &= ~(1U << _depth);
+
+    if (name)
+    {
+        put ('"');
+        put (name);
+        put ("\": ");
+    }
+}
+
+Json &Json::begin (const char *name)
+{
+    open (name, '{');
+
+    return (*this);
+}
+
+Json &Json::array (const char *name)
+{
+    open (name, '[');
+
+    return (*this);
+}
+
+void Json::open (const char *name, char bracket)
+{
+    if (_depth > 0)
+    {
+        key (name);
+    }
+
+    put (bracket);
+
+    if (_depth + 1 < DEPTH)
+    {
+        _depth++;
+        _first |= (1U << _depth);
+
+        // and a bit per level for whether it is an array
+        _arrays = (bracket == '[') ? (_arrays | (1U << _depth)) : (_arrays & ~(1U << _depth));
+    }
+}
+
+Json &Json::end (void)
+{
+    put ((_arrays & (1U << _depth)) ? ']' : '}');
+
+    if (_depth > 0)
+    {
+        _depth--;
+    }
+
+    return (*this);
+}
+
+Json &Json::field (const char *name, int32_t value)
+{
+    key (name);
+
+    if (value < 0)
+    {
+        put ('-');
+        number ((uint32_t) 0 - (uint32_t) value);
+    }
+    else
+    {
+        number ((uint32_t) value);
+    }
+
+    return (*this);
+}
+
+Json &Json::field (const char *name, uint32_t value)
+{
+    key (name);
+    number (value);
+
+    return (*this);
+}
+
+Json &Json::field (const char *name, float value, int decimals)
+{
+    static const uint32_t scales[] = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+
+    key (name);
+
+    decimals = (decimals < 0) ? 0 : ((decimals > 6) ? 6 : decimals);
+
+    // JSON has no representation for these, nor for what overflows 32 bits
+    if (!isfinite (value) || (fabsf (value) >= 4294967295.0f / scales[decimals]))
+    {
+        put ("null");
+        return (*this);
+    }
+
+    uint32_t scaled = (uint32_t) lroundf (fabsf (value) * scales[decimals]);
+
+    if ((value < 0) && (scaled > 0))
+    {
+        put ('-');
+    }
+
+    number (scaled / scales[decimals]);
+
+    if (decimals > 0)
+    {
+        put ('.');
+        number (scaled % scales[decimals], decimals);
+    }
+
+    return (*this);
+}
+
+Json &Json::field (const char *name, const char *value)
+{
+    key (name);
+    put ('"');
+
+    // escape what JSON requires, control characters are dropped
+    for (; *value; value++)
+    {
+        if ((*value == '"') || (*value == '\\'))
+        {
+            put ('\\');
+            put (*value);
+        }
+        else if ((uint8_t) *value >= ' ')
+        {
+            put (*value);
+        }
+    }
+
+    put ('"');
+
+    return (*this);
+}
+
+const char *Json::text (void)
+{
+    return (_buffer);
+}
+
+size_t Json::length (void)
+{
+    return (_length);
+}
+
+bool Json::overflow (void)
+{
+    return (_overflow);
+}
+
+// -----
+// cache
+// -----
+
+JsonCache::JsonCache (void (*render) (Json &json)) :
+    _render (render),
+    _valid (false),
+    _version (0),
+    _length (0)
+{
+    _buffer[0] = '\0';
+}
+
+const char *JsonCache::get (uint32_t version, size_t *length)
+{
+    if (!_valid || (version != _version))
+    {
+        Json json (_buffer, sizeof (_buffer));
+        _render (json);
+
+        _length = json.length ();
+        _version = version;
+        _valid = true;
+    }
+
+    *length = _length;
+
+    return (_buffer);
+}
@@ -0,0 +1,74 @@
+#ifndef __JSON_H__
+#define __JSON_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ----
+// json
+// ----
+
+//
+// streaming JSON writer into a caller-supplied buffer
+//
+// Values are formatted by hand, integers digit by digit and floats as fixed
+// point, so nothing goes through the printf machinery. Separators follow
+// the style the endpoints have always used: `{"key": 1, "other": 2}`, and
+// array elements are fields without a key, `[1, 2]`. Output that does not
+// fit is cut short and flagged; the buffer always stays terminated.
+//
+class Json
+{
+    public:
+        static const int DEPTH = 8;
+    public:
+        Json (char *buffer, size_t size);
+        Json &begin (const char *key = NULL);
+        Json &array (const char *key = NULL);
+        Json &end (void);
+        Json &field (const char *key, int32_t value);
+        Json &field (const char *key, uint32_t value);
+        Json &field (const char *key, float value, int decimals);
+        Json &field (const char *key, const char *value);
+        const char *text (void);
+        size_t length (void);
+        bool overflow (void);
+    private:
+        void key (const char *name);
+        void open (const char *name, char bracket);
+        void put (char character);
+        void put (const char *text);
+        void number (uint32_t value, int minimum = 1);
+    private:
+        char *_buffer;
+        size_t _size;
+        size_t _length;
+        bool _overflow;
+        int _depth;
+        uint32_t _first;
+        uint32_t _arrays;
+};
+
+//
+// response text regenerated only when the state it renders changes
+//
+// The owner bumps a version number whenever anything the response shows
+// changes; get() re-renders only when the version differs from the one the
+// cached text was made for. There is no locking, use it from one task.
+//
+class JsonCache
+{
+    public:
+        static const int SIZE = 256;
+    public:
+        JsonCache (void (*render) (Json &json));
+        const char *get (uint32_t version, size_t *length);
+    private:
+        void (*_render) (Json &json);
+        bool _valid;
+        uint32_t _version;
+        size_t _length;
+        char _buffer[SIZE];
+};
+
+#endif
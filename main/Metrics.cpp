@@ -0,0 +1,246 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+
+#include "Metrics.h"
+
+// constant-initialized, so metrics can register from any static constructor
+Metric *Metric::_first = NULL;
+Metric *Metric::_last = NULL;
+
+Metric::Metric (const char *name, const char *labels, const char *help) :
+    _name (name),
+    _labels (labels ? labels : ""),
+    _help (help),
+    _next (NULL)
+{
+    // keep registration order so the output is stable
+    if (_last)
+    {
+        _last->_next = this;
+    }
+    else
+    {
+        _first = this;
+    }
+
+    _last = this;
+}
+
+Metric::~Metric ()
+{
+}
+
+void Metric::render (std::string &output)
+{
+    for (Metric *metric = _first; metric; metric = metric->_next)
+    {
+        // each family is written once, where its first member registered
+        bool seen = false;
+        for (Metric *earlier = _first; earlier != metric; earlier = earlier->_next)
+        {
+            if (strcmp (earlier->_name, metric->_name) == 0)
+            {
+                seen = true;
+                break;
+            }
+        }
+
+        if (seen)
+        {
+            continue;
+        }
+
+        output += "# HELP ";
+        output += metric->_name;
+        output += " ";
+        output += metric->_help;
+        output += "\n# TYPE ";
+        output += metric->_name;
+        output += " ";
+        output += metric->type ();
+        output += "\n";
+
+        for (Metric *member = metric; member; member = member->_next)
+        {
+            if (strcmp (member->_name, metric->_name) == 0)
+            {
+                member->samples (output);
+            }
+        }
+    }
+}
+
+void Metric::sample (std::string &output, const char *suffix, const char *extra, const char *format, ...)
+{
+    char value[32];
+
+    va_list arguments;
+    va_start (arguments, format);
+    vsnprintf (value, sizeof (value), format, arguments);
+    va_end (arguments);
+
+    output += _name;
+    output += suffix ? suffix : "";
+
+    if (!_labels.empty () || extra)
+    {
+        output += "{";
+        output += _labels;
+        output += (!_labels.empty () && extra) ? "," : "";
+        output += extra ? extra : "";
+        output += "}";
+    }
+
+    output += " ";
+    output += value;
+    output += "\n";
+}
+
+// -------
+// counter
+// -------
+
+Counter::Counter (const char *name, const char *labels, const char *help) :
+    Metric (name, labels, help),
+    _value (0)
+{
+}
+
+uint32_t Counter::value (void)
+{
+    return (_value.load (std::memory_order_relaxed));
+}
+
+const char *Counter::type (void)
+{
+    return ("counter");
+}
+
+void Counter::samples (std::string &output)
+{
+    sample (output, NULL, NULL, "%u", value ());
+}
+
+// -----
+// gauge
+// -----
+
+Gauge::Gauge (const char *name, const char *labels, const char *help, uint32_t (*read) (void)) :
+    Metric (name, labels, help),
+    _read (read)
+{
+}
+
+const char *Gauge::type (void)
+{
+    return ("gauge");
+}
+
+void Gauge::samples (std::string &output)
+{
+    sample (output, NULL, NULL, "%u", _read ());
+}
+
+// -------
+// summary
+// -------
+
+Summary::Summary (const char *name, const char *labels, const char *help, Histogram *histogram) :
+    Metric (name, labels, help),
+    _histogram (histogram),
+    _seen (0),
+    _sum (0)
+{
+}
+
+void Summary::attach (Histogram *histogram)
+{
+    _histogram.store (histogram);
+}
+
+const char *Summary::type (void)
+{
+    return ("summary");
+}
+
+void Summary::samples (std::string &output)
+{
+    Histogram *histogram = _histogram.load ();
+
+    if (histogram == NULL)
+    {
+        return;
+    }
+
+    sample (output, NULL, "quantile=\"0.5\"", "%.6f", histogram->percentile (0.50) / 1e6);
+    sample (output, NULL, "quantile=\"0.9\"", "%.6f", histogram->percentile (0.90) / 1e6);
+    sample (output, NULL, "quantile=\"0.99\"", "%.6f", histogram->percentile (0.99) / 1e6);
+    // the unsigned difference is right across a wrap
+    uint32_t sum = histogram->sum ();
+    _sum += (uint32_t) (sum - _seen);
+    _seen = sum;
+
+    sample (output, "_sum", NULL, "%.6f", _sum / 1e6);
+    sample (output, "_count", NULL, "%u", histogram->count ());
+}
+
+// --------
+// endpoint
+// --------
+
+Endpoint::Endpoint (const char *uri) :
+    _labels (std::string ("uri=\"") + uri + "\""),
+    _requests ("mindbridge_http_requests_total", _labels.c_str (), "Requests handled, by endpoint"),
+    _summary ("mindbridge_http_request_seconds", _labels.c_str (), "Time spent in the request handler, by endpoint", &_latency)
+{
+}
+
+void Endpoint::record (int64_t start)
+{
+    _requests.add ();
+    _latency.record ((uint32_t) (esp_timer_get_time () - start));
+}
+
+Timing::Timing (Endpoint &endpoint) :
+    _endpoint (endpoint),
+    _start (esp_timer_get_time ())
+{
+}
+
+Timing::~Timing ()
+{
+    _endpoint.record (_start);
+}
+
+// ----
+// heap
+// ----
+
+static uint32_t internal_free (void)
+{
+    return (heap_caps_get_free_size (MALLOC_CAP_INTERNAL));
+}
+
+static uint32_t internal_minimum (void)
+{
+    return (heap_caps_get_minimum_free_size (MALLOC_CAP_INTERNAL));
+}
+
+static uint32_t spiram_free (void)
+{
+    return (heap_caps_get_free_size (MALLOC_CAP_SPIRAM));
+}
+
+static uint32_t spiram_minimum (void)
+{
+    return (heap_caps_get_minimum_free_size (MALLOC_CAP_SPIRAM));
+}
+
+static Gauge internal_free_gauge ("mindbridge_heap_free_bytes", "heap=\"internal\"", "Free heap", internal_free);
+static Gauge spiram_free_gauge ("mindbridge_heap_free_bytes", "heap=\"spiram\"", "Free heap", spiram_free);
+static Gauge internal_minimum_gauge ("mindbridge_heap_minimum_free_bytes", "heap=\"internal\"", "Lowest free heap since boot", internal_minimum);
+static Gauge spiram_minimum_gauge ("mindbridge_heap_minimum_free_bytes", "heap=\"spiram\"", "Lowest free heap since boot", spiram_minimum);
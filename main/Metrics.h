@@ -0,0 +1,119 @@
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+
+#include "Histogram.h"
+
+// -------
+// metrics
+// -------
+
+//
+// registry of runtime metrics rendered in the Prometheus text format
+//
+// Metrics are meant to be static objects; each one links itself into the
+// registry when constructed, before the web server can render it. Recording
+// is a relaxed atomic operation and never locks or allocates, so counters
+// can sit on the streaming path. Counters are 32 bits wide and wrap, which
+// Prometheus treats as a counter reset.
+//
+class Metric
+{
+    public:
+        Metric (const char *name, const char *labels, const char *help);
+        virtual ~Metric ();
+        static void render (std::string &output);
+    protected:
+        virtual const char *type (void) = 0;
+        virtual void samples (std::string &output) = 0;
+        void sample (std::string &output, const char *suffix, const char *extra, const char *format, ...);
+    private:
+        const char *_name;
+        std::string _labels;
+        const char *_help;
+        Metric *_next;
+        static Metric *_first;
+        static Metric *_last;
+};
+
+class Counter : public Metric
+{
+    public:
+        Counter (const char *name, const char *labels, const char *help);
+        void add (uint32_t amount = 1)
+        {
+            _value.fetch_add (amount, std::memory_order_relaxed);
+        }
+        uint32_t value (void);
+    protected:
+        virtual const char *type (void);
+        virtual void samples (std::string &output);
+    private:
+        std::atomic<uint32_t> _value;
+};
+
+class Gauge : public Metric
+{
+    public:
+        Gauge (const char *name, const char *labels, const char *help, uint32_t (*read) (void));
+    protected:
+        virtual const char *type (void);
+        virtual void samples (std::string &output);
+    private:
+        uint32_t (*_read) (void);
+};
+
+//
+// latency quantiles and sum of a histogram recorded in microseconds, reported
+// in seconds; a summary without a histogram attached reports nothing
+//
+// The histogram's sum wraps at 32 bits. Each scrape adds what it grew by
+// since the one before to a 64 bit total, which stays right while scrapes
+// come less than 71 minutes of samples apart.
+//
+class Summary : public Metric
+{
+    public:
+        Summary (const char *name, const char *labels, const char *help, Histogram *histogram = NULL);
+        void attach (Histogram *histogram);
+    protected:
+        virtual const char *type (void);
+        virtual void samples (std::string &output);
+    private:
+        std::atomic<Histogram *> _histogram;
+        uint32_t _seen;
+        uint64_t _sum;
+};
+
+//
+// request count and latency of one web server endpoint
+//
+class Endpoint
+{
+    public:
+        Endpoint (const char *uri);
+        void record (int64_t start);
+    private:
+        std::string _labels;
+        Histogram _latency;
+        Counter _requests;
+        Summary _summary;
+};
+
+//
+// times a request from construction until it goes out of scope
+//
+class Timing
+{
+    public:
+        Timing (Endpoint &endpoint);
+        ~Timing ();
+    private:
+        Endpoint &_endpoint;
+        int64_t _start;
+};
+
+#endif
@@ -0,0 +1,267 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "Motion.h"
+
+Motion::Motion (int columns, int rows, int sensitivity, int trigger) :
+    _columns (MIN (MOTION_GRID_MAX, MAX (1, columns))),
+    _rows (MIN (MOTION_GRID_MAX, MAX (1, rows))),
+    _sensitivity (50),
+    _trigger (MIN (100, MAX (0, trigger))),
+    _width (0),
+    _height (0),
+    _luma (NULL),
+    _background (NULL),
+    _events (0),
+    _frames (0)
+{
+    this->sensitivity (sensitivity);
+    reset ();
+}
+
+Motion::~Motion ()
+{
+    free (_luma);
+    free (_background);
+}
+
+//
+// forget the background, the next frame analyzed becomes the new one
+//
+void Motion::reset (void)
+{
+    _learned = false;
+    _level = 0;
+    _triggered = false;
+    memset (_scores, 0, sizeof (_scores));
+}
+
+void Motion::sensitivity (int value)
+{
+    _sensitivity = MIN (100, MAX (1, value));
+}
+
+int Motion::sensitivity (void)
+{
+    return (_sensitivity);
+}
+
+int Motion::trigger (void)
+{
+    return (_trigger);
+}
+
+int Motion::columns (void)
+{
+    return (_columns);
+}
+
+int Motion::rows (void)
+{
+    return (_rows);
+}
+
+// the size of the brightness map, in blocks
+int Motion::width (void)
+{
+    return (_width);
+}
+
+int Motion::height (void)
+{
+    return (_height);
+}
+
+// percentage of the blocks in a region that changed in the last frame
+int Motion::score (int region)
+{
+    if ((region < 0) || (region >= _columns * _rows))
+    {
+        return (0);
+    }
+
+    return (_scores[region]);
+}
+
+// the highest region score
+int Motion::level (void)
+{
+    return (_level);
+}
+
+bool Motion::triggered (void)
+{
+    return (_triggered);
+}
+
+// times the detector triggered
+uint32_t Motion::events (void)
+{
+    return (_events);
+}
+
+uint32_t Motion::frames (void)
+{
+    return (_frames);
+}
+
+// brightness of each block in the last frame, row by row
+const uint8_t *Motion::map (void)
+{
+    return (_luma);
+}
+
+bool Motion::resize (int width, int height)
+{
+    if ((width == _width) && (height == _height) && _luma)
+    {
+        return (true);
+    }
+
+    free (_luma);
+    free (_background);
+
+    _luma = (uint8_t *) malloc (width * height);
+    _background = (uint16_t *) malloc (width * height * sizeof (uint16_t));
+
+    if (!_luma || !_background)
+    {
+        free (_luma);
+        free (_background);
+        _luma = NULL;
+        _background = NULL;
+        _width = 0;
+        _height = 0;
+
+        return (false);
+    }
+
+    _width = width;
+    _height = height;
+    reset ();
+
+    return (true);
+}
+
+bool Motion::block (void *argument, const jpg_coeff_info_t *info, const jpg_coeff_block_t *block)
+{
+    Motion *motion = (Motion *) argument;
+
+    // the MCU padding past the right and bottom edges is left out
+    if ((block->component == 0) && (block->x < motion->_width) && (block->y < motion->_height))
+    {
+        // the DC coefficient is eight times the block's mean, less the level shift
+        int value = block->coef[0] * info->quant[info->component[0].tq][0] / 8 + 128;
+
+        motion->_luma[block->y * motion->_width + block->x] = MIN (255, MAX (0, value));
+    }
+
+    return (true);
+}
+
+//
+// decode the brightness map of a frame and compare it with the background
+//
+esp_err_t Motion::analyze (const uint8_t *jpeg, size_t length)
+{
+    // a frame cut short would show its missing part as motion
+    if ((length < 4) || (jpeg[length - 2] != 0xff) || (jpeg[length - 1] != 0xd9))
+    {
+        return (ESP_ERR_INVALID_SIZE);
+    }
+
+    jpg_coeff_info_t info;
+    esp_err_t err = esp_jpg_coeff_info (jpeg, length, &info);
+
+    if (err != ESP_OK)
+    {
+        return (err);
+    }
+
+    if (!resize ((info.width + 7) / 8, (info.height + 7) / 8))
+    {
+        return (ESP_ERR_NO_MEM);
+    }
+
+    err = esp_jpg_coeff_decode (jpeg, length, JPG_COEFF_DC, block, this, NULL);
+    if (err != ESP_OK)
+    {
+        return (err);
+    }
+
+    compare ();
+    _frames++;
+
+    return (ESP_OK);
+}
+
+void Motion::compare (void)
+{
+    int count = _width * _height;
+
+    // the first frame of a size is the background
+    if (!_learned)
+    {
+        for (int loop = 0; loop < count; loop++)
+        {
+            _background[loop] = _luma[loop] << 8;
+        }
+
+        _learned = true;
+        return;
+    }
+
+    // the exposure moving or a light switched on changes every block alike
+    int32_t shift = 0;
+    for (int loop = 0; loop < count; loop++)
+    {
+        shift += _luma[loop] - (_background[loop] >> 8);
+    }
+    shift /= count;
+
+    // from 50 brightness levels at the least sensitive down to 2
+    int threshold = 2 + ((100 - _sensitivity) * 48) / 99;
+
+    uint16_t changed[MOTION_REGIONS_MAX];
+    uint16_t total[MOTION_REGIONS_MAX];
+    memset (changed, 0, sizeof (changed));
+    memset (total, 0, sizeof (total));
+
+    for (int y = 0; y < _height; y++)
+    {
+        int row = (y * _rows / _height) * _columns;
+
+        for (int x = 0; x < _width; x++)
+        {
+            int index = y * _width + x;
+            int region = row + x * _columns / _width;
+            int difference = _luma[index] - (_background[index] >> 8) - shift;
+            bool moved = (difference > threshold) || (difference < -threshold);
+
+            total[region]++;
+            changed[region] += moved;
+
+            // a changed block is learned slowly, so something moving through
+            // is not taken into the background but something moved in is
+            int target = _luma[index] << 8;
+            _background[index] += (target - _background[index]) / (moved ? 64 : 8);
+        }
+    }
+
+    _level = 0;
+    for (int region = 0; region < _columns * _rows; region++)
+    {
+        _scores[region] = total[region] ? (changed[region] * 100 / total[region]) : 0;
+        _level = MAX (_level, (int) _scores[region]);
+    }
+
+    // count an event when the detector starts triggering
+    bool triggered = (_trigger > 0) && (_level >= _trigger);
+    if (triggered && !_triggered)
+    {
+        _events++;
+    }
+
+    _triggered = triggered;
+}
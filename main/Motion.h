@@ -0,0 +1,73 @@
+#ifndef __MOTION_H__
+#define __MOTION_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_jpg_coeff.h"
+
+// ------
+// motion
+// ------
+
+// the region grid is at most this many columns and rows
+#define MOTION_GRID_MAX     (8)
+#define MOTION_REGIONS_MAX  (MOTION_GRID_MAX * MOTION_GRID_MAX)
+
+//
+// motion detection on the DC coefficients of JPEG frames
+//
+// Only the entropy coded data is read, the DC coefficient of every luma
+// block gives the frame's brightness at 1/8 scale, 80x60 for VGA, with no
+// IDCT. Each block is compared with a running average of the scene; a
+// block whose brightness moved further than the sensitivity allows, after
+// taking out a change of the whole frame's brightness, counts as changed.
+// The frame is split into a grid of regions and each region scores the
+// percentage of its blocks that changed. The detector triggers while any
+// region scores at least the trigger percentage.
+//
+// The background starts over when the frame size changes.
+//
+class Motion
+{
+    public:
+        Motion (int columns, int rows, int sensitivity, int trigger);
+        ~Motion ();
+        esp_err_t analyze (const uint8_t *jpeg, size_t length);
+        void reset (void);
+        void sensitivity (int value);
+        int sensitivity (void);
+        int trigger (void);
+        int columns (void);
+        int rows (void);
+        int width (void);
+        int height (void);
+        int score (int region);
+        int level (void);
+        bool triggered (void);
+        uint32_t events (void);
+        uint32_t frames (void);
+        const uint8_t *map (void);
+    private:
+        static bool block (void *argument, const jpg_coeff_info_t *info, const jpg_coeff_block_t *block);
+        bool resize (int width, int height);
+        void compare (void);
+    private:
+        int _columns;
+        int _rows;
+        int _sensitivity;
+        int _trigger;
+        int _width;
+        int _height;
+        uint8_t *_luma;
+        uint16_t *_background;
+        bool _learned;
+        uint8_t _scores[MOTION_REGIONS_MAX];
+        int _level;
+        bool _triggered;
+        uint32_t _events;
+        uint32_t _frames;
+};
+
+#endif
@@ -0,0 +1,215 @@
+#ifndef __NXT_H__
+#define __NXT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <tuple>
+
+// -----------------------
+// NXT direct command codec
+// -----------------------
+
+//
+// Each direct command and reply is described once as a list of field types.
+// The message sizes and field offsets are computed at compile time, encoders
+// write the little endian wire format straight into the caller's buffer and
+// decoders read fields in place.
+//
+// http://kio4.com/b4a/programas/Appendix%202-LEGO%20MINDSTORMS%20NXT%20Direct%20commands.pdf
+//
+namespace nxt
+{
+    // Bluetooth messages carry a two byte length ahead of at most 64 bytes
+    static const size_t HEADER = 2;
+    static const size_t MAXIMUM = 64;
+
+    // command types
+    static const uint8_t DIRECT = 0x00;
+    static const uint8_t NO_REPLY = 0x80;
+    static const uint8_t REPLY = 0x02;
+
+    // little endian field access
+    template <typename T> inline void store (uint8_t *data, T value)
+    {
+        for (size_t loop = 0; loop < sizeof (T); loop++)
+        {
+            data[loop] = (uint8_t) ((uint32_t) value >> (8 * loop));
+        }
+    }
+
+    template <typename T> inline T load (const uint8_t *data)
+    {
+        uint32_t value = 0;
+
+        for (size_t loop = 0; loop < sizeof (T); loop++)
+        {
+            value |= (uint32_t) data[loop] << (8 * loop);
+        }
+
+        return ((T) value);
+    }
+
+    // total size of a list of fields
+    template <typename... FIELDS> struct sizes;
+
+    template <> struct sizes<>
+    {
+        static const size_t value = 0;
+    };
+
+    template <typename FIRST, typename... REST> struct sizes<FIRST, REST...>
+    {
+        static const size_t value = sizeof (FIRST) + sizes<REST...>::value;
+    };
+
+    // offset of field N within a list of fields
+    template <size_t N, typename... FIELDS> struct offset;
+
+    template <typename FIRST, typename... REST> struct offset<0, FIRST, REST...>
+    {
+        static const size_t value = 0;
+    };
+
+    template <size_t N, typename FIRST, typename... REST> struct offset<N, FIRST, REST...>
+    {
+        static const size_t value = sizeof (FIRST) + offset<N - 1, REST...>::value;
+    };
+
+    // serialize a list of field values
+    inline void put (uint8_t *)
+    {
+    }
+
+    template <typename FIRST, typename... REST> inline void put (uint8_t *data, FIRST first, REST... rest)
+    {
+        store<FIRST> (data, first);
+        put (data + sizeof (FIRST), rest...);
+    }
+
+    //
+    // direct command: [length] [type] [opcode] [fields...]
+    //
+    template <uint8_t OPCODE, bool REPLIES, typename... FIELDS> struct command
+    {
+        static const uint8_t opcode = OPCODE;
+        static const bool replies = REPLIES;
+        static const size_t size = HEADER + 2 + sizes<FIELDS...>::value;
+
+        static_assert (size <= HEADER + MAXIMUM, "NXT messages are limited to 64 bytes");
+
+        static size_t encode (uint8_t *data, FIELDS... values)
+        {
+            store<uint16_t> (data, size - HEADER);
+            data[2] = REPLIES ? DIRECT : (DIRECT | NO_REPLY);
+            data[3] = OPCODE;
+            put (data + 4, values...);
+
+            return (size);
+        }
+    };
+
+    //
+    // reply: [length] [0x02] [opcode] [status] [fields...]
+    //
+    template <uint8_t OPCODE, typename... FIELDS> struct reply
+    {
+        static const uint8_t opcode = OPCODE;
+        static const size_t size = HEADER + 3 + sizes<FIELDS...>::value;
+
+        static_assert (size <= HEADER + MAXIMUM, "NXT messages are limited to 64 bytes");
+
+        template <size_t N> using type = typename std::tuple_element<N, std::tuple<FIELDS...> >::type;
+
+        static bool match (const uint8_t *data)
+        {
+            return ((data[2] == REPLY) && (data[3] == OPCODE));
+        }
+
+        static uint8_t status (const uint8_t *data)
+        {
+            return (data[4]);
+        }
+
+        template <size_t N> static type<N> get (const uint8_t *data)
+        {
+            return (load<type<N> > (data + HEADER + 3 + offset<N, FIELDS...>::value));
+        }
+    };
+
+    // -------------------
+    // supported messages
+    // -------------------
+
+    // tone frequency (Hz), duration (ms)
+    typedef command<0x03, false, uint16_t, uint16_t> PlayTone;
+
+    // port, power, mode, regulation mode, turn ratio, run state, tacho limit
+    typedef command<0x04, false, uint8_t, int8_t, uint8_t, uint8_t, int8_t, uint8_t, uint32_t> SetOutputState;
+
+    // port
+    typedef command<0x06, true, uint8_t> GetOutputState;
+
+    // port, power, mode, regulation mode, turn ratio, run state, tacho limit,
+    // tacho count, block tacho count, rotation count
+    typedef reply<0x06, uint8_t, int8_t, uint8_t, uint8_t, int8_t, uint8_t, uint32_t,
+            int32_t, int32_t, int32_t> OutputState;
+
+    // port
+    typedef command<0x07, true, uint8_t> GetInputValues;
+
+    // port, valid, calibrated, sensor type, sensor mode, raw A/D value,
+    // normalized A/D value, scaled value, calibrated value
+    typedef reply<0x07, uint8_t, uint8_t, uint8_t, uint8_t, uint8_t, uint16_t,
+            uint16_t, int16_t, int16_t> InputValues;
+
+    typedef command<0x0b, true> GetBatteryLevel;
+
+    // voltage (mV)
+    typedef reply<0x0b, uint16_t> BatteryLevel;
+
+    typedef command<0x0d, true> KeepAlive;
+
+    // sleep time limit (ms)
+    typedef reply<0x0d, uint32_t> SleepTime;
+
+    // output modes
+    static const uint8_t MOTORON = 0x01;
+    static const uint8_t BRAKE = 0x02;
+    static const uint8_t REGULATED = 0x04;
+
+    // output run states
+    static const uint8_t RUNSTATE_IDLE = 0x00;
+    static const uint8_t RUNSTATE_RUNNING = 0x20;
+
+    // size of the reply to an opcode, zero if the opcode is not known
+    inline size_t reply_size (uint8_t opcode)
+    {
+        switch (opcode)
+        {
+            case OutputState::opcode:
+                return (OutputState::size);
+            case InputValues::opcode:
+                return (InputValues::size);
+            case BatteryLevel::opcode:
+                return (BatteryLevel::size);
+            case SleepTime::opcode:
+                return (SleepTime::size);
+            default:
+                return (0);
+        }
+    }
+
+    // the wire sizes the robot firmware expects
+    static_assert (PlayTone::size == 8, "PLAYTONE is 6 bytes");
+    static_assert (SetOutputState::size == 14, "SETOUTPUTSTATE is 12 bytes");
+    static_assert (GetOutputState::size == 5, "GETOUTPUTSTATE is 3 bytes");
+    static_assert (OutputState::size == 27, "GETOUTPUTSTATE reply is 25 bytes");
+    static_assert (GetInputValues::size == 5, "GETINPUTVALUES is 3 bytes");
+    static_assert (InputValues::size == 18, "GETINPUTVALUES reply is 16 bytes");
+    static_assert (GetBatteryLevel::size == 4, "GETBATTERYLEVEL is 2 bytes");
+    static_assert (BatteryLevel::size == 7, "GETBATTERYLEVEL reply is 5 bytes");
+    static_assert (KeepAlive::size == 4, "KEEPALIVE is 2 bytes");
+    static_assert (SleepTime::size == 9, "KEEPALIVE reply is 7 bytes");
+}
+
+#endif
@@ -0,0 +1,150 @@
+#include <limits.h>
+#include <string.h>
+#include <strings.h>
+
+#include "Query.h"
+
+Query::Query (httpd_req_t *request)
+{
+    parse (request->uri);
+}
+
+Query::Query (const char *uri)
+{
+    parse (uri);
+}
+
+void Query::parse (const char *uri)
+{
+    _count = 0;
+
+    // skip the path
+    const char *cursor = uri;
+    while (*cursor && (*cursor != '?'))
+    {
+        cursor++;
+    }
+
+    // fields are separated by '&', a field without '=' has an empty value
+    while (*cursor && (_count < FIELDS))
+    {
+        cursor++;
+
+        const char *key = cursor;
+        while (*cursor && (*cursor != '=') && (*cursor != '&'))
+        {
+            cursor++;
+        }
+
+        const char *end = cursor;
+        const char *value = cursor;
+
+        if (*cursor == '=')
+        {
+            value = ++cursor;
+            while (*cursor && (*cursor != '&'))
+            {
+                cursor++;
+            }
+        }
+
+        // empty keys ("&&", "?=1") are dropped
+        if ((end > key) && (end - key <= UINT16_MAX) && (cursor - value <= UINT16_MAX))
+        {
+            field &entry = _fields[_count++];
+
+            entry.key = key;
+            entry.key_length = end - key;
+            entry.value = value;
+            entry.value_length = cursor - value;
+        }
+    }
+}
+
+int Query::find (const char *key)
+{
+    size_t length = strlen (key);
+
+    for (int loop = 0; loop < _count; loop++)
+    {
+        if ((_fields[loop].key_length == length) && (strncasecmp (_fields[loop].key, key, length) == 0))
+        {
+            return (loop);
+        }
+    }
+
+    return (-1);
+}
+
+int Query::count (void)
+{
+    return (_count);
+}
+
+bool Query::has (const char *key)
+{
+    return (find (key) >= 0);
+}
+
+const char *Query::value (const char *key, size_t *length)
+{
+    int index = find (key);
+    if (index < 0)
+    {
+        return (NULL);
+    }
+
+    *length = _fields[index].value_length;
+
+    return (_fields[index].value);
+}
+
+bool Query::integer (const char *key, long *value)
+{
+    size_t length = 0;
+    const char *text = Query::value (key, &length);
+
+    if (text == NULL)
+    {
+        return (false);
+    }
+
+    // optional sign and decimal digits, nothing else, saturating on overflow
+    size_t position = 0;
+    bool negative = false;
+
+    if ((length > 0) && ((text[0] == '-') || (text[0] == '+')))
+    {
+        negative = (text[0] == '-');
+        position++;
+    }
+
+    if (position == length)
+    {
+        return (false);
+    }
+
+    long result = 0;
+    for (; position < length; position++)
+    {
+        if ((text[position] < '0') || (text[position] > '9'))
+        {
+            return (false);
+        }
+
+        int digit = text[position] - '0';
+
+        if (result > (LONG_MAX - digit) / 10)
+        {
+            result = LONG_MAX;
+        }
+        else
+        {
+            result = result * 10 + digit;
+        }
+    }
+
+    *value = negative ? -result : result;
+
+    return (true);
+}
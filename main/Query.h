@@ -0,0 +1,49 @@
+#ifndef __QUERY_H__
+#define __QUERY_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_http_server.h"
+
+// -----
+// query
+// -----
+
+//
+// single-pass tokenizer for a request's query string
+//
+// The constructor walks the query once and records where each key and value
+// start in the request URI itself, so nothing is copied or allocated and the
+// object lives on the handler's stack. Lookups compare keys the way
+// httpd_query_key_value does, ignoring case, and the first of repeated keys
+// wins. Fields beyond FIELDS are ignored.
+//
+class Query
+{
+    public:
+        static const int FIELDS = 8;
+    public:
+        Query (httpd_req_t *request);
+        Query (const char *uri);
+        int count (void);
+        bool has (const char *key);
+        bool integer (const char *key, long *value);
+        const char *value (const char *key, size_t *length);
+    private:
+        void parse (const char *uri);
+        int find (const char *key);
+    private:
+        struct field
+        {
+            const char *key;
+            const char *value;
+            uint16_t key_length;
+            uint16_t value_length;
+        };
+    private:
+        field _fields[FIELDS];
+        int _count;
+};
+
+#endif
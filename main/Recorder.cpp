@@ -0,0 +1,310 @@
+#include <string.h>
+
+#include "esp_heap_caps.h"
+
+#include "Recorder.h"
+
+// records start on this boundary, so their headers are aligned
+#define RECORD_ALIGN    (8)
+
+Recorder::Recorder (size_t size) :
+    _buffer (NULL),
+    _size (0),
+    _oldest (0),
+    _next (0),
+    _end (0),
+    _newest (0),
+    _wrapped (false),
+    _count (0),
+    _bytes (0),
+    _sequence (0),
+    _overwritten (0),
+    _frozen (false),
+    _clip (0),
+    _clip_offset (0),
+    _clip_frames (0),
+    _clip_bytes (0)
+{
+    size &= ~(size_t) (RECORD_ALIGN - 1);
+
+    if (size > sizeof (record_t))
+    {
+        _buffer = (uint8_t *) heap_caps_malloc (size, MALLOC_CAP_SPIRAM);
+    }
+
+    if (_buffer)
+    {
+        _size = size;
+    }
+}
+
+Recorder::~Recorder ()
+{
+    heap_caps_free (_buffer);
+}
+
+// false when there is no PSRAM for the ring, or it was sized 0
+bool Recorder::enabled (void)
+{
+    return (_buffer != NULL);
+}
+
+bool Recorder::frozen (void)
+{
+    return (_frozen);
+}
+
+// the number of the last clip frozen, 0 before the first
+uint32_t Recorder::clip (void)
+{
+    return (_clip);
+}
+
+size_t Recorder::size (void)
+{
+    return (_size);
+}
+
+// frames in the ring
+uint32_t Recorder::frames (void)
+{
+    return (_count);
+}
+
+// JPEG data in the ring, without the record headers
+size_t Recorder::bytes (void)
+{
+    return (_bytes);
+}
+
+// capture time of the oldest frame in the ring, in microseconds
+int64_t Recorder::oldest (void)
+{
+    return (_count ? at (_oldest)->timestamp : 0);
+}
+
+int64_t Recorder::newest (void)
+{
+    return (_count ? at (_newest)->timestamp : 0);
+}
+
+// frames ever recorded
+uint32_t Recorder::recorded (void)
+{
+    return (_sequence);
+}
+
+// frames dropped from the ring to make room for newer ones
+uint32_t Recorder::overwritten (void)
+{
+    return (_overwritten);
+}
+
+uint32_t Recorder::clip_frames (void)
+{
+    return (_frozen ? _clip_frames : 0);
+}
+
+size_t Recorder::clip_bytes (void)
+{
+    return (_frozen ? _clip_bytes : 0);
+}
+
+int64_t Recorder::clip_start (void)
+{
+    return ((_frozen && _clip_frames) ? at (_clip_offset)->timestamp : 0);
+}
+
+int64_t Recorder::clip_end (void)
+{
+    return ((_frozen && _clip_frames) ? at (_newest)->timestamp : 0);
+}
+
+Recorder::record_t *Recorder::at (size_t offset)
+{
+    return ((record_t *) (_buffer + offset));
+}
+
+// the room a frame of this length takes, header included
+size_t Recorder::span (size_t length)
+{
+    return ((sizeof (record_t) + length + RECORD_ALIGN - 1) & ~(size_t) (RECORD_ALIGN - 1));
+}
+
+// the offset of the record after the one at offset
+size_t Recorder::advance (size_t offset)
+{
+    offset += span (at (offset)->length);
+
+    // the frames after the end of a wrapped ring start over at the beginning
+    if (_wrapped && (offset == _end))
+    {
+        offset = 0;
+    }
+
+    return (offset);
+}
+
+void Recorder::drop (void)
+{
+    _bytes -= at (_oldest)->length;
+    _count--;
+    _overwritten++;
+
+    if (_count == 0)
+    {
+        _oldest = 0;
+        _next = 0;
+        _wrapped = false;
+        return;
+    }
+
+    // past the end, the oldest frame is back at the start ahead of the newest
+    if (_wrapped && (_oldest + span (at (_oldest)->length) == _end))
+    {
+        _oldest = 0;
+        _wrapped = false;
+        return;
+    }
+
+    _oldest += span (at (_oldest)->length);
+}
+
+//
+// copy a frame into the ring, dropping as many of the oldest as it takes
+//
+// Unwrapped, the frames lie between the oldest and the next offset and the
+// free room is after them and before them. Wrapped, they run from the
+// oldest to the end mark and on from the start up to the next offset, and
+// the free room lies between the two.
+//
+bool Recorder::record (const uint8_t *data, size_t length, int64_t timestamp)
+{
+    size_t need = span (length);
+
+    if (!_buffer || _frozen || (need > _size))
+    {
+        return (false);
+    }
+
+    while (_count > 0)
+    {
+        if (!_wrapped)
+        {
+            if (_size - _next >= need)
+            {
+                break;
+            }
+
+            // no room before the end of the buffer, start over at the beginning
+            _end = _next;
+            _next = 0;
+            _wrapped = true;
+        }
+        else
+        {
+            if (_oldest - _next >= need)
+            {
+                break;
+            }
+
+            drop ();
+        }
+    }
+
+    record_t *record = at (_next);
+    record->length = length;
+    record->timestamp = timestamp;
+    memcpy (record + 1, data, length);
+
+    _newest = _next;
+    _next += need;
+    _bytes += length;
+    _count++;
+    _sequence++;
+
+    return (true);
+}
+
+//
+// stop recording and mark the frames of the last seconds as the clip
+//
+// The clip runs from the first frame taken no more than the given seconds
+// before the newest, up to the newest. It stays until release.
+//
+bool Recorder::freeze (uint32_t seconds)
+{
+    if (!_buffer || _frozen || (_count == 0))
+    {
+        return (false);
+    }
+
+    int64_t start = at (_newest)->timestamp - seconds * 1000000LL;
+    size_t offset = _oldest;
+    uint32_t remaining = _count;
+
+    while ((remaining > 1) && (at (offset)->timestamp < start))
+    {
+        offset = advance (offset);
+        remaining--;
+    }
+
+    _clip_offset = offset;
+    _clip_frames = remaining;
+    _clip_bytes = 0;
+
+    for (uint32_t loop = 0; loop < remaining; loop++)
+    {
+        _clip_bytes += at (offset)->length;
+        offset = advance (offset);
+    }
+
+    _frozen = true;
+    _clip++;
+
+    return (true);
+}
+
+// forget the clip and go on recording where it stopped
+void Recorder::release (void)
+{
+    _frozen = false;
+}
+
+// start reading the clip from its first frame
+bool Recorder::rewind (cursor &position)
+{
+    position.clip = _clip;
+    position.offset = _clip_offset;
+    position.remaining = _frozen ? _clip_frames : 0;
+
+    return (_frozen);
+}
+
+//
+// the next frame of the clip, NULL at its end or once the clip has gone
+//
+const uint8_t *Recorder::next (cursor &position, size_t *length, int64_t *timestamp)
+{
+    if (!_frozen || (position.clip != _clip) || (position.remaining == 0))
+    {
+        return (NULL);
+    }
+
+    record_t *record = at (position.offset);
+
+    if (length)
+    {
+        *length = record->length;
+    }
+
+    if (timestamp)
+    {
+        *timestamp = record->timestamp;
+    }
+
+    position.offset = advance (position.offset);
+    position.remaining--;
+
+    return ((const uint8_t *) (record + 1));
+}
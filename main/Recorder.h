@@ -0,0 +1,86 @@
+#ifndef __RECORDER_H__
+#define __RECORDER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --------
+// recorder
+// --------
+
+//
+// a ring of the most recent JPEG frames, kept in PSRAM
+//
+// The ring is one buffer allocated when the recorder is made; recording a
+// frame copies it in behind a small header with its length, sequence
+// number and capture time, and drops the oldest frames to make room, so
+// nothing is allocated while recording. A frame that does not fit before
+// the end of the buffer starts over at its beginning.
+//
+// Freezing stops the recording and marks the frames of the last seconds
+// as the clip, which can then be read out frame by frame until the
+// recorder is released. Every freeze starts a new clip number, so a
+// reader can tell when the clip it was reading has gone.
+//
+class Recorder
+{
+    public:
+        struct cursor
+        {
+            uint32_t clip;
+            size_t offset;
+            uint32_t remaining;
+        };
+    public:
+        Recorder (size_t size);
+        ~Recorder ();
+        bool enabled (void);
+        bool record (const uint8_t *data, size_t length, int64_t timestamp);
+        bool freeze (uint32_t seconds);
+        void release (void);
+        bool frozen (void);
+        uint32_t clip (void);
+        size_t size (void);
+        uint32_t frames (void);
+        size_t bytes (void);
+        int64_t oldest (void);
+        int64_t newest (void);
+        uint32_t recorded (void);
+        uint32_t overwritten (void);
+        uint32_t clip_frames (void);
+        size_t clip_bytes (void);
+        int64_t clip_start (void);
+        int64_t clip_end (void);
+        bool rewind (cursor &position);
+        const uint8_t *next (cursor &position, size_t *length, int64_t *timestamp);
+    private:
+        struct record_t
+        {
+            int64_t timestamp;
+            uint32_t length;
+        };
+    private:
+        record_t *at (size_t offset);
+        size_t span (size_t length);
+        size_t advance (size_t offset);
+        void drop (void);
+    private:
+        uint8_t *_buffer;
+        size_t _size;
+        size_t _oldest;
+        size_t _next;
+        size_t _end;
+        size_t _newest;
+        bool _wrapped;
+        uint32_t _count;
+        size_t _bytes;
+        uint32_t _sequence;
+        uint32_t _overwritten;
+        bool _frozen;
+        uint32_t _clip;
+        size_t _clip_offset;
+        uint32_t _clip_frames;
+        size_t _clip_bytes;
+};
+
+#endif
@@ -2,83 +2,30 @@
 
 #include "esp_log.h"
 #include "esp_spp_api.h"
+#include "esp_timer.h"
 
+#include "Json.h"
+#include "Metrics.h"
 #include "Robot.h"
 
+static Counter spp_writes ("mindbridge_spp_writes_total", NULL, "Commands written to the SPP link");
+static Counter spp_congestion ("mindbridge_spp_congestion_total", NULL, "Times the SPP link reported congestion");
+static Summary command_latency ("mindbridge_robot_command_seconds", NULL, "Round trip of robot commands that expect a reply");
+
 void Robot_task (void *parameters)
 {
     Robot *robot = (Robot *) parameters;
 
-    int8_t output[3];
-    output[0] = 0;
-    output[1] = 0;
-    output[2] = 0;
+    TickType_t wait = portMAX_DELAY;
 
     while (true)
     {
-        if (xSemaphoreTake (robot->_semaphore, portMAX_DELAY))
-        {
-            int8_t pending[3];
+        // sleep until a command is queued, the link clears congestion or a
+        // telemetry poll is due
+        ulTaskNotifyTake (pdTRUE, wait);
 
-            for (int loop = 0; loop < 3; loop++)
-            {
-                pending[loop] = robot->_output[loop];
-            }
-
-            xSemaphoreGive (robot->_semaphore);
-
-            for (int loop = 0; loop < 3; loop++)
-            {
-                if (output[loop] != pending[loop])
-                {
-                    output[loop] = pending[loop];
-                    //robot->motor (loop, output[loop]);
-
-                    const unsigned int length = 14;
-                    uint8_t message[length];
-
-                    // http://kio4.com/b4a/programas/Appendix%202-LEGO%20MINDSTORMS%20NXT%20Direct%20commands.pdf
-                    // http://www.robotappstore.com/Knowledge-Base/-How-to-Control-Lego-NXT-Motors/81.html
-
-                    // mode, byte #6
-                    //    2 1 0
-                    // 0: 0 0 0 - coast
-                    // 1: 0 0 1 - motor on
-                    // 2: 0 1 0 - break mode (modifier)
-                    // 3: 0 1 1 - motor on | break mode
-                    // 4: 1 0 0 - regulated mode (modifier)
-                    // 5: 1 0 1 - motor on | regulated mode
-                    // 6: 1 1 0 - NA
-                    // 7: 1 1 1 - motor on | regulated mode | break mode
-                    //
-                    message[0] = length - 2;
-                    message[1] = 0;
-
-                    message[2] = 0x80; // direct command with no reply
-                    message[3] = 0x04; // set output state command
-                    message[4] = loop;
-                    message[5] = (uint8_t) output[loop];
-                    message[6] = 0x07; // motor on
-                    message[7] = 0x00; // no regulation 
-                    message[8] = 0x00; // no turn ratio
-                    message[9] = 0x20; // running
-                    message[10] = 0;
-                    message[11] = 0;
-                    message[12] = 0;
-                    message[13] = 0;
-
-                    if (output[loop] == 0)
-                    {
-                        message[6] = 0; // coast
-                        message[9] = 0x00; // disable power
-                    }
-
-                    robot->command (message);
-                }
-            }
-        }
-
-        vTaskDelay (10 / portTICK_PERIOD_MS);
+        wait = robot->poll ();
+        robot->flush ();
     }
 }
 
@@ -86,8 +33,10 @@ Robot::Robot (std::string name, LED *led) :
     _connected (false),
     _handle (0),
     _battery (0.0),
-    _keepalive (0.0)
-
+    _keepalive (0.0),
+    _outstanding (0),
+    _lost (0),
+    _last (0)
 {
     _name = name;
     _led = led;
@@ -95,12 +44,25 @@ Robot::Robot (std::string name, LED *led) :
     _output[1] = 0;
     _output[2] = 0;
 
+    // configure the telemetry poll rates
+    _telemetry.period (0, CONFIG_MINDBRIDGE_TELEMETRY_S1_PERIOD);
+    _telemetry.period (1, CONFIG_MINDBRIDGE_TELEMETRY_S2_PERIOD);
+    _telemetry.period (2, CONFIG_MINDBRIDGE_TELEMETRY_S3_PERIOD);
+    _telemetry.period (3, CONFIG_MINDBRIDGE_TELEMETRY_S4_PERIOD);
+
+    for (int port = 0; port < TELEMETRY_OUTPUTS; port++)
+    {
+        _telemetry.period (TELEMETRY_INPUTS + port, CONFIG_MINDBRIDGE_TELEMETRY_TACHO_PERIOD);
+    }
+
+    command_latency.attach (&_latency);
+
     // create and take the semaphore
     _semaphore = xSemaphoreCreateBinary ();
 
     // start the LED control task
     _task = NULL;
-    xTaskCreate (Robot_task, "Robot_task", 4096, (void *) this, tskIDLE_PRIORITY, &_task);
+    xTaskCreate (Robot_task, "Robot_task", 4096, (void *) this, ROBOT_PRIORITY, &_task);
 
     // release the semaphore
     xSemaphoreGive (_semaphore);
@@ -122,106 +84,344 @@ bool Robot::connected (void)
 
 bool Robot::connected (bool state, uint32_t handle)
 {
+    // anything queued for a previous connection is stale
+    if (xSemaphoreTake (_semaphore, portMAX_DELAY))
+    {
+        _scheduler.clear ();
+        _scheduler.congested (false);
+        _telemetry.reset ();
+
+        xSemaphoreGive (_semaphore);
+    }
+
     _connected = state;
     _handle = handle;
 
+    // start polling on a new connection
+    if (_connected)
+    {
+        xTaskNotifyGive (_task);
+    }
+
     return (connected ());
 }
 
 void Robot::battery (void)
 {
-    const unsigned int length = 2 + 2;
-    uint8_t message[length];
+    send<nxt::GetBatteryLevel> (Scheduler::TELEMETRY, nxt::GetBatteryLevel::opcode);
+}
+
+void Robot::keepalive (void)
+{
+    send<nxt::KeepAlive> (Scheduler::TELEMETRY, nxt::KeepAlive::opcode);
+}
 
-    message[0] = length - 2;
-    message[1] = 0;
+void Robot::beep (void)
+{
+    // 523 Hz for 500 ms
+    send<nxt::PlayTone> (Scheduler::TONE, -1, 0x020b, 0x01f4);
+}
 
-    message[2] = 0x00; // direct command and reply
-    message[3] = 0x0b; // get battery level
+void Robot::motor (uint8_t port, int8_t speed)
+{
+    if ((port != 0) && (port != 1) && (port != 2))
+    {
+        return;
+    }
+
+    // only send setpoints that change the motor state
+    if (xSemaphoreTake (_semaphore, portMAX_DELAY))
+    {
+        bool changed = (_output[port] != speed);
+        _output[port] = speed;
 
-    // response:
-    // [0][1] = lsb and msb of length
-    // [2] = command type
-    // [3] = command
-    // [4] = command status
+        xSemaphoreGive (_semaphore);
 
-    command (message);
+        if (!changed)
+        {
+            return;
+        }
+    }
+    else
+    {
+        return;
+    }
+
+    // http://www.robotappstore.com/Knowledge-Base/-How-to-Control-Lego-NXT-Motors/81.html
+
+    // mode
+    //    2 1 0
+    // 0: 0 0 0 - coast
+    // 1: 0 0 1 - motor on
+    // 2: 0 1 0 - break mode (modifier)
+    // 3: 0 1 1 - motor on | break mode
+    // 4: 1 0 0 - regulated mode (modifier)
+    // 5: 1 0 1 - motor on | regulated mode
+    // 6: 1 1 0 - NA
+    // 7: 1 1 1 - motor on | regulated mode | break mode
+    //
+    uint8_t mode = nxt::MOTORON | nxt::BRAKE | nxt::REGULATED;
+    uint8_t runstate = nxt::RUNSTATE_RUNNING;
+
+    if (speed == 0)
+    {
+        mode = 0; // coast
+        runstate = nxt::RUNSTATE_IDLE; // disable power
+    }
+
+    // a newer setpoint for the same port replaces one not yet sent
+    send<nxt::SetOutputState> (Scheduler::MOTOR, port, port, speed, mode, 0, 0, runstate, 0);
 }
 
-void Robot::keepalive (void)
+void Robot::stop (void)
 {
-    const unsigned int length = 2 + 2;
-    uint8_t message[length];
-
-    message[0] = length - 2;
-    message[1] = 0;
+    if (xSemaphoreTake (_semaphore, portMAX_DELAY))
+    {
+        for (int port = 0; port < 3; port++)
+        {
+            _output[port] = 0;
+        }
 
-    message[2] = 0x00; // direct command with reply
-    message[3] = 0x0d; // keep alive
+        xSemaphoreGive (_semaphore);
+    }
 
-    command (message);
+    // coast with power off
+    for (int port = 0; port < 3; port++)
+    {
+        send<nxt::SetOutputState> (Scheduler::STOP, port, port, 0, 0, 0, 0, nxt::RUNSTATE_IDLE, 0);
+    }
 }
 
-void Robot::beep (void)
+void Robot::congested (bool state)
 {
-    const unsigned int length = 6 + 2;
-    uint8_t message[length];
+    if (xSemaphoreTake (_semaphore, portMAX_DELAY))
+    {
+        if (state && !_scheduler.congested ())
+        {
+            spp_congestion.add ();
+        }
 
-    message[0] = length - 2;
-    message[1] = 0;
+        _scheduler.congested (state);
 
-    message[2] = 0x80; // direct command with no reply
-    message[3] = 0x03; // play a tone
-    message[4] = 0x0b; // tone frequency (lsb)
-    message[5] = 0x02; // tone frequency (msb)
-    message[6] = 0xf4; // tone duration ms (lsb)
-    message[7] = 0x01; // tone duration ms (lsb)
+        xSemaphoreGive (_semaphore);
+    }
 
-    command (message);
+    // resume sending anything held back
+    if (!state)
+    {
+        xTaskNotifyGive (_task);
+    }
 }
 
-void Robot::motor (uint8_t port, int8_t speed)
+void Robot::command (uint8_t *data, int priority, int key)
 {
-    if ((port == 0) || (port == 1) || (port == 2))
+    // queue the command data, it is sent by the robot task
+    if (connected ())
     {
         if (xSemaphoreTake (_semaphore, portMAX_DELAY))
         {
-            _output[port] = speed;
+            int lost;
 
+            _scheduler.push (priority, data, key, &lost);
+            dropped (lost);
             xSemaphoreGive (_semaphore);
         }
-        else
+
+        xTaskNotifyGive (_task);
+    }
+}
+
+TickType_t Robot::poll (void)
+{
+    int64_t next = -1;
+
+    if (connected () && xSemaphoreTake (_semaphore, portMAX_DELAY))
+    {
+        int64_t now = esp_timer_get_time ();
+        int channel;
+
+        while ((channel = _telemetry.due (now)) >= 0)
         {
-            return;
+            int lost;
+            uint8_t *slot = _scheduler.reserve (Scheduler::TELEMETRY, ROBOT_TELEMETRY_KEY + channel, &lost);
+
+            dropped (lost);
+            if (slot == NULL)
+            {
+                // the class is full and sending, the rest would not fit either
+                _telemetry.cancel (channel);
+                break;
+            }
+
+            if (Telemetry::type (channel) == nxt::InputValues::opcode)
+            {
+                nxt::GetInputValues::encode (slot, Telemetry::port (channel));
+            }
+            else
+            {
+                nxt::GetOutputState::encode (slot, Telemetry::port (channel));
+            }
         }
+
+        next = _telemetry.next (now);
+
+        xSemaphoreGive (_semaphore);
+    }
+
+    if (next < 0)
+    {
+        return (portMAX_DELAY);
     }
+
+    // round up so the task never wakes before the poll is due
+    return ((next + (portTICK_PERIOD_MS * 1000) - 1) / (portTICK_PERIOD_MS * 1000));
 }
 
-void Robot::command (uint8_t *data)
+void Robot::dropped (int key)
 {
-    // blink the LED
-    if (_led)
+    // a poll dropped from the queue will never be answered, called with the semaphore held
+    if ((key >= ROBOT_TELEMETRY_KEY) && (key < ROBOT_TELEMETRY_KEY + TELEMETRY_CHANNELS))
     {
-        _led->on ();
+        _telemetry.cancel (key - ROBOT_TELEMETRY_KEY);
     }
+}
 
-    // determine the internal length of the data
-    uint16_t length = (data[1] << 8) + data[0];
+uint32_t Robot::history (uint32_t since, telemetry_sample_t *samples, uint32_t count, uint32_t *first)
+{
+    uint32_t available = 0;
+    *first = since;
 
-    // send the command data
-    if (connected ())
+    if (xSemaphoreTake (_semaphore, portMAX_DELAY))
     {
-        if (xSemaphoreTake (_semaphore, portMAX_DELAY))
+        available = _telemetry.read (since, samples, count, first);
+
+        xSemaphoreGive (_semaphore);
+    }
+
+    return (available);
+}
+
+void Robot::flush (void)
+{
+    while (connected ())
+    {
+        // keep the configured minimum gap between commands, newer setpoints
+        // queued in the meantime still replace older ones
+        int64_t gap = _last + ROBOT_GAP - esp_timer_get_time ();
+        if (gap > 0)
         {
-            esp_log_buffer_hex ("mindbridge", data, length + 2);
-            esp_spp_write (_handle, length + 2, data);
-            xSemaphoreGive (_semaphore);
+            vTaskDelay ((gap / 1000 + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS);
+        }
+
+        if (!xSemaphoreTake (_semaphore, portMAX_DELAY))
+        {
+            break;
+        }
+
+        // transmit straight from the queue slot
+        uint16_t length = 0;
+        uint8_t *data = _scheduler.front (&length);
+
+        if (data)
+        {
+            // remember when commands that expect a reply went out
+            if ((data[2] & nxt::NO_REPLY) == 0)
+            {
+                sent (data[3]);
+            }
+
+            esp_log_buffer_hex ("mindbridge", data, length);
+            esp_spp_write (_handle, length, data);
+            spp_writes.add ();
+            _scheduler.release ();
+            _last = esp_timer_get_time ();
+        }
+
+        xSemaphoreGive (_semaphore);
+
+        if (data == NULL)
+        {
+            break;
+        }
+
+        // blink the LED
+        if (_led)
+        {
+            _led->on ();
+        }
+    }
+}
+
+void Robot::sent (uint8_t command)
+{
+    expire ();
+
+    // the oldest command is given up on if the table is full
+    if (_outstanding == ROBOT_PENDING)
+    {
+        for (int loop = 1; loop < _outstanding; loop++)
+        {
+            _pending[loop - 1] = _pending[loop];
         }
+
+        _outstanding--;
+        _lost++;
     }
+
+    _pending[_outstanding].command = command;
+    _pending[_outstanding].time = esp_timer_get_time ();
+    _outstanding++;
 }
 
-#define UINT16(x) (((x)[1] << 8) | ((x)[0] << 0))
-#define UINT32(x) (((x)[3] << 24) | ((x)[2] << 16) | ((x)[1] << 8) | ((x)[0] << 0))
+void Robot::replied (uint8_t command)
+{
+    // replies arrive in order, so match the oldest command of the same type
+    for (int loop = 0; loop < _outstanding; loop++)
+    {
+        if (_pending[loop].command == command)
+        {
+            _latency.record ((uint32_t) (esp_timer_get_time () - _pending[loop].time));
+
+            for (int next = loop + 1; next < _outstanding; next++)
+            {
+                _pending[next - 1] = _pending[next];
+            }
+
+            _outstanding--;
+            return;
+        }
+    }
+}
+
+void Robot::expire (void)
+{
+    int64_t now = esp_timer_get_time ();
+    int kept = 0;
+
+    for (int loop = 0; loop < _outstanding; loop++)
+    {
+        if ((now - _pending[loop].time) > ROBOT_TIMEOUT)
+        {
+            _lost++;
+        }
+        else
+        {
+            _pending[kept++] = _pending[loop];
+        }
+    }
+
+    _outstanding = kept;
+}
+
+Histogram &Robot::latency (void)
+{
+    return (_latency);
+}
+
+uint32_t Robot::lost (void)
+{
+    return (_lost);
+}
 
 bool Robot::process (uint32_t handle, uint16_t length, uint8_t *data)
 {
@@ -234,49 +434,90 @@ bool Robot::process (uint32_t handle, uint16_t length, uint8_t *data)
     // process the available data
     uint16_t remaining = length;
 
+    if (!xSemaphoreTake (_semaphore, portMAX_DELAY))
+    {
+        return (false);
+    }
+
     while (remaining >= 4)
     {
-        uint16_t size = 0;
+        uint16_t size = nxt::reply_size (data[3]);
 
-        if (data[3] == 0x0b)
+        if ((size == 0) || (data[2] != nxt::REPLY) || (remaining < size))
         {
-            size = 7;
-
-            if (remaining < size)
-            {
-                break;
-            }
+            break;
+        }
 
-            if (data[4] == 0x00)
+        if (nxt::BatteryLevel::match (data))
+        {
+            if (nxt::BatteryLevel::status (data) == 0x00)
             {
-                _battery = UINT16 (&data[5]) / 1000.0;
+                _battery = nxt::BatteryLevel::get<0> (data) / 1000.0;
                 ESP_LOGI ("mindbridge", "battery: %0.1f", _battery);
             }
         }
-        else if (data[3] == 0x0d)
+        else if (nxt::SleepTime::match (data))
         {
-            size = 9;
-
-            if (remaining < size)
+            if (nxt::SleepTime::status (data) == 0x00)
             {
-                break;
+                _keepalive = nxt::SleepTime::get<0> (data) / 1000.0;
+                ESP_LOGI ("mindbridge", "keepalive: %0.1f", _keepalive);
             }
+        }
+        else if (nxt::OutputState::match (data))
+        {
+            typedef nxt::OutputState reply;
+
+            _telemetry.answered (reply::opcode, reply::get<0> (data));
 
-            if (data[4] == 0x00)
+            if (reply::status (data) == 0x00)
             {
-                _keepalive = UINT32 (&data[5]) / 1000.0;
-                ESP_LOGI ("mindbridge", "keepalive: %0.1f", _keepalive);
+                telemetry_sample_t sample;
+
+                sample.time = esp_timer_get_time () / 1000;
+                sample.type = reply::opcode;
+                sample.port = reply::get<0> (data);
+                sample.raw = reply::get<1> (data);
+                sample.value = reply::get<7> (data);
+                sample.extra = reply::get<9> (data);
+
+                _telemetry.record (sample);
             }
+
+            xTaskNotifyGive (_task);
         }
-        else
+        else if (nxt::InputValues::match (data))
         {
-            break;
+            typedef nxt::InputValues reply;
+
+            _telemetry.answered (reply::opcode, reply::get<0> (data));
+
+            // only keep readings the sensor marks as valid
+            if ((reply::status (data) == 0x00) && reply::get<1> (data))
+            {
+                telemetry_sample_t sample;
+
+                sample.time = esp_timer_get_time () / 1000;
+                sample.type = reply::opcode;
+                sample.port = reply::get<0> (data);
+                sample.raw = reply::get<5> (data);
+                sample.value = reply::get<7> (data);
+                sample.extra = reply::get<8> (data);
+
+                _telemetry.record (sample);
+            }
+
+            xTaskNotifyGive (_task);
         }
 
+        replied (data[3]);
+
         remaining = remaining - size;
         data = data + size;
     }
 
+    xSemaphoreGive (_semaphore);
+
     return (remaining == 0);
 }
 
@@ -284,13 +525,30 @@ std::string Robot::status (void)
 {
     char buffer[256];
 
-    sprintf (buffer, "{\"connected\": %d}", _connected);
+    if (xSemaphoreTake (_semaphore, portMAX_DELAY))
+    {
+        expire ();
+        xSemaphoreGive (_semaphore);
+    }
+
+    Json json (buffer, sizeof (buffer));
+
+    json.begin ().field ("connected", (int32_t) _connected);
 
     if (_connected)
     {
-        sprintf (buffer, "{\"connected\": %d, \"battery\": %f, \"keepalive\": %f}",
-                _connected, _battery, _keepalive);
+        json.field ("battery", _battery, 3)
+            .field ("keepalive", _keepalive, 1)
+            .begin ("latency")
+                .field ("replies", _latency.count ())
+                .field ("lost", _lost)
+                .field ("p50", _latency.percentile (0.50))
+                .field ("p95", _latency.percentile (0.95))
+                .field ("p99", _latency.percentile (0.99))
+            .end ();
     }
 
-    return (std::string (buffer));
+    json.end ();
+
+    return (std::string (json.text (), json.length ()));
 }
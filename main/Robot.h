@@ -7,7 +7,11 @@
 #include "freertos/semphr.h"
 #include "freertos/task.h"
 
+#include "Histogram.h"
 #include "LED.h"
+#include "NXT.h"
+#include "Scheduler.h"
+#include "Telemetry.h"
 
 // -----
 // robot
@@ -16,6 +20,21 @@
 #define LEFT_MOTOR      (1)
 #define RIGHT_MOTOR     (2)
 
+// maximum number of commands awaiting a reply
+#define ROBOT_PENDING   (8)
+
+// time after which an unanswered command is counted as lost
+#define ROBOT_TIMEOUT   (2 * 1000 * 1000)
+
+// minimum time between commands sent to the robot
+#define ROBOT_GAP       (CONFIG_MINDBRIDGE_ROBOT_COMMAND_GAP * 1000)
+
+// priority of the command sender task
+#define ROBOT_PRIORITY  (5)
+
+// scheduler keys of the telemetry polls, one per channel
+#define ROBOT_TELEMETRY_KEY (0x100)
+
 class Robot
 {
     public:
@@ -29,10 +48,23 @@ class Robot
         void keepalive (void);
         void beep (void);
         void motor (uint8_t port, int8_t speed);
+        void stop (void);
+        void congested (bool state);
         bool process (uint32_t handle, uint16_t length, uint8_t *data);
         std::string status (void);
+        uint32_t history (uint32_t since, telemetry_sample_t *samples, uint32_t count, uint32_t *first);
+        Histogram &latency (void);
+        uint32_t lost (void);
     public:
-        void command (uint8_t *data);
+        void command (uint8_t *data, int priority = Scheduler::TELEMETRY, int key = -1);
+        TickType_t poll (void);
+        void flush (void);
+    private:
+        template <typename COMMAND, typename... ARGS> void send (int priority, int key, ARGS... args);
+        void dropped (int key);
+        void sent (uint8_t command);
+        void replied (uint8_t command);
+        void expire (void);
     public:
         SemaphoreHandle_t _semaphore;
         TaskHandle_t _task;
@@ -44,6 +76,40 @@ class Robot
         uint32_t _handle;
         float _battery;
         float _keepalive;
+        struct
+        {
+            uint8_t command;
+            int64_t time;
+        } _pending[ROBOT_PENDING];
+        int _outstanding;
+        uint32_t _lost;
+        int64_t _last;
+        Histogram _latency;
+        Scheduler _scheduler;
+        Telemetry _telemetry;
 };
 
+template <typename COMMAND, typename... ARGS> void Robot::send (int priority, int key, ARGS... args)
+{
+    // encode the command straight into its queue slot, it is sent by the robot task
+    if (connected ())
+    {
+        if (xSemaphoreTake (_semaphore, portMAX_DELAY))
+        {
+            int lost;
+            uint8_t *slot = _scheduler.reserve (priority, key, &lost);
+
+            dropped (lost);
+            if (slot)
+            {
+                COMMAND::encode (slot, args...);
+            }
+
+            xSemaphoreGive (_semaphore);
+        }
+
+        xTaskNotifyGive (_task);
+    }
+}
+
 #endif
@@ -0,0 +1,125 @@
+#include <string.h>
+
+#include "Router.h"
+
+#include "assets.h"
+
+Router::Router (handler_t files) :
+    _files (files),
+    _observer (NULL)
+{
+    memset (_routes, 0, sizeof (_routes));
+}
+
+uint32_t Router::hash (const char *text, size_t length, uint32_t seed)
+{
+    // FNV-1a, kept in step with assets.py
+    uint32_t value = 2166136261U ^ seed;
+
+    for (size_t loop = 0; loop < length; loop++)
+    {
+        value ^= (uint8_t) text[loop];
+        value *= 16777619U;
+    }
+
+    return (value);
+}
+
+bool Router::add (const char *uri, handler_t handler)
+{
+    uint32_t slot = hash (uri, strlen (uri), 0);
+
+    // linear probing, the table is sized well above the route count
+    for (int loop = 0; loop < SLOTS; loop++, slot++)
+    {
+        route &entry = _routes[slot % SLOTS];
+
+        if ((entry.uri == NULL) || (strcmp (entry.uri, uri) == 0))
+        {
+            entry.uri = uri;
+            entry.handler = handler;
+            return (true);
+        }
+    }
+
+    return (false);
+}
+
+void Router::observe (observer_t observer)
+{
+    _observer = observer;
+}
+
+const asset_t *Router::asset (const char *uri, size_t length)
+{
+    const asset_t *candidate = &ASSETS[hash (uri, length, ASSET_SEED) & (ASSET_SLOTS - 1)];
+
+    // every asset has a slot of its own, one compare confirms the match
+    if (candidate->uri && (strncmp (candidate->uri, uri, length) == 0) && (candidate->uri[length] == '\0'))
+    {
+        return (candidate);
+    }
+
+    return (NULL);
+}
+
+size_t Router::assets (void)
+{
+    return (ASSET_COUNT);
+}
+
+esp_err_t Router::dispatch (httpd_req_t *request)
+{
+    Router *router = (Router *) request->user_ctx;
+
+    if (router->_observer)
+    {
+        router->_observer (request);
+    }
+
+    // the query string is not part of the route
+    const char *uri = request->uri;
+    size_t length = strcspn (uri, "?");
+
+    uint32_t slot = hash (uri, length, 0);
+    for (int loop = 0; loop < SLOTS; loop++, slot++)
+    {
+        route &entry = router->_routes[slot % SLOTS];
+
+        if (entry.uri == NULL)
+        {
+            break;
+        }
+
+        if ((strncmp (entry.uri, uri, length) == 0) && (entry.uri[length] == '\0'))
+        {
+            return (entry.handler (request));
+        }
+    }
+
+    const asset_t *file = asset (uri, length);
+    if (file)
+    {
+        // the file handler finds its asset where a plain handler finds its context
+        request->user_ctx = (void *) file;
+        return (router->_files (request));
+    }
+
+    httpd_resp_send_404 (request);
+
+    // all done
+    return (ESP_OK);
+}
+
+esp_err_t Router::register_with (httpd_handle_t server)
+{
+    httpd_uri_t wildcard;
+    memset (&wildcard, 0, sizeof (wildcard));
+
+    wildcard.uri = "/*";
+    wildcard.method = HTTP_GET;
+    wildcard.handler = dispatch;
+    wildcard.user_ctx = this;
+
+    return (httpd_register_uri_handler (server, &wildcard));
+}
@@ -0,0 +1,64 @@
+#ifndef __ROUTER_H__
+#define __ROUTER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_http_server.h"
+
+// ------
+// router
+// ------
+
+//
+// static file served by the router
+//
+typedef struct
+{
+    const char *uri;
+    const char *path;
+    const char *type;
+} asset_t;
+
+//
+// request router behind a single wildcard URI handler
+//
+// The web server walks its handlers in order for every request and caps
+// how many can be registered. The router takes every GET request instead
+// and dispatches in constant time: service routes sit in an open-addressed
+// table filled at startup, and static assets in a perfect hash table
+// generated from the filesystem directory at build time (see assets.py),
+// so adding a file needs no code and no handler slot.
+//
+// Routes are added before the server starts; lookups take no lock. An
+// observer, if set, sees every request before it is dispatched.
+//
+class Router
+{
+    public:
+        typedef esp_err_t (*handler_t) (httpd_req_t *request);
+        typedef void (*observer_t) (httpd_req_t *request);
+        static const int SLOTS = 32;
+    public:
+        Router (handler_t files);
+        bool add (const char *uri, handler_t handler);
+        void observe (observer_t observer);
+        esp_err_t register_with (httpd_handle_t server);
+        static const asset_t *asset (const char *uri, size_t length);
+        static uint32_t hash (const char *text, size_t length, uint32_t seed);
+        static size_t assets (void);
+    private:
+        static esp_err_t dispatch (httpd_req_t *request);
+    private:
+        struct route
+        {
+            const char *uri;
+            handler_t handler;
+        };
+    private:
+        handler_t _files;
+        observer_t _observer;
+        route _routes[SLOTS];
+};
+
+#endif
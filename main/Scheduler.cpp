@@ -0,0 +1,195 @@
+#include <string.h>
+
+#include "Scheduler.h"
+
+Scheduler::Scheduler () :
+    _front (-1),
+    _congested (false),
+    _dropped (0),
+    _collapsed (0)
+{
+    clear ();
+}
+
+uint8_t *Scheduler::reserve (int priority, int key, int *dropped)
+{
+    if (dropped)
+    {
+        *dropped = -1;
+    }
+
+    if ((priority < 0) || (priority >= CLASSES))
+    {
+        return (NULL);
+    }
+
+    // a stop supersedes any motor setpoints still waiting to go out
+    if (priority == STOP)
+    {
+        queue &motor = _queues[MOTOR];
+        int kept = (_front == MOTOR) ? 1 : 0;
+
+        _collapsed += motor.count - kept;
+        motor.count = kept;
+    }
+
+    queue &q = _queues[priority];
+    entry *slot = NULL;
+
+    // replace a queued command with the same key, unless it is being sent
+    if (key >= 0)
+    {
+        int first = (_front == priority) ? 1 : 0;
+
+        for (int loop = first; loop < q.count; loop++)
+        {
+            entry &e = q.entries[(q.head + loop) % DEPTH];
+
+            if (e.key == key)
+            {
+                slot = &e;
+                _collapsed++;
+                break;
+            }
+        }
+    }
+
+    if (slot == NULL)
+    {
+        // the class is full, drop its oldest command
+        if (q.count == DEPTH)
+        {
+            if (_front == priority)
+            {
+                return (NULL);
+            }
+
+            if (dropped)
+            {
+                *dropped = q.entries[q.head].key;
+            }
+
+            q.head = (q.head + 1) % DEPTH;
+            q.count--;
+            _dropped++;
+        }
+
+        slot = &q.entries[(q.head + q.count) % DEPTH];
+        q.count++;
+    }
+
+    slot->key = key;
+
+    return (slot->data);
+}
+
+bool Scheduler::push (int priority, const uint8_t *data, int key, int *dropped)
+{
+    if (dropped)
+    {
+        *dropped = -1;
+    }
+
+    // determine the full length of the message, including the length bytes
+    uint16_t length = ((data[1] << 8) + data[0]) + 2;
+    if (length > SIZE)
+    {
+        return (false);
+    }
+
+    uint8_t *slot = reserve (priority, key, dropped);
+    if (slot == NULL)
+    {
+        return (false);
+    }
+
+    memcpy (slot, data, length);
+
+    return (true);
+}
+
+uint8_t *Scheduler::front (uint16_t *length)
+{
+    *length = 0;
+
+    if (_congested)
+    {
+        return (NULL);
+    }
+
+    for (int priority = 0; priority < CLASSES; priority++)
+    {
+        queue &q = _queues[priority];
+
+        if (q.count > 0)
+        {
+            entry &e = q.entries[q.head];
+
+            _front = priority;
+            *length = ((e.data[1] << 8) + e.data[0]) + 2;
+
+            return (e.data);
+        }
+    }
+
+    return (NULL);
+}
+
+void Scheduler::release (void)
+{
+    if (_front < 0)
+    {
+        return;
+    }
+
+    queue &q = _queues[_front];
+
+    q.head = (q.head + 1) % DEPTH;
+    q.count--;
+
+    _front = -1;
+}
+
+void Scheduler::clear (void)
+{
+    for (int priority = 0; priority < CLASSES; priority++)
+    {
+        _queues[priority].head = 0;
+        _queues[priority].count = 0;
+    }
+
+    _front = -1;
+}
+
+bool Scheduler::empty (void)
+{
+    for (int priority = 0; priority < CLASSES; priority++)
+    {
+        if (_queues[priority].count > 0)
+        {
+            return (false);
+        }
+    }
+
+    return (true);
+}
+
+bool Scheduler::congested (void)
+{
+    return (_congested);
+}
+
+void Scheduler::congested (bool state)
+{
+    _congested = state;
+}
+
+uint32_t Scheduler::dropped (void)
+{
+    return (_dropped);
+}
+
+uint32_t Scheduler::collapsed (void)
+{
+    return (_collapsed);
+}
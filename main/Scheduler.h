@@ -0,0 +1,71 @@
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ---------
+// scheduler
+// ---------
+
+//
+// priority scheduler for commands going out over the Bluetooth link
+//
+// Commands are queued per priority class and always leave highest class
+// first. A command queued with a key replaces any not-yet-sent command of
+// the same class and key, so only the newest motor setpoint for a port is
+// ever sent. Nothing is released while the link reports congestion.
+//
+// Commands are encoded in place: reserve() hands out the queue slot to write
+// into and front() the slot to transmit from, so a message is never copied
+// between being encoded and being handed to the Bluetooth stack. When a full
+// class drops its oldest command to make room, reserve() and push() hand
+// back the key it was queued with, so the caller can stop waiting for it.
+// The class has no FreeRTOS dependencies.
+//
+class Scheduler
+{
+    public:
+        enum
+        {
+            STOP = 0,       // safety stop
+            MOTOR,          // motor setpoints
+            TONE,           // tones and sounds
+            TELEMETRY,      // battery, keepalive and sensor polls
+            CLASSES
+        };
+        static const int DEPTH = 8;
+        static const int SIZE = 64 + 2;
+    public:
+        Scheduler ();
+        uint8_t *reserve (int priority, int key = -1, int *dropped = NULL);
+        bool push (int priority, const uint8_t *data, int key = -1, int *dropped = NULL);
+        uint8_t *front (uint16_t *length);
+        void release (void);
+        void clear (void);
+        bool empty (void);
+        bool congested (void);
+        void congested (bool state);
+        uint32_t dropped (void);
+        uint32_t collapsed (void);
+    private:
+        struct entry
+        {
+            int key;
+            uint8_t data[SIZE];
+        };
+        struct queue
+        {
+            entry entries[DEPTH];
+            int head;
+            int count;
+        };
+    private:
+        queue _queues[CLASSES];
+        int _front;
+        bool _congested;
+        uint32_t _dropped;
+        uint32_t _collapsed;
+};
+
+#endif
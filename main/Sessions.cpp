@@ -0,0 +1,268 @@
+#include <unistd.h>
+
+#include "esp_log.h"
+#include "lwip/sockets.h"
+#include "sdkconfig.h"
+
+#include "Metrics.h"
+#include "Sessions.h"
+
+static const char *TAG = "sessions";
+
+// keep-alive probes of an idle control connection
+#define KEEPALIVE_INTERVAL (5)
+#define KEEPALIVE_COUNT (3)
+
+// open sockets of each kind, for the gauges
+static uint32_t control_sockets = 0;
+static uint32_t video_sockets = 0;
+
+static uint32_t control_count (void)
+{
+    return (control_sockets);
+}
+
+static uint32_t video_count (void)
+{
+    return (video_sockets);
+}
+
+static Counter sessions_opened ("mindbridge_http_sessions_opened_total", NULL, "Connections accepted by the web server");
+static Counter sessions_purged ("mindbridge_http_sessions_purged_total", NULL, "Idle control connections closed to make room");
+static Counter streams_refused ("mindbridge_http_streams_refused_total", NULL, "Video streams refused to keep sockets for control");
+static Gauge control_gauge ("mindbridge_http_sessions", "kind=\"control\"", "Open web server connections", control_count);
+static Gauge video_gauge ("mindbridge_http_sessions", "kind=\"video\"", "Open web server connections", video_count);
+
+Sessions::Sessions (uint16_t sockets, uint16_t reserved) :
+    _sockets (sockets),
+    _reserved (reserved),
+    _clock (0),
+    _driver (-1)
+{
+    for (int loop = 0; loop < SLOTS; loop++)
+    {
+        _slots[loop].fd = -1;
+        _slots[loop].type = UNUSED;
+        _slots[loop].used = 0;
+    }
+}
+
+void Sessions::configure (httpd_config_t &config)
+{
+    config.max_open_sockets = _sockets;
+    config.lru_purge_enable = true;
+    config.global_user_ctx = this;
+    config.global_user_ctx_free_fn = keep;
+    config.open_fn = opened;
+    config.close_fn = closed;
+}
+
+//
+// claims the socket of the request for a video stream, false if streams
+// already use every socket not reserved for control
+//
+bool Sessions::stream (httpd_req_t *request)
+{
+    int fd = httpd_req_to_sockfd (request);
+    slot *entry = find (fd);
+
+    if ((fd < 0) || (entry == NULL) || (entry->type != CONTROL))
+    {
+        return (false);
+    }
+
+    if (count (VIDEO) >= _sockets - _reserved)
+    {
+        streams_refused.add ();
+        ESP_LOGW (TAG, "refusing stream on %d, %d streams open", fd, count (VIDEO));
+        return (false);
+    }
+
+    // Nagle stays off, the frame goes out in two sends and waiting on an ACK only delays it
+    struct timeval timeout = { CONFIG_MINDBRIDGE_HTTPD_VIDEO_SEND_TIMEOUT, 0 };
+    setsockopt (fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof (timeout));
+
+    entry->type = VIDEO;
+    control_sockets--;
+    video_sockets++;
+
+    return (true);
+}
+
+//
+// true while the socket still carries the stream, which also keeps it out
+// of the LRU purge; the socket may since have been closed and reused
+//
+bool Sessions::streaming (httpd_handle_t handle, int fd)
+{
+    slot *entry = find (fd);
+
+    if ((entry == NULL) || (entry->type != VIDEO))
+    {
+        return (false);
+    }
+
+    httpd_sess_update_lru_counter (handle, fd);
+
+    return (true);
+}
+
+//
+// ends a stream that failed to send, the connection is of no further use
+//
+void Sessions::finish (httpd_handle_t handle, int fd)
+{
+    if (find (fd))
+    {
+        httpd_sess_trigger_close (handle, fd);
+    }
+}
+
+//
+// marks the socket of the session holder, which is kept when making room
+//
+void Sessions::driver (httpd_req_t *request)
+{
+    _driver = httpd_req_to_sockfd (request);
+}
+
+// every request counts as use of its socket
+void Sessions::request (httpd_req_t *request)
+{
+    Sessions *sessions = (Sessions *) httpd_get_global_user_ctx (request->handle);
+    slot *entry = sessions->find (httpd_req_to_sockfd (request));
+
+    if (entry)
+    {
+        entry->used = ++sessions->_clock;
+    }
+}
+
+Sessions::slot *Sessions::find (int fd)
+{
+    for (int loop = 0; loop < SLOTS; loop++)
+    {
+        if ((_slots[loop].type != UNUSED) && (_slots[loop].fd == fd))
+        {
+            return (&_slots[loop]);
+        }
+    }
+
+    return (NULL);
+}
+
+int Sessions::count (kind type)
+{
+    int result = 0;
+
+    for (int loop = 0; loop < SLOTS; loop++)
+    {
+        result += (_slots[loop].type == type) ? 1 : 0;
+    }
+
+    return (result);
+}
+
+//
+// closes the least recently used control socket other than the one just opened
+//
+void Sessions::purge (httpd_handle_t handle, int fd)
+{
+    slot *oldest = NULL;
+
+    for (int loop = 0; loop < SLOTS; loop++)
+    {
+        slot &entry = _slots[loop];
+
+        if ((entry.type == CONTROL) && (entry.fd != fd) && (entry.fd != _driver)
+                && ((oldest == NULL) || (entry.used < oldest->used)))
+        {
+            oldest = &entry;
+        }
+    }
+
+    if (oldest)
+    {
+        ESP_LOGD (TAG, "purging idle socket %d", oldest->fd);
+        sessions_purged.add ();
+        oldest->type = CLOSING;
+        httpd_sess_trigger_close (handle, oldest->fd);
+    }
+}
+
+esp_err_t Sessions::opened (httpd_handle_t handle, int fd)
+{
+    Sessions *sessions = (Sessions *) httpd_get_global_user_ctx (handle);
+
+    for (int loop = 0; loop < SLOTS; loop++)
+    {
+        slot &entry = sessions->_slots[loop];
+
+        if (entry.type == UNUSED)
+        {
+            int enable = 1;
+            int idle = CONFIG_MINDBRIDGE_HTTPD_KEEPALIVE;
+            int interval = KEEPALIVE_INTERVAL;
+            int probes = KEEPALIVE_COUNT;
+
+            setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof (enable));
+            setsockopt (fd, SOL_SOCKET, SO_KEEPALIVE, &enable, sizeof (enable));
+            setsockopt (fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof (idle));
+            setsockopt (fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof (interval));
+            setsockopt (fd, IPPROTO_TCP, TCP_KEEPCNT, &probes, sizeof (probes));
+
+            entry.fd = fd;
+            entry.type = CONTROL;
+            entry.used = ++sessions->_clock;
+            control_sockets++;
+            sessions_opened.add ();
+
+            // keep a socket free for the next client, rather than let it displace a stream
+            if (sessions->count (UNUSED) <= SLOTS - sessions->_sockets)
+            {
+                sessions->purge (handle, fd);
+            }
+
+            return (ESP_OK);
+        }
+    }
+
+    // more sockets than the server was configured for
+    ESP_LOGE (TAG, "no slot for socket %d", fd);
+    return (ESP_FAIL);
+}
+
+void Sessions::closed (httpd_handle_t handle, int fd)
+{
+    Sessions *sessions = (Sessions *) httpd_get_global_user_ctx (handle);
+    slot *entry = sessions->find (fd);
+
+    if (entry)
+    {
+        if (entry->type == VIDEO)
+        {
+            video_sockets--;
+        }
+        else
+        {
+            control_sockets--;
+        }
+
+        entry->fd = -1;
+        entry->type = UNUSED;
+    }
+
+    if (sessions->_driver == fd)
+    {
+        sessions->_driver = -1;
+    }
+
+    // with a close function set, closing the socket is up to it
+    close (fd);
+}
+
+// the sessions outlive the server, which would otherwise free them
+void Sessions::keep (void *context)
+{
+    (void) context;
+}
@@ -0,0 +1,75 @@
+#ifndef __SESSIONS_H__
+#define __SESSIONS_H__
+
+#include <stdint.h>
+
+#include "esp_http_server.h"
+
+// --------
+// sessions
+// --------
+
+//
+// web server connection profile
+//
+// Connections are either control connections, which carry short requests
+// such as the drive updates and status polls, or video connections, which
+// hold a multipart stream. Control sockets have Nagle disabled so small
+// replies are not held back, and TCP keep-alive probes so a client that has
+// gone away frees its socket. A socket becomes a video socket when it starts
+// a stream; it then gets a short send timeout, so a stalled viewer cannot
+// hold up the server task for long. Video streams are capped so that the
+// reserved number of sockets always remains for control connections.
+//
+// When a new connection fills the last socket, the least recently used
+// control socket is closed, so there is always a socket free for the next
+// client; neither a stream nor the socket the session holder last drove
+// through is ever the one displaced. The server's own LRU purge
+// stays enabled behind this; streams refresh their place in it with every
+// frame.
+//
+// The open and close callbacks, the handlers and the stream work all run on
+// the web server task, so the socket table takes no lock.
+//
+class Sessions
+{
+    public:
+        static const int SLOTS = 16;
+    public:
+        Sessions (uint16_t sockets, uint16_t reserved);
+        void configure (httpd_config_t &config);
+        bool stream (httpd_req_t *request);
+        bool streaming (httpd_handle_t handle, int fd);
+        void finish (httpd_handle_t handle, int fd);
+        void driver (httpd_req_t *request);
+        static void request (httpd_req_t *request);
+    private:
+        enum kind
+        {
+            UNUSED,
+            CONTROL,
+            CLOSING,
+            VIDEO
+        };
+        struct slot
+        {
+            int fd;
+            kind type;
+            uint32_t used;
+        };
+    private:
+        slot *find (int fd);
+        int count (kind type);
+        void purge (httpd_handle_t handle, int fd);
+        static esp_err_t opened (httpd_handle_t handle, int fd);
+        static void closed (httpd_handle_t handle, int fd);
+        static void keep (void *context);
+    private:
+        uint16_t _sockets;
+        uint16_t _reserved;
+        uint32_t _clock;
+        int _driver;
+        slot _slots[SLOTS];
+};
+
+#endif
@@ -0,0 +1,191 @@
+#include <sys/param.h>
+
+#include "Telemetry.h"
+
+Telemetry::Telemetry () :
+    _inflight (0),
+    _sequence (0)
+{
+    for (int loop = 0; loop < TELEMETRY_CHANNELS; loop++)
+    {
+        _channels[loop].period = 0;
+    }
+
+    reset ();
+}
+
+uint8_t Telemetry::type (int channel)
+{
+    return ((channel < TELEMETRY_INPUTS) ? nxt::InputValues::opcode : nxt::OutputState::opcode);
+}
+
+uint8_t Telemetry::port (int channel)
+{
+    return ((channel < TELEMETRY_INPUTS) ? channel : channel - TELEMETRY_INPUTS);
+}
+
+int Telemetry::channel (uint8_t type, uint8_t port)
+{
+    if ((type == nxt::InputValues::opcode) && (port < TELEMETRY_INPUTS))
+    {
+        return (port);
+    }
+
+    if ((type == nxt::OutputState::opcode) && (port < TELEMETRY_OUTPUTS))
+    {
+        return (TELEMETRY_INPUTS + port);
+    }
+
+    return (-1);
+}
+
+void Telemetry::period (int channel, uint32_t msec)
+{
+    if ((channel >= 0) && (channel < TELEMETRY_CHANNELS))
+    {
+        _channels[channel].period = msec * 1000LL;
+    }
+}
+
+void Telemetry::reset (void)
+{
+    for (int loop = 0; loop < TELEMETRY_CHANNELS; loop++)
+    {
+        _channels[loop].due = 0;
+        _channels[loop].sent = 0;
+    }
+
+    _inflight = 0;
+}
+
+int Telemetry::due (int64_t now)
+{
+    // polls that were never answered no longer hold up the pipeline
+    for (int loop = 0; loop < TELEMETRY_CHANNELS; loop++)
+    {
+        if (_channels[loop].sent && ((now - _channels[loop].sent) > TELEMETRY_TIMEOUT))
+        {
+            _channels[loop].sent = 0;
+            _inflight--;
+        }
+    }
+
+    if (_inflight >= CONFIG_MINDBRIDGE_TELEMETRY_PIPELINE)
+    {
+        return (-1);
+    }
+
+    // pick the most overdue channel that is not already in flight
+    int selected = -1;
+
+    for (int loop = 0; loop < TELEMETRY_CHANNELS; loop++)
+    {
+        if ((_channels[loop].period == 0) || _channels[loop].sent || (_channels[loop].due > now))
+        {
+            continue;
+        }
+
+        if ((selected < 0) || (_channels[loop].due < _channels[selected].due))
+        {
+            selected = loop;
+        }
+    }
+
+    if (selected >= 0)
+    {
+        // keep the rate, but do not try to catch up on missed polls
+        _channels[selected].due = MAX (_channels[selected].due + _channels[selected].period,
+                now - _channels[selected].period / 2);
+        _channels[selected].sent = now;
+        _inflight++;
+    }
+
+    return (selected);
+}
+
+int64_t Telemetry::next (int64_t now)
+{
+    int64_t next = -1;
+    bool full = (_inflight >= CONFIG_MINDBRIDGE_TELEMETRY_PIPELINE);
+
+    for (int loop = 0; loop < TELEMETRY_CHANNELS; loop++)
+    {
+        int64_t when;
+
+        // with the pipeline full only a reply or a timeout frees a slot
+        if (_channels[loop].sent)
+        {
+            when = _channels[loop].sent + TELEMETRY_TIMEOUT;
+        }
+        else if (_channels[loop].period && !full)
+        {
+            when = _channels[loop].due;
+        }
+        else
+        {
+            continue;
+        }
+
+        when = MAX (0, when - now);
+
+        if ((next < 0) || (when < next))
+        {
+            next = when;
+        }
+    }
+
+    return (next);
+}
+
+void Telemetry::answered (uint8_t type, uint8_t port)
+{
+    int index = channel (type, port);
+
+    if ((index >= 0) && _channels[index].sent)
+    {
+        _channels[index].sent = 0;
+        _inflight--;
+    }
+}
+
+void Telemetry::cancel (int channel)
+{
+    // the poll never went out, so no reply will free its slot
+    if ((channel >= 0) && (channel < TELEMETRY_CHANNELS) && _channels[channel].sent)
+    {
+        _channels[channel].sent = 0;
+        _inflight--;
+    }
+}
+
+void Telemetry::record (const telemetry_sample_t &sample)
+{
+    _samples[_sequence % CONFIG_MINDBRIDGE_TELEMETRY_SAMPLES] = sample;
+    _sequence++;
+}
+
+uint32_t Telemetry::read (uint32_t since, telemetry_sample_t *samples, uint32_t count, uint32_t *first)
+{
+    // the oldest sample still held in the ring
+    uint32_t oldest = 0;
+    if (_sequence > CONFIG_MINDBRIDGE_TELEMETRY_SAMPLES)
+    {
+        oldest = _sequence - CONFIG_MINDBRIDGE_TELEMETRY_SAMPLES;
+    }
+
+    uint32_t start = MIN (MAX (since, oldest), _sequence);
+    uint32_t available = MIN (_sequence - start, count);
+
+    for (uint32_t loop = 0; loop < available; loop++)
+    {
+        samples[loop] = _samples[(start + loop) % CONFIG_MINDBRIDGE_TELEMETRY_SAMPLES];
+    }
+
+    *first = start;
+    return (available);
+}
+
+uint32_t Telemetry::sequence (void)
+{
+    return (_sequence);
+}
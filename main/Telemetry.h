@@ -0,0 +1,79 @@
+#ifndef __TELEMETRY_H__
+#define __TELEMETRY_H__
+
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+#include "NXT.h"
+
+// ---------
+// telemetry
+// ---------
+
+// poll channels, the four sensor inputs followed by the three motor outputs
+#define TELEMETRY_INPUTS    (4)
+#define TELEMETRY_OUTPUTS   (3)
+#define TELEMETRY_CHANNELS  (TELEMETRY_INPUTS + TELEMETRY_OUTPUTS)
+
+// time after which an unanswered poll no longer counts as in flight
+#define TELEMETRY_TIMEOUT   (2 * 1000 * 1000)
+
+//
+// one telemetry sample as stored and as sent by the binary endpoint
+//
+// For input values, raw is the raw A/D value, value the scaled value and
+// extra the calibrated value. For output state, raw is the power setpoint,
+// value the tacho count and extra the rotation count. All fields are little
+// endian.
+//
+typedef struct __attribute__ ((packed))
+{
+    uint32_t time;      // milliseconds since boot
+    uint8_t type;       // nxt::OutputState::opcode or nxt::InputValues::opcode
+    uint8_t port;
+    int16_t raw;
+    int32_t value;
+    int32_t extra;
+} telemetry_sample_t;
+
+//
+// sensor and tacho poll scheduling and sample history
+//
+// Each channel is polled at its own period with up to a configured number of
+// polls in flight on the link at once. A poll that is dropped before it goes
+// out is cancelled, as nothing will answer it. Samples go into a fixed-size ring that
+// is addressed by a running sequence number, so readers can ask for
+// everything after the last sample they saw. The time is passed in rather
+// than read from the clock.
+//
+class Telemetry
+{
+    public:
+        Telemetry ();
+        void period (int channel, uint32_t msec);
+        void reset (void);
+        int due (int64_t now);
+        int64_t next (int64_t now);
+        void answered (uint8_t type, uint8_t port);
+        void cancel (int channel);
+        void record (const telemetry_sample_t &sample);
+        uint32_t read (uint32_t since, telemetry_sample_t *samples, uint32_t count, uint32_t *first);
+        uint32_t sequence (void);
+        static uint8_t type (int channel);
+        static uint8_t port (int channel);
+    private:
+        int channel (uint8_t type, uint8_t port);
+    private:
+        struct
+        {
+            int64_t period;
+            int64_t due;
+            int64_t sent;
+        } _channels[TELEMETRY_CHANNELS];
+        int _inflight;
+        telemetry_sample_t _samples[CONFIG_MINDBRIDGE_TELEMETRY_SAMPLES];
+        uint32_t _sequence;
+};
+
+#endif
@@ -0,0 +1,239 @@
+#include <string.h>
+
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "img_converters.h"
+
+#include "Transcoder.h"
+
+Transcoder::Transcoder (const char *name, jpg_scale_t scale, int quality) :
+    _name (name),
+    _scale (scale),
+    _quality (quality),
+    _labels (std::string ("profile=\"") + name + "\""),
+    _frames ("mindbridge_transcoded_frames_total", _labels.c_str (), "Frames transcoded, by stream profile"),
+    _summary ("mindbridge_transcode_seconds", _labels.c_str (), "Time to decode, scale and encode a frame, by stream profile", &_latency),
+    _viewers (0),
+    _sequence (0),
+    _source (NULL),
+    _source_length (0),
+    _pixels (NULL),
+    _pixels_size (0),
+    _width (0),
+    _height (0),
+    _output (NULL),
+    _output_size (0),
+    _length (0),
+    _failed (false)
+{
+}
+
+Transcoder::~Transcoder ()
+{
+    release ();
+}
+
+const char *Transcoder::name (void)
+{
+    return (_name);
+}
+
+void Transcoder::join (void)
+{
+    _viewers++;
+}
+
+// the last viewer to leave lets the buffers go
+void Transcoder::leave (void)
+{
+    if ((_viewers > 0) && (--_viewers == 0))
+    {
+        release ();
+    }
+}
+
+int Transcoder::viewers (void)
+{
+    return (_viewers);
+}
+
+void Transcoder::release (void)
+{
+    heap_caps_free (_pixels);
+    heap_caps_free (_output);
+
+    _pixels = NULL;
+    _pixels_size = 0;
+    _output = NULL;
+    _output_size = 0;
+    _length = 0;
+}
+
+// changes with every frame transcoded
+uint32_t Transcoder::sequence (void)
+{
+    return (_sequence);
+}
+
+// the last frame transcoded
+const uint8_t *Transcoder::data (void)
+{
+    return (_output);
+}
+
+size_t Transcoder::length (void)
+{
+    return (_length);
+}
+
+size_t Transcoder::read (void *argument, size_t index, uint8_t *buffer, size_t length)
+{
+    Transcoder *self = (Transcoder *) argument;
+
+    if (index >= self->_source_length)
+    {
+        return (0);
+    }
+
+    length = (length < self->_source_length - index) ? length : (self->_source_length - index);
+
+    // the decoder skips what it does not need with no buffer
+    if (buffer)
+    {
+        memcpy (buffer, self->_source + index, length);
+    }
+
+    return (length);
+}
+
+//
+// the decoder hands over the size of the scaled image with no data first,
+// then its pixels a block at a time, R, G, B, and the size again at the end
+//
+bool Transcoder::write (void *argument, uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint8_t *data)
+{
+    Transcoder *self = (Transcoder *) argument;
+
+    if (data == NULL)
+    {
+        if ((x == 0) && (y == 0))
+        {
+            size_t size = (size_t) width * height * 3;
+
+            if (size > self->_pixels_size)
+            {
+                uint8_t *pixels = (uint8_t *) heap_caps_realloc (self->_pixels, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+
+                if (pixels == NULL)
+                {
+                    self->_failed = true;
+                    return (false);
+                }
+
+                self->_pixels = pixels;
+                self->_pixels_size = size;
+            }
+
+            self->_width = width;
+            self->_height = height;
+        }
+
+        return (true);
+    }
+
+    if (((size_t) x + width > self->_width) || ((size_t) y + height > self->_height))
+    {
+        self->_failed = true;
+        return (false);
+    }
+
+    // stored B, G, R as fmt2jpg expects
+    for (int row = 0; row < height; row++)
+    {
+        uint8_t *out = self->_pixels + ((y + row) * self->_width + x) * 3;
+
+        for (int column = 0; column < width; column++, data += 3, out += 3)
+        {
+            out[0] = data[2];
+            out[1] = data[1];
+            out[2] = data[0];
+        }
+    }
+
+    return (true);
+}
+
+size_t Transcoder::append (void *argument, size_t index, const void *data, size_t length)
+{
+    Transcoder *self = (Transcoder *) argument;
+
+    if ((data == NULL) || (length == 0))
+    {
+        return (0);
+    }
+
+    if (self->_length + length > self->_output_size)
+    {
+        size_t size = (self->_length + length) * 5 / 4;
+        uint8_t *output = (uint8_t *) heap_caps_realloc (self->_output, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+
+        if (output == NULL)
+        {
+            self->_failed = true;
+            return (0);
+        }
+
+        self->_output = output;
+        self->_output_size = size;
+    }
+
+    memcpy (self->_output + self->_length, data, length);
+    self->_length += length;
+
+    return (length);
+}
+
+//
+// decode a frame at the profile's scale and encode it at its quality, or at
+// full scale requantize it; on failure there is no frame until the next one
+// succeeds
+//
+bool Transcoder::transcode (const uint8_t *jpeg, size_t length)
+{
+    int64_t start = esp_timer_get_time ();
+    bool done = false;
+
+    _source = jpeg;
+    _source_length = length;
+    _width = 0;
+    _height = 0;
+    _failed = false;
+
+    if (_scale == JPG_SCALE_NONE)
+    {
+        _length = 0;
+        done = jpg_requantize_cb (jpeg, length, _quality, append, this);
+    }
+    else if ((esp_jpg_decode (length, _scale, read, write, this) == ESP_OK) && !_failed && (_width > 0) && (_height > 0))
+    {
+        _length = 0;
+        done = fmt2jpg_cb (_pixels, _width * _height * 3, _width, _height, PIXFORMAT_RGB888, _quality, append, this);
+    }
+    else
+    {
+        _length = 0;
+        return (false);
+    }
+
+    if (!done || _failed)
+    {
+        _length = 0;
+        return (false);
+    }
+
+    _sequence++;
+    _frames.add ();
+    _latency.record (esp_timer_get_time () - start);
+
+    return (true);
+}
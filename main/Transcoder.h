@@ -0,0 +1,70 @@
+#ifndef __TRANSCODER_H__
+#define __TRANSCODER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+#include "esp_jpg_decode.h"
+
+#include "Histogram.h"
+#include "Metrics.h"
+
+// ----------
+// transcoder
+// ----------
+
+//
+// a lower quality stream profile, for viewers on slow links
+//
+// Each frame is decoded at a reduced scale, which the decoder does in its
+// IDCT for little more than the cost of the entropy decoding, and encoded
+// again at a lower quality. A profile at full scale is not decoded at all;
+// its coefficients are requantized to the lower quality instead. The result
+// is kept until the next frame, so every viewer of the profile is sent the
+// same encoding and each frame is transcoded once however many share it;
+// the sequence number tells a viewer whether there is one it has not had.
+// The pixel and output buffers are allocated in PSRAM while the profile has
+// viewers and grow with the frame size.
+//
+class Transcoder
+{
+    public:
+        Transcoder (const char *name, jpg_scale_t scale, int quality);
+        ~Transcoder ();
+        const char *name (void);
+        void join (void);
+        void leave (void);
+        int viewers (void);
+        bool transcode (const uint8_t *jpeg, size_t length);
+        uint32_t sequence (void);
+        const uint8_t *data (void);
+        size_t length (void);
+    private:
+        static size_t read (void *argument, size_t index, uint8_t *buffer, size_t length);
+        static bool write (void *argument, uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint8_t *data);
+        static size_t append (void *argument, size_t index, const void *data, size_t length);
+        void release (void);
+    private:
+        const char *_name;
+        jpg_scale_t _scale;
+        int _quality;
+        std::string _labels;
+        Histogram _latency;
+        Counter _frames;
+        Summary _summary;
+        int _viewers;
+        uint32_t _sequence;
+        const uint8_t *_source;
+        size_t _source_length;
+        uint8_t *_pixels;
+        size_t _pixels_size;
+        uint16_t _width;
+        uint16_t _height;
+        uint8_t *_output;
+        size_t _output_size;
+        size_t _length;
+        bool _failed;
+};
+
+#endif
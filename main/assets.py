@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+#
+# Generates the static asset table served by the router.
+#
+# Every file in the filesystem directory becomes an asset under its own
+# name, and "/" serves index.html. The table is a perfect hash: a seed is
+# searched for so that no two URIs share a slot, which makes a lookup one
+# hash and one string compare. The hash must match Router::hash.
+#
+# usage: assets.py <filesystem directory> <base path> <output header>
+#
+
+import os
+import sys
+
+TYPES = {
+    "css": "text/css",
+    "gif": "image/gif",
+    "html": "text/html",
+    "ico": "image/x-icon",
+    "jpg": "image/jpeg",
+    "js": "text/javascript",
+    "json": "application/json",
+    "manifest": "application/manifest+json",
+    "png": "image/png",
+    "svg": "image/svg+xml",
+}
+
+
+def fnv1a(text, seed):
+    value = (2166136261 ^ seed) & 0xffffffff
+    for byte in text.encode():
+        value ^= byte
+        value = (value * 16777619) & 0xffffffff
+    return value
+
+
+def main():
+    directory, base, output = sys.argv[1:4]
+
+    assets = []
+    for name in sorted(os.listdir(directory)):
+        if not os.path.isfile(os.path.join(directory, name)):
+            continue
+        extension = name.rsplit(".", 1)[-1].lower() if "." in name else ""
+        entry = ("/" + name, base + "/" + name, TYPES.get(extension, "text/plain"))
+        assets.append(entry)
+        if name == "index.html":
+            assets.append(("/", entry[1], entry[2]))
+
+    # at most half full, so a seed turns up within a few tries
+    slots = 1
+    while slots < 2 * max(1, len(assets)):
+        slots *= 2
+
+    for seed in range(1 << 20):
+        table = {}
+        for asset in assets:
+            slot = fnv1a(asset[0], seed) & (slots - 1)
+            if slot in table:
+                break
+            table[slot] = asset
+        else:
+            break
+    else:
+        sys.exit("assets.py: no perfect hash seed found")
+
+    lines = [
+        "// generated by assets.py from %s, do not edit" % os.path.basename(os.path.normpath(directory)),
+        "#ifndef __ASSETS_H__",
+        "#define __ASSETS_H__",
+        "",
+        "#define ASSET_COUNT (%d)" % len(assets),
+        "#define ASSET_SLOTS (%d)" % slots,
+        "#define ASSET_SEED (0x%08xU)" % seed,
+        "",
+        "static const asset_t ASSETS[ASSET_SLOTS] = {",
+    ]
+    for slot in range(slots):
+        if slot in table:
+            uri, path, kind = table[slot]
+            lines.append('    { "%s", "%s", "%s" },' % (uri, path, kind))
+        else:
+            lines.append("    { NULL, NULL, NULL },")
+    lines += ["};", "", "#endif", ""]
+
+    text = "\n".join(lines)
+
+    # leave the header alone when nothing changed, to avoid rebuilds
+    if os.path.exists(output):
+        with open(output) as existing:
+            if existing.read() == text:
+                return
+
+    with open(output, "w") as header:
+        header.write(text)
+
+
+if __name__ == "__main__":
+    main()
@@ -1,6 +1,8 @@
 #include <sys/param.h>
 #include <string.h>
 
+#include <atomic>
+
 #include "esp_event.h"
 #include "esp_log.h"
 #include "esp_system.h"
@@ -18,14 +20,27 @@
 #include "esp_http_server.h"
 #include "driver/gpio.h"
 #include "esp_camera.h"
+#include "camera_trace.h"
+#include "img_converters.h"
 #include "esp_bt.h"
 #include "esp_bt_main.h"
 #include "esp_gap_bt_api.h"
 #include "esp_bt_device.h"
 #include "esp_spp_api.h"
 
+#include "Admission.h"
+#include "Avi.h"
+#include "Boot.h"
 #include "LED.h"
+#include "Json.h"
+#include "Metrics.h"
+#include "Motion.h"
+#include "Query.h"
+#include "Recorder.h"
 #include "Robot.h"
+#include "Router.h"
+#include "Sessions.h"
+#include "Transcoder.h"
 
 // -------
 // logging
@@ -76,6 +91,16 @@ static int right = 0;
 static unsigned int token = 0;
 static int64_t last = 0;
 
+// bumped whenever anything the status response shows changes, by the web
+// server and by camera_task when it settles the frame size during start-up
+static std::atomic<uint32_t> status_version (0);
+
+// set by camera_task once the camera is up, after it has settled the frame
+// size and orientation; until then the handlers leave the camera alone
+static std::atomic<bool> camera_ready (false);
+static std::atomic<int> framesize (FRAMESIZE_VGA);
+static bool status_connected = false;
+
 // ---------
 // bluetooth
 // ---------
@@ -187,9 +212,14 @@ static void esp_spp_cb (esp_spp_cb_event_t event, esp_spp_cb_param_t *param)
             break;
         case ESP_SPP_CONG_EVT:
             ESP_LOGI (TAG, "ESP_SPP_CONG_EVT cong=%d", param->cong.cong);
+            robot->congested (param->cong.cong);
             break;
         case ESP_SPP_WRITE_EVT:
             //ESP_LOGI (TAG, "ESP_SPP_WRITE_EVT len=%d cong=%d", param->write.len , param->write.cong);
+            if (param->write.cong)
+            {
+                robot->congested (true);
+            }
             break;
         case ESP_SPP_SRV_OPEN_EVT:
             ESP_LOGI (TAG, "ESP_SPP_SRV_OPEN_EVT");
@@ -305,54 +335,85 @@ static void esp_bt_gap_cb (esp_bt_gap_cb_event_t event, esp_bt_gap_cb_param_t *p
 // web server
 // ----------
 
-static const char *filetype (const char *path)
-{
-    const char *dot = strrchr (path, '.');
-
-    if (!dot || (dot == path))
-    {
-        return "";
-    }
-
-    return (dot + 1);
-}
+// request counts and latencies
+static Endpoint file_metrics ("static");
+static Endpoint open_metrics ("/open");
+static Endpoint status_metrics ("/status");
+static Endpoint robot_metrics ("/robot");
+static Endpoint telemetry_metrics ("/telemetry");
+static Endpoint video_metrics ("/video");
+static Endpoint drive_metrics ("/drive");
+static Endpoint camera_metrics ("/camera");
+static Endpoint motion_metrics ("/motion");
+static Endpoint thumbnail_metrics ("/thumbnail");
+static Endpoint recording_metrics ("/recording");
+static Endpoint metrics_metrics ("/metrics");
+static Endpoint trace_metrics ("/trace");
+
+// camera and stream counters, updated from the video path without locking
+static Counter frames_captured ("mindbridge_frames_captured_total", NULL, "Frames taken from the camera");
+static Counter frames_dropped ("mindbridge_frames_dropped_total", NULL, "Frame requests the camera could not satisfy");
+static Counter frames_bad ("mindbridge_frames_bad_total", NULL, "Frames without JPEG start and end markers, not sent");
+static Counter frames_stale ("mindbridge_frames_stale_total", NULL, "Frames taken after a frame size switch that still had the old size");
+static Counter jpeg_bytes ("mindbridge_jpeg_bytes_sent_total", NULL, "JPEG data sent to video viewers");
+
+// what is left of the orientation once the sensor has mirrored and flipped
+static std::atomic<jpg_transform_t> orientation (JPG_TRANSFORM_NONE);
+static Histogram orientation_latency;
+static Summary orientation_time ("mindbridge_frame_transform_seconds", NULL, "Time to rotate or mirror a frame in the DCT domain", &orientation_latency);
+
+// The transcoders, the motion detector and the recorder below do no locking
+// of their own. They are only used from the web server task, in a request
+// handler or in work queued with httpd_queue_work, and the server runs those
+// one at a time. The robot's scheduler and telemetry are likewise only used
+// under the robot's semaphore.
+
+// lower quality video for slow links, each frame transcoded once for all its viewers
+static Transcoder high_profile ("high", JPG_SCALE_NONE, CONFIG_MINDBRIDGE_PROFILE_HIGH_QUALITY);
+static Transcoder medium_profile ("medium", JPG_SCALE_2X, CONFIG_MINDBRIDGE_PROFILE_MEDIUM_QUALITY);
+static Transcoder low_profile ("low", JPG_SCALE_4X, CONFIG_MINDBRIDGE_PROFILE_LOW_QUALITY);
+static Transcoder *profiles[] = { &high_profile, &medium_profile, &low_profile };
+
+// motion detection
+static Motion motion (CONFIG_MINDBRIDGE_MOTION_COLUMNS, CONFIG_MINDBRIDGE_MOTION_ROWS,
+        CONFIG_MINDBRIDGE_MOTION_SENSITIVITY, CONFIG_MINDBRIDGE_MOTION_TRIGGER);
+static int64_t motion_last = 0;
+static Histogram motion_latency;
+static Summary motion_time ("mindbridge_motion_analysis_seconds", NULL, "Time to check a frame for motion", &motion_latency);
+static Counter motion_events ("mindbridge_motion_events_total", NULL, "Times the motion detector triggered");
+
+// the recent frames in PSRAM
+static Recorder recorder (CONFIG_MINDBRIDGE_RECORDER_SIZE * 1024);
+static int64_t recorder_due = 0;
+static int downloads = 0;
+static bool saving = false;
+static long saved_bytes = -1;
+static Counter recorder_frames ("mindbridge_recorder_frames_total", NULL, "Frames copied into the recorder");
+static Counter recorder_clips ("mindbridge_recorder_clips_total", NULL, "Recordings frozen for download");
+static Counter recording_bytes ("mindbridge_recording_bytes_sent_total", NULL, "Recorded JPEG data sent as downloads");
+
+// how often a frame is taken while nobody watches the video, 0 for never
+static int watch_period = 0;
+
+// connection profile of the web server
+static Sessions sessions (CONFIG_MINDBRIDGE_HTTPD_SOCKETS, CONFIG_MINDBRIDGE_HTTPD_CONTROL_SOCKETS);
+
+// stream caps and poll limits, so the driver stays responsive
+static Admission admission (CONFIG_MINDBRIDGE_VIDEO_STREAMS, CONFIG_MINDBRIDGE_VIDEO_STREAMS_DRIVING,
+        CONFIG_MINDBRIDGE_POLL_RATE, CONFIG_MINDBRIDGE_POLL_BURST);
 
 // handler for statc file content
 static esp_err_t file_get_handler (httpd_req_t *req)
 {
-    // set response headers
-    httpd_resp_set_hdr (req, "Access-Control-Allow-Origin", "*");
-
-    const char* path = (const char*) req->user_ctx;
-    const char *ext = filetype (path);
-    const char *type = "text/plain";
+    Timing timing (file_metrics);
 
-    if (!strcmp (ext, "html"))
-    {
-        type = "text/html";
-    }
-    else if (!strcmp (ext, "ico"))
-    {
-        type = "image/x-icon";
-    }
-    else if (!strcmp (ext, "manifest"))
-    {
-        type = "application/manifest+json";
-    }
-    else if (!strcmp (ext, "png"))
-    {
-        type = "image/png";
-    }
-    else if (!strcmp (ext, "css"))
-    {
-        type = "text/css";
-    }
-    else if (!strcmp (ext, "js"))
-    {
-        type = "text/javascript";
-    }
+    // the router hands over the matched asset
+    const asset_t *asset = (const asset_t *) req->user_ctx;
+    const char *path = asset->path;
 
-    httpd_resp_set_type (req, type);
+    // set response headers
+    httpd_resp_set_hdr (req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_type (req, asset->type);
 
     FILE *file = fopen (path, "r");
     if (file == NULL)
@@ -380,46 +441,125 @@ static esp_err_t file_get_handler (httpd_req_t *req)
     return (ESP_OK);
 }
 
+static void render_status (Json &json, unsigned int shown)
+{
+    json.begin ()
+        .field ("active", (int32_t) active)
+        .field ("connected", (int32_t) status_connected)
+        .field ("token", (uint32_t) shown)
+        .field ("streaming", (int32_t) streaming)
+        .field ("left", (int32_t) left)
+        .field ("right", (int32_t) right)
+        .field ("framesize", (int32_t) framesize.load ())
+        .field ("motion", (int32_t) motion.triggered ())
+        .end ();
+}
+
+// the status as everyone but the session holder sees it, token hidden
+static void render_public_status (Json &json)
+{
+    render_status (json, 0);
+}
+
+static JsonCache status_cache (render_public_status);
+
+// only ever called from the web server task, as is the cache
 void produce_status (httpd_req_t *request, bool authorized = false)
 {
     // allow 5 seconds of inactivity
     if ((esp_timer_get_time () - last) > (10 * 1e6))
     {
+        // stop the robot when the session holder goes away
+        if (active)
+        {
+            robot->stop ();
+        }
+
+        if (active || token || left || right)
+        {
+            status_version++;
+        }
+
         active = false;
         token = 0;
         left = 0;
         right = 0;
     }
 
+    // the link state lives in the robot, fold its changes into the version
+    if (robot->connected () != status_connected)
+    {
+        status_connected = robot->connected ();
+        status_version++;
+    }
+
     // set response headers
     httpd_resp_set_hdr (request, "Access-Control-Allow-Origin", "*");
     httpd_resp_set_type (request, "application/json");
 
     // produce response
-    int temp = 0;
     if (authorized)
     {
-        temp = token;
+        // only the session holder sees the token, rare enough not to cache
+        char response[JsonCache::SIZE];
+        Json json (response, sizeof (response));
+
+        render_status (json, token);
+        httpd_resp_send (request, json.text (), json.length ());
     }
+    else
+    {
+        size_t length = 0;
+        const char *response = status_cache.get (status_version, &length);
 
-    char response[256];
-    snprintf ((char *) response, sizeof (response),
-            "{"
-                "\"active\": %d, "
-                "\"connected\": %d, "
-                "\"token\": %d, "
-                "\"streaming\": %d, "
-                "\"left\": %d, "
-                "\"right\": %d"
-            "}", active, robot->connected (), temp, streaming, left, right);
-    httpd_resp_send (request, response, strlen (response));
+        httpd_resp_send (request, response, length);
+    }
 
     return;
 }
 
+// answers a poll from a client without the session that came too soon
+static bool throttled (httpd_req_t *request)
+{
+    uint32_t retry = 0;
+
+    if (admission.poll (request, &retry))
+    {
+        return (false);
+    }
+
+    char seconds[12];
+    snprintf (seconds, sizeof (seconds), "%u", retry);
+
+    httpd_resp_set_hdr (request, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr (request, "Retry-After", seconds);
+    httpd_resp_set_status (request, "429 Too Many Requests");
+    httpd_resp_sendstr (request, "too many requests");
+
+    return (true);
+}
+
+// answers 503 while the camera is still starting, true when it did
+static bool camera_starting (httpd_req_t *request)
+{
+    if (camera_ready.load ())
+    {
+        return (false);
+    }
+
+    httpd_resp_set_hdr (request, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr (request, "Retry-After", "1");
+    httpd_resp_set_status (request, "503 Service Unavailable");
+    httpd_resp_sendstr (request, "camera starting");
+
+    return (true);
+}
+
 // session open URL
 static esp_err_t open_get_handler (httpd_req_t *request)
 {
+    Timing timing (open_metrics);
+
     bool authorized = false;
 
     if (token == 0)
@@ -433,32 +573,29 @@ static esp_err_t open_get_handler (httpd_req_t *request)
     }
 
     // get the parameters
-    size_t length = httpd_req_get_url_query_len (request);
-    if (length > 0)
-    {
-        char *buffer = (char *) malloc (length + 1);
-        if (httpd_req_get_url_query_str (request, buffer, length + 1) == ESP_OK)
-        {
-            char parameter[32];
-            char *temp;
-
-            if (httpd_query_key_value (buffer, "T", parameter, sizeof (parameter)) == ESP_OK)
-            {
-                unsigned int requested = strtol (parameter, &temp, 10);
-                if ((requested != 0) && (requested == token))
-                {
-                    authorized = true;
-                }
-            }
-        }
+    Query query (request);
+    long requested = 0;
 
-        free (buffer);
+    if (query.integer ("T", &requested) && (requested > 0) && ((unsigned long) requested == token))
+    {
+        authorized = true;
     }
 
     if (authorized)
     {
-        active = true;
+        if (!active)
+        {
+            active = true;
+            status_version++;
+        }
+
         last = esp_timer_get_time ();
+        sessions.driver (request);
+    }
+    else if (throttled (request))
+    {
+        // all done
+        return (ESP_OK);
     }
 
     produce_status (request, authorized);
@@ -470,7 +607,100 @@ static esp_err_t open_get_handler (httpd_req_t *request)
 // status URL
 static esp_err_t status_get_handler (httpd_req_t *request)
 {
-    produce_status (request);
+    Timing timing (status_metrics);
+
+    // the session holder may poll as often as it likes
+    Query query (request);
+    long requested = 0;
+    bool authorized = query.integer ("T", &requested) && (requested > 0) && ((unsigned long) requested == token);
+
+    if (!authorized && throttled (request))
+    {
+        // all done
+        return (ESP_OK);
+    }
+
+    produce_status (request, authorized);
+
+    // all done
+    return (ESP_OK);
+}
+
+// robot link status URL
+static esp_err_t robot_get_handler (httpd_req_t *request)
+{
+    Timing timing (robot_metrics);
+
+    // set response headers
+    httpd_resp_set_hdr (request, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_type (request, "application/json");
+
+    std::string response = robot->status ();
+    httpd_resp_send (request, response.c_str (), response.length ());
+
+    // all done
+    return (ESP_OK);
+}
+
+// telemetry history URL
+static esp_err_t telemetry_get_handler (httpd_req_t *request)
+{
+    Timing timing (telemetry_metrics);
+
+    uint32_t since = 0;
+
+    // get the parameters
+    Query query (request);
+    long requested = 0;
+
+    if (query.integer ("S", &requested) && (requested >= 0))
+    {
+        since = (uint32_t) requested;
+    }
+
+    // set response headers
+    httpd_resp_set_hdr (request, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_type (request, "application/octet-stream");
+
+    // the samples are sent as stored, in batches copied out under the robot lock
+    telemetry_sample_t samples[32];
+    uint32_t first = 0;
+    uint32_t count = robot->history (since, samples, 32, &first);
+
+    // header: sequence number of the first sample, format version, sample size
+    uint8_t header[8];
+    header[0] = (first >> 0) & 0xff;
+    header[1] = (first >> 8) & 0xff;
+    header[2] = (first >> 16) & 0xff;
+    header[3] = (first >> 24) & 0xff;
+    header[4] = 1;
+    header[5] = 0;
+    header[6] = sizeof (telemetry_sample_t);
+    header[7] = 0;
+
+    httpd_resp_send_chunk (request, (const char *) header, sizeof (header));
+
+    uint32_t total = 0;
+    while ((count > 0) && (total < CONFIG_MINDBRIDGE_TELEMETRY_SAMPLES))
+    {
+        if (httpd_resp_send_chunk (request, (const char *) samples, count * sizeof (telemetry_sample_t)) != ESP_OK)
+        {
+            return (ESP_FAIL);
+        }
+
+        total += count;
+
+        uint32_t next = 0;
+        count = robot->history (first + total, samples, 32, &next);
+
+        // stop if the ring wrapped past the samples already sent
+        if (next != first + total)
+        {
+            break;
+        }
+    }
+
+    httpd_resp_send_chunk (request, NULL, 0);
 
     // all done
     return (ESP_OK);
@@ -486,244 +716,1147 @@ int httpd_default_send_str (httpd_handle_t hd, int sockfd, const char *buf, int
 struct video_resp_arg {
     httpd_handle_t hd;
     int fd;
+    Transcoder *profile;
+    uint32_t sequence;
+};
+
+struct recording_resp_arg {
+    httpd_handle_t hd;
+    int fd;
+    Recorder::cursor position;
+    Avi *avi;
+};
+
+struct recording_save_arg {
+    httpd_handle_t hd;
+    FILE *file;
+    Recorder::cursor position;
+    Avi *avi;
 };
 
 #define BOUNDARY "ce3c8aac-21d4-4fa5-8c63-8c87fb2d0e27"
 
-static void emit_video_frame (void *argument)
+// a frame cut short by the DMA lacks its start or end marker
+static bool complete_frame (camera_fb_t *fb)
 {
-    struct video_resp_arg *parameters = (struct video_resp_arg *) argument;
-    httpd_handle_t hd = parameters->hd;
-    int fd = parameters->fd;
-
-    headlight->on (500); // turn on the headlight for 500ms
-    camera_fb_t *fb = esp_camera_fb_get ();
+    return ((fb->len >= 4) && (fb->buf[0] == 0xff) && (fb->buf[1] == 0xd8)
+            && (fb->buf[fb->len - 2] == 0xff) && (fb->buf[fb->len - 1] == 0xd9));
+}
 
-    if (fb)
+// keeps the history before an event for download, unless one is kept already
+static void freeze_recording (const char *reason)
+{
+    if (!recorder.freeze (CONFIG_MINDBRIDGE_RECORDER_HISTORY))
     {
-        int bytes = 0;
-        size_t length = fb->len;
-        uint8_t * data = fb->buf;
-        char buffer[256];
-
-        bytes = httpd_default_send_str (hd, fd, "Content-Type: image/jpeg\r\n", 0);
-        snprintf ((char *) buffer, 256, "Content-Length: %u\r\n", length);
-        bytes = httpd_default_send_str (hd, fd, buffer, 0);
-        bytes = httpd_default_send_str (hd, fd, "\r\n", 0);
-        bytes = httpd_default_send (hd, fd, (const char *) data, length, 0);
-
-        esp_camera_fb_return (fb);
-
-        if (bytes > 0)
-        {
-            bytes = httpd_default_send_str (hd, fd, "\r\n--" BOUNDARY "\r\n", 0);
-            httpd_queue_work (hd, emit_video_frame, argument);
-            return;
-        }
+        return;
     }
 
-    streaming = MAX (0, streaming - 1);
-    httpd_default_send_str (hd, fd, "\r\n--" BOUNDARY "--\r\n", 0);
-
-    free (argument);
+    recorder_clips.add ();
+    ESP_LOGI (TAG, "recording frozen by %s, %u frames over %d ms", reason, recorder.clip_frames (),
+            (int) ((recorder.clip_end () - recorder.clip_start ()) / 1000));
 }
 
-static esp_err_t video_get_handler (httpd_req_t *request)
+//
+// a frame as the viewers see it, rotated or mirrored as the sensor could
+// not, without decoding it; the frame's own data or a new buffer to free
+//
+static uint8_t *orient_frame (camera_fb_t *fb, size_t *length)
 {
-    struct video_resp_arg *argument = (struct video_resp_arg *) malloc (sizeof (struct video_resp_arg));
+    uint8_t *data = NULL;
+    int64_t start = esp_timer_get_time ();
 
-    argument->hd = request->handle;
-    argument->fd = httpd_req_to_sockfd (request);
+    *length = fb->len;
+
+    jpg_transform_t transform = orientation.load ();
 
-    if (argument->fd < 0) {
-        return (ESP_FAIL);
+    if (transform == JPG_TRANSFORM_NONE)
+    {
+        return (fb->buf);
     }
 
-    httpd_default_send_str (argument->hd, argument->fd, "HTTP/1.1 200 OK\r\n", 0);
-    httpd_default_send_str (argument->hd, argument->fd, "Content-Type: multipart/x-mixed-replace; boundary=" BOUNDARY "\r\n", 0);
-    //httpd_default_send_str (argument->hd, argument->fd, "Transfer-Encoding: chunked\r\n", 0);
-    httpd_default_send_str (argument->hd, argument->fd, "Access-Control-Allow-Origin: *\r\n", 0);
-    httpd_default_send_str (argument->hd, argument->fd, "\r\n", 0);
-    //httpd_default_send_str (argument->hd, argument->fd, "\r\n--" BOUNDARY "\r\n", 0);
-    //httpd_default_send_str (argument->hd, argument->fd, "\r\n", 0);
+    if (!jpg_transform (fb->buf, fb->len, transform, &data, length))
+    {
+        *length = fb->len;
+        return (fb->buf);
+    }
 
-    streaming++;
-    httpd_queue_work (request->handle, emit_video_frame, argument);
+    orientation_latency.record (esp_timer_get_time () - start);
 
-    return (ESP_OK);
+    return (data);
 }
 
-// handler for the motor control URL
-static esp_err_t drive_get_handler (httpd_req_t *request)
+// records a frame and checks it for motion, as each falls due
+static void observe_frame (camera_fb_t *fb, const uint8_t *data, size_t length)
 {
-    // get the parameters
-    size_t length = httpd_req_get_url_query_len (request);
-    if (length > 0)
-    {
-        char *buffer = (char *) malloc (length + 1);
-        if (httpd_req_get_url_query_str (request, buffer, length + 1) == ESP_OK)
-        {
-            char parameter[32];
-            char *temp;
-
-            if (httpd_query_key_value (buffer, "T", parameter, sizeof (parameter)) == ESP_OK)
-            {
-                unsigned int requested = strtol (parameter, &temp, 10);
-                if ((requested != 0) && (requested == token))
-                {
-                    if (httpd_query_key_value (buffer, "L", parameter, sizeof (parameter)) == ESP_OK)
-                    {
-                        int8_t speed = (int8_t) MIN (100, MAX (-100, strtol (parameter, &temp, 10)));
-                        robot->motor (LEFT_MOTOR, speed);
-                        left = speed;
-                    }
+    int64_t now = esp_timer_get_time ();
+    int64_t period = CONFIG_MINDBRIDGE_RECORDER_PERIOD * 1000LL;
 
-                    if (httpd_query_key_value (buffer, "R", parameter, sizeof (parameter)) == ESP_OK)
-                    {
-                        int8_t speed = (int8_t) MIN (100, MAX (-100, strtol (parameter, &temp, 10)));
-                        robot->motor (RIGHT_MOTOR, speed);
-                        right = speed;
-                    }
-                }
-            }
+    // recorded frames keep to a schedule, and one a little early counts, so
+    // the rate holds whichever frames arrive
+    if (recorder.enabled () && !recorder.frozen () && (now >= recorder_due - period / 4) && complete_frame (fb))
+    {
+        recorder_due = ((now - recorder_due) < period) ? (recorder_due + period) : (now + period);
 
-            free (buffer);
+        if (recorder.record (data, length, fb->timestamp.tv_sec * 1000000LL + fb->timestamp.tv_usec))
+        {
+            recorder_frames.add ();
         }
     }
 
-    ESP_LOGI (TAG, "left: %d, right: %d", left, right);
+    if ((CONFIG_MINDBRIDGE_MOTION_PERIOD == 0) || ((now - motion_last) < CONFIG_MINDBRIDGE_MOTION_PERIOD * 1000LL))
+    {
+        return;
+    }
 
-    produce_status (request);
+    motion_last = now;
 
-    // all done
-    return (ESP_OK);
-}
+    bool triggered = motion.triggered ();
+    uint32_t events = motion.events ();
 
-static const httpd_uri_t icon_192_png_uri = {
-    .uri        = "/icon-192.png",
-    .method     = HTTP_GET,
-    .handler    = file_get_handler,
-    .user_ctx   = (void *) "/local/icon-192.png"
-};
+    if (motion.analyze (data, length) != ESP_OK)
+    {
+        return;
+    }
 
-static const httpd_uri_t manifest_json_uri = {
-    .uri        = "/manifest.json",
-    .method     = HTTP_GET,
-    .handler    = file_get_handler,
-    .user_ctx   = (void *) "/local/manifest.json"
-};
+    motion_latency.record (esp_timer_get_time () - now);
 
-static const httpd_uri_t favicon_png_uri = {
-    .uri        = "/favicon.png",
-    .method     = HTTP_GET,
-    .handler    = file_get_handler,
-    .user_ctx   = (void *) "/local/favicon.png"
-};
+    if (motion.events () != events)
+    {
+        motion_events.add ();
+        ESP_LOGI (TAG, "motion, %d%% of a region changed", motion.level ());
 
-static const httpd_uri_t slash_uri = {
-    .uri        = "/",
-    .method     = HTTP_GET,
-    .handler    = file_get_handler,
-    .user_ctx   = (void *) "/local/index.html"
-};
+#ifdef CONFIG_MINDBRIDGE_RECORDER_MOTION
+        freeze_recording ("motion");
+#endif
+    }
 
-static const httpd_uri_t jquery_min_js_uri = {
-    .uri        = "/jquery.min.js",
-    .method     = HTTP_GET,
-    .handler    = file_get_handler,
-    .user_ctx   = (void *) "/local/jquery.min.js"
-};
+    if (motion.triggered () != triggered)
+    {
+        status_version++;
+    }
+}
 
-static const httpd_uri_t mindbridge_js_uri = {
-    .uri        = "/mindbridge.js",
-    .method     = HTTP_GET,
-    .handler    = file_get_handler,
-    .user_ctx   = (void *) "/local/mindbridge.js"
-};
+// takes a frame just for the motion detector and recorder while nobody watches the video
+static void watch_frame (void *argument)
+{
+    if (!camera_ready.load () || (streaming > 0) || ((CONFIG_MINDBRIDGE_MOTION_PERIOD == 0) && recorder.frozen ()))
+    {
+        return;
+    }
 
-static const httpd_uri_t mindbridge_css_uri = {
-    .uri        = "/mindbridge.css",
-    .method     = HTTP_GET,
-    .handler    = file_get_handler,
-    .user_ctx   = (void *) "/local/mindbridge.css"
-};
+    camera_fb_t *fb = esp_camera_fb_get ();
 
-static const httpd_uri_t smpte_gif_uri = {
-    .uri        = "/smpte.gif",
-    .method     = HTTP_GET,
-    .handler    = file_get_handler,
-    .user_ctx   = (void *) "/local/smpte.gif"
-};
+    if (fb == NULL)
+    {
+        frames_dropped.add ();
+        return;
+    }
 
-static const httpd_uri_t open_uri = {
-    .uri        = "/open",
-    .method     = HTTP_GET,
-    .handler    = open_get_handler,
-    .user_ctx   = (void *) "open session"
-};
+    frames_captured.add ();
 
-static const httpd_uri_t status_uri = {
-    .uri        = "/status",
-    .method     = HTTP_GET,
-    .handler    = status_get_handler,
-    .user_ctx   = (void *) "status handler"
-};
+    size_t length = 0;
+    uint8_t *data = orient_frame (fb, &length);
 
-static const httpd_uri_t video_uri = {
-    .uri        = "/video",
-    .method     = HTTP_GET,
-    .handler    = video_get_handler,
-    .user_ctx   = (void *) "async video handler"
-};
+    observe_frame (fb, data, length);
 
-static const httpd_uri_t drive_uri = {
-    .uri        = "/drive",
-    .method     = HTTP_GET,
-    .handler    = drive_get_handler,
-    .user_ctx   = (void *) "motor control handler"
-};
+    if (data != fb->buf)
+    {
+        free (data);
+    }
 
-static httpd_handle_t start_webserver (void)
+    esp_camera_fb_return (fb);
+}
+
+static void watch_task (void *parameter)
 {
-    httpd_handle_t server = NULL;
-    httpd_config_t config = HTTPD_DEFAULT_CONFIG ();
-    config.max_uri_handlers = 16;
-    config.backlog_conn = 16;
+    httpd_handle_t *server = (httpd_handle_t *) parameter;
+    TickType_t wake = xTaskGetTickCount ();
 
-    // Start the httpd server
-    ESP_LOGI (TAG, "starting httpd on port: '%d'", config.server_port);
-    if (httpd_start (&server, &config) == ESP_OK)
+    // the frame is taken in the web server task, as the video streams take theirs
+    while (true)
     {
-        // Set URI handlers
-        ESP_LOGI (TAG, "registering URI handlers");
-
-        // file access handlers
-        httpd_register_uri_handler (server, &slash_uri);
-        httpd_register_uri_handler (server, &favicon_png_uri);
-        httpd_register_uri_handler (server, &icon_192_png_uri);
-        httpd_register_uri_handler (server, &manifest_json_uri);
-        httpd_register_uri_handler (server, &jquery_min_js_uri);
-        httpd_register_uri_handler (server, &mindbridge_js_uri);
-        httpd_register_uri_handler (server, &mindbridge_css_uri);
-        httpd_register_uri_handler (server, &smpte_gif_uri);
-
-        // control handlers
-        httpd_register_uri_handler (server, &open_uri);
-        httpd_register_uri_handler (server, &status_uri);
-        httpd_register_uri_handler (server, &video_uri);
-        httpd_register_uri_handler (server, &drive_uri);
+        vTaskDelayUntil (&wake, watch_period / portTICK_PERIOD_MS);
 
-        return (server);
+        if (*server && (streaming == 0))
+        {
+            httpd_queue_work (*server, watch_frame, NULL);
+        }
     }
-
-    ESP_LOGE (TAG, "failed to start httpd");
-    return (NULL);
 }
 
-static void stop_webserver (httpd_handle_t server)
+// closes a video stream once a frame cannot be sent
+static void end_video_stream (struct video_resp_arg *parameters)
 {
-    // stop the httpd server
-    httpd_stop (server);
+    if (parameters->profile)
+    {
+        parameters->profile->leave ();
+    }
+
+    streaming = MAX (0, streaming - 1);
+    status_version++;
+    httpd_default_send_str (parameters->hd, parameters->fd, "\r\n--" BOUNDARY "--\r\n", 0);
+    sessions.finish (parameters->hd, parameters->fd);
+
+    free (parameters);
+}
+
+// sends a frame as the next part of a video stream, 0 or less once the viewer has gone
+static int send_video_frame (httpd_handle_t hd, int fd, const uint8_t *data, size_t length)
+{
+    int bytes = 0;
+    char buffer[256];
+
+    snprintf ((char *) buffer, 256, "Content-Type: image/jpeg\r\nContent-Length: %zu\r\n\r\n", length);
+    bytes = httpd_default_send_str (hd, fd, buffer, 0);
+    bytes = httpd_default_send (hd, fd, (const char *) data, length, 0);
+
+    if (bytes > 0)
+    {
+        jpeg_bytes.add (bytes);
+        httpd_default_send_str (hd, fd, "\r\n--" BOUNDARY "\r\n", 0);
+    }
+
+    return (bytes);
+}
+
+static void emit_video_frame (void *argument)
+{
+    struct video_resp_arg *parameters = (struct video_resp_arg *) argument;
+    httpd_handle_t hd = parameters->hd;
+    int fd = parameters->fd;
+    Transcoder *profile = parameters->profile;
+
+    // the viewer went away, or its socket was closed to make room
+    if (!sessions.streaming (hd, fd))
+    {
+        if (profile)
+        {
+            profile->leave ();
+        }
+
+        streaming = MAX (0, streaming - 1);
+        status_version++;
+        free (argument);
+        return;
+    }
+
+    headlight->on (500); // turn on the headlight for 500ms
+
+    // another viewer of the profile has transcoded a frame this one has not had
+    if (profile && (profile->sequence () != parameters->sequence) && (profile->length () > 0))
+    {
+        parameters->sequence = profile->sequence ();
+
+        if (send_video_frame (hd, fd, profile->data (), profile->length ()) > 0)
+        {
+            httpd_queue_work (hd, emit_video_frame, argument);
+            return;
+        }
+
+        end_video_stream (parameters);
+        return;
+    }
+
+    camera_fb_t *fb = esp_camera_fb_get ();
+
+    if (fb == NULL)
+    {
+        frames_dropped.add ();
+    }
+    else
+    {
+        frames_captured.add ();
+        Boot::reached (Boot::FIRST_FRAME);
+
+        if (fb->width != resolution[framesize].width)
+        {
+            frames_stale.add ();
+        }
+    }
+
+    if (fb && !complete_frame (fb))
+    {
+        frames_bad.add ();
+        esp_camera_fb_return (fb);
+        httpd_queue_work (hd, emit_video_frame, argument);
+        return;
+    }
+
+    if (fb)
+    {
+        int bytes = 0;
+        size_t length = 0;
+        uint8_t * data = orient_frame (fb, &length);
+        uint32_t frame = camera_trace_frame (fb);
+
+        camera_trace (CAMERA_TRACE_SEND_FIRST, frame);
+
+        // the profile's viewers are sent the frame as it was if it cannot be transcoded
+        if (profile && profile->transcode (data, length))
+        {
+            parameters->sequence = profile->sequence ();
+            bytes = send_video_frame (hd, fd, profile->data (), profile->length ());
+        }
+        else
+        {
+            bytes = send_video_frame (hd, fd, data, length);
+        }
+
+        camera_trace (CAMERA_TRACE_SEND_LAST, frame);
+
+        observe_frame (fb, data, length);
+
+        if (data != fb->buf)
+        {
+            free (data);
+        }
+
+        esp_camera_fb_return (fb);
+
+        if (bytes > 0)
+        {
+            httpd_queue_work (hd, emit_video_frame, argument);
+            return;
+        }
+    }
+
+    end_video_stream (parameters);
+}
+
+static esp_err_t video_get_handler (httpd_req_t *request)
+{
+    Timing timing (video_metrics);
+
+    if (camera_starting (request))
+    {
+        // all done
+        return (ESP_OK);
+    }
+
+    // get the parameters
+    Query query (request);
+    size_t length = 0;
+    const char *name = query.value ("profile", &length);
+    Transcoder *profile = NULL;
+
+    if (name && ((length != 4) || strncmp (name, "full", length)))
+    {
+        for (Transcoder *candidate : profiles)
+        {
+            if ((strlen (candidate->name ()) == length) && (strncmp (candidate->name (), name, length) == 0))
+            {
+                profile = candidate;
+            }
+        }
+
+        if (profile == NULL)
+        {
+            httpd_resp_set_hdr (request, "Access-Control-Allow-Origin", "*");
+            httpd_resp_set_status (request, "400 Bad Request");
+            httpd_resp_sendstr (request, "unknown video profile");
+
+            // all done
+            return (ESP_OK);
+        }
+    }
+
+    // streams may not take the sockets kept for control, nor crowd out the driver
+    if (!admission.stream (streaming, active) || !sessions.stream (request))
+    {
+        httpd_resp_set_hdr (request, "Access-Control-Allow-Origin", "*");
+        httpd_resp_set_hdr (request, "Retry-After", "5");
+        httpd_resp_set_status (request, "503 Service Unavailable");
+        httpd_resp_sendstr (request, "too many video streams");
+
+        // all done
+        return (ESP_OK);
+    }
+
+    struct video_resp_arg *argument = (struct video_resp_arg *) malloc (sizeof (struct video_resp_arg));
+
+    argument->hd = request->handle;
+    argument->fd = httpd_req_to_sockfd (request);
+    argument->profile = profile;
+    argument->sequence = profile ? profile->sequence () : 0;
+
+    httpd_default_send_str (argument->hd, argument->fd, "HTTP/1.1 200 OK\r\n", 0);
+    httpd_default_send_str (argument->hd, argument->fd, "Content-Type: multipart/x-mixed-replace; boundary=" BOUNDARY "\r\n", 0);
+    //httpd_default_send_str (argument->hd, argument->fd, "Transfer-Encoding: chunked\r\n", 0);
+    httpd_default_send_str (argument->hd, argument->fd, "Access-Control-Allow-Origin: *\r\n", 0);
+    httpd_default_send_str (argument->hd, argument->fd, "\r\n", 0);
+    //httpd_default_send_str (argument->hd, argument->fd, "\r\n--" BOUNDARY "\r\n", 0);
+    //httpd_default_send_str (argument->hd, argument->fd, "\r\n", 0);
+
+    if (profile)
+    {
+        profile->join ();
+    }
+
+    streaming++;
+    status_version++;
+    httpd_queue_work (request->handle, emit_video_frame, argument);
+
+    return (ESP_OK);
+}
+
+// runtime metrics URL
+static esp_err_t metrics_get_handler (httpd_req_t *request)
+{
+    Timing timing (metrics_metrics);
+
+    // set response headers
+    httpd_resp_set_hdr (request, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_type (request, "text/plain; version=0.0.4");
+
+    std::string response;
+    Metric::render (response);
+    httpd_resp_send (request, response.c_str (), response.length ());
+
+    // all done
+    return (ESP_OK);
+}
+
+// frame pipeline trace URL
+static esp_err_t trace_get_handler (httpd_req_t *request)
+{
+    Timing timing (trace_metrics);
+
+    // set response headers
+    httpd_resp_set_hdr (request, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_type (request, "application/json");
+
+    // copy the ring out first so recording is never held up by the sends
+    size_t capacity = MAX (1, CONFIG_CAMERA_TRACE_EVENTS);
+    camera_trace_event_t *events = (camera_trace_event_t *) malloc (capacity * sizeof (camera_trace_event_t));
+    if (events == NULL)
+    {
+        httpd_resp_send_500 (request);
+        return (ESP_OK);
+    }
+
+    size_t count = camera_trace_read (events, capacity);
+
+    // Chrome trace-event format, one row per stage; each event is drawn as a
+    // span from the stage the same frame reached before it
+    char buffer[1024];
+    size_t used = snprintf (buffer, sizeof (buffer), "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+
+    for (int stage = 0; stage < CAMERA_TRACE_STAGES; stage++)
+    {
+        used += snprintf (buffer + used, sizeof (buffer) - used,
+                "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+                stage ? ", " : "", stage, camera_trace_name ((camera_trace_stage_t) stage));
+    }
+
+    for (size_t loop = 0; loop < count; loop++)
+    {
+        const camera_trace_event_t &event = events[loop];
+
+        // look back a few frames' worth of events for the previous stage
+        uint32_t start = event.time;
+        for (size_t back = loop; (back > 0) && (loop - back < 4 * CAMERA_TRACE_STAGES); back--)
+        {
+            if ((events[back - 1].frame == event.frame) && (events[back - 1].stage < event.stage))
+            {
+                start = events[back - 1].time;
+                break;
+            }
+        }
+
+        if (used > sizeof (buffer) - 256)
+        {
+            if (httpd_resp_send_chunk (request, buffer, used) != ESP_OK)
+            {
+                free (events);
+                return (ESP_FAIL);
+            }
+
+            used = 0;
+        }
+
+        used += snprintf (buffer + used, sizeof (buffer) - used,
+                ", {\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %d, \"dur\": %u, "
+                "\"args\": {\"frame\": %u, \"core\": %u}}",
+                camera_trace_name ((camera_trace_stage_t) event.stage), event.stage,
+                (int) (start - events[0].time), event.time - start, event.frame, event.core);
+    }
+
+    used += snprintf (buffer + used, sizeof (buffer) - used, "]}");
+    httpd_resp_send_chunk (request, buffer, used);
+    httpd_resp_send_chunk (request, NULL, 0);
+
+    free (events);
+
+    // all done
+    return (ESP_OK);
+}
+
+// handler for the motor control URL
+static esp_err_t drive_get_handler (httpd_req_t *request)
+{
+    Timing timing (drive_metrics);
+
+    // get the parameters
+    Query query (request);
+    long requested = 0;
+    long value = 0;
+
+    if (query.integer ("T", &requested) && (requested > 0) && ((unsigned long) requested == token))
+    {
+        sessions.driver (request);
+
+        if (query.integer ("L", &value))
+        {
+            int8_t speed = (int8_t) MIN (100, MAX (-100, value));
+            robot->motor (LEFT_MOTOR, speed);
+            if (left != speed)
+            {
+                left = speed;
+                status_version++;
+            }
+        }
+
+        if (query.integer ("R", &value))
+        {
+            int8_t speed = (int8_t) MIN (100, MAX (-100, value));
+            robot->motor (RIGHT_MOTOR, speed);
+            if (right != speed)
+            {
+                right = speed;
+                status_version++;
+            }
+        }
+    }
+
+    ESP_LOGI (TAG, "left: %d, right: %d", left, right);
+
+    produce_status (request);
+
+    // all done
+    return (ESP_OK);
+}
+
+// handler for the camera URL, the session holder picks the frame size
+static esp_err_t camera_get_handler (httpd_req_t *request)
+{
+    Timing timing (camera_metrics);
+
+    if (camera_starting (request))
+    {
+        // all done
+        return (ESP_OK);
+    }
+
+    // get the parameters
+    Query query (request);
+    long requested = 0;
+    long value = 0;
+
+    if (query.integer ("T", &requested) && (requested > 0) && ((unsigned long) requested == token))
+    {
+        sessions.driver (request);
+
+        // the streams switch with their next frame, see esp_camera_fb_get
+        sensor_t *sensor = esp_camera_sensor_get ();
+        if (sensor && query.integer ("F", &value) && (value >= 0) && (value < FRAMESIZE_INVALID) && (value != framesize))
+        {
+            if (sensor->set_framesize (sensor, (framesize_t) value) == 0)
+            {
+                framesize = value;
+                status_version++;
+
+                // the next boot starts at this size, see init_camera
+                if (esp_camera_save_to_nvs ("camera") != ESP_OK)
+                {
+                    ESP_LOGW (TAG, "could not save the camera settings");
+                }
+            }
+        }
+    }
+
+    produce_status (request);
+
+    // all done
+    return (ESP_OK);
+}
+
+// motion detector URL, the session holder may set the sensitivity
+static esp_err_t motion_get_handler (httpd_req_t *request)
+{
+    Timing timing (motion_metrics);
+
+    // get the parameters
+    Query query (request);
+    long requested = 0;
+    long value = 0;
+    bool authorized = query.integer ("T", &requested) && (requested > 0) && ((unsigned long) requested == token);
+
+    if (authorized)
+    {
+        sessions.driver (request);
+
+        if (query.integer ("S", &value))
+        {
+            motion.sensitivity (value);
+        }
+    }
+    else if (throttled (request))
+    {
+        // all done
+        return (ESP_OK);
+    }
+
+    // set response headers
+    httpd_resp_set_hdr (request, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_type (request, "application/json");
+
+    char response[512];
+    Json json (response, sizeof (response));
+
+    json.begin ()
+        .field ("period", (int32_t) CONFIG_MINDBRIDGE_MOTION_PERIOD)
+        .field ("width", (int32_t) motion.width ())
+        .field ("height", (int32_t) motion.height ())
+        .field ("columns", (int32_t) motion.columns ())
+        .field ("rows", (int32_t) motion.rows ())
+        .field ("sensitivity", (int32_t) motion.sensitivity ())
+        .field ("trigger", (int32_t) motion.trigger ())
+        .field ("level", (int32_t) motion.level ())
+        .field ("triggered", (int32_t) motion.triggered ())
+        .field ("events", motion.events ())
+        .field ("frames", motion.frames ())
+        .array ("scores");
+
+    for (int region = 0; region < motion.columns () * motion.rows (); region++)
+    {
+        json.field (NULL, (int32_t) motion.score (region));
+    }
+
+    json.end ().end ();
+    httpd_resp_send (request, json.text (), json.length ());
+
+    // all done
+    return (ESP_OK);
+}
+
+static size_t send_thumbnail (void *argument, size_t index, const void *data, size_t length)
+{
+    httpd_req_t *request = (httpd_req_t *) argument;
+
+    return ((httpd_resp_send_chunk (request, (const char *) data, length) == ESP_OK) ? length : 0);
+}
+
+// preview URL, a 1/8 scale JPEG made from the DC coefficients of a frame
+static esp_err_t thumbnail_get_handler (httpd_req_t *request)
+{
+    Timing timing (thumbnail_metrics);
+
+    if (camera_starting (request))
+    {
+        // all done
+        return (ESP_OK);
+    }
+
+    // get the parameters
+    Query query (request);
+    long requested = 0;
+    long value = 0;
+    bool authorized = query.integer ("T", &requested) && (requested > 0) && ((unsigned long) requested == token);
+    pixformat_t format = (query.integer ("G", &value) && value) ? PIXFORMAT_GRAYSCALE : PIXFORMAT_RGB888;
+    int quality = query.integer ("Q", &value) ? MIN (100, MAX (1, value)) : 80;
+
+    // each preview takes a frame, so others may not ask too often
+    if (!authorized && throttled (request))
+    {
+        // all done
+        return (ESP_OK);
+    }
+
+    camera_fb_t *fb = esp_camera_fb_get ();
+    if (fb == NULL)
+    {
+        frames_dropped.add ();
+        httpd_resp_send_500 (request);
+        return (ESP_OK);
+    }
+
+    frames_captured.add ();
+
+    // decode the thumbnail and let the camera have its buffer back before encoding
+    size_t length = 0;
+    uint8_t *data = orient_frame (fb, &length);
+    size_t size = ((fb->width + 7) / 8) * ((fb->height + 7) / 8) * ((format == PIXFORMAT_GRAYSCALE) ? 1 : 3);
+    uint8_t *pixels = (uint8_t *) malloc (size);
+    uint16_t width = 0;
+    uint16_t height = 0;
+    bool decoded = pixels && jpg2thumbnail (data, length, format, pixels, size, &width, &height);
+
+    if (data != fb->buf)
+    {
+        free (data);
+    }
+
+    esp_camera_fb_return (fb);
+
+    if (!decoded)
+    {
+        free (pixels);
+        frames_bad.add ();
+        httpd_resp_send_500 (request);
+        return (ESP_OK);
+    }
+
+    // set response headers
+    httpd_resp_set_hdr (request, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_type (request, "image/jpeg");
+
+    fmt2jpg_cb (pixels, size, width, height, format, quality, send_thumbnail, request);
+    httpd_resp_send_chunk (request, NULL, 0);
+
+    free (pixels);
+
+    // all done
+    return (ESP_OK);
+}
+
+// the recording saved to flash, which outlasts a restart
+#define RECORDING_FILE "/local/recording.avi"
+
+// one HTTP chunk on a socket taken over from its request, 0 bytes end the response
+static bool send_chunk (httpd_handle_t hd, int fd, const void *data, size_t length)
+{
+    char size[16];
+    snprintf (size, sizeof (size), "%zx\r\n", length);
+
+    return ((httpd_default_send (hd, fd, size, strlen (size), 0) > 0)
+            && ((length == 0) || (httpd_default_send (hd, fd, (const char *) data, length, 0) > 0))
+            && (httpd_default_send (hd, fd, "\r\n", 2, 0) > 0));
+}
+
+// AVI output to a download, which can only go forward
+static bool send_avi (void *argument, size_t offset, const void *data, size_t length)
+{
+    struct recording_resp_arg *parameters = (struct recording_resp_arg *) argument;
+
+    return (send_chunk (parameters->hd, parameters->fd, data, length));
+}
+
+// AVI output to a file, which seeks back for the header at the end
+static bool write_avi (void *argument, size_t offset, const void *data, size_t length)
+{
+    FILE *file = (FILE *) argument;
+
+    if ((ftell (file) != (long) offset) && (fseek (file, offset, SEEK_SET) != 0))
+    {
+        return (false);
+    }
+
+    return (fwrite (data, 1, length, file) == length);
+}
+
+// an AVI of the frozen recording, its frame period the average of the frames'
+static Avi *recording_avi (Avi::output_t output, void *argument)
+{
+    uint32_t frames = recorder.clip_frames ();
+    int64_t period = (frames > 1) ? ((recorder.clip_end () - recorder.clip_start ()) / (frames - 1))
+            : (CONFIG_MINDBRIDGE_RECORDER_PERIOD * 1000LL);
+
+    return (new Avi (output, argument, frames, period));
+}
+
+// the JPEG data of the frames left to a cursor, as an AVI holds them
+static size_t padded_bytes (Recorder::cursor position)
+{
+    size_t length = 0;
+    size_t bytes = 0;
+
+    while (recorder.next (position, &length, NULL))
+    {
+        bytes += (length + 1) & ~1;
+    }
+
+    return (bytes);
+}
+
+static void emit_recording_frame (void *argument)
+{
+    struct recording_resp_arg *parameters = (struct recording_resp_arg *) argument;
+    httpd_handle_t hd = parameters->hd;
+    int fd = parameters->fd;
+
+    // the frames are sent straight out of the ring, until the clip is released
+    if (sessions.streaming (hd, fd))
+    {
+        size_t length = 0;
+        const uint8_t *data = recorder.next (parameters->position, &length, NULL);
+        bool sent = data && (parameters->avi ? parameters->avi->frame (data, length)
+                : (httpd_default_send (hd, fd, (const char *) data, length, 0) > 0));
+
+        if (sent)
+        {
+            recording_bytes.add (length);
+
+            if (parameters->position.remaining > 0)
+            {
+                httpd_queue_work (hd, emit_recording_frame, argument);
+                return;
+            }
+
+            // the index and the last chunk end an AVI
+            if (parameters->avi && parameters->avi->finish (false))
+            {
+                send_chunk (hd, fd, NULL, 0);
+            }
+        }
+    }
+
+    downloads = MAX (0, downloads - 1);
+    sessions.finish (hd, fd);
+
+    delete parameters->avi;
+    free (argument);
+}
+
+// starts sending the frozen recording, one frame per turn of the web server task
+static void download_recording (httpd_req_t *request, bool avi)
+{
+    // a download holds its socket like a video stream
+    if (!admission.stream (streaming + downloads, active) || !sessions.stream (request))
+    {
+        httpd_resp_set_hdr (request, "Access-Control-Allow-Origin", "*");
+        httpd_resp_set_hdr (request, "Retry-After", "5");
+        httpd_resp_set_status (request, "503 Service Unavailable");
+        httpd_resp_sendstr (request, "too many video streams");
+        return;
+    }
+
+    struct recording_resp_arg *argument = (struct recording_resp_arg *) malloc (sizeof (struct recording_resp_arg));
+    char buffer[256];
+
+    argument->hd = request->handle;
+    argument->fd = httpd_req_to_sockfd (request);
+    argument->avi = NULL;
+    recorder.rewind (argument->position);
+
+    if (avi)
+    {
+        // the header goes out first, so it is given the sizes before the frames
+        argument->avi = recording_avi (send_avi, argument);
+        argument->avi->expect (recorder.clip_frames (), padded_bytes (argument->position));
+
+        snprintf (buffer, sizeof (buffer), "HTTP/1.1 200 OK\r\n"
+                "Content-Type: video/x-msvideo\r\n"
+                "Transfer-Encoding: chunked\r\n"
+                "Content-Disposition: attachment; filename=\"recording-%u.avi\"\r\n"
+                "Access-Control-Allow-Origin: *\r\n"
+                "Connection: close\r\n\r\n", recorder.clip ());
+    }
+    else
+    {
+        // the frames back to back, which players take as raw MJPEG
+        snprintf (buffer, sizeof (buffer), "HTTP/1.1 200 OK\r\n"
+                "Content-Type: video/x-motion-jpeg\r\n"
+                "Content-Length: %zu\r\n"
+                "Content-Disposition: attachment; filename=\"recording-%u.mjpeg\"\r\n"
+                "Access-Control-Allow-Origin: *\r\n"
+                "Connection: close\r\n\r\n", recorder.clip_bytes (), recorder.clip ());
+    }
+
+    httpd_default_send_str (argument->hd, argument->fd, buffer, 0);
+
+    downloads++;
+    httpd_queue_work (request->handle, emit_recording_frame, argument);
+}
+
+static void save_recording_frame (void *argument)
+{
+    struct recording_save_arg *parameters = (struct recording_save_arg *) argument;
+    size_t length = 0;
+    const uint8_t *data = recorder.next (parameters->position, &length, NULL);
+    bool written = data && parameters->avi->frame (data, length);
+
+    if (written && (parameters->position.remaining > 0))
+    {
+        httpd_queue_work (parameters->hd, save_recording_frame, argument);
+        return;
+    }
+
+    // the index, then the header again now the sizes are known
+    written = written && parameters->avi->finish (true);
+    fclose (parameters->file);
+
+    if (written)
+    {
+        saved_bytes = parameters->avi->size ();
+        ESP_LOGI (TAG, "saved %u frames of the recording, %ld bytes", parameters->avi->frames (), saved_bytes);
+    }
+    else
+    {
+        // a file cut short is left empty, not taken for a recording after a restart
+        FILE *file = fopen (RECORDING_FILE, "w");
+
+        if (file)
+        {
+            fclose (file);
+        }
+
+        ESP_LOGW (TAG, "failed to save the recording");
+    }
+
+    saving = false;
+
+    delete parameters->avi;
+    free (argument);
+}
+
+// starts writing the frozen recording to flash as an AVI, one frame per turn of the web server task
+static void save_recording (httpd_req_t *request)
+{
+    if (saving || !recorder.frozen ())
+    {
+        return;
+    }
+
+    // the old recording goes first, so its room counts as free
+    FILE *file = fopen (RECORDING_FILE, "w");
+
+    if (file == NULL)
+    {
+        ESP_LOGE (TAG, "failed to open %s for writing", RECORDING_FILE);
+        return;
+    }
+
+    saved_bytes = 0;
+
+    // SPIFFS slows down and cannot collect its garbage when nearly full, a quarter stays free
+    size_t total = 0;
+    size_t used = 0;
+    size_t room = 0;
+
+    if ((esp_spiffs_info (NULL, &total, &used) == ESP_OK) && (total - used > total / 4))
+    {
+        room = total - used - total / 4;
+    }
+
+    struct recording_save_arg *argument = (struct recording_save_arg *) malloc (sizeof (struct recording_save_arg));
+
+    argument->hd = request->handle;
+    argument->file = file;
+    recorder.rewind (argument->position);
+
+    // when the frames do not all fit, those nearest the event are kept
+    size_t bytes = padded_bytes (argument->position);
+    size_t length = 0;
+
+    while ((argument->position.remaining > 0) && (Avi::length (argument->position.remaining, bytes) > room))
+    {
+        recorder.next (argument->position, &length, NULL);
+        bytes -= (length + 1) & ~1;
+    }
+
+    if (argument->position.remaining == 0)
+    {
+        ESP_LOGW (TAG, "no room to save the recording, %zu bytes free", total - used);
+        fclose (file);
+        free (argument);
+        return;
+    }
+
+    argument->avi = recording_avi (write_avi, file);
+    saving = true;
+    httpd_queue_work (request->handle, save_recording_frame, argument);
+}
+
+// the size of the recording saved to flash, 0 for none
+static long saved_recording (void)
+{
+    if (saved_bytes < 0)
+    {
+        FILE *file = fopen (RECORDING_FILE, "r");
+
+        saved_bytes = 0;
+
+        if (file)
+        {
+            fseek (file, 0, SEEK_END);
+            saved_bytes = ftell (file);
+            fclose (file);
+        }
+    }
+
+    return (saved_bytes);
+}
+
+// sends the recording saved to flash as it is
+static void send_saved_recording (httpd_req_t *request)
+{
+    FILE *file = (!saving && (saved_recording () > 0)) ? fopen (RECORDING_FILE, "r") : NULL;
+
+    httpd_resp_set_hdr (request, "Access-Control-Allow-Origin", "*");
+
+    if (file == NULL)
+    {
+        httpd_resp_set_status (request, "404 Not Found");
+        httpd_resp_sendstr (request, "no recording saved");
+        return;
+    }
+
+    httpd_resp_set_type (request, "video/x-msvideo");
+    httpd_resp_set_hdr (request, "Content-Disposition", "attachment; filename=\"recording.avi\"");
+
+    char buffer[1024];
+    size_t bytes;
+
+    while ((bytes = fread (buffer, 1, sizeof (buffer), file)) > 0)
+    {
+        if (httpd_resp_send_chunk (request, buffer, bytes) != ESP_OK)
+        {
+            break;
+        }
+    }
+
+    httpd_resp_send_chunk (request, NULL, 0);
+    fclose (file);
+}
+
+//
+// recorder URL, the session holder may freeze the recent history (X=1),
+// download it as MJPEG (D=1) or AVI (D=2), save it to flash as AVI (S=1),
+// download the saved AVI (D=3) and release the recording to record again
+// (R=1) once it is not being saved or downloaded
+//
+static esp_err_t recording_get_handler (httpd_req_t *request)
+{
+    Timing timing (recording_metrics);
+
+    // get the parameters
+    Query query (request);
+    long requested = 0;
+    long value = 0;
+    bool authorized = query.integer ("T", &requested) && (requested > 0) && ((unsigned long) requested == token);
+
+    if (authorized)
+    {
+        sessions.driver (request);
+
+        // the save and the downloads read the frozen frames as they go
+        if (query.integer ("R", &value) && value && !saving && (downloads == 0))
+        {
+            recorder.release ();
+        }
+
+        if (query.integer ("X", &value) && value)
+        {
+            freeze_recording ("request");
+        }
+
+        if (query.integer ("S", &value) && value)
+        {
+            save_recording (request);
+        }
+
+        if (query.integer ("D", &value) && (value == 3))
+        {
+            send_saved_recording (request);
+
+            // all done
+            return (ESP_OK);
+        }
+
+        if (query.integer ("D", &value) && ((value == 1) || (value == 2)) && recorder.frozen ())
+        {
+            download_recording (request, value == 2);
+
+            // all done
+            return (ESP_OK);
+        }
+    }
+    else if (throttled (request))
+    {
+        // all done
+        return (ESP_OK);
+    }
+
+    // set response headers
+    httpd_resp_set_hdr (request, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_type (request, "application/json");
+
+    char response[512];
+    Json json (response, sizeof (response));
+
+    json.begin ()
+        .field ("size", (uint32_t) recorder.size ())
+        .field ("period", (int32_t) CONFIG_MINDBRIDGE_RECORDER_PERIOD)
+        .field ("history", (int32_t) CONFIG_MINDBRIDGE_RECORDER_HISTORY)
+        .field ("frames", recorder.frames ())
+        .field ("bytes", (uint32_t) recorder.bytes ())
+        .field ("span", (int32_t) ((recorder.newest () - recorder.oldest ()) / 1000))
+        .field ("recorded", recorder.recorded ())
+        .field ("overwritten", recorder.overwritten ())
+        .field ("frozen", (int32_t) recorder.frozen ())
+        .field ("clip", recorder.clip ())
+        .field ("clip_frames", recorder.clip_frames ())
+        .field ("clip_bytes", (uint32_t) recorder.clip_bytes ())
+        .field ("clip_span", (int32_t) ((recorder.clip_end () - recorder.clip_start ()) / 1000))
+        .field ("saving", (int32_t) saving)
+        .field ("saved", (uint32_t) saved_recording ())
+        .end ();
+    httpd_resp_send (request, json.text (), json.length ());
+
+    // all done
+    return (ESP_OK);
+}
+
+static Router router (file_get_handler);
+
+// every request, ahead of its handler
+static void observe_request (httpd_req_t *request)
+{
+    Boot::reached (Boot::FIRST_REQUEST);
+    Sessions::request (request);
+}
+
+static httpd_handle_t start_webserver (void)
+{
+    httpd_handle_t server = NULL;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG ();
+    config.uri_match_fn = httpd_uri_match_wildcard;
+    config.backlog_conn = 16;
+    sessions.configure (config);
+    router.observe (observe_request);
+
+    // service handlers, static files are found by the router itself
+    router.add ("/open", open_get_handler);
+    router.add ("/status", status_get_handler);
+    router.add ("/robot", robot_get_handler);
+    router.add ("/telemetry", telemetry_get_handler);
+    router.add ("/video", video_get_handler);
+    router.add ("/drive", drive_get_handler);
+    router.add ("/camera", camera_get_handler);
+    router.add ("/motion", motion_get_handler);
+    router.add ("/thumbnail", thumbnail_get_handler);
+    router.add ("/recording", recording_get_handler);
+    router.add ("/metrics", metrics_get_handler);
+    router.add ("/trace", trace_get_handler);
+
+    // Start the httpd server
+    ESP_LOGI (TAG, "starting httpd on port: '%d'", config.server_port);
+    if (httpd_start (&server, &config) == ESP_OK)
+    {
+        ESP_LOGI (TAG, "routing %zu static files", Router::assets ());
+        router.register_with (server);
+
+        return (server);
+    }
+
+    ESP_LOGE (TAG, "failed to start httpd");
+    return (NULL);
+}
+
+static void stop_webserver (httpd_handle_t server)
+{
+    // stop the httpd server
+    httpd_stop (server);
 }
 
 // ----
@@ -800,7 +1933,10 @@ void wifi_init_sta (void)
     ESP_ERROR_CHECK (esp_wifi_start () );
 
     ESP_LOGI (TAG, "wifi_init_sta finished.");
+}
 
+void wifi_wait_sta (void)
+{
     /* Waiting until either the connection is established (WIFI_CONNECTED_BIT) or connection failed for the maximum
      * number of re-tries (WIFI_FAIL_BIT). The bits are set by event_handler() (see above) */
     EventBits_t bits = xEventGroupWaitBits (s_wifi_event_group,
@@ -827,8 +1963,6 @@ void wifi_init_sta (void)
     ESP_ERROR_CHECK (esp_event_handler_unregister (IP_EVENT, IP_EVENT_STA_GOT_IP, &event_handler));
     ESP_ERROR_CHECK (esp_event_handler_unregister (WIFI_EVENT, ESP_EVENT_ANY_ID, &event_handler));
     vEventGroupDelete (s_wifi_event_group);
-
-    return;
 }
 
 static void disconnect_handler (void* arg, esp_event_base_t event_base,
@@ -888,13 +2022,14 @@ static camera_config_t camera_config = {
     .frame_size = FRAMESIZE_VGA,    //QQVGA-UXGA Do not use sizes above QVGA when not JPEG
 
     .jpeg_quality = 63, // 12, //0-63 lower number means higher quality
-    .fb_count = 1 // 1       //if more than one, i2s runs in continuous mode. Use only with JPEG
+    .fb_count = 1, // 1       //if more than one, i2s runs in continuous mode. Use only with JPEG
+    .max_frame_size = FRAMESIZE_SVGA // /camera can switch up to this without a restart
 };
 
 static esp_err_t init_camera ()
 {
     //initialize the camera
-    esp_err_t err = esp_camera_init (&camera_config);
+    esp_err_t err = esp_camera_init_from_nvs (&camera_config, "camera");
     if (err != ESP_OK)
     {
         ESP_LOGE (TAG, "Camera Init Failed");
@@ -902,17 +2037,202 @@ static esp_err_t init_camera ()
     }
 
     sensor_t * s = esp_camera_sensor_get ();
-    s->set_hmirror (s, true);
-    s->set_vflip (s, true);
+
+    // a rotation is a mirror, a flip or both and then perhaps a transpose
+    int turns = (CONFIG_MINDBRIDGE_ROTATION / 90) % 4;
+    bool transpose = (turns & 1);
+    bool mirror = (turns == 2) || (turns == 3);
+    bool flip = (turns == 1) || (turns == 2);
+
+#ifdef CONFIG_MINDBRIDGE_MIRROR
+    // mirroring the rotated image is the other axis of the sensor's if it is transposed
+    flip ^= transpose;
+    mirror ^= !transpose;
+#endif
+
+    // the sensor mirrors and flips for nothing, where it can
+    if (s->set_hmirror && (s->set_hmirror (s, mirror) == 0))
+    {
+        mirror = false;
+    }
+
+    if (s->set_vflip && (s->set_vflip (s, flip) == 0))
+    {
+        flip = false;
+    }
+
+    // the rest is done to every frame, by index mirror, flip and transpose
+    static const jpg_transform_t transforms[8] =
+    {
+        JPG_TRANSFORM_NONE, JPG_TRANSFORM_FLIP_H, JPG_TRANSFORM_FLIP_V, JPG_TRANSFORM_ROT_180,
+        JPG_TRANSFORM_TRANSPOSE, JPG_TRANSFORM_ROT_270, JPG_TRANSFORM_ROT_90, JPG_TRANSFORM_TRANSVERSE
+    };
+
+    orientation = transforms[(mirror ? 1 : 0) | (flip ? 2 : 0) | (transpose ? 4 : 0)];
+
+    // the size saved in NVS may differ from the configured one
+    framesize = s->status.framesize;
+    status_version++;
+
+    // so a first boot, or one with a new sensor, has settings to restore next time
+    if (esp_camera_save_to_nvs ("camera") != ESP_OK)
+    {
+        ESP_LOGW (TAG, "could not save the camera settings");
+    }
+
+    return (ESP_OK);
+}
+
+// ---------
+// bluetooth
+// ---------
+
+static esp_err_t init_bluetooth ()
+{
+    esp_err_t ret;
+
+    ESP_ERROR_CHECK (esp_bt_controller_mem_release (ESP_BT_MODE_BLE));
+
+    esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT ();
+    if ((ret = esp_bt_controller_init (&bt_cfg)) != ESP_OK)
+    {
+        ESP_LOGE (TAG, "%s initialize controller failed: %s\n", __func__, esp_err_to_name (ret));
+        return (ret);
+    }
+
+    if ((ret = esp_bt_controller_enable (ESP_BT_MODE_CLASSIC_BT)) != ESP_OK)
+    {
+        ESP_LOGE (TAG, "%s enable controller failed: %s\n", __func__, esp_err_to_name (ret));
+        return (ret);
+    }
+
+    if ((ret = esp_bluedroid_init ()) != ESP_OK)
+    {
+        ESP_LOGE (TAG, "%s initialize bluedroid failed: %s\n", __func__, esp_err_to_name (ret));
+        return (ret);
+    }
+
+    if ((ret = esp_bluedroid_enable ()) != ESP_OK)
+    {
+        ESP_LOGE (TAG, "%s enable bluedroid failed: %s\n", __func__, esp_err_to_name (ret));
+        return (ret);
+    }
+
+    if ((ret = esp_bt_gap_register_callback (esp_bt_gap_cb)) != ESP_OK)
+    {
+        ESP_LOGE (TAG, "%s gap register failed: %s\n", __func__, esp_err_to_name (ret));
+        return (ret);
+    }
+
+    if ((ret = esp_spp_register_callback (esp_spp_cb)) != ESP_OK)
+    {
+        ESP_LOGE (TAG, "%s spp register failed: %s\n", __func__, esp_err_to_name (ret));
+        return (ret);
+    }
+
+    if ((ret = esp_spp_init (esp_spp_mode)) != ESP_OK)
+    {
+        ESP_LOGE (TAG, "%s spp init failed: %s\n", __func__, esp_err_to_name (ret));
+        return (ret);
+    }
+
+    /* Set default parameters for Secure Simple Pairing */
+    esp_bt_sp_param_t param_type = ESP_BT_SP_IOCAP_MODE;
+    esp_bt_io_cap_t iocap = ESP_BT_IO_CAP_IO;
+    esp_bt_gap_set_security_param (param_type, &iocap, sizeof (uint8_t));
+
+    /*
+     * Set default parameters for Legacy Pairing
+     * Use variable pin, input pin code when pairing
+     */
+    esp_bt_pin_type_t pin_type = ESP_BT_PIN_TYPE_VARIABLE;
+    esp_bt_pin_code_t pin_code;
+    esp_bt_gap_set_pin (pin_type, 0, pin_code);
+
+    return (ESP_OK);
+}
+
+// ----------
+// filesystem
+// ----------
+
+static esp_err_t init_filesystem ()
+{
+    esp_vfs_spiffs_conf_t spiffs_conf =
+    {
+        .base_path = "/local",
+        .partition_label = NULL,
+        .max_files = 16,
+        .format_if_mount_failed = false
+    };
+
+    esp_err_t ret = esp_vfs_spiffs_register (&spiffs_conf);
+
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE (TAG, "Failed to initialize SPIFFS (%s)", esp_err_to_name (ret));
+        return (ret);
+    }
+
+    size_t total = 0;
+    size_t used = 0;
+
+    ret = esp_spiffs_info (spiffs_conf.partition_label, &total, &used);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE (TAG, "Failed to get SPIFFS partition information (%s)", esp_err_to_name (ret));
+    }
+    else
+    {
+        ESP_LOGI (TAG, "Partition size: total: %zu, used: %zu", total, used);
+    }
 
     return (ESP_OK);
 }
 
+// ----
+// boot
+// ----
+
+//
+// The camera and Bluetooth bring-up each take hundreds of milliseconds and
+// neither needs the network, so they run in their own tasks while the main
+// task waits for the access point. Each sets its bit once it is done.
+//
+static EventGroupHandle_t s_boot_event_group;
+
+#define BOOT_CAMERA_BIT    BIT0
+#define BOOT_BLUETOOTH_BIT BIT1
+
+static esp_err_t bluetooth_status = ESP_OK;
+
+static void camera_task (void *parameter)
+{
+    Boot::begin (Boot::CAMERA);
+    ESP_ERROR_CHECK (init_camera ());
+    Boot::end (Boot::CAMERA);
+
+    camera_ready.store (true);
+    xEventGroupSetBits (s_boot_event_group, BOOT_CAMERA_BIT);
+    vTaskDelete (NULL);
+}
+
+static void bluetooth_task (void *parameter)
+{
+    Boot::begin (Boot::BLUETOOTH);
+    bluetooth_status = init_bluetooth ();
+    Boot::end (Boot::BLUETOOTH);
+
+    xEventGroupSetBits (s_boot_event_group, BOOT_BLUETOOTH_BIT);
+    vTaskDelete (NULL);
+}
+
 extern "C" void app_main ()
 {
     //
     // initialize NVS
     //
+    Boot::begin (Boot::NVS);
     esp_err_t ret = nvs_flash_init ();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
     {
@@ -920,6 +2240,7 @@ extern "C" void app_main ()
         ret = nvs_flash_init ();
     }
     ESP_ERROR_CHECK (ret);
+    Boot::end (Boot::NVS);
 
     // create the LED interfaces
     led = new LED ((gpio_num_t) CONFIG_MINDBRIDGE_ACTIVITY_LED);
@@ -928,18 +2249,22 @@ extern "C" void app_main ()
     // create the robot interface
     robot = new Robot ("Chad", led);
 
+    // the camera comes up alongside everything else
+    s_boot_event_group = xEventGroupCreate ();
+    xTaskCreatePinnedToCore (camera_task, "camera_init", 4096, NULL, 5, NULL, 0);
+
     //
     // start WIFI and connect to the access point
     //
     ESP_LOGI (TAG, "ESP_WIFI_MODE_STA");
+    Boot::begin (Boot::WIFI);
     wifi_init_sta ();
 
-    static httpd_handle_t server = NULL;
-
-    ESP_ERROR_CHECK (esp_event_handler_register (IP_EVENT, IP_EVENT_STA_GOT_IP, &connect_handler, &server));
-    ESP_ERROR_CHECK (esp_event_handler_register (WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &disconnect_handler, &server));
+    // and Bluetooth while the station associates
+    xTaskCreatePinnedToCore (bluetooth_task, "bluetooth_init", 4096, NULL, 5, NULL, 0);
 
     // configure mDNS
+    Boot::begin (Boot::MDNS);
     ret = mdns_init ();
     ESP_ERROR_CHECK (ret);
 
@@ -948,44 +2273,34 @@ extern "C" void app_main ()
 
     //add our services
     mdns_service_add (NULL, "_http", "_tcp", 80, NULL, 0);
+    Boot::end (Boot::MDNS);
 
     // ------------------------
     // configure the filesystem
     // ------------------------
-
-    esp_vfs_spiffs_conf_t spiffs_conf =
-    {
-        .base_path = "/local",
-        .partition_label = NULL,
-        .max_files = 16,
-        .format_if_mount_failed = false
-    };
-
-    ret = esp_vfs_spiffs_register (&spiffs_conf);
-
-    if (ret != ESP_OK)
+    Boot::begin (Boot::FILESYSTEM);
+    if (init_filesystem () != ESP_OK)
     {
-        ESP_LOGE (TAG, "Failed to initialize SPIFFS (%s)", esp_err_to_name (ret));
         return;
     }
+    Boot::end (Boot::FILESYSTEM);
 
-    size_t total = 0;
-    size_t used = 0;
+    // the association has been going on all this time
+    wifi_wait_sta ();
+    Boot::end (Boot::WIFI);
 
-    ret = esp_spiffs_info (spiffs_conf.partition_label, &total, &used);
-    if (ret != ESP_OK)
-    {
-        ESP_LOGE (TAG, "Failed to get SPIFFS partition information (%s)", esp_err_to_name (ret));
-    }
-    else
-    {
-        ESP_LOGI (TAG, "Partition size: total: %d, used: %d", total, used);
-    }
+    static httpd_handle_t server = NULL;
+
+    ESP_ERROR_CHECK (esp_event_handler_register (IP_EVENT, IP_EVENT_STA_GOT_IP, &connect_handler, &server));
+    ESP_ERROR_CHECK (esp_event_handler_register (WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &disconnect_handler, &server));
 
     // ----------
     // web server
     // ----------
+    Boot::begin (Boot::HTTPD);
     server = start_webserver ();
+    Boot::end (Boot::HTTPD);
+    Boot::reached (Boot::SERVING);
 
 #if 0
     //configure GPIO
@@ -999,66 +2314,35 @@ extern "C" void app_main ()
     gpio_config (&io_conf);
 #endif
 
-    ESP_ERROR_CHECK (esp_bt_controller_mem_release (ESP_BT_MODE_BLE));
-
-    esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT ();
-    if ((ret = esp_bt_controller_init (&bt_cfg)) != ESP_OK)
-    {
-        ESP_LOGE (TAG, "%s initialize controller failed: %s\n", __func__, esp_err_to_name (ret));
-        return;
-    }
+    xEventGroupWaitBits (s_boot_event_group, BOOT_CAMERA_BIT | BOOT_BLUETOOTH_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+    vEventGroupDelete (s_boot_event_group);
 
-    if ((ret = esp_bt_controller_enable (ESP_BT_MODE_CLASSIC_BT)) != ESP_OK)
-    {
-        ESP_LOGE (TAG, "%s enable controller failed: %s\n", __func__, esp_err_to_name (ret));
-        return;
-    }
+    Boot::reached (Boot::READY);
+    Boot::report ();
 
-    if ((ret = esp_bluedroid_init ()) != ESP_OK)
+    // watch for motion and record once the camera is up, as often as the more frequent needs
+    if ((CONFIG_MINDBRIDGE_RECORDER_SIZE > 0) && !recorder.enabled ())
     {
-        ESP_LOGE (TAG, "%s initialize bluedroid failed: %s\n", __func__, esp_err_to_name (ret));
-        return;
+        ESP_LOGW (TAG, "no PSRAM for the %d KB recorder", CONFIG_MINDBRIDGE_RECORDER_SIZE);
     }
 
-    if ((ret = esp_bluedroid_enable ()) != ESP_OK)
-    {
-        ESP_LOGE (TAG, "%s enable bluedroid failed: %s\n", __func__, esp_err_to_name (ret));
-        return;
-    }
+    watch_period = CONFIG_MINDBRIDGE_MOTION_PERIOD;
 
-    if ((ret = esp_bt_gap_register_callback (esp_bt_gap_cb)) != ESP_OK)
+    if (recorder.enabled () && ((watch_period == 0) || (CONFIG_MINDBRIDGE_RECORDER_PERIOD < watch_period)))
     {
-        ESP_LOGE (TAG, "%s gap register failed: %s\n", __func__, esp_err_to_name (ret));
-        return;
+        watch_period = CONFIG_MINDBRIDGE_RECORDER_PERIOD;
     }
 
-    if ((ret = esp_spp_register_callback (esp_spp_cb)) != ESP_OK)
+    if (watch_period > 0)
     {
-        ESP_LOGE (TAG, "%s spp register failed: %s\n", __func__, esp_err_to_name (ret));
-        return;
+        xTaskCreatePinnedToCore (watch_task, "watch", 2048, &server, 4, NULL, 0);
     }
 
-    if ((ret = esp_spp_init (esp_spp_mode)) != ESP_OK)
+    if (bluetooth_status != ESP_OK)
     {
-        ESP_LOGE (TAG, "%s spp init failed: %s\n", __func__, esp_err_to_name (ret));
         return;
     }
 
-    /* Set default parameters for Secure Simple Pairing */
-    esp_bt_sp_param_t param_type = ESP_BT_SP_IOCAP_MODE;
-    esp_bt_io_cap_t iocap = ESP_BT_IO_CAP_IO;
-    esp_bt_gap_set_security_param (param_type, &iocap, sizeof (uint8_t));
-
-    /*
-     * Set default parameters for Legacy Pairing
-     * Use variable pin, input pin code when pairing
-     */
-    esp_bt_pin_type_t pin_type = ESP_BT_PIN_TYPE_VARIABLE;
-    esp_bt_pin_code_t pin_code;
-    esp_bt_gap_set_pin (pin_type, 0, pin_code);
-
-    ESP_ERROR_CHECK (init_camera ());
-
     // use motor controls to keep the connection alive
     while (true)
     {